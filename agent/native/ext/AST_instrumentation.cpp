@@ -36,6 +36,7 @@ extern "C" {
 #include "util_for_PHP.h"
 #include "AST_util.h"
 #include "elastic_apm_alloc.h"
+#include "observer_instrumentation.h"
 
 #define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_AUTO_INSTRUMENT
 
@@ -1638,7 +1639,11 @@ void elasticApmTransformAst( zend_ast* ast )
 
 void astInstrumentationOnModuleInit( const ConfigSnapshot* config )
 {
-    if ( config->astProcessEnabled )
+    if ( isObserverInstrumentationOfUserlandCodeActive() )
+    {
+        ELASTIC_APM_LOG_DEBUG( "zend_ast_process is not changed because userland code is instrumented using zend_observer API" );
+    }
+    else if ( config->astProcessEnabled )
     {
         g_originalZendAstProcess = zend_ast_process;
         g_isOriginalZendAstProcessSet = true;
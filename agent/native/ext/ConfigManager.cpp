@@ -120,9 +120,17 @@ struct SizeOptionAdditionalMetadata
 };
 typedef struct SizeOptionAdditionalMetadata SizeOptionAdditionalMetadata;
 
+struct IntOptionAdditionalMetadata
+{
+    int minValue = 0;
+    int maxValue = 0;
+};
+typedef struct IntOptionAdditionalMetadata IntOptionAdditionalMetadata;
+
 union OptionAdditionalMetadata
 {
     EnumOptionAdditionalMetadata enumData;
+    IntOptionAdditionalMetadata intData;
     DurationOptionAdditionalMetadata durationData;
     SizeOptionAdditionalMetadata sizeData;
 };
@@ -452,6 +460,53 @@ static void parsedSizeValueToZval( const OptionMetadata* optMeta, ParsedOptionVa
     RETURN_DOUBLE( sizeToBytes( parsedValue.u.sizeValue ) );
 }
 
+static ResultCode parseIntValue( const OptionMetadata* optMeta, String rawValue, /* out */ ParsedOptionValue* parsedValue )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( optMeta );
+    ELASTIC_APM_ASSERT_EQ_UINT64( optMeta->defaultValue.type, parsedOptionValueType_int );
+    ELASTIC_APM_ASSERT_VALID_PTR( rawValue );
+    ELASTIC_APM_ASSERT_VALID_PTR( parsedValue );
+    ELASTIC_APM_ASSERT_EQ_UINT64( parsedValue->type, parsedOptionValueType_undefined );
+
+    Int64 parsedInt64;
+    ResultCode parseResultCode = parseDecimalInteger( stringToView( rawValue ), /* out */ &parsedInt64 );
+    if ( parseResultCode != resultSuccess ) return parseResultCode;
+
+    if ( ! ELASTIC_APM_IS_IN_INCLUSIVE_RANGE( optMeta->additionalData.intData.minValue, parsedInt64, optMeta->additionalData.intData.maxValue ) )
+    {
+        ELASTIC_APM_LOG_ERROR(
+                "Failed to parse integer configuration option - value is out of range."
+                " Option name: `%s'. Raw value: `%s'. Valid range: [%d, %d]."
+                , optMeta->name, rawValue, optMeta->additionalData.intData.minValue, optMeta->additionalData.intData.maxValue );
+        return resultParsingFailed;
+    }
+
+    parsedValue->u.intValue = (int)parsedInt64;
+    parsedValue->type = parsedOptionValueType_int;
+    return resultSuccess;
+}
+
+static String streamParsedInt( const OptionMetadata* optMeta, ParsedOptionValue parsedValue, TextOutputStream* txtOutStream )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( optMeta );
+    ELASTIC_APM_ASSERT_EQ_UINT64( optMeta->defaultValue.type, parsedOptionValueType_int );
+    ELASTIC_APM_ASSERT_VALID_PARSED_OPTION_VALUE( parsedValue );
+    ELASTIC_APM_ASSERT_EQ_UINT64( parsedValue.type, optMeta->defaultValue.type );
+
+    return streamInt( parsedValue.u.intValue, txtOutStream );
+}
+
+static void parsedIntValueToZval( const OptionMetadata* optMeta, ParsedOptionValue parsedValue, zval* return_value )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( optMeta );
+    ELASTIC_APM_ASSERT_EQ_UINT64( optMeta->defaultValue.type, parsedOptionValueType_int );
+    ELASTIC_APM_ASSERT_VALID_PARSED_OPTION_VALUE( parsedValue );
+    ELASTIC_APM_ASSERT_EQ_UINT64( parsedValue.type, optMeta->defaultValue.type );
+    ELASTIC_APM_ASSERT_VALID_PTR( return_value );
+
+    RETURN_LONG( (long)( parsedValue.u.intValue ) );
+}
+
 static
 ResultCode parseEnumValue( const OptionMetadata* optMeta, String rawValue, /* out */ ParsedOptionValue* parsedValue )
 {
@@ -516,6 +571,21 @@ static void parsedEnumValueToZval( const OptionMetadata* optMeta, ParsedOptionVa
     RETURN_LONG( (long)( parsedValue.u.intValue ) );
 }
 
+static String streamParsedEnum( const OptionMetadata* optMeta, ParsedOptionValue parsedValue, TextOutputStream* txtOutStream )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( optMeta );
+    ELASTIC_APM_ASSERT_EQ_UINT64( optMeta->defaultValue.type, parsedOptionValueType_int );
+    ELASTIC_APM_ASSERT_VALID_PARSED_OPTION_VALUE( parsedValue );
+    ELASTIC_APM_ASSERT_EQ_UINT64( parsedValue.type, optMeta->defaultValue.type );
+
+    if ( parsedValue.u.intValue < 0 || (size_t)( parsedValue.u.intValue ) >= optMeta->additionalData.enumData.enumElementsCount )
+    {
+        return streamInt( parsedValue.u.intValue, txtOutStream );
+    }
+
+    return streamString( optMeta->additionalData.enumData.names[ parsedValue.u.intValue ], txtOutStream );
+}
+
 static String streamParsedLogLevel( const OptionMetadata* optMeta, ParsedOptionValue parsedValue, TextOutputStream* txtOutStream )
 {
     ELASTIC_APM_ASSERT_VALID_PTR( optMeta );
@@ -667,7 +737,7 @@ static OptionMetadata buildDurationOptionMetadata(
     };
 }
 
-[[maybe_unused]] static OptionMetadata buildSizeOptionMetadata(
+static OptionMetadata buildSizeOptionMetadata(
         String name
         , StringView iniName
         , bool isSecret
@@ -696,6 +766,36 @@ static OptionMetadata buildDurationOptionMetadata(
     };
 }
 
+static OptionMetadata buildIntOptionMetadata(
+        String name
+        , StringView iniName
+        , bool isSecret
+        , bool isDynamic
+        , int defaultValue
+        , SetConfigSnapshotFieldFunc setFieldFunc
+        , GetConfigSnapshotFieldFunc getFieldFunc
+        , int minValue
+        , int maxValue
+)
+{
+    return (OptionMetadata)
+    {
+        .name = name,
+        .iniName = iniName,
+        .isSecret = isSecret,
+        .isDynamic = isDynamic,
+        .isLoggingRelated = false,
+        .defaultValue = { defaultValue },
+        .interpretIniRawValue = &interpretStringIniRawValue,
+        .parseRawValue = &parseIntValue,
+        .streamParsedValue = &streamParsedInt,
+        .setField = setFieldFunc,
+        .getField = getFieldFunc,
+        .parsedValueToZval = &parsedIntValueToZval,
+        .additionalData = (OptionAdditionalMetadata){ .intData = (IntOptionAdditionalMetadata){ .minValue = minValue, .maxValue = maxValue } }
+    };
+}
+
 static OptionMetadata buildEnumOptionMetadata(
         String name
         , StringView iniName
@@ -794,6 +894,9 @@ ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, abortOnMemoryLeak )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, allowAbortDialog )
 #   endif
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, apiKey )
+ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( intValue, apiRequestMaxEventsBatches )
+ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( sizeValue, apiRequestSize )
+ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( durationValue, apiRequestTime )
 #   if ( ELASTIC_APM_ASSERT_ENABLED_01 != 0 )
 ELASTIC_APM_DEFINE_ENUM_FIELD_ACCESS_FUNCS( AssertLevel, assertLevel )
 #   endif
@@ -802,11 +905,19 @@ ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, astProcessDebugDumpConvertedBa
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, astProcessDebugDumpForPathPrefix )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, astProcessDebugDumpOutDir )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( optionalBoolValue, asyncBackendComm )
+ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, backendCommDeferSyncSend )
+ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, backendCommSharedBackoff )
+ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( sizeValue, backendCommSharedRingSize )
+ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, backendCommSidecarSocket )
+ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, backendCommSpillDir )
+ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( sizeValue, backendCommSpillMaxSize )
+ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, backendCommWarmUpConnection )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, bootstrapPhpPartFile )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, breakdownMetrics )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, captureErrors )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, captureErrorsWithPhpPart )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( optionalBoolValue, captureExceptions )
+ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, deferredHookRecordingEnabled )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, devInternal )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, devInternalBackendCommLogVerbose )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, devInternalCaptureErrorsOnlyToLog )
@@ -816,6 +927,7 @@ ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, enabled )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, environment )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, globalLabels )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, hostname )
+ELASTIC_APM_DEFINE_ENUM_FIELD_ACCESS_FUNCS( InstrumentationBackend, instrumentationBackend )
 ELASTIC_APM_DEFINE_ENUM_FIELD_ACCESS_FUNCS( InternalChecksLevel, internalChecksLevel )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, logFile )
 ELASTIC_APM_DEFINE_ENUM_FIELD_ACCESS_FUNCS( LogLevel, logLevel )
@@ -836,6 +948,8 @@ ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, profilingInferredSpansMinDur
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, profilingInferredSpansSamplingInterval )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, sanitizeFieldNames )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, secretToken )
+ELASTIC_APM_DEFINE_ENUM_FIELD_ACCESS_FUNCS( BackendCommCompression, serverRequestCompression )
+ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( intValue, serverRequestCompressionLevel )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( durationValue, serverTimeout )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, serverUrl )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, serviceName )
@@ -846,6 +960,7 @@ ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, spanCompressionExactMatchMax
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, spanCompressionSameKindMaxDuration )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, spanStackTraceMinDuration )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, stackTraceLimit )
+ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, streamingBackendComm )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, transactionIgnoreUrls )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, transactionMaxSpans )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, transactionSampleRate )
@@ -888,7 +1003,13 @@ ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, debugDiagnosticsFile )
 #define ELASTIC_APM_INIT_DYNAMIC_METADATA( buildFunc, fieldName, optName, defaultValue ) \
     ELASTIC_APM_INIT_METADATA_EX( buildFunc, fieldName, optName, /* isSecret */ false, /* isDynamic */ true, defaultValue )
 
-#define ELASTIC_APM_ENUM_INIT_METADATA_EX( fieldName, optName, isDynamic, isLoggingRelated, defaultValue, interpretIniRawValue, enumNamesArray, isUniquePrefixEnoughArg ) \
+#define ELASTIC_APM_INIT_SIZE_METADATA( fieldName, optName, defaultValue, defaultUnits ) \
+    ELASTIC_APM_INIT_METADATA_EX( buildSizeOptionMetadata, fieldName, optName, /* isSecret */ false, /* isDynamic */ false, defaultValue, defaultUnits )
+
+#define ELASTIC_APM_INIT_INT_METADATA( fieldName, optName, defaultValue, minValue, maxValue ) \
+    ELASTIC_APM_INIT_METADATA_EX( buildIntOptionMetadata, fieldName, optName, /* isSecret */ false, /* isDynamic */ false, defaultValue, minValue, maxValue )
+
+#define ELASTIC_APM_ENUM_INIT_METADATA_EX( fieldName, optName, isDynamic, isLoggingRelated, defaultValue, interpretIniRawValue, enumNamesArray, isUniquePrefixEnoughArg, streamParsedValueFunc ) \
     initOptionMetadataForId \
     ( \
         optsMeta \
@@ -905,7 +1026,7 @@ ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, debugDiagnosticsFile )
             , interpretIniRawValue \
             , ELASTIC_APM_SET_FIELD_FUNC_NAME( fieldName ) \
             , ELASTIC_APM_GET_FIELD_FUNC_NAME( fieldName ) \
-            , &streamParsedLogLevel \
+            , (streamParsedValueFunc) \
             , (EnumOptionAdditionalMetadata) \
             { \
                 .names = (enumNamesArray), \
@@ -916,10 +1037,10 @@ ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, debugDiagnosticsFile )
     )
 
 #define ELASTIC_APM_ENUM_INIT_METADATA( fieldName, optName, defaultValue, interpretIniRawValue, enumNamesArray, isUniquePrefixEnoughArg ) \
-    ELASTIC_APM_ENUM_INIT_METADATA_EX( fieldName, optName, /* isDynamic */ false, /* isLoggingRelated */ false, defaultValue, interpretIniRawValue, enumNamesArray, isUniquePrefixEnoughArg )
+    ELASTIC_APM_ENUM_INIT_METADATA_EX( fieldName, optName, /* isDynamic */ false, /* isLoggingRelated */ false, defaultValue, interpretIniRawValue, enumNamesArray, isUniquePrefixEnoughArg, &streamParsedEnum )
 
 #define ELASTIC_APM_INIT_LOG_LEVEL_METADATA_EX( fieldName, optName, isDynamic ) \
-    ELASTIC_APM_ENUM_INIT_METADATA_EX( fieldName, optName, isDynamic, /* isLoggingRelated */ true, logLevel_not_set, &interpretEmptyIniRawValueAsOff, logLevelNames, /* isUniquePrefixEnough: */ true )
+    ELASTIC_APM_ENUM_INIT_METADATA_EX( fieldName, optName, isDynamic, /* isLoggingRelated */ true, logLevel_not_set, &interpretEmptyIniRawValueAsOff, logLevelNames, /* isUniquePrefixEnough: */ true, &streamParsedLogLevel )
 
 #define ELASTIC_APM_INIT_LOG_LEVEL_METADATA( fieldName, optName ) \
     ELASTIC_APM_INIT_LOG_LEVEL_METADATA_EX( fieldName, optName, /* isDynamic: */ false )
@@ -957,6 +1078,26 @@ static void initOptionsMetadata( OptionMetadata* optsMeta )
             ELASTIC_APM_CFG_OPT_NAME_API_KEY,
             /* defaultValue: */ NULL );
 
+    ELASTIC_APM_INIT_INT_METADATA(
+            apiRequestMaxEventsBatches
+            , ELASTIC_APM_CFG_OPT_NAME_API_REQUEST_MAX_EVENTS_BATCHES
+            , /* defaultValue */ 100
+            , /* minValue */ 1
+            , /* maxValue */ 10000 );
+
+    ELASTIC_APM_INIT_SIZE_METADATA(
+            apiRequestSize
+            , ELASTIC_APM_CFG_OPT_NAME_API_REQUEST_SIZE
+            , /* defaultValue */ makeSize( 768, sizeUnits_kibibyte )
+            , /* defaultUnits: */ sizeUnits_byte );
+
+    ELASTIC_APM_INIT_DURATION_METADATA(
+            apiRequestTime
+            , ELASTIC_APM_CFG_OPT_NAME_API_REQUEST_TIME
+            , /* defaultValue */ makeDuration( 10, durationUnits_second )
+            , /* defaultUnits: */ durationUnits_second
+            , /* isNegativeValid */ false );
+
     #if ( ELASTIC_APM_ASSERT_ENABLED_01 != 0 )
     ELASTIC_APM_ENUM_INIT_METADATA(
             /* fieldName: */ assertLevel,
@@ -997,6 +1138,48 @@ static void initOptionsMetadata( OptionMetadata* optsMeta )
             ELASTIC_APM_CFG_OPT_NAME_ASYNC_BACKEND_COMM,
             /* defaultValue: */ makeNotSetOptionalBool() );
 
+    ELASTIC_APM_INIT_METADATA(
+            buildBoolOptionMetadata,
+            backendCommDeferSyncSend,
+            ELASTIC_APM_CFG_OPT_NAME_BACKEND_COMM_DEFER_SYNC_SEND,
+            /* defaultValue: */ false );
+
+    ELASTIC_APM_INIT_METADATA(
+            buildBoolOptionMetadata,
+            backendCommSharedBackoff,
+            ELASTIC_APM_CFG_OPT_NAME_BACKEND_COMM_SHARED_BACKOFF,
+            /* defaultValue: */ false );
+
+    ELASTIC_APM_INIT_SIZE_METADATA(
+            backendCommSharedRingSize
+            , ELASTIC_APM_CFG_OPT_NAME_BACKEND_COMM_SHARED_RING_SIZE
+            , /* defaultValue */ makeSize( 0, sizeUnits_byte )
+            , /* defaultUnits: */ sizeUnits_byte );
+
+    ELASTIC_APM_INIT_METADATA(
+            buildStringOptionMetadata,
+            backendCommSidecarSocket,
+            ELASTIC_APM_CFG_OPT_NAME_BACKEND_COMM_SIDECAR_SOCKET,
+            /* defaultValue: */ NULL );
+
+    ELASTIC_APM_INIT_METADATA(
+            buildStringOptionMetadata,
+            backendCommSpillDir,
+            ELASTIC_APM_CFG_OPT_NAME_BACKEND_COMM_SPILL_DIR,
+            /* defaultValue: */ NULL );
+
+    ELASTIC_APM_INIT_SIZE_METADATA(
+            backendCommSpillMaxSize
+            , ELASTIC_APM_CFG_OPT_NAME_BACKEND_COMM_SPILL_MAX_SIZE
+            , /* defaultValue */ makeSize( 64, sizeUnits_mebibyte )
+            , /* defaultUnits: */ sizeUnits_byte );
+
+    ELASTIC_APM_INIT_METADATA(
+            buildBoolOptionMetadata,
+            backendCommWarmUpConnection,
+            ELASTIC_APM_CFG_OPT_NAME_BACKEND_COMM_WARM_UP_CONNECTION,
+            /* defaultValue: */ false );
+
     ELASTIC_APM_INIT_METADATA(
             buildStringOptionMetadata,
             bootstrapPhpPartFile,
@@ -1027,6 +1210,12 @@ static void initOptionsMetadata( OptionMetadata* optsMeta )
             ELASTIC_APM_CFG_OPT_NAME_CAPTURE_EXCEPTIONS,
             /* defaultValue: */ makeNotSetOptionalBool() );
 
+    ELASTIC_APM_INIT_METADATA(
+            buildBoolOptionMetadata,
+            deferredHookRecordingEnabled,
+            ELASTIC_APM_CFG_OPT_NAME_DEFERRED_HOOK_RECORDING_ENABLED,
+            /* defaultValue: */ false );
+
     ELASTIC_APM_INIT_METADATA(
             buildStringOptionMetadata,
             devInternal,
@@ -1081,6 +1270,14 @@ static void initOptionsMetadata( OptionMetadata* optsMeta )
             ELASTIC_APM_CFG_OPT_NAME_HOSTNAME,
             /* defaultValue: */ NULL );
 
+    ELASTIC_APM_ENUM_INIT_METADATA(
+            /* fieldName: */ instrumentationBackend,
+            /* optName: */ ELASTIC_APM_CFG_OPT_NAME_INSTRUMENTATION_BACKEND,
+            /* defaultValue: */ instrumentationBackend_handlerAndAst,
+            &interpretStringIniRawValue,
+            instrumentationBackendNames,
+            /* isUniquePrefixEnough: */ false );
+
     ELASTIC_APM_ENUM_INIT_METADATA(
             /* fieldName: */ internalChecksLevel,
             /* optName: */ ELASTIC_APM_CFG_OPT_NAME_INTERNAL_CHECKS_LEVEL,
@@ -1161,6 +1358,21 @@ static void initOptionsMetadata( OptionMetadata* optsMeta )
             ELASTIC_APM_CFG_OPT_NAME_SECRET_TOKEN,
             /* defaultValue: */ NULL );
 
+    ELASTIC_APM_ENUM_INIT_METADATA(
+            /* fieldName: */ serverRequestCompression,
+            /* optName: */ ELASTIC_APM_CFG_OPT_NAME_SERVER_REQUEST_COMPRESSION,
+            /* defaultValue: */ backendCommCompression_off,
+            &interpretEmptyIniRawValueAsOff,
+            backendCommCompressionNames,
+            /* isUniquePrefixEnough: */ false );
+
+    ELASTIC_APM_INIT_INT_METADATA(
+            serverRequestCompressionLevel
+            , ELASTIC_APM_CFG_OPT_NAME_SERVER_REQUEST_COMPRESSION_LEVEL
+            , /* defaultValue */ ELASTIC_APM_BACKEND_COMM_COMPRESSION_DEFAULT_LEVEL
+            , /* minValue */ ELASTIC_APM_BACKEND_COMM_COMPRESSION_MIN_LEVEL
+            , /* maxValue */ ELASTIC_APM_BACKEND_COMM_COMPRESSION_MAX_LEVEL );
+
     ELASTIC_APM_INIT_DURATION_METADATA(
             serverTimeout
             , ELASTIC_APM_CFG_OPT_NAME_SERVER_TIMEOUT
@@ -1222,6 +1434,12 @@ static void initOptionsMetadata( OptionMetadata* optsMeta )
             ELASTIC_APM_CFG_OPT_NAME_STACK_TRACE_LIMIT,
             /* defaultValue: */ NULL );
 
+    ELASTIC_APM_INIT_METADATA(
+            buildBoolOptionMetadata,
+            streamingBackendComm,
+            ELASTIC_APM_CFG_OPT_NAME_STREAMING_BACKEND_COMM,
+            /* defaultValue: */ false );
+
     ELASTIC_APM_INIT_METADATA(
             buildStringOptionMetadata,
             transactionIgnoreUrls,
@@ -1266,6 +1484,8 @@ static void initOptionsMetadata( OptionMetadata* optsMeta )
 #undef ELASTIC_APM_FREE_AND_RESET_FIELD_FUNC_NAME
 
 #undef ELASTIC_APM_INIT_METADATA_EX
+#undef ELASTIC_APM_INIT_SIZE_METADATA
+#undef ELASTIC_APM_INIT_INT_METADATA
 #undef ELASTIC_APM_INIT_METADATA
 #undef ELASTIC_APM_ENUM_INIT_METADATA
 #undef ELASTIC_APM_ENUM_INIT_METADATA_EX
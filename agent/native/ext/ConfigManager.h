@@ -63,6 +63,9 @@ enum OptionId
     optionId_allowAbortDialog,
     #endif
     optionId_apiKey,
+    optionId_apiRequestMaxEventsBatches,
+    optionId_apiRequestSize,
+    optionId_apiRequestTime,
     #if ( ELASTIC_APM_ASSERT_ENABLED_01 != 0 )
     optionId_assertLevel,
     #endif
@@ -71,11 +74,19 @@ enum OptionId
     optionId_astProcessDebugDumpForPathPrefix,
     optionId_astProcessDebugDumpOutDir,
     optionId_asyncBackendComm,
+    optionId_backendCommDeferSyncSend,
+    optionId_backendCommSharedBackoff,
+    optionId_backendCommSharedRingSize,
+    optionId_backendCommSidecarSocket,
+    optionId_backendCommSpillDir,
+    optionId_backendCommSpillMaxSize,
+    optionId_backendCommWarmUpConnection,
     optionId_bootstrapPhpPartFile,
     optionId_breakdownMetrics,
     optionId_captureErrors,
     optionId_captureErrorsWithPhpPart,
     optionId_captureExceptions,
+    optionId_deferredHookRecordingEnabled,
     optionId_devInternal,
     optionId_devInternalBackendCommLogVerbose,
     optionId_devInternalCaptureErrorsOnlyToLog,
@@ -85,6 +96,7 @@ enum OptionId
     optionId_environment,
     optionId_globalLabels,
     optionId_hostname,
+    optionId_instrumentationBackend,
     optionId_internalChecksLevel,
     optionId_logFile,
     optionId_logLevel,
@@ -105,6 +117,8 @@ enum OptionId
     optionId_profilingInferredSpansSamplingInterval,
     optionId_sanitizeFieldNames,
     optionId_secretToken,
+    optionId_serverRequestCompression,
+    optionId_serverRequestCompressionLevel,
     optionId_serverTimeout,
     optionId_serverUrl,
     optionId_serviceName,
@@ -115,6 +129,7 @@ enum OptionId
     optionId_spanCompressionSameKindMaxDuration,
     optionId_spanStackTraceMinDuration,
     optionId_stackTraceLimit,
+    optionId_streamingBackendComm,
     optionId_transactionIgnoreUrls,
     optionId_transactionMaxSpans,
     optionId_transactionSampleRate,
@@ -230,6 +245,9 @@ const ConfigSnapshot* getGlobalCurrentConfigSnapshot();
 #   endif
 
 #define ELASTIC_APM_CFG_OPT_NAME_API_KEY "api_key"
+#define ELASTIC_APM_CFG_OPT_NAME_API_REQUEST_MAX_EVENTS_BATCHES "api_request_max_events_batches"
+#define ELASTIC_APM_CFG_OPT_NAME_API_REQUEST_SIZE "api_request_size"
+#define ELASTIC_APM_CFG_OPT_NAME_API_REQUEST_TIME "api_request_time"
 
 /**
  * Internal configuration option (not included in public documentation)
@@ -257,6 +275,14 @@ const ConfigSnapshot* getGlobalCurrentConfigSnapshot();
  */
 #define ELASTIC_APM_CFG_OPT_NAME_ASYNC_BACKEND_COMM "async_backend_comm"
 
+#define ELASTIC_APM_CFG_OPT_NAME_BACKEND_COMM_DEFER_SYNC_SEND "backend_comm_defer_sync_send"
+#define ELASTIC_APM_CFG_OPT_NAME_BACKEND_COMM_SHARED_BACKOFF "backend_comm_shared_backoff"
+#define ELASTIC_APM_CFG_OPT_NAME_BACKEND_COMM_SHARED_RING_SIZE "backend_comm_shared_ring_size"
+#define ELASTIC_APM_CFG_OPT_NAME_BACKEND_COMM_SIDECAR_SOCKET "backend_comm_sidecar_socket"
+#define ELASTIC_APM_CFG_OPT_NAME_BACKEND_COMM_SPILL_DIR "backend_comm_spill_dir"
+#define ELASTIC_APM_CFG_OPT_NAME_BACKEND_COMM_SPILL_MAX_SIZE "backend_comm_spill_max_size"
+#define ELASTIC_APM_CFG_OPT_NAME_BACKEND_COMM_WARM_UP_CONNECTION "backend_comm_warm_up_connection"
+
 #define ELASTIC_APM_CFG_OPT_NAME_BOOTSTRAP_PHP_PART_FILE "bootstrap_php_part_file"
 #define ELASTIC_APM_CFG_OPT_NAME_BREAKDOWN_METRICS "breakdown_metrics"
 
@@ -264,6 +290,8 @@ const ConfigSnapshot* getGlobalCurrentConfigSnapshot();
 #define ELASTIC_APM_CFG_OPT_NAME_CAPTURE_ERRORS_WITH_PHP_PART "capture_errors_with_php_part"
 #define ELASTIC_APM_CFG_OPT_NAME_CAPTURE_EXCEPTIONS "capture_exceptions"
 
+#define ELASTIC_APM_CFG_OPT_NAME_DEFERRED_HOOK_RECORDING_ENABLED "deferred_hook_recording_enabled"
+
 /**
  * Internal configuration option (not included in public documentation)
  */
@@ -278,6 +306,14 @@ const ConfigSnapshot* getGlobalCurrentConfigSnapshot();
 #define ELASTIC_APM_CFG_OPT_NAME_GLOBAL_LABELS "global_labels"
 #define ELASTIC_APM_CFG_OPT_NAME_HOSTNAME "hostname"
 
+/**
+ * Internal configuration option (not included in public documentation)
+ * `observer' uses zend_observer API (PHP 8.0+) instead of replacing internal functions' handlers and AST processing
+ * (userland code is still instrumented only if ast_process_enabled is true).
+ * @see observer_instrumentation.h
+ */
+#define ELASTIC_APM_CFG_OPT_NAME_INSTRUMENTATION_BACKEND "instrumentation_backend"
+
 /**
  * Internal configuration option (not included in public documentation)
  */
@@ -324,6 +360,8 @@ const ConfigSnapshot* getGlobalCurrentConfigSnapshot();
 
 #define ELASTIC_APM_CFG_OPT_NAME_SANITIZE_FIELD_NAMES "sanitize_field_names"
 #define ELASTIC_APM_CFG_OPT_NAME_SECRET_TOKEN "secret_token"
+#define ELASTIC_APM_CFG_OPT_NAME_SERVER_REQUEST_COMPRESSION "server_request_compression"
+#define ELASTIC_APM_CFG_OPT_NAME_SERVER_REQUEST_COMPRESSION_LEVEL "server_request_compression_level"
 #define ELASTIC_APM_CFG_OPT_NAME_SERVER_TIMEOUT "server_timeout"
 #define ELASTIC_APM_CFG_OPT_NAME_SERVER_URL "server_url"
 #define ELASTIC_APM_CFG_OPT_NAME_SERVICE_NAME "service_name"
@@ -334,6 +372,7 @@ const ConfigSnapshot* getGlobalCurrentConfigSnapshot();
 #define ELASTIC_APM_CFG_OPT_NAME_SPAN_COMPRESSION_SAME_KIND_MAX_DURATION "span_compression_same_kind_max_duration"
 #define ELASTIC_APM_CFG_OPT_NAME_SPAN_STACK_TRACE_MIN_DURATION "span_stack_trace_min_duration"
 #define ELASTIC_APM_CFG_OPT_NAME_STACK_TRACE_LIMIT "stack_trace_limit"
+#define ELASTIC_APM_CFG_OPT_NAME_STREAMING_BACKEND_COMM "streaming_backend_comm"
 #define ELASTIC_APM_CFG_OPT_NAME_TRANSACTION_IGNORE_URLS "transaction_ignore_urls"
 #define ELASTIC_APM_CFG_OPT_NAME_TRANSACTION_MAX_SPANS "transaction_max_spans"
 #define ELASTIC_APM_CFG_OPT_NAME_TRANSACTION_SAMPLE_RATE "transaction_sample_rate"
@@ -25,7 +25,10 @@
 #include "LogLevel.h"
 #include "OptionalBool.h"
 #include "time_util.h" // Duration
+#include "util.h" // Size
 #include "elastic_apm_assert_enabled.h"
+#include "backend_comm_compression.h"
+#include "instrumentation_backend.h"
 
 struct ConfigSnapshot
 {
@@ -37,17 +40,28 @@ struct ConfigSnapshot
     AssertLevel assertLevel = assertLevel_off;
         #endif
     String apiKey = nullptr;
+    int apiRequestMaxEventsBatches = 0;
+    Size apiRequestSize;
+    Duration apiRequestTime;
     bool astProcessEnabled = false;
     bool astProcessDebugDumpConvertedBackToSource = false;
     String astProcessDebugDumpForPathPrefix = nullptr;
     String astProcessDebugDumpOutDir = nullptr;
     OptionalBool asyncBackendComm = ELASTIC_APM_MAKE_NOT_SET_OPTIONAL_BOOL();
+    bool backendCommDeferSyncSend = false;
+    bool backendCommSharedBackoff = false;
+    Size backendCommSharedRingSize;
+    String backendCommSidecarSocket = nullptr;
+    String backendCommSpillDir = nullptr;
+    Size backendCommSpillMaxSize;
+    bool backendCommWarmUpConnection = false;
     String bootstrapPhpPartFile = nullptr;
     bool breakdownMetrics = false;
     bool captureErrors = false;
     bool captureErrorsWithPhpPart = false;
     OptionalBool captureExceptions = ELASTIC_APM_MAKE_NOT_SET_OPTIONAL_BOOL();
     String debugDiagnosticsFile = nullptr;
+    bool deferredHookRecordingEnabled = false;
     String devInternal = nullptr;
     bool devInternalBackendCommLogVerbose = false;
     bool devInternalCaptureErrorsOnlyToLog = false;
@@ -57,6 +71,7 @@ struct ConfigSnapshot
     String environment = nullptr;
     String globalLabels = nullptr;
     String hostname = nullptr;
+    InstrumentationBackend instrumentationBackend = instrumentationBackend_handlerAndAst;
     InternalChecksLevel internalChecksLevel = internalChecksLevel_off;
     String logFile = nullptr;
     LogLevel logLevel = logLevel_off;
@@ -77,6 +92,8 @@ struct ConfigSnapshot
     String profilingInferredSpansSamplingInterval = nullptr;
     String sanitizeFieldNames = nullptr;
     String secretToken = nullptr;
+    BackendCommCompression serverRequestCompression = backendCommCompression_off;
+    int serverRequestCompressionLevel = ELASTIC_APM_BACKEND_COMM_COMPRESSION_DEFAULT_LEVEL;
     String serverUrl = nullptr;
     Duration serverTimeout;
     String serviceName = nullptr;
@@ -87,6 +104,7 @@ struct ConfigSnapshot
     String spanCompressionSameKindMaxDuration = nullptr;
     String spanStackTraceMinDuration = nullptr;
     String stackTraceLimit = nullptr;
+    bool streamingBackendComm = false;
     String transactionIgnoreUrls = nullptr;
     String transactionMaxSpans = nullptr;
     String transactionSampleRate = nullptr;
@@ -31,6 +31,7 @@ enum ResultCode
     resultCurlFailure,
     resultSyncObjUseAfterFork,
     resultBufferIsTooSmall,
+    resultBackingOff,
     resultFailure,
 
     numberOfResultCodes
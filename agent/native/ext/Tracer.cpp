@@ -21,6 +21,7 @@
 #include "elastic_apm_version.h"
 #include "elastic_apm_alloc.h"
 #include "ConfigSnapshot.h"
+#include "metadata_cache.h"
 
 #define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_EXT_INFRA
 
@@ -174,6 +175,9 @@ ResultCode ensureAllComponentsHaveLatestConfig( Tracer* tracer )
 
     resultCode = resultSuccess;
 
+    // Metadata is built from configuration so the cached one might be stale
+    metadataCache_clear();
+
     config = getTracerCurrentConfigSnapshot( tracer );
     ensureInternalChecksLevelHasLatestConfig( tracer, config );
     ELASTIC_APM_CALL_IF_FAILED_GOTO( ensureLoggerHasLatestConfig( &tracer->logger, config ) );
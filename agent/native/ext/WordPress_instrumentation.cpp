@@ -22,6 +22,10 @@
 #include "AST_instrumentation.h"
 #include "util.h"
 #include "TextOutputStream.h"
+#include "observer_instrumentation.h"
+#include "tracer_PHP_part.h"
+#include "constants.h"
+#include <zend_API.h>
 
 #define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_AUTO_INSTRUMENT
 
@@ -49,6 +53,7 @@ struct WordPressInstrumentationRequestScopedState
 {
     bool isInFailedMode;
     bool seenFile[ number_of_WordPress_instrumentation_files_to_transform_AST ];
+    bool isSetReadyToWrapFilterCallbacksCalled;
 };
 typedef struct WordPressInstrumentationRequestScopedState WordPressInstrumentationRequestScopedState;
 
@@ -76,6 +81,7 @@ void wordPressInstrumentationOnRequestInit()
     {
         g_wordPressInstrumentationRequestScopedState.seenFile[ i ] = false;
     }
+    g_wordPressInstrumentationRequestScopedState.isSetReadyToWrapFilterCallbacksCalled = false;
 
     ELASTIC_APM_LOG_DEBUG_FUNCTION_EXIT();
 }
@@ -250,3 +256,141 @@ void wordPressInstrumentationTransformAst( size_t fileIndex, StringView compiled
     wordPressInstrumentationSwitchToFailedMode( __FUNCTION__ );
     goto finally;
 }
+
+/**
+ * Functions instrumented by AST transformation above when userland code is instrumented using zend_observer API instead
+ */
+struct WordPressInstrumentationFunctionToObserve
+{
+    StringView className;
+    StringView functionName;
+    uint32_t minParamsCount;
+};
+typedef struct WordPressInstrumentationFunctionToObserve WordPressInstrumentationFunctionToObserve;
+
+static WordPressInstrumentationFunctionToObserve g_functionsToObserve[ number_of_WordPress_instrumentation_files_to_transform_AST ] =
+{
+    // function _wp_filter_build_unique_id( $hook_name, $callback, $priority )
+    [ wordPress_instrumentation_file_to_transform_AST_plugin_php ] = { ELASTIC_APM_STRING_LITERAL_TO_VIEW( "" ), ELASTIC_APM_STRING_LITERAL_TO_VIEW( "_wp_filter_build_unique_id" ), 3 },
+    // public function add_filter( $hook_name, $callback, $priority, $accepted_args )
+    [ wordPress_instrumentation_file_to_transform_AST_class_wp_hook_php ] = { ELASTIC_APM_STRING_LITERAL_TO_VIEW( "WP_Hook" ), ELASTIC_APM_STRING_LITERAL_TO_VIEW( "add_filter" ), 4 },
+    // function get_template()
+    [ wordPress_instrumentation_file_to_transform_AST_theme_php ] = { ELASTIC_APM_STRING_LITERAL_TO_VIEW( "" ), ELASTIC_APM_STRING_LITERAL_TO_VIEW( "get_template" ), 0 }
+};
+
+static
+bool isZendStringEqualIgnoringCase( const zend_string* zendString, StringView stringView )
+{
+    return areStringViewsEqualIgnoringCase( makeStringView( ZSTR_VAL( zendString ), ZSTR_LEN( zendString ) ), stringView );
+}
+
+static
+bool findFunctionToObserve( const zend_function* func, /* out */ size_t* pFileIndex )
+{
+    if ( func->type != ZEND_USER_FUNCTION || func->common.function_name == NULL || func->op_array.filename == NULL )
+    {
+        return false;
+    }
+
+    ELASTIC_APM_FOR_EACH_INDEX( i, number_of_WordPress_instrumentation_files_to_transform_AST )
+    {
+        const WordPressInstrumentationFunctionToObserve* functionToObserve = &( g_functionsToObserve[ i ] );
+        const bool isScopeMatching = ( func->common.scope == NULL )
+                                     ? isEmptyStringView( functionToObserve->className )
+                                     : isZendStringEqualIgnoringCase( func->common.scope->name, functionToObserve->className );
+        if ( isScopeMatching
+             && isZendStringEqualIgnoringCase( func->common.function_name, functionToObserve->functionName )
+             && func->common.num_args >= functionToObserve->minParamsCount
+             && isStringViewSuffix( makeStringView( ZSTR_VAL( func->op_array.filename ), ZSTR_LEN( func->op_array.filename ) ), g_filesToTransformAstPathSuffix[ i ] ) )
+        {
+            *pFileIndex = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool wordPressInstrumentationShouldObserveFunction( zend_function* func )
+{
+    if ( g_wordPressInstrumentationRequestScopedState.isInFailedMode )
+    {
+        return false;
+    }
+
+    size_t fileIndex;
+    return findFunctionToObserve( func, /* out */ &fileIndex );
+}
+
+static
+void setReadyToWrapFilterCallbacksIfObserving_wp_filter_build_unique_id()
+{
+    if ( g_wordPressInstrumentationRequestScopedState.isSetReadyToWrapFilterCallbacksCalled )
+    {
+        return;
+    }
+    g_wordPressInstrumentationRequestScopedState.isSetReadyToWrapFilterCallbacksCalled = true;
+
+    // See the comment in wordPressInstrumentationTransformFile_plugin_php - PHP part wraps callbacks
+    // only if _wp_filter_build_unique_id is instrumented as well
+    const WordPressInstrumentationFunctionToObserve* functionToObserve = &( g_functionsToObserve[ wordPress_instrumentation_file_to_transform_AST_plugin_php ] );
+    // function name is already in lower case - the same as the keys in the function table
+    zend_function* func = (zend_function*) zend_hash_str_find_ptr( EG( function_table ), functionToObserve->functionName.begin, functionToObserve->functionName.length );
+    size_t fileIndex;
+    if ( func == NULL || ! findFunctionToObserve( func, /* out */ &fileIndex ) || fileIndex != wordPress_instrumentation_file_to_transform_AST_plugin_php )
+    {
+        ELASTIC_APM_LOG_ERROR( "Function %s was not found", functionToObserve->functionName.begin );
+        return;
+    }
+
+    tracerPhpPartAstInstrumentationDirectCallMethod( ELASTIC_APM_STRING_LITERAL_TO_VIEW( ELASTIC_APM_WORDPRESS_DIRECT_CALL_METHOD_SET_READY_TO_WRAP_FILTER_CALLBACKS ) );
+}
+
+void wordPressInstrumentationOnObservedCallBegin( zend_execute_data* execute_data, /* out */ zval* postHook )
+{
+    ZVAL_NULL( postHook );
+
+    size_t fileIndex;
+    zend_function* func = execute_data->func;
+    if ( g_wordPressInstrumentationRequestScopedState.isInFailedMode || ! findFunctionToObserve( func, /* out */ &fileIndex ) )
+    {
+        return;
+    }
+
+    ELASTIC_APM_LOG_TRACE_FUNCTION_ENTRY_MSG( "fileIndex: %u", (UInt)fileIndex );
+
+    zend_string* className = ( func->common.scope == NULL ) ? NULL : func->common.scope->name;
+    zval capturedArgs;
+    zval discardedPostHook;
+    if ( fileIndex == wordPress_instrumentation_file_to_transform_AST_class_wp_hook_php )
+    {
+        setReadyToWrapFilterCallbacksIfObserving_wp_filter_build_unique_id();
+    }
+
+    switch ( fileIndex )
+    {
+        case wordPress_instrumentation_file_to_transform_AST_plugin_php:
+        case wordPress_instrumentation_file_to_transform_AST_class_wp_hook_php:
+        {
+            // The same arguments as the ones captured by insertPreHookForFunctionWithHookNameCallbackParams
+            ArgCaptureSpec argCaptureSpecArr[] = { /* capture $hook_name by value */ captureArgByValue, /* capture $callback by reference */ captureArgByRef };
+            observerInstrumentationCaptureUserlandCallArgs( execute_data, ELASTIC_APM_MAKE_ARRAY_VIEW_FROM_STATIC( ArgCaptureSpecArrayView, argCaptureSpecArr ), /* out */ &capturedArgs );
+            tracerPhpPartAstInstrumentationPreHook( className, func->common.function_name, &capturedArgs, /* out */ &discardedPostHook );
+            zval_ptr_dtor( &discardedPostHook );
+            break;
+        }
+
+        case wordPress_instrumentation_file_to_transform_AST_theme_php:
+            observerInstrumentationGetAllUserlandCallArgs( execute_data, /* out */ &capturedArgs );
+            tracerPhpPartAstInstrumentationPreHook( className, func->common.function_name, &capturedArgs, /* out */ postHook );
+            break;
+
+        default:
+            ELASTIC_APM_ASSERT( false, "fileIndex: %u", (UInt)fileIndex );
+            return;
+    }
+
+    zval_ptr_dtor( &capturedArgs );
+
+    ELASTIC_APM_LOG_TRACE_FUNCTION_EXIT();
+}
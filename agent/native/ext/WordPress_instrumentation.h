@@ -30,3 +30,6 @@ void wordPressInstrumentationOnRequestShutdown();
 bool wordPressInstrumentationShouldTransformAstInFile( StringView compiledFileFullPath, /* out */ size_t* pFileIndex );
 void wordPressInstrumentationTransformAst( size_t fileIndex, StringView compiledFileFullPath, zend_ast* ast );
 
+bool wordPressInstrumentationShouldObserveFunction( zend_function* func );
+void wordPressInstrumentationOnObservedCallBegin( zend_execute_data* execute_data, /* out */ zval* postHook );
+
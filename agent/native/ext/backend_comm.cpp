@@ -31,8 +31,15 @@
 #include "util_for_PHP.h"
 #include "basic_macros.h"
 #include "backend_comm_backoff.h"
-
-#include <string_view>
+#include "backend_comm_compression.h"
+#include "backend_comm_curl_share.h"
+#include "backend_comm_queue.h"
+#include "backend_comm_server_url.h"
+#include "backend_comm_shared_ring.h"
+#include "backend_comm_sidecar.h"
+#include "backend_comm_spill.h"
+#include "backend_comm_stats.h"
+#include "php_elastic_apm.h"
 
 #define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_BACKEND_COMM
 
@@ -194,9 +201,10 @@ struct ConnectionData
     CURL* curlHandle;
     struct curl_slist* requestHeaders;
     BackendCommBackoff backoff;
+    BackendCommCompressor compressor;
 };
 typedef struct ConnectionData ConnectionData;
-ConnectionData g_connectionData = { .curlHandle = NULL, .requestHeaders = NULL, .backoff = ELASTIC_APM_DEFAULT_BACKEND_COMM_BACKOFF };
+ConnectionData g_connectionData = { .curlHandle = NULL, .requestHeaders = NULL, .backoff = ELASTIC_APM_DEFAULT_BACKEND_COMM_BACKOFF, .compressor = ELASTIC_APM_DEFAULT_BACKEND_COMM_COMPRESSOR };
 
 void cleanupConnectionData( ConnectionData* connectionData )
 {
@@ -213,6 +221,8 @@ void cleanupConnectionData( ConnectionData* connectionData )
         curl_easy_cleanup( connectionData->curlHandle );
         connectionData->curlHandle = NULL;
     }
+
+    backendCommCompressor_cleanup( &connectionData->compressor );
 }
 
 String streamCurlInfoType( curl_infotype value, TextOutputStream* txtOutStream )
@@ -313,54 +323,39 @@ void enableCurlVerboseMode( CURL* curlHandle )
     goto finally;
 }
 
-ResultCode initConnectionData( const ConfigSnapshot* config, ConnectionData* connectionData, StringView userAgentHttpHeader )
+/**
+ * Sets options that are the same for all the handles used to communicate with APM Server
+ */
+static
+ResultCode setConnectionCurlOptions( const ConfigSnapshot* config, CURL* curlHandle )
 {
     ResultCode resultCode;
-    enum { authBufferSize = 256 };
-    char auth[authBufferSize];
-    const char* authKind = NULL;
-    const char* authValue = NULL;
-    int snprintfRetVal;
     char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE ];
     TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
+    CURLSH* curlShare = getBackendCommCurlShare();
 
-    ELASTIC_APM_ASSERT_VALID_PTR( connectionData );
-    ELASTIC_APM_ASSERT( connectionData->curlHandle == NULL, "" );
-    ELASTIC_APM_ASSERT( connectionData->requestHeaders == NULL, "" );
-
-    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY_MSG(
-            "config: {serverUrl: %s, disableSend: %s, serverTimeout: %s, devInternalBackendCommLogVerbose: %s}"
-            "; userAgentHttpHeader: `%s'"
-            "; curl info: %s"
-            , config->serverUrl, boolToString( config->disableSend ), streamDuration( config->serverTimeout, &txtOutStream ), boolToString( config->devInternalBackendCommLogVerbose )
-            , streamStringView( userAgentHttpHeader, &txtOutStream )
-            , streamLibCurlInfo( &txtOutStream ) );
-    textOutputStreamRewind( &txtOutStream );
-
-    connectionData->curlHandle = curl_easy_init();
-    if ( connectionData->curlHandle == NULL )
+    if ( curlShare != NULL )
     {
-        ELASTIC_APM_LOG_ERROR( "curl_easy_init() returned NULL; curl info: %s", streamLibCurlInfo( &txtOutStream ) );
-        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE_EX( resultCurlFailure );
+        ELASTIC_APM_CURL_EASY_SETOPT( curlHandle, CURLOPT_SHARE, curlShare );
     }
 
-    ELASTIC_APM_CURL_EASY_SETOPT( connectionData->curlHandle, CURLOPT_WRITEFUNCTION, logResponse );
+    ELASTIC_APM_CURL_EASY_SETOPT( curlHandle, CURLOPT_WRITEFUNCTION, logResponse );
 
     if ( config->devInternalBackendCommLogVerbose )
     {
-        enableCurlVerboseMode( connectionData->curlHandle );
+        enableCurlVerboseMode( curlHandle );
     }
 
     if ( config->serverTimeout.valueInUnits == 0 )
     {
-        ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY_MSG( "Timeout is disabled. %s (serverTimeout): %s"
-                                                  , ELASTIC_APM_CFG_OPT_NAME_SERVER_TIMEOUT, streamDuration( config->serverTimeout, &txtOutStream ) );
+        ELASTIC_APM_LOG_DEBUG( "Timeout is disabled. %s (serverTimeout): %s"
+                               , ELASTIC_APM_CFG_OPT_NAME_SERVER_TIMEOUT, streamDuration( config->serverTimeout, &txtOutStream ) );
         textOutputStreamRewind( &txtOutStream );
     }
     else
     {
         long serverTimeoutInMilliseconds = (long)durationToMilliseconds( config->serverTimeout );
-        ELASTIC_APM_CURL_EASY_SETOPT( connectionData->curlHandle, CURLOPT_TIMEOUT_MS, serverTimeoutInMilliseconds );
+        ELASTIC_APM_CURL_EASY_SETOPT( curlHandle, CURLOPT_TIMEOUT_MS, serverTimeoutInMilliseconds );
     }
 
     if ( ! config->verifyServerCert )
@@ -375,7 +370,7 @@ ResultCode initConnectionData( const ConfigSnapshot* config, ConnectionData* con
          *
          * @link https://curl.se/libcurl/c/CURLOPT_SSL_VERIFYHOST.html
          */
-        ELASTIC_APM_CURL_EASY_SETOPT( connectionData->curlHandle, CURLOPT_SSL_VERIFYHOST, 0L );
+        ELASTIC_APM_CURL_EASY_SETOPT( curlHandle, CURLOPT_SSL_VERIFYHOST, 0L );
 
         /**
          * This option determines whether curl verifies the authenticity of the peer's certificate. A value of 1 means curl verifies; 0 (zero) means it does not.
@@ -385,9 +380,55 @@ ResultCode initConnectionData( const ConfigSnapshot* config, ConnectionData* con
          *
          * @link https://curl.se/libcurl/c/CURLOPT_SSL_VERIFYPEER.html
          */
-        ELASTIC_APM_CURL_EASY_SETOPT( connectionData->curlHandle, CURLOPT_SSL_VERIFYPEER, 0L );
+        ELASTIC_APM_CURL_EASY_SETOPT( curlHandle, CURLOPT_SSL_VERIFYPEER, 0L );
+    }
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+ResultCode initConnectionData( const ConfigSnapshot* config, ConnectionData* connectionData, StringView userAgentHttpHeader )
+{
+    ResultCode resultCode;
+    enum { authBufferSize = 256 };
+    char auth[authBufferSize];
+    const char* authKind = NULL;
+    const char* authValue = NULL;
+    enum { contentEncodingBufferSize = 64 };
+    char contentEncoding[contentEncodingBufferSize];
+    String contentEncodingValue = backendCommCompressionToContentEncoding( config->serverRequestCompression );
+    int snprintfRetVal;
+    char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE ];
+    TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
+
+    ELASTIC_APM_ASSERT_VALID_PTR( connectionData );
+    ELASTIC_APM_ASSERT( connectionData->curlHandle == NULL, "" );
+    ELASTIC_APM_ASSERT( connectionData->requestHeaders == NULL, "" );
+
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY_MSG(
+            "config: {serverUrl: %s, disableSend: %s, serverTimeout: %s, devInternalBackendCommLogVerbose: %s"
+            ", serverRequestCompression: %s, serverRequestCompressionLevel: %d}"
+            "; userAgentHttpHeader: `%s'"
+            "; curl info: %s"
+            , config->serverUrl, boolToString( config->disableSend ), streamDuration( config->serverTimeout, &txtOutStream ), boolToString( config->devInternalBackendCommLogVerbose )
+            , streamBackendCommCompression( config->serverRequestCompression, &txtOutStream ), config->serverRequestCompressionLevel
+            , streamStringView( userAgentHttpHeader, &txtOutStream )
+            , streamLibCurlInfo( &txtOutStream ) );
+    textOutputStreamRewind( &txtOutStream );
+
+    connectionData->curlHandle = curl_easy_init();
+    if ( connectionData->curlHandle == NULL )
+    {
+        ELASTIC_APM_LOG_ERROR( "curl_easy_init() returned NULL; curl info: %s", streamLibCurlInfo( &txtOutStream ) );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE_EX( resultCurlFailure );
     }
 
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( setConnectionCurlOptions( config, connectionData->curlHandle ) );
+
     // Authorization with API key or secret token if present
     if ( ! isNullOrEmtpyString( config->apiKey ) )
     {
@@ -413,6 +454,19 @@ ResultCode initConnectionData( const ConfigSnapshot* config, ConnectionData* con
         ELASTIC_APM_CALL_IF_FAILED_GOTO( addToCurlStringList( /* in,out */ &connectionData->requestHeaders, auth ) );
     }
     ELASTIC_APM_CALL_IF_FAILED_GOTO( addToCurlStringList( /* in,out */ &connectionData->requestHeaders, "Content-Type: application/x-ndjson" ) );
+
+    if ( contentEncodingValue != NULL )
+    {
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( backendCommCompressor_init( &connectionData->compressor, config->serverRequestCompression, config->serverRequestCompressionLevel ) );
+        snprintfRetVal = snprintf( contentEncoding, contentEncodingBufferSize, "Content-Encoding: %s", contentEncodingValue );
+        if ( snprintfRetVal < 0 || snprintfRetVal >= contentEncodingBufferSize )
+        {
+            ELASTIC_APM_LOG_ERROR( "Failed to build Content-Encoding header. snprintfRetVal: %d. contentEncodingValue: %s.", snprintfRetVal, contentEncodingValue );
+            ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+        }
+        ELASTIC_APM_LOG_TRACE( "Adding header: %s", contentEncoding );
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( addToCurlStringList( /* in,out */ &connectionData->requestHeaders, contentEncoding ) );
+    }
     ELASTIC_APM_CURL_EASY_SETOPT( connectionData->curlHandle, CURLOPT_HTTPHEADER, connectionData->requestHeaders );
 
     ELASTIC_APM_CURL_EASY_SETOPT( connectionData->curlHandle, CURLOPT_USERAGENT, userAgentHttpHeader );
@@ -426,35 +480,198 @@ ResultCode initConnectionData( const ConfigSnapshot* config, ConnectionData* con
     goto finally;
 }
 
-ResultCode syncSendEventsToApmServerWithConn( const ConfigSnapshot* config, ConnectionData* connectionData, StringView serializedEvents )
+/**
+ * Information about APM Server's response that is used to decide whether a failed request should be retried
+ */
+struct ApmServerResponse
+{
+    // 0 if the request failed without receiving HTTP response
+    long httpStatusCode;
+    // 0 if there is no Retry-After HTTP response header
+    UInt retryAfterInSeconds;
+};
+typedef struct ApmServerResponse ApmServerResponse;
+
+static
+void getApmServerResponse( CURL* curlHandle, /* out */ ApmServerResponse* response )
+{
+    curl_easy_getinfo( curlHandle, CURLINFO_RESPONSE_CODE, &( response->httpStatusCode ) );
+
+    response->retryAfterInSeconds = 0;
+    // CURLINFO_RETRY_AFTER was added in libcurl 7.66.0 - it supports both delay-seconds and HTTP-date forms of Retry-After
+#if LIBCURL_VERSION_NUM >= 0x074200
+    curl_off_t retryAfter = 0;
+    if ( curl_easy_getinfo( curlHandle, CURLINFO_RETRY_AFTER, &retryAfter ) == CURLE_OK && retryAfter > 0 )
+    {
+        response->retryAfterInSeconds = (UInt) std::min( retryAfter, (curl_off_t) UINT_MAX );
+    }
+#endif
+}
+
+/**
+ * Backoff state shared by all the processes in the pool - it's set only if backend_comm_shared_backoff configuration option is set.
+ * Each process keeps its own backoff state as well and waits until both of them allow it to send.
+ */
+static elasticapm::php::SharedMemoryState* g_sharedBackoff = NULL;
+
+// Used as the time the process probing whether APM Server has recovered is allowed to keep the rest of the pool waiting
+// when server_timeout configuration option is set to 0 (i.e., timeout is disabled)
+enum { sharedBackoffProbeTimeoutIfServerTimeoutDisabledInSeconds = 30 };
+
+static
+bool getMonotonicTimeInNanoseconds( /* out */ Int64* currentTime )
+{
+    TimeSpec currentTimeSpec;
+    if ( getClockTimeSpec( /* isRealTime */ false, /* out */ &currentTimeSpec ) != resultSuccess )
+    {
+        return false;
+    }
+    *currentTime = ( (Int64) currentTimeSpec.tv_sec ) * ELASTIC_APM_NUMBER_OF_NANOSECONDS_IN_SECOND + currentTimeSpec.tv_nsec;
+    return true;
+}
+
+static
+Int64 getSharedBackoffProbeTimeoutInNanoseconds( const ConfigSnapshot* config )
+{
+    Int64 probeTimeout = ( config->serverTimeout.valueInUnits == 0 )
+            ? ( (Int64) sharedBackoffProbeTimeoutIfServerTimeoutDisabledInSeconds ) * ELASTIC_APM_NUMBER_OF_NANOSECONDS_IN_SECOND
+            : ( (Int64) durationToMilliseconds( config->serverTimeout ) ) * ELASTIC_APM_NUMBER_OF_NANOSECONDS_IN_MILLISECOND;
+    // Streaming request is kept open for api_request_time
+    if ( config->streamingBackendComm )
+    {
+        probeTimeout += ( (Int64) durationToMilliseconds( config->apiRequestTime ) ) * ELASTIC_APM_NUMBER_OF_NANOSECONDS_IN_MILLISECOND;
+    }
+    return probeTimeout;
+}
+
+/**
+ * @param isAboutToSend if the pool's wait has ended the current process tries to become the one probing whether APM Server has recovered
+ */
+static
+bool shouldWaitForBackoff( const ConfigSnapshot* config, BackendCommBackoff* backoff, bool isAboutToSend )
+{
+    Int64 currentTime;
+
+    if ( backendCommBackoff_shouldWait( backoff ) )
+    {
+        return true;
+    }
+
+    if ( g_sharedBackoff == NULL || ! getMonotonicTimeInNanoseconds( /* out */ &currentTime ) )
+    {
+        return false;
+    }
+
+    if ( isAboutToSend )
+    {
+        return ! g_sharedBackoff->tryToProbeBackendComm( getCurrentProcessId(), currentTime, getSharedBackoffProbeTimeoutInNanoseconds( config ) );
+    }
+
+    return g_sharedBackoff->getBackendCommBackoffTimeLeftToWait( getCurrentProcessId(), currentTime ) > 0;
+}
+
+static
+UInt64 getBackoffTimeLeftToWaitInMilliseconds( BackendCommBackoff* backoff )
+{
+    UInt64 timeLeftInMilliseconds = backendCommBackoff_getTimeLeftToWaitInMilliseconds( backoff );
+    Int64 currentTime;
+    if ( g_sharedBackoff == NULL || ! getMonotonicTimeInNanoseconds( /* out */ &currentTime ) )
+    {
+        return timeLeftInMilliseconds;
+    }
+
+    Int64 sharedTimeLeftInNanoseconds = g_sharedBackoff->getBackendCommBackoffTimeLeftToWait( getCurrentProcessId(), currentTime );
+    // Rounded up so that waiting for the returned time is enough for the backoff to end
+    UInt64 sharedTimeLeftInMilliseconds = (UInt64) ( ( sharedTimeLeftInNanoseconds + ELASTIC_APM_NUMBER_OF_NANOSECONDS_IN_MILLISECOND - 1 ) / ELASTIC_APM_NUMBER_OF_NANOSECONDS_IN_MILLISECOND );
+    return std::max( timeLeftInMilliseconds, sharedTimeLeftInMilliseconds );
+}
+
+static
+void onApmServerRequestSucceeded( ConnectionData* connectionData )
+{
+    backendCommBackoff_onSuccess( &connectionData->backoff );
+    if ( g_sharedBackoff != NULL )
+    {
+        g_sharedBackoff->onBackendCommSuccess();
+    }
+}
+
+static
+void onApmServerRequestFailed( ConnectionData* connectionData, const ApmServerResponse* response )
+{
+    Int64 currentTime;
+
+    // Wait time grows with the number of errors in a row in the whole pool and not only in the current process
+    if ( g_sharedBackoff != NULL )
+    {
+        connectionData->backoff.errorCount = std::max( connectionData->backoff.errorCount, (UInt) g_sharedBackoff->getBackendCommBackoffErrorCount() );
+    }
+
+    if ( response->retryAfterInSeconds == 0 )
+    {
+        backendCommBackoff_onError( &connectionData->backoff );
+    }
+    else
+    {
+        backendCommBackoff_onErrorWithRetryAfter( &connectionData->backoff, response->retryAfterInSeconds );
+    }
+
+    // errorCount is 0 if backoff failed to get current time
+    if ( g_sharedBackoff != NULL && connectionData->backoff.errorCount != 0 && getMonotonicTimeInNanoseconds( /* out */ &currentTime ) )
+    {
+        Int64 waitEndTime = ( (Int64) connectionData->backoff.waitEndTime.tv_sec ) * ELASTIC_APM_NUMBER_OF_NANOSECONDS_IN_SECOND + connectionData->backoff.waitEndTime.tv_nsec;
+        g_sharedBackoff->onBackendCommError( connectionData->backoff.errorCount, waitEndTime, currentTime );
+    }
+
+    cleanupConnectionData( connectionData );
+}
+
+static
+void countApmServerRequest( CURL* curlHandle, bool isFailed )
+{
+    long httpStatusCode = 0;
+    curl_off_t totalTimeInMicroseconds = 0;
+    curl_off_t sentBytesCount = 0;
+
+    curl_easy_getinfo( curlHandle, CURLINFO_RESPONSE_CODE, &httpStatusCode );
+    curl_easy_getinfo( curlHandle, CURLINFO_TOTAL_TIME_T, &totalTimeInMicroseconds );
+    // Unlike CURLOPT_POSTFIELDSIZE it's known for streaming requests as well
+    curl_easy_getinfo( curlHandle, CURLINFO_SIZE_UPLOAD_T, &sentBytesCount );
+    backendCommStats_onRequest( (UInt64) sentBytesCount, httpStatusCode, isFailed, (UInt64) ( totalTimeInMicroseconds / 1000 ) );
+}
+
+ResultCode syncSendEventsToApmServerWithConn( const ConfigSnapshot* config, ConnectionData* connectionData, StringView serializedEvents, /* out */ ApmServerResponse* response )
 {
     ResultCode resultCode;
     CURLcode curlResult;
-    enum { urlBufferSize = 256 };
-    char url[urlBufferSize];
-    int snprintfRetVal;
+    char url[ intakeApiUrlBufferSize ];
     char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE ];
     TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
-    long responseCode = 0;
     bool isFailed = true;
-    const char *serverUrlAndQuerySeparator = std::string_view(config->serverUrl).ends_with('/') ? "" : "/";
+    StringView requestBody;
 
     ELASTIC_APM_ASSERT_VALID_PTR( connectionData );
     ELASTIC_APM_ASSERT( connectionData->curlHandle != NULL, "" );
+    ELASTIC_APM_ASSERT_VALID_PTR( response );
 
-    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY();
+    ELASTIC_APM_ZERO_STRUCT( response );
 
-    ELASTIC_APM_CURL_EASY_SETOPT( connectionData->curlHandle, CURLOPT_POST, 1L );
-    ELASTIC_APM_CURL_EASY_SETOPT( connectionData->curlHandle, CURLOPT_POSTFIELDS, serializedEvents.begin );
-    ELASTIC_APM_CURL_EASY_SETOPT( connectionData->curlHandle, CURLOPT_POSTFIELDSIZE, serializedEvents.length );
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY();
 
-    snprintfRetVal = snprintf( url, urlBufferSize, "%s%sintake/v2/events", config->serverUrl, serverUrlAndQuerySeparator);
-    if ( snprintfRetVal < 0 || snprintfRetVal >= urlBufferSize )
+    if ( connectionData->compressor.zStream == NULL )
     {
-        ELASTIC_APM_LOG_ERROR( "Failed to build full URL to APM Server's intake API. snprintfRetVal: %d", snprintfRetVal );
-        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+        requestBody = serializedEvents;
+    }
+    else
+    {
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( backendCommCompressor_compress( &connectionData->compressor, serializedEvents, /* out */ &requestBody ) );
     }
-    ELASTIC_APM_CURL_EASY_SETOPT( connectionData->curlHandle, CURLOPT_URL, url );
+
+    ELASTIC_APM_CURL_EASY_SETOPT( connectionData->curlHandle, CURLOPT_POST, 1L );
+    ELASTIC_APM_CURL_EASY_SETOPT( connectionData->curlHandle, CURLOPT_POSTFIELDS, requestBody.begin );
+    ELASTIC_APM_CURL_EASY_SETOPT( connectionData->curlHandle, CURLOPT_POSTFIELDSIZE, requestBody.length );
+
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( setIntakeApiUrlCurlOptions( connectionData->curlHandle, config->serverUrl, /* out */ url ) );
 
     curlResult = curl_easy_perform( connectionData->curlHandle );
     if ( curlResult != CURLE_OK )
@@ -469,17 +686,21 @@ ResultCode syncSendEventsToApmServerWithConn( const ConfigSnapshot* config, Conn
                 , curl_easy_strerror( curlResult )
                 , streamLibCurlInfo( &txtOutStream )
                 , streamCurrentProcessCommandLine( &txtOutStream, /* maxLength */ 200 ) );
+        countApmServerRequest( connectionData->curlHandle, /* isFailed */ true );
         ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
     }
 
-    curl_easy_getinfo( connectionData->curlHandle, CURLINFO_RESPONSE_CODE, &responseCode );
+    getApmServerResponse( connectionData->curlHandle, /* out */ response );
     /**
      *  If the HTTP response status code isn’t 2xx or if a request is prematurely closed (either on the TCP or HTTP level) the request MUST be considered failed.
      *
      * @see https://github.com/elastic/apm/blob/d8cb5607dbfffea819ab5efc9b0743044772fb23/specs/agents/transport.md#transport-errors
      */
-    isFailed = ( responseCode / 100 ) != 2;
-    ELASTIC_APM_LOG_WITH_LEVEL( isFailed ? logLevel_error : logLevel_debug, "Sent events to APM Server. Response HTTP code: %ld. URL: `%s'.", responseCode, url );
+    isFailed = ( response->httpStatusCode / 100 ) != 2;
+    countApmServerRequest( connectionData->curlHandle, isFailed );
+    ELASTIC_APM_LOG_WITH_LEVEL( isFailed ? logLevel_error : logLevel_debug
+                                , "Sent events to APM Server. Response HTTP code: %ld. Retry-After: %u. URL: `%s'. Events size: %" PRIu64 ". Request body size: %" PRIu64 "."
+                                , response->httpStatusCode, response->retryAfterInSeconds, url, (UInt64)serializedEvents.length, (UInt64)requestBody.length );
     resultCode = isFailed ? resultFailure : resultSuccess;
     finally:
     ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT();
@@ -489,14 +710,23 @@ ResultCode syncSendEventsToApmServerWithConn( const ConfigSnapshot* config, Conn
     goto finally;
 }
 
-ResultCode syncSendEventsToApmServer( const ConfigSnapshot* config, StringView userAgentHttpHeader, StringView serializedEvents )
+/**
+ * @param batchesCount number of batches of events coalesced in serializedEvents - used only for statistics
+ * @param isBackoffAlreadyChecked true if the caller has already checked (and claimed the probe for) backoff just before calling this function
+ * @param isFailureRetriable set only if sending failed - whether there is a chance that sending the same events again succeeds
+ * @return resultBackingOff if the events were not sent because backoff wait time has not elapsed yet -
+ *         the events are neither sent nor counted as dropped so it's up to the caller to either keep or drop them
+ */
+ResultCode syncSendEventsToApmServer( const ConfigSnapshot* config, StringView userAgentHttpHeader, StringView serializedEvents, size_t batchesCount, bool isBackoffAlreadyChecked, /* out */ bool* isFailureRetriable )
 {
     char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE ];
     TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
     ResultCode resultCode;
     ConnectionData* connectionData = &g_connectionData;
+    ApmServerResponse response = { .httpStatusCode = 0, .retryAfterInSeconds = 0 };
 
     ELASTIC_APM_ASSERT_VALID_PTR( connectionData );
+    ELASTIC_APM_ASSERT_VALID_PTR( isFailureRetriable );
 
     ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY_MSG(
             "Sending events to APM Server..."
@@ -516,10 +746,11 @@ ResultCode syncSendEventsToApmServer( const ConfigSnapshot* config, StringView u
         ELASTIC_APM_SET_RESULT_CODE_TO_SUCCESS_AND_GOTO_FINALLY();
     }
 
-    if ( backendCommBackoff_shouldWait( &connectionData->backoff ) )
+    if ( ( ! isBackoffAlreadyChecked ) && shouldWaitForBackoff( config, &connectionData->backoff, /* isAboutToSend */ true ) )
     {
-        ELASTIC_APM_LOG_DEBUG( "Backoff wait time has not elapsed yet - discarding events instead of sending" );
-        ELASTIC_APM_SET_RESULT_CODE_TO_SUCCESS_AND_GOTO_FINALLY();
+        ELASTIC_APM_LOG_DEBUG( "Backoff wait time has not elapsed yet - not sending events" );
+        resultCode = resultBackingOff;
+        goto finally;
     }
 
     if ( connectionData->curlHandle == NULL )
@@ -527,8 +758,9 @@ ResultCode syncSendEventsToApmServer( const ConfigSnapshot* config, StringView u
         ELASTIC_APM_CALL_IF_FAILED_GOTO( initConnectionData( config, connectionData, userAgentHttpHeader ) );
     }
 
-    ELASTIC_APM_CALL_IF_FAILED_GOTO( syncSendEventsToApmServerWithConn( config, connectionData, serializedEvents ) );
-    backendCommBackoff_onSuccess( &connectionData->backoff );
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( syncSendEventsToApmServerWithConn( config, connectionData, serializedEvents, /* out */ &response ) );
+    onApmServerRequestSucceeded( connectionData );
+    backendCommStats_onBatchesSent( batchesCount );
 
     resultCode = resultSuccess;
     finally:
@@ -536,142 +768,209 @@ ResultCode syncSendEventsToApmServer( const ConfigSnapshot* config, StringView u
     return resultCode;
 
     failure:
-    backendCommBackoff_onError( &connectionData->backoff );
-    cleanupConnectionData( connectionData );
+    *isFailureRetriable = isBackendCommFailureRetriable( response.httpStatusCode );
+    onApmServerRequestFailed( connectionData, &response );
     goto finally;
 }
 
-#undef ELASTIC_APM_CURL_EASY_SETOPT
-
-struct DataToSendNode;
-typedef struct DataToSendNode DataToSendNode;
-
-struct DataToSendNode
+/**
+ * Resolves APM Server's host name and does TLS handshake so that the handles sending events find both
+ * in the curl share object's caches instead of paying for them while events are waiting to be sent.
+ * A separate handle is used because connection data is initialized with User-Agent HTTP header of the events it sends.
+ * The request is sent to APM Server's root endpoint (server information) so its response is irrelevant.
+ */
+ResultCode warmUpConnectionToApmServer( const ConfigSnapshot* config )
 {
-    UInt64 id;
+    ResultCode resultCode;
+    CURLcode curlResult;
+    CURL* curlHandle = NULL;
+    String unixSocketPath = NULL;
+    long httpStatusCode = 0;
+    char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE ];
+    TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
 
-    DataToSendNode* prev;
-    DataToSendNode* next;
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY_MSG( "serverUrl: %s", config->serverUrl );
 
-    StringBuffer userAgentHttpHeader;
-    StringBuffer serializedEvents;
-};
+    if ( getBackendCommCurlShare() == NULL || isUnixSocketServerUrl( config->serverUrl, /* out */ &unixSocketPath ) )
+    {
+        ELASTIC_APM_LOG_DEBUG( "There is nothing to warm up - %s", getBackendCommCurlShare() == NULL ? "curl share object is not available" : "APM Server is on the same host" );
+        ELASTIC_APM_SET_RESULT_CODE_TO_SUCCESS_AND_GOTO_FINALLY();
+    }
 
-static void freeDataToSendNode( DataToSendNode** nodeOutPtr )
-{
-    ELASTIC_APM_ASSERT_VALID_IN_PTR_TO_PTR( nodeOutPtr );
+    curlHandle = curl_easy_init();
+    if ( curlHandle == NULL )
+    {
+        ELASTIC_APM_LOG_ERROR( "curl_easy_init() returned NULL; curl info: %s", streamLibCurlInfo( &txtOutStream ) );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE_EX( resultCurlFailure );
+    }
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( setConnectionCurlOptions( config, curlHandle ) );
+    ELASTIC_APM_CURL_EASY_SETOPT( curlHandle, CURLOPT_URL, config->serverUrl );
 
-    freeMallocedStringBuffer( /* in,out */ &( (*nodeOutPtr)->userAgentHttpHeader ) );
-    freeMallocedStringBuffer( /* in,out */ &( (*nodeOutPtr)->serializedEvents ) );
-    ELASTIC_APM_ZERO_STRUCT( *nodeOutPtr );
-    ELASTIC_APM_FREE_INSTANCE_AND_SET_TO_NULL( DataToSendNode, /* in,out */ *nodeOutPtr );
-}
+    curlResult = curl_easy_perform( curlHandle );
+    if ( curlResult != CURLE_OK )
+    {
+        ELASTIC_APM_LOG_WARNING( "Warming up connection to APM Server failed; URL: `%s'; error message: `%s'", config->serverUrl, curl_easy_strerror( curlResult ) );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
 
-struct DataToSendQueue
-{
-    DataToSendNode head;
-    DataToSendNode tail;
-};
-typedef struct DataToSendQueue DataToSendQueue;
+    curl_easy_getinfo( curlHandle, CURLINFO_RESPONSE_CODE, &httpStatusCode );
+    ELASTIC_APM_LOG_DEBUG( "Warmed up connection to APM Server; URL: `%s'; response HTTP code: %ld", config->serverUrl, httpStatusCode );
 
-static void initDataToSendQueue( DataToSendQueue* dataQueue )
-{
-    ELASTIC_APM_ASSERT_VALID_PTR( dataQueue );
+    resultCode = resultSuccess;
+    finally:
+    if ( curlHandle != NULL )
+    {
+        curl_easy_cleanup( curlHandle );
+    }
+    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT();
+    return resultCode;
 
-    dataQueue->head.prev =  NULL;
-    dataQueue->head.next =  &dataQueue->tail;
-    dataQueue->tail.prev =  &dataQueue->head;
-    dataQueue->tail.next =  NULL;
+    failure:
+    goto finally;
 }
 
-static ResultCode addCopyToDataToSendQueue( DataToSendQueue* dataQueue
-                                            , UInt64 id
-                                            , StringView userAgentHttpHeader
-                                            , StringView serializedEvents )
-{
-    ELASTIC_APM_ASSERT_VALID_PTR( dataQueue );
+ConnectionData g_streamingConnectionData = { .curlHandle = NULL, .requestHeaders = NULL, .backoff = ELASTIC_APM_DEFAULT_BACKEND_COMM_BACKOFF, .compressor = ELASTIC_APM_DEFAULT_BACKEND_COMM_COMPRESSOR };
 
+ResultCode initStreamingConnectionData( const ConfigSnapshot* config, ConnectionData* connectionData, StringView userAgentHttpHeader )
+{
     ResultCode resultCode;
-    DataToSendNode* newNode = NULL;
+    char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE ];
+    TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
 
-    ELASTIC_APM_MALLOC_INSTANCE_IF_FAILED_GOTO( DataToSendNode, /* out */ newNode );
-    ELASTIC_APM_ZERO_STRUCT( newNode );
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( initConnectionData( config, connectionData, userAgentHttpHeader ) );
 
-    ELASTIC_APM_CALL_IF_FAILED_GOTO( dupMallocStringView( userAgentHttpHeader, /* out */ &( newNode->userAgentHttpHeader ) ) );
-    ELASTIC_APM_CALL_IF_FAILED_GOTO( dupMallocStringView( serializedEvents, /* out */ &( newNode->serializedEvents ) ) );
+    // Request body size is not known in advance so the body is sent using chunked transfer encoding.
+    // For POST libcurl uses chunked transfer encoding only when it's requested explicitly.
+    //
+    // @link https://curl.se/libcurl/c/CURLOPT_READFUNCTION.html
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( addToCurlStringList( /* in,out */ &connectionData->requestHeaders, "Transfer-Encoding: chunked" ) );
+    ELASTIC_APM_CURL_EASY_SETOPT( connectionData->curlHandle, CURLOPT_HTTPHEADER, connectionData->requestHeaders );
 
     resultCode = resultSuccess;
-
-    newNode->id = id;
-
-    newNode->next = &( dataQueue->tail );
-    newNode->prev = dataQueue->tail.prev;
-    dataQueue->tail.prev->next = newNode;
-    dataQueue->tail.prev = newNode;
-
     finally:
     return resultCode;
 
     failure:
-    freeDataToSendNode( &newNode );
     goto finally;
 }
 
-static
-bool isDataToSendQueueEmpty( const DataToSendQueue* dataQueue )
+/**
+ * Sends one request with the body provided by readCallback.
+ * The request is kept open for as long as readCallback keeps providing data (it's allowed to block waiting for more data)
+ * so the timeout for the whole request is extended by api_request_time.
+ */
+ResultCode syncStreamEventsToApmServerWithConn(
+        const ConfigSnapshot* config
+        , ConnectionData* connectionData
+        , curl_read_callback readCallback
+        , void* readCallbackCtx
+        , /* out */ ApmServerResponse* response )
 {
-    ELASTIC_APM_ASSERT_VALID_PTR( dataQueue );
+    ResultCode resultCode;
+    CURLcode curlResult;
+    char url[ intakeApiUrlBufferSize ];
+    char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE ];
+    TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
+    bool isFailed = true;
 
-    return dataQueue->head.next == &( dataQueue->tail );
-}
+    ELASTIC_APM_ASSERT_VALID_PTR( connectionData );
+    ELASTIC_APM_ASSERT( connectionData->curlHandle != NULL, "" );
+    ELASTIC_APM_ASSERT_VALID_PTR( response );
 
-DataToSendNode* getFirstNodeInDataToSendQueue( DataToSendQueue* dataQueue )
-{
-    ELASTIC_APM_ASSERT_VALID_PTR( dataQueue );
+    ELASTIC_APM_ZERO_STRUCT( response );
 
-    return isDataToSendQueueEmpty( dataQueue ) ? NULL : dataQueue->head.next;
-}
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY();
 
-size_t removeFirstNodeInDataToSendQueue( DataToSendQueue* dataQueue )
-{
-    ELASTIC_APM_ASSERT_VALID_PTR( dataQueue );
-    ELASTIC_APM_ASSERT( ! isDataToSendQueueEmpty( dataQueue ), "" );
+    ELASTIC_APM_CURL_EASY_SETOPT( connectionData->curlHandle, CURLOPT_POST, 1L );
+    ELASTIC_APM_CURL_EASY_SETOPT( connectionData->curlHandle, CURLOPT_READFUNCTION, readCallback );
+    ELASTIC_APM_CURL_EASY_SETOPT( connectionData->curlHandle, CURLOPT_READDATA, readCallbackCtx );
+    if ( config->serverTimeout.valueInUnits != 0 )
+    {
+        long timeoutInMilliseconds = (long)( durationToMilliseconds( config->serverTimeout ) + durationToMilliseconds( config->apiRequestTime ) );
+        ELASTIC_APM_CURL_EASY_SETOPT( connectionData->curlHandle, CURLOPT_TIMEOUT_MS, timeoutInMilliseconds );
+    }
 
-    DataToSendNode* firstNode = dataQueue->head.next;
-    // -1 since terminating '\0' is counted in buffer's size but not in string's length
-    size_t firstNodeDataSize = firstNode->serializedEvents.size - 1;
-    DataToSendNode* newFirstNode = firstNode->next;
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( setIntakeApiUrlCurlOptions( connectionData->curlHandle, config->serverUrl, /* out */ url ) );
 
-    dataQueue->head.next = newFirstNode;
-    newFirstNode->prev = &( dataQueue->head );
+    curlResult = curl_easy_perform( connectionData->curlHandle );
+    if ( curlResult != CURLE_OK )
+    {
+        ELASTIC_APM_LOG_ERROR(
+                "Streaming events to APM Server failed"
+                "; URL: `%s'"
+                "; error message: `%s'"
+                "; curl info: %s"
+                "; current process command line: `%s'"
+                , url
+                , curl_easy_strerror( curlResult )
+                , streamLibCurlInfo( &txtOutStream )
+                , streamCurrentProcessCommandLine( &txtOutStream, /* maxLength */ 200 ) );
+        countApmServerRequest( connectionData->curlHandle, /* isFailed */ true );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
 
-    freeDataToSendNode( &firstNode );
+    getApmServerResponse( connectionData->curlHandle, /* out */ response );
+    isFailed = ( response->httpStatusCode / 100 ) != 2;
+    countApmServerRequest( connectionData->curlHandle, isFailed );
+    ELASTIC_APM_LOG_WITH_LEVEL( isFailed ? logLevel_error : logLevel_debug
+                                , "Streamed events to APM Server. Response HTTP code: %ld. Retry-After: %u. URL: `%s'."
+                                , response->httpStatusCode, response->retryAfterInSeconds, url );
+    resultCode = isFailed ? resultFailure : resultSuccess;
+    finally:
+    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT();
+    return resultCode;
 
-    return firstNodeDataSize;
+    failure:
+    goto finally;
 }
 
-static void freeDataToSendQueue( DataToSendQueue* dataQueue )
+#undef ELASTIC_APM_CURL_EASY_SETOPT
+
+// Each events batch starts with metadata line followed by event lines, lines are separated by '\n'
+static StringView extractMetadataLine( StringView serializedEvents )
 {
-    ELASTIC_APM_ASSERT_VALID_PTR( dataQueue );
+    const char* newLine = (const char*) memchr( serializedEvents.begin, '\n', serializedEvents.length );
+    return newLine == NULL ? serializedEvents : makeStringViewFromBeginEnd( serializedEvents.begin, newLine );
+}
 
-    while ( ! isDataToSendQueueEmpty( dataQueue ) )
-    {
-        removeFirstNodeInDataToSendQueue( dataQueue );
-    }
+static bool canEventsBatchBeCoalescedWith( const DataToSendNode* node, StringView userAgentHttpHeader, StringView metadataLine )
+{
+    return areStringViewsEqual( stringBufferToView( node->userAgentHttpHeader ), userAgentHttpHeader )
+           && areStringViewsEqual( extractMetadataLine( stringBufferToView( node->serializedEvents ) ), metadataLine );
 }
 
 #define ELASTIC_APM_MAX_QUEUE_SIZE_IN_BYTES (10 * 1024 * 1024)
+// When spilling is enabled the queue admits batches above max queue size (up to this limit)
+// so that the background thread spills them instead of them being dropped
+#define ELASTIC_APM_MAX_QUEUE_OVERFLOW_TO_SPILL_IN_BYTES ELASTIC_APM_MAX_QUEUE_SIZE_IN_BYTES
+// How often the thread draining shared ring buffer checks if it should exit
+#define ELASTIC_APM_SHARED_RING_DRAINER_WAIT_IN_MILLISECONDS 1000
+// The drainer signals heartbeat on each wait so the sender is considered gone only if it misses many of them in a row
+#define ELASTIC_APM_SHARED_RING_SENDER_HEARTBEAT_TIMEOUT_IN_MILLISECONDS ( 10 * ELASTIC_APM_SHARED_RING_DRAINER_WAIT_IN_MILLISECONDS )
 
 struct BackgroundBackendComm
 {
-    Mutex* mutex;
-    ConditionVariable* condVar;
+    // Used by the threads queueing events and by the thread exit request to wake up the background thread
+    WakeupEvent* wakeupEvent;
     Thread* thread;
+    // Events are pushed by any thread without locking and consumed only by the background thread
     DataToSendQueue dataToSendQueue;
-    size_t dataToSendTotalSize;
-    size_t nextEventsBatchId;
-    bool shouldExit;
+    // shouldExitBy is set before shouldExit is set and read only after shouldExit is observed as set
+    std::atomic< bool > shouldExit;
     TimeSpec shouldExitBy;
+    // Buffer used to coalesce several queued events batches into one intake API request.
+    // It is accessed only by the background thread.
+    char* coalescedEventsBuffer;
+    size_t coalescedEventsBufferCapacity;
+    // Events that could not be sent - it's open only if backend_comm_spill_dir configuration option is set.
+    // It is accessed only by the background thread.
+    BackendCommSpillFile spillFile;
+    // Set by the background thread after the spill file is opened - read by the threads queueing events
+    std::atomic< bool > isSpillEnabled;
+    // Spilled batch that failed to be sent too many times in a row is dropped so that it doesn't block the batches spilled after it
+    size_t firstSpilledBatchFailedReplaysCount;
+    // Failed attempts to send the batch at the head of the queue - it's kept in the queue while the failure is retriable
+    BackendCommRetry retry;
 };
 typedef struct BackgroundBackendComm BackgroundBackendComm;
 
@@ -684,6 +983,16 @@ struct BackgroundBackendCommSharedStateSnapshot
 };
 typedef struct BackgroundBackendCommSharedStateSnapshot BackgroundBackendCommSharedStateSnapshot;
 
+struct EventsBatchesToSend
+{
+    const DataToSendNode* firstNode;
+    const DataToSendNode* lastNode;
+    size_t count;
+    // Size of the request body after coalescing - metadata line is included only once
+    size_t coalescedSize;
+};
+typedef struct EventsBatchesToSend EventsBatchesToSend;
+
 static inline bool isDataToSendQueueEmptyInSnapshot( const BackgroundBackendCommSharedStateSnapshot* sharedStateSnapshot )
 {
     return sharedStateSnapshot->firstDataToSendNode == NULL;
@@ -714,32 +1023,26 @@ String streamSharedStateSnapshot( const BackgroundBackendCommSharedStateSnapshot
     );
 }
 
-#define ELASTIC_APM_BACKGROUND_BACKEND_COMM_DO_UNDER_LOCK_PROLOG() \
-    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY(); \
-    ELASTIC_APM_ASSERT_VALID_PTR( backgroundBackendComm ); \
-    ResultCode resultCode; \
-    bool shouldUnlockMutex = false; \
-    ELASTIC_APM_CALL_IF_FAILED_GOTO( lockMutex( backgroundBackendComm->mutex, &shouldUnlockMutex, __FUNCTION__ ) );
-
-#define ELASTIC_APM_BACKGROUND_BACKEND_COMM_DO_UNDER_LOCK_EPILOG() \
-    finally: \
-    unlockMutex( backgroundBackendComm->mutex, &shouldUnlockMutex, __FUNCTION__ ); \
-    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT(); \
-    return resultCode; \
-    failure: \
-    goto finally;
-
-void backgroundBackendCommThreadFunc_underLockCopySharedStateToSnapshot(
+/**
+ * Can be called only by the background thread since it moves events batches queued by other threads to the part of the queue accessed only by the background thread
+ */
+void backgroundBackendCommThreadFunc_getSharedStateSnapshot(
         BackgroundBackendComm* backgroundBackendComm
         , /* out */ BackgroundBackendCommSharedStateSnapshot* sharedStateSnapshot
 )
 {
+    ELASTIC_APM_ASSERT_VALID_PTR( backgroundBackendComm );
     ELASTIC_APM_ASSERT_VALID_PTR( sharedStateSnapshot );
 
+    // shouldExit is read before the queue so that if it's set the queue already contains all the events queued before exit was requested
+    sharedStateSnapshot->shouldExit = backgroundBackendComm->shouldExit.load();
+    if ( sharedStateSnapshot->shouldExit )
+    {
+        sharedStateSnapshot->shouldExitBy = backgroundBackendComm->shouldExitBy;
+    }
+    moveDataToSendQueueIntakeToList( &( backgroundBackendComm->dataToSendQueue ) );
     sharedStateSnapshot->firstDataToSendNode = getFirstNodeInDataToSendQueue( &( backgroundBackendComm->dataToSendQueue ) );
-    sharedStateSnapshot->dataToSendTotalSize = backgroundBackendComm->dataToSendTotalSize;
-    sharedStateSnapshot->shouldExit = backgroundBackendComm->shouldExit;
-    sharedStateSnapshot->shouldExitBy = backgroundBackendComm->shouldExitBy;
+    sharedStateSnapshot->dataToSendTotalSize = getDataToSendQueueTotalSize( &( backgroundBackendComm->dataToSendQueue ) );
 }
 
 static inline bool areEqualSharedSnapshots( const BackgroundBackendCommSharedStateSnapshot* val1, const BackgroundBackendCommSharedStateSnapshot* val2 )
@@ -765,22 +1068,10 @@ static inline bool areEqualSharedSnapshots( const BackgroundBackendCommSharedSta
     return true;
 }
 
-ResultCode backgroundBackendCommThreadFunc_getSharedStateSnapshot(
-        BackgroundBackendComm* backgroundBackendComm
-        , /* out */ BackgroundBackendCommSharedStateSnapshot* sharedStateSnapshot
-)
-{
-    ELASTIC_APM_ASSERT_VALID_PTR( sharedStateSnapshot );
-
-    ELASTIC_APM_BACKGROUND_BACKEND_COMM_DO_UNDER_LOCK_PROLOG()
-
-    backgroundBackendCommThreadFunc_underLockCopySharedStateToSnapshot( backgroundBackendComm, /* out */ sharedStateSnapshot );
-
-    ELASTIC_APM_BACKGROUND_BACKEND_COMM_DO_UNDER_LOCK_EPILOG()
-}
-
 ResultCode backgroundBackendCommThreadFunc_shouldBreakLoop(
         const BackgroundBackendCommSharedStateSnapshot* sharedStateSnapshot
+        , bool hasSpilledEventsToReplay
+        , bool isWaitingForBackoff
         , bool* shouldBreakLoop
 )
 {
@@ -788,7 +1079,8 @@ ResultCode backgroundBackendCommThreadFunc_shouldBreakLoop(
 
     if ( sharedStateSnapshot->shouldExit )
     {
-        if ( isDataToSendQueueEmptyInSnapshot( sharedStateSnapshot ) )
+        // Events kept in the queue to be sent again after backoff don't delay the exit
+        if ( ( isDataToSendQueueEmptyInSnapshot( sharedStateSnapshot ) && ! hasSpilledEventsToReplay ) || isWaitingForBackoff )
         {
             *shouldBreakLoop = true;
             goto success;
@@ -816,334 +1108,1042 @@ ResultCode backgroundBackendCommThreadFunc_shouldBreakLoop(
     goto finally;
 }
 
-ResultCode backgroundBackendCommThreadFunc_removeFirstEventsBatchAndUpdateSnapshot(
-        BackgroundBackendComm* backgroundBackendComm
-        , /* out */ BackgroundBackendCommSharedStateSnapshot* sharedStateSnapshot
+void backgroundBackendCommThreadFunc_selectEventsBatchesToSend(
+        const ConfigSnapshot* config
+        , BackgroundBackendComm* backgroundBackendComm
+        , const BackgroundBackendCommSharedStateSnapshot* sharedStateSnapshot
+        , /* out */ EventsBatchesToSend* batchesToSend
 )
 {
-    size_t firstNodeDataSize = 0;
-    ELASTIC_APM_BACKGROUND_BACKEND_COMM_DO_UNDER_LOCK_PROLOG()
+    // This function is called only when data-queue-to-send is not empty
+    // so firstDataToSendNode is not NULL
+    const DataToSendNode* firstNode = sharedStateSnapshot->firstDataToSendNode;
+    StringView firstNodeSerializedEvents = stringBufferToView( firstNode->serializedEvents );
+    StringView userAgentHttpHeader = stringBufferToView( firstNode->userAgentHttpHeader );
+    StringView metadataLine = extractMetadataLine( firstNodeSerializedEvents );
+    Int64 maxRequestSize = sizeToBytes( config->apiRequestSize );
+    size_t maxBatchesCount = (size_t) config->apiRequestMaxEventsBatches;
+
+    // The first batch is always sent even if it's larger than the request size limit
+    batchesToSend->firstNode = firstNode;
+    batchesToSend->lastNode = firstNode;
+    batchesToSend->count = 1;
+    batchesToSend->coalescedSize = firstNodeSerializedEvents.length;
+
+    // Pick up the batches queued since the snapshot was taken
+    moveDataToSendQueueIntakeToList( &( backgroundBackendComm->dataToSendQueue ) );
+
+    // Only this thread accesses the list part of the queue so it's stable without any locking
+    for ( const DataToSendNode* node = firstNode->next
+          ; ( node != &( backgroundBackendComm->dataToSendQueue.tail ) ) && ( batchesToSend->count < maxBatchesCount )
+          ; node = node->next )
+    {
+        if ( ! canEventsBatchBeCoalescedWith( node, userAgentHttpHeader, metadataLine ) )
+        {
+            break;
+        }
+
+        // Only event lines (including the separating '\n') are appended - metadata line is sent only once
+        size_t eventsSize = ( node->serializedEvents.size - 1 ) - metadataLine.length;
+        if ( (Int64) ( batchesToSend->coalescedSize + eventsSize ) > maxRequestSize )
+        {
+            break;
+        }
 
-    firstNodeDataSize = removeFirstNodeInDataToSendQueue( &( backgroundBackendComm->dataToSendQueue ) );
-    backgroundBackendComm->dataToSendTotalSize -= firstNodeDataSize;
+        batchesToSend->lastNode = node;
+        ++batchesToSend->count;
+        batchesToSend->coalescedSize += eventsSize;
+    }
+}
 
-    backgroundBackendCommThreadFunc_underLockCopySharedStateToSnapshot( backgroundBackendComm, /* out */ sharedStateSnapshot );
+void backgroundBackendCommThreadFunc_removeEventsBatchesAndUpdateSnapshot(
+        BackgroundBackendComm* backgroundBackendComm
+        , size_t batchesCount
+        , /* out */ BackgroundBackendCommSharedStateSnapshot* sharedStateSnapshot
+)
+{
+    ELASTIC_APM_FOR_EACH_INDEX( i, batchesCount )
+    {
+        removeFirstNodeInDataToSendQueue( &( backgroundBackendComm->dataToSendQueue ) );
+    }
 
-    ELASTIC_APM_BACKGROUND_BACKEND_COMM_DO_UNDER_LOCK_EPILOG()
+    backgroundBackendCommThreadFunc_getSharedStateSnapshot( backgroundBackendComm, /* out */ sharedStateSnapshot );
 }
 
 ResultCode backgroundBackendCommThreadFunc_waitForChangesInSharedState(
         BackgroundBackendComm* backgroundBackendComm
+        , const TimeSpec* timeoutAbsUtc
         , /* in,out */ BackgroundBackendCommSharedStateSnapshot* sharedStateSnapshot
 )
 {
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY();
+
+    ResultCode resultCode;
     char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE ];
     TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
-
-    ELASTIC_APM_BACKGROUND_BACKEND_COMM_DO_UNDER_LOCK_PROLOG()
-
     BackgroundBackendCommSharedStateSnapshot localSharedStateSnapshot;
-    backgroundBackendCommThreadFunc_underLockCopySharedStateToSnapshot( backgroundBackendComm, /* out */ &localSharedStateSnapshot );
+    bool hasTimedOut;
+
+    // Wait is announced before the shared state is checked again so that any change made after the check wakes us up
+    announceWaitWakeupEvent( backgroundBackendComm->wakeupEvent );
+    backgroundBackendCommThreadFunc_getSharedStateSnapshot( backgroundBackendComm, /* out */ &localSharedStateSnapshot );
     if ( areEqualSharedSnapshots( sharedStateSnapshot, &localSharedStateSnapshot ) )
     {
-        ELASTIC_APM_LOG_DEBUG( "Shared state is the same - we need to wait; shared state snapshots: before lock: %s, after lock: %s"
+        ELASTIC_APM_LOG_DEBUG( "Shared state is the same - we need to wait; shared state snapshots: before: %s, after announcing wait: %s"
                                , streamSharedStateSnapshot( sharedStateSnapshot, &txtOutStream )
                                , streamSharedStateSnapshot( &localSharedStateSnapshot, &txtOutStream ) );
         textOutputStreamRewind( &txtOutStream );
-        ELASTIC_APM_CALL_IF_FAILED_GOTO( waitConditionVariable( backgroundBackendComm->condVar, backgroundBackendComm->mutex, __FUNCTION__ ) );
-        backgroundBackendCommThreadFunc_underLockCopySharedStateToSnapshot( backgroundBackendComm, /* out */ sharedStateSnapshot );
-        ELASTIC_APM_LOG_DEBUG( "Waiting exited; shared state snapshots: after lock: %s, after wait: %s"
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( timedWaitWakeupEvent( backgroundBackendComm->wakeupEvent, timeoutAbsUtc, /* out */ &hasTimedOut, __FUNCTION__ ) );
+        backgroundBackendCommThreadFunc_getSharedStateSnapshot( backgroundBackendComm, /* out */ sharedStateSnapshot );
+        ELASTIC_APM_LOG_DEBUG( "Waiting exited; hasTimedOut: %s; shared state snapshots: after announcing wait: %s, after wait: %s"
+                               , boolToString( hasTimedOut )
                                , streamSharedStateSnapshot( &localSharedStateSnapshot, &txtOutStream )
                                , streamSharedStateSnapshot( sharedStateSnapshot, &txtOutStream ) );
     }
     else
     {
-        ELASTIC_APM_LOG_DEBUG( "Shared state is not the same - there is no need to wait; shared state snapshots: before lock: %s, after lock: %s"
+        ELASTIC_APM_LOG_DEBUG( "Shared state is not the same - there is no need to wait; shared state snapshots: before: %s, after announcing wait: %s"
                                , streamSharedStateSnapshot( sharedStateSnapshot, &txtOutStream )
                                , streamSharedStateSnapshot( &localSharedStateSnapshot, &txtOutStream ) );
         *sharedStateSnapshot = localSharedStateSnapshot;
     }
 
-    ELASTIC_APM_BACKGROUND_BACKEND_COMM_DO_UNDER_LOCK_EPILOG()
-}
-
-ResultCode backgroundBackendCommThreadFunc_sendFirstEventsBatch(
-        const ConfigSnapshot* config
-        , const BackgroundBackendCommSharedStateSnapshot* sharedStateSnapshot )
-{
-    // This function is called only when data-queue-to-send is not empty
-    // so firstDataToSendNode is not NULL
-    StringView serializedEvents = stringBufferToView( sharedStateSnapshot->firstDataToSendNode->serializedEvents );
-
-    ELASTIC_APM_LOG_DEBUG(
-            "About to send batch of events"
-            "; batch ID: %" PRIu64
-            "; batch size: %" PRIu64
-            "; total size of queued events: %" PRIu64
-            , (UInt64) sharedStateSnapshot->firstDataToSendNode->id
-            , (UInt64) serializedEvents.length
-            , (UInt64) sharedStateSnapshot->dataToSendTotalSize );
-
-    ResultCode resultCode;
+    resultCode = resultSuccess;
 
-    resultCode = syncSendEventsToApmServer( config
-                                            , stringBufferToView( sharedStateSnapshot->firstDataToSendNode->userAgentHttpHeader )
-                                            , serializedEvents );
-    // If we failed to send the currently first batch we return success nevertheless
-    // it means that this batch will be removed, and we will continue on to sending the rest of the queued events
-    if ( resultCode != resultSuccess )
-    {
-        ELASTIC_APM_LOG_ERROR(
-                "Failed to send batch of events - the batch will be dequeued and dropped"
-                "; batch ID: %" PRIu64
-                "; batch size: %" PRIu64
-                "; total size of queued events: %" PRIu64
-                , (UInt64) sharedStateSnapshot->firstDataToSendNode->id
-                , (UInt64) serializedEvents.length
-                , (UInt64) sharedStateSnapshot->dataToSendTotalSize );
-    }
+    finally:
+    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT();
+    return resultCode;
 
-    return resultSuccess;
+    failure:
+    goto finally;
 }
 
-#undef ELASTIC_APM_BACKGROUND_BACKEND_COMM_DO_UNDER_LOCK_EPILOG
-#undef ELASTIC_APM_BACKGROUND_BACKEND_COMM_DO_UNDER_LOCK_PROLOG
-
-void backgroundBackendCommThreadFunc_logSharedStateSnapshot( const BackgroundBackendCommSharedStateSnapshot* sharedStateSnapshot )
+static
+ResultCode backgroundBackendCommThreadFunc_coalesceEventsBatches(
+        BackgroundBackendComm* backgroundBackendComm
+        , const EventsBatchesToSend* batchesToSend
+        , /* out */ StringView* coalescedEvents )
 {
-    StringView serializedEvents = { nullptr, 0 };
-    char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE ];
-    TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
-
-    ELASTIC_APM_LOG_TRACE( "Shared state snapshot: %s", streamSharedStateSnapshot( sharedStateSnapshot, &txtOutStream ) );
+    ResultCode resultCode;
+    const DataToSendNode* node = batchesToSend->firstNode;
+    StringView metadataLine = extractMetadataLine( stringBufferToView( node->serializedEvents ) );
+    size_t coalescedLength = 0;
 
-    if ( ! isDataToSendQueueEmptyInSnapshot( sharedStateSnapshot ) )
+    if ( backgroundBackendComm->coalescedEventsBufferCapacity < batchesToSend->coalescedSize )
     {
-        serializedEvents = stringBufferToView( sharedStateSnapshot->firstDataToSendNode->serializedEvents );
+        ELASTIC_APM_FREE_AND_SET_TO_NULL( char, backgroundBackendComm->coalescedEventsBufferCapacity, backgroundBackendComm->coalescedEventsBuffer );
+        backgroundBackendComm->coalescedEventsBufferCapacity = 0;
+        ELASTIC_APM_MALLOC_IF_FAILED_GOTO( char, batchesToSend->coalescedSize, /* out */ backgroundBackendComm->coalescedEventsBuffer );
+        backgroundBackendComm->coalescedEventsBufferCapacity = batchesToSend->coalescedSize;
     }
 
-    ELASTIC_APM_ASSERT( (sharedStateSnapshot->dataToSendTotalSize == 0) == ( sharedStateSnapshot->firstDataToSendNode == NULL )
-                        , "dataToSendTotalSize: %" PRIu64  ", firstDataToSendNode: %p (serializedEvents.length: %" PRIu64  ")"
-                        , (UInt64) sharedStateSnapshot->dataToSendTotalSize
-                        , sharedStateSnapshot->firstDataToSendNode
-                        , (UInt64) serializedEvents.length );
-}
-
-void* backgroundBackendCommThreadFunc( void* arg )
-{
-    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY();
-
-    ELASTIC_APM_ASSERT_VALID_PTR( arg );
-
-    ResultCode resultCode;
-    BackgroundBackendComm* backgroundBackendComm = (BackgroundBackendComm*)arg;
-    const ConfigSnapshot* config = getTracerCurrentConfigSnapshot( getGlobalTracer() );
-
-    BackgroundBackendCommSharedStateSnapshot sharedStateSnapshot;
-    ELASTIC_APM_CALL_IF_FAILED_GOTO( backgroundBackendCommThreadFunc_getSharedStateSnapshot( backgroundBackendComm, /* out */ &sharedStateSnapshot ) );
-    while ( true )
+    ELASTIC_APM_FOR_EACH_INDEX( i, batchesToSend->count )
     {
-        backgroundBackendCommThreadFunc_logSharedStateSnapshot( &sharedStateSnapshot );
-
-        bool shouldBreakLoop;
-        ELASTIC_APM_CALL_IF_FAILED_GOTO( backgroundBackendCommThreadFunc_shouldBreakLoop( /* in */ &sharedStateSnapshot, /* out */ &shouldBreakLoop ) );
-        if ( shouldBreakLoop )
-        {
-            break;
-        }
-
-        if ( isDataToSendQueueEmptyInSnapshot( &sharedStateSnapshot ) )
+        // Only lines after the metadata line are copied from all the batches except the first one
+        StringView serializedEvents = stringBufferToView( node->serializedEvents );
+        StringView linesToCopy = ( i == 0 ) ? serializedEvents : subStringView( serializedEvents, metadataLine.length );
+        memcpy( backgroundBackendComm->coalescedEventsBuffer + coalescedLength, linesToCopy.begin, linesToCopy.length );
+        coalescedLength += linesToCopy.length;
+        if ( node != batchesToSend->lastNode )
         {
-            ELASTIC_APM_CALL_IF_FAILED_GOTO( backgroundBackendCommThreadFunc_waitForChangesInSharedState( backgroundBackendComm, /* out */ &sharedStateSnapshot ) );
-            continue;
+            node = node->next;
         }
-
-        ELASTIC_APM_CALL_IF_FAILED_GOTO( backgroundBackendCommThreadFunc_sendFirstEventsBatch( config, /* in */ &sharedStateSnapshot ) );
-        ELASTIC_APM_CALL_IF_FAILED_GOTO( backgroundBackendCommThreadFunc_removeFirstEventsBatchAndUpdateSnapshot( backgroundBackendComm, /* out */ &sharedStateSnapshot ) );
     }
+    ELASTIC_APM_ASSERT_EQ_UINT64( coalescedLength, batchesToSend->coalescedSize );
 
+    *coalescedEvents = makeStringView( backgroundBackendComm->coalescedEventsBuffer, coalescedLength );
     resultCode = resultSuccess;
 
     finally:
-    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT();
-    return NULL;
+    return resultCode;
 
     failure:
     goto finally;
 }
 
-ResultCode unwindBackgroundBackendComm( BackgroundBackendComm** backgroundBackendCommOutPtr, const TimeSpec* timeoutAbsUtc, bool isCreatedByThisProcess )
+static inline
+bool backgroundBackendCommThreadFunc_isSpillEnabled( const BackgroundBackendComm* backgroundBackendComm )
 {
-    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY_MSG( "isCreatedByThisProcess: %s", boolToString( isCreatedByThisProcess ) );
-
-    ELASTIC_APM_ASSERT_VALID_PTR( backgroundBackendCommOutPtr );
-    // ELASTIC_APM_ASSERT_VALID_PTR( timeoutAbsUtc ); <- timeoutAbsUtc can be NULL
-
-    ResultCode resultCode;
-
-    BackgroundBackendComm* backgroundBackendComm = *backgroundBackendCommOutPtr;
-    if ( backgroundBackendComm == NULL )
-    {
-        resultCode = resultSuccess;
-        goto finally;
-    }
+    return backendCommSpillFile_isOpen( &( backgroundBackendComm->spillFile ) );
+}
 
-    if ( ! isCreatedByThisProcess )
+static
+void backgroundBackendCommThreadFunc_openSpillFile( const ConfigSnapshot* config, BackgroundBackendComm* backgroundBackendComm )
+{
+    Int64 maxSize = sizeToBytes( config->backendCommSpillMaxSize );
+    if ( maxSize <= 0 )
     {
-        ELASTIC_APM_LOG_DEBUG( "Deallocating memory related to background communication data structures inherited from parent process after fork"
-                               " without actually properly destroying synchronization primitives since it's impossible to do in child process"
-                               "; parent PID: %d"
-                               , (int)getParentProcessId() );
+        ELASTIC_APM_LOG_ERROR( "backend_comm_spill_max_size (backendCommSpillMaxSize) configuration option is not positive - events that cannot be sent will be dropped"
+                               "; backendCommSpillMaxSize: %" PRId64 " bytes", maxSize );
+        return;
     }
 
-    if ( backgroundBackendComm->thread != NULL )
+    if ( backendCommSpillFile_open( &( backgroundBackendComm->spillFile ), config->backendCommSpillDir, (size_t) maxSize ) != resultSuccess )
     {
-        void* backgroundBackendCommThreadFuncRetVal = NULL;
-        bool hasTimedOut;
-        ELASTIC_APM_CALL_IF_FAILED_GOTO(
-                timedJoinAndDeleteThread( &( backgroundBackendComm->thread ), &backgroundBackendCommThreadFuncRetVal, timeoutAbsUtc, isCreatedByThisProcess, &hasTimedOut, __FUNCTION__ ) );
-        if ( hasTimedOut )
-        {
-            ELASTIC_APM_LOG_ERROR( "Join to thread for background backend communications timed out - skipping the rest of cleanup and exiting" );
-            ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
-        }
+        ELASTIC_APM_LOG_ERROR( "Failed to open spill file - events that cannot be sent will be dropped; backendCommSpillDir: %s", config->backendCommSpillDir );
+        return;
     }
 
-    if ( backgroundBackendComm->condVar != NULL )
-    {
-        ELASTIC_APM_CALL_IF_FAILED_GOTO( deleteConditionVariable( &( backgroundBackendComm->condVar ), isCreatedByThisProcess ) );
-    }
+    backgroundBackendComm->isSpillEnabled.store( true );
+    ELASTIC_APM_LOG_DEBUG( "Opened spill file; backendCommSpillDir: %s; backendCommSpillMaxSize: %" PRId64 " bytes", config->backendCommSpillDir, maxSize );
+}
 
-    if ( backgroundBackendComm->mutex != NULL )
+static
+void backgroundBackendCommThreadFunc_spillEvents(
+        BackgroundBackendComm* backgroundBackendComm
+        , StringView userAgentHttpHeader
+        , StringView serializedEvents
+        , UInt64 firstBatchId
+        , size_t batchesCount )
+{
+    if ( backendCommSpillFile_append( &( backgroundBackendComm->spillFile ), userAgentHttpHeader, serializedEvents ) != resultSuccess )
     {
-        ELASTIC_APM_CALL_IF_FAILED_GOTO( deleteMutex( &( backgroundBackendComm->mutex ) ) );
+        ELASTIC_APM_LOG_ERROR( "Spill file is full - dropping batches of events; first batch ID: %" PRIu64 "; number of batches: %" PRIu64 "; size: %" PRIu64
+                               , firstBatchId, (UInt64) batchesCount, (UInt64) serializedEvents.length );
+        backendCommStats_onBatchesDropped( batchesCount );
+        return;
     }
 
-    resultCode = resultSuccess;
-    freeDataToSendQueue( &( backgroundBackendComm->dataToSendQueue ) );
-    ELASTIC_APM_FREE_INSTANCE_AND_SET_TO_NULL( BackgroundBackendComm, *backgroundBackendCommOutPtr );
-
-    finally:
-    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT();
-    return resultCode;
-
-    failure:
-    goto finally;
+    ELASTIC_APM_LOG_DEBUG( "Spilled batches of events; first batch ID: %" PRIu64 "; number of batches: %" PRIu64 "; size: %" PRIu64 "; number of spilled records: %" PRIu64
+                           , firstBatchId, (UInt64) batchesCount, (UInt64) serializedEvents.length, (UInt64) backgroundBackendComm->spillFile.recordsCount );
 }
 
-static BackgroundBackendComm* g_backgroundBackendComm = NULL;
+static
+BackendCommBackoff* getBackoffForConfig( const ConfigSnapshot* config )
+{
+    return config->streamingBackendComm ? &( g_streamingConnectionData.backoff ) : &( g_connectionData.backoff );
+}
 
-static bool deriveAsyncBackendComm( const ConfigSnapshot* config, String* dbgReason )
+/**
+ * Queued events are spilled instead of being sent while backing off,
+ * while the queue is above max queue size (it's admitted above it only when spilling is enabled)
+ * and also when there are spilled events that were not replayed yet - to preserve the order of events
+ */
+static
+bool backgroundBackendCommThreadFunc_shouldSpillQueuedEvents(
+        const ConfigSnapshot* config
+        , BackgroundBackendComm* backgroundBackendComm
+        , const BackgroundBackendCommSharedStateSnapshot* sharedStateSnapshot )
 {
-    if ( config->asyncBackendComm.isSet )
+    if ( config->disableSend || ! backgroundBackendCommThreadFunc_isSpillEnabled( backgroundBackendComm ) )
     {
-        *dbgReason = config->asyncBackendComm.value ? "explicitly set to true" : "explicitly set to false";
-        return config->asyncBackendComm.value;
+        return false;
     }
 
-    *dbgReason = "implicitly set to true";
-    return true;
+    return ( ! backendCommSpillFile_isEmpty( &( backgroundBackendComm->spillFile ) ) )
+           || ( sharedStateSnapshot->dataToSendTotalSize > ELASTIC_APM_MAX_QUEUE_SIZE_IN_BYTES )
+           || shouldWaitForBackoff( config, getBackoffForConfig( config ), /* isAboutToSend */ false );
 }
 
-ResultCode newBackgroundBackendComm( const ConfigSnapshot* config, BackgroundBackendComm** backgroundBackendCommOut )
+static
+bool backgroundBackendCommThreadFunc_hasSpilledEventsToReplay( const ConfigSnapshot* config, BackgroundBackendComm* backgroundBackendComm )
 {
-    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY();
+    return ( ! backendCommSpillFile_isEmpty( &( backgroundBackendComm->spillFile ) ) ) && ( ! shouldWaitForBackoff( config, &( g_connectionData.backoff ), /* isAboutToSend */ false ) );
+}
 
-    ResultCode resultCode;
-    BackgroundBackendComm* backgroundBackendComm = NULL;
+static
+void backgroundBackendCommThreadFunc_replaySpilledEvents( const ConfigSnapshot* config, BackgroundBackendComm* backgroundBackendComm )
+{
+    StringView userAgentHttpHeader;
+    StringView serializedEvents;
 
-    ELASTIC_APM_MALLOC_INSTANCE_IF_FAILED_GOTO( BackgroundBackendComm, /* out */ backgroundBackendComm );
-    backgroundBackendComm->condVar = NULL;
-    backgroundBackendComm->mutex = NULL;
-    backgroundBackendComm->thread = NULL;
-    initDataToSendQueue( &( backgroundBackendComm->dataToSendQueue ) );
-    backgroundBackendComm->dataToSendTotalSize = 0;
-    backgroundBackendComm->nextEventsBatchId = 1;
-    backgroundBackendComm->shouldExit = false;
-    ELASTIC_APM_CALL_IF_FAILED_GOTO( newMutex( &( backgroundBackendComm->mutex ), /* dbgDesc */ "Background backend communications" ) );
-    ELASTIC_APM_CALL_IF_FAILED_GOTO( newConditionVariable( &( backgroundBackendComm->condVar ), /* dbgDesc */ "Background backend communications" ) );
+    backendCommSpillFile_peekFirst( &( backgroundBackendComm->spillFile ), /* out */ &userAgentHttpHeader, /* out */ &serializedEvents );
+    ELASTIC_APM_LOG_DEBUG( "About to replay spilled batches of events; size: %" PRIu64 "; number of spilled records: %" PRIu64
+                           , (UInt64) serializedEvents.length, (UInt64) backgroundBackendComm->spillFile.recordsCount );
 
-    resultCode = newThread( &( backgroundBackendComm->thread )
-                            , &backgroundBackendCommThreadFunc
-                            , /* threadFuncArg: */ backgroundBackendComm
-                            , /* thread's dbgDesc */ "Background backend communications" );
-    if ( resultCode == resultSuccess )
+    // Spilled events are always sent using non-streaming request since they are already coalesced
+    bool isFailureRetriable = false;
+    ResultCode resultCode = syncSendEventsToApmServer( config, userAgentHttpHeader, serializedEvents, /* batchesCount */ 1, /* isBackoffAlreadyChecked */ false, /* out */ &isFailureRetriable );
+    if ( resultCode == resultBackingOff )
     {
-        ELASTIC_APM_LOG_DEBUG( "Started thread for background backend communications; thread ID: %" PRIu64 , getThreadId( backgroundBackendComm->thread ) );
+        ELASTIC_APM_LOG_DEBUG( "Backoff wait time has not elapsed yet - spilled batches of events will be replayed after backoff" );
+        return;
+    }
+    if ( resultCode != resultSuccess )
+    {
+        ++backgroundBackendComm->firstSpilledBatchFailedReplaysCount;
+        if ( isFailureRetriable && backgroundBackendComm->firstSpilledBatchFailedReplaysCount < ELASTIC_APM_BACKEND_COMM_MAX_SEND_ATTEMPTS )
+        {
+            ELASTIC_APM_LOG_ERROR( "Failed to replay spilled batches of events - they will be replayed again after backoff; failed attempts: %" PRIu64
+                                   , (UInt64) backgroundBackendComm->firstSpilledBatchFailedReplaysCount );
+            return;
+        }
+        ELASTIC_APM_LOG_ERROR( "Failed to replay spilled batches of events - dropping them; failed attempts: %" PRIu64
+                               , (UInt64) backgroundBackendComm->firstSpilledBatchFailedReplaysCount );
+        backendCommStats_onBatchesDropped( 1 );
     }
 
-    resultCode = resultSuccess;
-    *backgroundBackendCommOut = backgroundBackendComm;
+    backendCommSpillFile_removeFirst( &( backgroundBackendComm->spillFile ) );
+    backgroundBackendComm->firstSpilledBatchFailedReplaysCount = 0;
+}
 
-    finally:
-    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT();
-    return resultCode;
+/**
+ * @return true if the first batch in the queue should be kept to be sent again after backoff
+ */
+static
+bool backgroundBackendCommThreadFunc_shouldRetryFirstBatch( BackgroundBackendComm* backgroundBackendComm, UInt64 firstBatchId, bool isFailureRetriable )
+{
+    TimeSpec currentTime;
+    if ( getClockTimeSpec( /* isRealTime */ false, /* out */ &currentTime ) != resultSuccess )
+    {
+        return false;
+    }
 
-    failure:
-    unwindBackgroundBackendComm( &backgroundBackendComm, /* timeoutAbsUtc: */ NULL, /* isCreatedByThisProcess */ true );
-    goto finally;
+    return backendCommRetry_onFailure( &( backgroundBackendComm->retry ), firstBatchId, isFailureRetriable, &currentTime );
 }
 
-ResultCode backgroundBackendCommEnsureInited( const ConfigSnapshot* config )
+/**
+ * @param backoff if not NULL the wait ends (at the latest) when backoff wait time elapses
+ */
+static
+ResultCode backgroundBackendCommThreadFunc_waitForChangesInSharedStateOrBackoffEnd(
+        BackgroundBackendComm* backgroundBackendComm
+        , BackendCommBackoff* backoff
+        , /* in,out */ BackgroundBackendCommSharedStateSnapshot* sharedStateSnapshot
+)
 {
-    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY();
-
     ResultCode resultCode;
+    TimeSpec backoffEndTime;
+    const TimeSpec* waitTimeout = NULL;
 
-    if ( g_backgroundBackendComm == NULL )
+    if ( backoff != NULL )
     {
-        ELASTIC_APM_CALL_IF_FAILED_GOTO( newBackgroundBackendComm( config, &g_backgroundBackendComm ) );
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( getCurrentAbsTimeSpec( /* out */ &backoffEndTime ) );
+        addDelayToAbsTimeSpec( /* in, out */ &backoffEndTime, (long)getBackoffTimeLeftToWaitInMilliseconds( backoff ) * ELASTIC_APM_NUMBER_OF_NANOSECONDS_IN_MILLISECOND );
+        waitTimeout = &backoffEndTime;
     }
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( backgroundBackendCommThreadFunc_waitForChangesInSharedState( backgroundBackendComm, waitTimeout, /* in,out */ sharedStateSnapshot ) );
 
     resultCode = resultSuccess;
-
     finally:
-    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT();
     return resultCode;
 
     failure:
     goto finally;
 }
 
-static
-ResultCode signalBackgroundBackendCommThreadToExit( const ConfigSnapshot* config
-                                                    , BackgroundBackendComm* backgroundBackendComm
-                                                    , /* out */ TimeSpec* shouldExitBy )
+ResultCode backgroundBackendCommThreadFunc_sendEventsBatches(
+        const ConfigSnapshot* config
+        , BackgroundBackendComm* backgroundBackendComm
+        , const BackgroundBackendCommSharedStateSnapshot* sharedStateSnapshot
+        , /* out */ size_t* sentBatchesCount )
 {
-    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY();
+    ResultCode resultCode;
+    EventsBatchesToSend batchesToSend;
+    StringView serializedEvents;
+
+    backgroundBackendCommThreadFunc_selectEventsBatchesToSend( config, backgroundBackendComm, sharedStateSnapshot, /* out */ &batchesToSend );
+
+    if ( batchesToSend.count > 1 )
+    {
+        resultCode = backgroundBackendCommThreadFunc_coalesceEventsBatches( backgroundBackendComm, &batchesToSend, /* out */ &serializedEvents );
+        if ( resultCode != resultSuccess )
+        {
+            ELASTIC_APM_LOG_ERROR( "Failed to coalesce batches of events - falling back on sending only the first batch"
+                                   "; number of batches: %" PRIu64 "; coalesced size: %" PRIu64
+                                   , (UInt64) batchesToSend.count, (UInt64) batchesToSend.coalescedSize );
+            batchesToSend.lastNode = batchesToSend.firstNode;
+            batchesToSend.count = 1;
+        }
+    }
+    if ( batchesToSend.count == 1 )
+    {
+        serializedEvents = stringBufferToView( batchesToSend.firstNode->serializedEvents );
+    }
+    *sentBatchesCount = batchesToSend.count;
+
+    ELASTIC_APM_LOG_DEBUG(
+            "About to send batches of events"
+            "; batch IDs: [%" PRIu64 ", %" PRIu64 "]"
+            "; number of batches: %" PRIu64
+            "; request size: %" PRIu64
+            "; total size of queued events: %" PRIu64
+            , (UInt64) batchesToSend.firstNode->id
+            , (UInt64) batchesToSend.lastNode->id
+            , (UInt64) batchesToSend.count
+            , (UInt64) serializedEvents.length
+            , (UInt64) sharedStateSnapshot->dataToSendTotalSize );
+
+    bool isFailureRetriable = false;
+    resultCode = syncSendEventsToApmServer( config
+                                            , stringBufferToView( batchesToSend.firstNode->userAgentHttpHeader )
+                                            , serializedEvents
+                                            , batchesToSend.count
+                                            // The loop in backgroundBackendCommThreadFunc has just checked backoff with isAboutToSend set to true
+                                            , /* isBackoffAlreadyChecked */ true
+                                            , /* out */ &isFailureRetriable );
+    if ( resultCode == resultSuccess )
+    {
+        backendCommRetry_onSuccess( &( backgroundBackendComm->retry ) );
+        return resultSuccess;
+    }
+    if ( resultCode == resultBackingOff )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Backoff wait time has not elapsed yet - the batches are kept at the head of the queue; batch IDs: [%" PRIu64 ", %" PRIu64 "]"
+                               , (UInt64) batchesToSend.firstNode->id, (UInt64) batchesToSend.lastNode->id );
+        *sentBatchesCount = 0;
+        return resultSuccess;
+    }
+
+    // If we failed to send the currently first batches we return success nevertheless.
+    // If the failure is retriable the batches are spilled (if spilling is enabled)
+    // or kept at the head of the queue to be sent again after backoff,
+    // otherwise these batches will be removed and we will continue on to sending the rest of the queued events
+    if ( isFailureRetriable && backgroundBackendCommThreadFunc_isSpillEnabled( backgroundBackendComm ) )
+    {
+        ELASTIC_APM_LOG_ERROR( "Failed to send batches of events - the batches will be spilled; batch IDs: [%" PRIu64 ", %" PRIu64 "]"
+                               , (UInt64) batchesToSend.firstNode->id, (UInt64) batchesToSend.lastNode->id );
+        backgroundBackendCommThreadFunc_spillEvents( backgroundBackendComm
+                                                     , stringBufferToView( batchesToSend.firstNode->userAgentHttpHeader )
+                                                     , serializedEvents
+                                                     , batchesToSend.firstNode->id
+                                                     , batchesToSend.count );
+    }
+    else if ( backgroundBackendCommThreadFunc_shouldRetryFirstBatch( backgroundBackendComm, batchesToSend.firstNode->id, isFailureRetriable ) )
+    {
+        ELASTIC_APM_LOG_ERROR( "Failed to send batches of events - the batches are kept in the queue and will be sent again after backoff"
+                               "; batch IDs: [%" PRIu64 ", %" PRIu64 "]; failed attempts: %u"
+                               , (UInt64) batchesToSend.firstNode->id, (UInt64) batchesToSend.lastNode->id, backgroundBackendComm->retry.failedAttemptsCount );
+        *sentBatchesCount = 0;
+    }
+    else
+    {
+        ELASTIC_APM_LOG_ERROR(
+                "Failed to send batches of events - the batches will be dequeued and dropped"
+                "; isFailureRetriable: %s"
+                "; batch IDs: [%" PRIu64 ", %" PRIu64 "]"
+                "; number of batches: %" PRIu64
+                "; request size: %" PRIu64
+                "; total size of queued events: %" PRIu64
+                , boolToString( isFailureRetriable )
+                , (UInt64) batchesToSend.firstNode->id
+                , (UInt64) batchesToSend.lastNode->id
+                , (UInt64) batchesToSend.count
+                , (UInt64) serializedEvents.length
+                , (UInt64) sharedStateSnapshot->dataToSendTotalSize );
+        backendCommStats_onBatchesDropped( batchesToSend.count );
+    }
+
+    return resultSuccess;
+}
+
+struct StreamingRequestState
+{
+    const ConfigSnapshot* config;
+    BackgroundBackendComm* backgroundBackendComm;
+    // NULL if compression is off
+    BackendCommCompressor* compressor;
+
+    // All the batches streamed in one request should have the same User-Agent and metadata
+    // as the first one (copied because the first batch is dequeued while the request is still open)
+    StringBuffer userAgentHttpHeader;
+    StringBuffer metadataLine;
+    TimeSpec closeBy;
+
+    // Batch the events of which are being fed to the request - it's dequeued only after it's fed completely
+    const DataToSendNode* currentNode;
+    size_t batchesCount;
+    size_t eventsSize;
+    // Part of the request body (possibly compressed) that was not fed to libcurl yet
+    StringView pendingBody;
+    bool isBodyComplete;
+};
+typedef struct StreamingRequestState StreamingRequestState;
+
+static
+ResultCode backgroundBackendCommThreadFunc_streamingRequestTakeNextBatch(
+        StreamingRequestState* state
+        , /* out */ StringView* eventsToFeed
+        , /* out */ bool* isLastChunk
+)
+{
+    BackgroundBackendComm* backgroundBackendComm = state->backgroundBackendComm;
+    StringView metadataLine = stringBufferToView( state->metadataLine );
+    Int64 maxRequestSize = sizeToBytes( state->config->apiRequestSize );
+    ResultCode resultCode;
+    TimeSpec now;
+    bool shouldExit;
+    bool hasTimedOut;
+
+    *eventsToFeed = ELASTIC_APM_EMPTY_STRING_VIEW;
+    *isLastChunk = true;
+
+    if ( state->currentNode != NULL )
+    {
+        ELASTIC_APM_ASSERT( getFirstNodeInDataToSendQueue( &( backgroundBackendComm->dataToSendQueue ) ) == state->currentNode, "" );
+        removeFirstNodeInDataToSendQueue( &( backgroundBackendComm->dataToSendQueue ) );
+        state->currentNode = NULL;
+    }
+
+    while ( true )
+    {
+        // Wait is announced before the queue is checked so that any batch queued after the check wakes us up
+        announceWaitWakeupEvent( backgroundBackendComm->wakeupEvent );
+        shouldExit = backgroundBackendComm->shouldExit.load();
+        moveDataToSendQueueIntakeToList( &( backgroundBackendComm->dataToSendQueue ) );
+
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( getCurrentAbsTimeSpec( /* out */ &now ) );
+        if ( shouldExit && compareAbsTimeSpecs( &( backgroundBackendComm->shouldExitBy ), &now ) < 0 )
+        {
+            break;
+        }
+
+        const DataToSendNode* node = getFirstNodeInDataToSendQueue( &( backgroundBackendComm->dataToSendQueue ) );
+        if ( node != NULL )
+        {
+            StringView serializedEvents = stringBufferToView( node->serializedEvents );
+            if ( state->batchesCount == 0 )
+            {
+                // The first batch is always sent as a whole even if it's larger than the request size limit
+                *eventsToFeed = serializedEvents;
+            }
+            else
+            {
+                if ( ! canEventsBatchBeCoalescedWith( node, stringBufferToView( state->userAgentHttpHeader ), metadataLine ) )
+                {
+                    break;
+                }
+                // Only event lines (including the separating '\n') are streamed - metadata line is sent only once per request
+                *eventsToFeed = subStringView( serializedEvents, metadataLine.length );
+                if ( (Int64) ( state->eventsSize + eventsToFeed->length ) > maxRequestSize )
+                {
+                    *eventsToFeed = ELASTIC_APM_EMPTY_STRING_VIEW;
+                    break;
+                }
+            }
+
+            state->currentNode = node;
+            ++state->batchesCount;
+            state->eventsSize += eventsToFeed->length;
+            *isLastChunk = false;
+            ELASTIC_APM_LOG_DEBUG( "Streaming batch of events; batch ID: %" PRIu64 "; batch index in request: %" PRIu64 "; size of events in request so far: %" PRIu64
+                                   , (UInt64) node->id, (UInt64) ( state->batchesCount - 1 ), (UInt64) state->eventsSize );
+            break;
+        }
+
+        if ( shouldExit || compareAbsTimeSpecs( &( state->closeBy ), &now ) <= 0 )
+        {
+            break;
+        }
+
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( timedWaitWakeupEvent( backgroundBackendComm->wakeupEvent, &( state->closeBy ), /* out */ &hasTimedOut, __FUNCTION__ ) );
+    }
+
+    resultCode = resultSuccess;
+
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+static
+ResultCode backgroundBackendCommThreadFunc_streamingRequestFeedNextBatch( StreamingRequestState* state )
+{
+    ResultCode resultCode;
+    StringView eventsToFeed;
+    bool isLastChunk;
+
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( backgroundBackendCommThreadFunc_streamingRequestTakeNextBatch( state, /* out */ &eventsToFeed, /* out */ &isLastChunk ) );
+
+    if ( state->compressor == NULL )
+    {
+        state->pendingBody = eventsToFeed;
+    }
+    else
+    {
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( backendCommCompressor_compressStreamChunk( state->compressor, eventsToFeed, isLastChunk, /* out */ &( state->pendingBody ) ) );
+    }
+    state->isBodyComplete = isLastChunk;
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+static
+size_t backgroundBackendCommThreadFunc_streamingRequestReadCallback( char* buffer, size_t size, size_t nitems, void* ctx )
+{
+    // https://curl.se/libcurl/c/CURLOPT_READFUNCTION.html
+    StreamingRequestState* state = (StreamingRequestState*)ctx;
+    size_t bufferSize = size * nitems;
+
+    while ( state->pendingBody.length == 0 )
+    {
+        if ( state->isBodyComplete )
+        {
+            return 0;
+        }
+
+        if ( backgroundBackendCommThreadFunc_streamingRequestFeedNextBatch( state ) != resultSuccess )
+        {
+            return CURL_READFUNC_ABORT;
+        }
+    }
+
+    size_t copiedSize = std::min( bufferSize, state->pendingBody.length );
+    memcpy( buffer, state->pendingBody.begin, copiedSize );
+    state->pendingBody = subStringView( state->pendingBody, copiedSize );
+    return copiedSize;
+}
+
+static
+void backgroundBackendCommThreadFunc_finishStreamingRequestAndUpdateSnapshot(
+        StreamingRequestState* state
+        , /* out */ BackgroundBackendCommSharedStateSnapshot* sharedStateSnapshot
+)
+{
+    BackgroundBackendComm* backgroundBackendComm = state->backgroundBackendComm;
+
+    // If the request failed before the current batch was completely fed the batch is dropped
+    if ( state->currentNode != NULL )
+    {
+        removeFirstNodeInDataToSendQueue( &( backgroundBackendComm->dataToSendQueue ) );
+        state->currentNode = NULL;
+    }
+
+    backgroundBackendCommThreadFunc_getSharedStateSnapshot( backgroundBackendComm, /* out */ sharedStateSnapshot );
+}
+
+ResultCode backgroundBackendCommThreadFunc_streamEventsBatches(
+        const ConfigSnapshot* config
+        , BackgroundBackendComm* backgroundBackendComm
+        , /* in,out */ BackgroundBackendCommSharedStateSnapshot* sharedStateSnapshot )
+{
+    ResultCode resultCode;
+    ResultCode streamResultCode;
+    ConnectionData* connectionData = &g_streamingConnectionData;
+    ApmServerResponse response = { .httpStatusCode = 0, .retryAfterInSeconds = 0 };
+    bool isFailureRetriable;
+    // This function is called only when data-queue-to-send is not empty
+    // so firstDataToSendNode is not NULL
+    const DataToSendNode* firstNode = sharedStateSnapshot->firstDataToSendNode;
+    StreamingRequestState state;
+    ELASTIC_APM_ZERO_STRUCT( &state );
+    state.config = config;
+    state.backgroundBackendComm = backgroundBackendComm;
+
+    // Backoff is checked (and the probe is claimed) by the loop in backgroundBackendCommThreadFunc before calling this function
+    // so while waiting for backoff to end the batches are kept in the queue
+    if ( config->disableSend )
+    {
+        ELASTIC_APM_LOG_DEBUG( "disable_send (disableSend) configuration option is set to true - discarding events instead of sending; batch ID: %" PRIu64
+                               , (UInt64) firstNode->id );
+        backgroundBackendCommThreadFunc_removeEventsBatchesAndUpdateSnapshot( backgroundBackendComm, /* batchesCount */ 1, /* out */ sharedStateSnapshot );
+        ELASTIC_APM_SET_RESULT_CODE_TO_SUCCESS_AND_GOTO_FINALLY();
+    }
+
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( dupMallocStringView( stringBufferToView( firstNode->userAgentHttpHeader ), /* out */ &state.userAgentHttpHeader ) );
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( dupMallocStringView( extractMetadataLine( stringBufferToView( firstNode->serializedEvents ) ), /* out */ &state.metadataLine ) );
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( getCurrentAbsTimeSpec( /* out */ &state.closeBy ) );
+    addDelayToAbsTimeSpec( /* in, out */ &state.closeBy, (long)durationToMilliseconds( config->apiRequestTime ) * ELASTIC_APM_NUMBER_OF_NANOSECONDS_IN_MILLISECOND );
+
+    if ( connectionData->curlHandle == NULL )
+    {
+        streamResultCode = initStreamingConnectionData( config, connectionData, stringBufferToView( state.userAgentHttpHeader ) );
+    }
+    else
+    {
+        streamResultCode = resultSuccess;
+    }
+    if ( streamResultCode == resultSuccess && connectionData->compressor.zStream != NULL )
+    {
+        state.compressor = &connectionData->compressor;
+        streamResultCode = backendCommCompressor_beginStream( state.compressor );
+    }
+    if ( streamResultCode == resultSuccess )
+    {
+        streamResultCode = syncStreamEventsToApmServerWithConn( config, connectionData, &backgroundBackendCommThreadFunc_streamingRequestReadCallback, &state, /* out */ &response );
+    }
+
+    // If we failed to stream the events we return success nevertheless
+    // it means that the events fed to the failed request are dropped, and we will continue on to sending the rest of the queued events
+    if ( streamResultCode == resultSuccess )
+    {
+        onApmServerRequestSucceeded( connectionData );
+        backendCommRetry_onSuccess( &( backgroundBackendComm->retry ) );
+        backendCommStats_onBatchesSent( state.batchesCount );
+    }
+    else
+    {
+        isFailureRetriable = isBackendCommFailureRetriable( response.httpStatusCode );
+        ELASTIC_APM_LOG_ERROR( "Failed to stream batches of events - the batches fed to the request will be dropped"
+                               "; number of batches: %" PRIu64 "; events size: %" PRIu64 "; HTTP response code: %ld; isFailureRetriable: %s"
+                               , (UInt64) state.batchesCount, (UInt64) state.eventsSize, response.httpStatusCode, boolToString( isFailureRetriable ) );
+        onApmServerRequestFailed( connectionData, &response );
+        backendCommStats_onBatchesDropped( state.batchesCount );
+        // If the request failed before any of the batches was fed to it
+        // the first batch is either kept in the queue to be sent again after backoff or dropped
+        if ( state.batchesCount == 0 && ! backgroundBackendCommThreadFunc_shouldRetryFirstBatch( backgroundBackendComm, firstNode->id, isFailureRetriable ) )
+        {
+            state.currentNode = firstNode;
+            backendCommStats_onBatchesDropped( 1 );
+        }
+    }
+    ELASTIC_APM_LOG_DEBUG( "Finished streaming request; number of batches: %" PRIu64 "; events size: %" PRIu64, (UInt64) state.batchesCount, (UInt64) state.eventsSize );
+
+    backgroundBackendCommThreadFunc_finishStreamingRequestAndUpdateSnapshot( &state, /* out */ sharedStateSnapshot );
+
+    resultCode = resultSuccess;
+    finally:
+    freeMallocedStringBuffer( /* in,out */ &state.userAgentHttpHeader );
+    freeMallocedStringBuffer( /* in,out */ &state.metadataLine );
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+void backgroundBackendCommThreadFunc_logSharedStateSnapshot( const BackgroundBackendCommSharedStateSnapshot* sharedStateSnapshot )
+{
+    StringView serializedEvents = { nullptr, 0 };
+    char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE ];
+    TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
+
+    ELASTIC_APM_LOG_TRACE( "Shared state snapshot: %s", streamSharedStateSnapshot( sharedStateSnapshot, &txtOutStream ) );
+
+    if ( ! isDataToSendQueueEmptyInSnapshot( sharedStateSnapshot ) )
+    {
+        serializedEvents = stringBufferToView( sharedStateSnapshot->firstDataToSendNode->serializedEvents );
+    }
+
+    // Total size includes batches queued after the snapshot was taken so it can be non-zero even if the first node is NULL
+    ELASTIC_APM_ASSERT( ( sharedStateSnapshot->firstDataToSendNode == NULL ) || ( sharedStateSnapshot->dataToSendTotalSize != 0 )
+                        , "dataToSendTotalSize: %" PRIu64  ", firstDataToSendNode: %p (serializedEvents.length: %" PRIu64  ")"
+                        , (UInt64) sharedStateSnapshot->dataToSendTotalSize
+                        , sharedStateSnapshot->firstDataToSendNode
+                        , (UInt64) serializedEvents.length );
+}
+
+void* backgroundBackendCommThreadFunc( void* arg )
+{
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY();
+
+    ELASTIC_APM_ASSERT_VALID_PTR( arg );
+
+    ResultCode resultCode;
+    BackgroundBackendComm* backgroundBackendComm = (BackgroundBackendComm*)arg;
+    const ConfigSnapshot* config = getTracerCurrentConfigSnapshot( getGlobalTracer() );
+
+    if ( config->backendCommSpillDir != NULL )
+    {
+        backgroundBackendCommThreadFunc_openSpillFile( config, backgroundBackendComm );
+    }
+
+    // Failure to warm up is not an error - the connection is established when the first events are sent
+    if ( config->backendCommWarmUpConnection && ! config->disableSend )
+    {
+        warmUpConnectionToApmServer( config );
+    }
+
+    BackgroundBackendCommSharedStateSnapshot sharedStateSnapshot;
+    backgroundBackendCommThreadFunc_getSharedStateSnapshot( backgroundBackendComm, /* out */ &sharedStateSnapshot );
+    while ( true )
+    {
+        backgroundBackendCommThreadFunc_logSharedStateSnapshot( &sharedStateSnapshot );
+
+        bool hasSpilledEventsToReplay = backgroundBackendCommThreadFunc_hasSpilledEventsToReplay( config, backgroundBackendComm );
+        // Only a process that has events to send tries to become the one probing whether APM Server has recovered
+        bool isWaitingForBackoff = ( ! config->disableSend )
+                                   && shouldWaitForBackoff( config, getBackoffForConfig( config ), /* isAboutToSend */ ! isDataToSendQueueEmptyInSnapshot( &sharedStateSnapshot ) );
+        bool shouldBreakLoop;
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( backgroundBackendCommThreadFunc_shouldBreakLoop( /* in */ &sharedStateSnapshot, hasSpilledEventsToReplay, isWaitingForBackoff, /* out */ &shouldBreakLoop ) );
+        if ( shouldBreakLoop )
+        {
+            break;
+        }
+
+        // Spilled events were queued before the events currently in the queue so they are sent first
+        if ( hasSpilledEventsToReplay )
+        {
+            backgroundBackendCommThreadFunc_replaySpilledEvents( config, backgroundBackendComm );
+            backgroundBackendCommThreadFunc_getSharedStateSnapshot( backgroundBackendComm, /* out */ &sharedStateSnapshot );
+            continue;
+        }
+
+        if ( isDataToSendQueueEmptyInSnapshot( &sharedStateSnapshot ) )
+        {
+            // Spilled events are replayed using non-streaming connection so wake up when its backoff ends
+            BackendCommBackoff* waitBackoff = backendCommSpillFile_isEmpty( &( backgroundBackendComm->spillFile ) ) ? NULL : &( g_connectionData.backoff );
+            ELASTIC_APM_CALL_IF_FAILED_GOTO( backgroundBackendCommThreadFunc_waitForChangesInSharedStateOrBackoffEnd( backgroundBackendComm, waitBackoff, /* out */ &sharedStateSnapshot ) );
+            continue;
+        }
+
+        if ( backgroundBackendCommThreadFunc_shouldSpillQueuedEvents( config, backgroundBackendComm, &sharedStateSnapshot ) )
+        {
+            const DataToSendNode* firstNode = sharedStateSnapshot.firstDataToSendNode;
+            backgroundBackendCommThreadFunc_spillEvents( backgroundBackendComm
+                                                         , stringBufferToView( firstNode->userAgentHttpHeader )
+                                                         , stringBufferToView( firstNode->serializedEvents )
+                                                         , firstNode->id
+                                                         , /* batchesCount */ 1 );
+            backgroundBackendCommThreadFunc_removeEventsBatchesAndUpdateSnapshot( backgroundBackendComm, /* batchesCount */ 1, /* out */ &sharedStateSnapshot );
+            continue;
+        }
+
+        // Batches that failed to be sent are kept at the head of the queue until backoff ends
+        if ( isWaitingForBackoff )
+        {
+            ELASTIC_APM_CALL_IF_FAILED_GOTO( backgroundBackendCommThreadFunc_waitForChangesInSharedStateOrBackoffEnd( backgroundBackendComm, getBackoffForConfig( config ), /* out */ &sharedStateSnapshot ) );
+            continue;
+        }
+
+        if ( config->streamingBackendComm )
+        {
+            ELASTIC_APM_CALL_IF_FAILED_GOTO( backgroundBackendCommThreadFunc_streamEventsBatches( config, backgroundBackendComm, /* in,out */ &sharedStateSnapshot ) );
+            continue;
+        }
+
+        size_t sentBatchesCount = 0;
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( backgroundBackendCommThreadFunc_sendEventsBatches( config, backgroundBackendComm, /* in */ &sharedStateSnapshot, /* out */ &sentBatchesCount ) );
+        backgroundBackendCommThreadFunc_removeEventsBatchesAndUpdateSnapshot( backgroundBackendComm, sentBatchesCount, /* out */ &sharedStateSnapshot );
+    }
+
+    resultCode = resultSuccess;
+
+    finally:
+    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT();
+    return NULL;
+
+    failure:
+    goto finally;
+}
+
+ResultCode unwindBackgroundBackendComm( BackgroundBackendComm** backgroundBackendCommOutPtr, const TimeSpec* timeoutAbsUtc, bool isCreatedByThisProcess )
+{
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY_MSG( "isCreatedByThisProcess: %s", boolToString( isCreatedByThisProcess ) );
+
+    ELASTIC_APM_ASSERT_VALID_PTR( backgroundBackendCommOutPtr );
+    // ELASTIC_APM_ASSERT_VALID_PTR( timeoutAbsUtc ); <- timeoutAbsUtc can be NULL
+
+    ResultCode resultCode;
+
+    BackgroundBackendComm* backgroundBackendComm = *backgroundBackendCommOutPtr;
+    if ( backgroundBackendComm == NULL )
+    {
+        resultCode = resultSuccess;
+        goto finally;
+    }
+
+    if ( ! isCreatedByThisProcess )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Deallocating memory related to background communication data structures inherited from parent process after fork"
+                               " without actually properly destroying synchronization primitives since it's impossible to do in child process"
+                               "; parent PID: %d"
+                               , (int)getParentProcessId() );
+    }
+
+    if ( backgroundBackendComm->thread != NULL )
+    {
+        void* backgroundBackendCommThreadFuncRetVal = NULL;
+        bool hasTimedOut;
+        ELASTIC_APM_CALL_IF_FAILED_GOTO(
+                timedJoinAndDeleteThread( &( backgroundBackendComm->thread ), &backgroundBackendCommThreadFuncRetVal, timeoutAbsUtc, isCreatedByThisProcess, &hasTimedOut, __FUNCTION__ ) );
+        if ( hasTimedOut )
+        {
+            ELASTIC_APM_LOG_ERROR( "Join to thread for background backend communications timed out - skipping the rest of cleanup and exiting" );
+            ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+        }
+    }
+
+    if ( backgroundBackendComm->wakeupEvent != NULL )
+    {
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( deleteWakeupEvent( &( backgroundBackendComm->wakeupEvent ) ) );
+    }
+
+    resultCode = resultSuccess;
+    freeDataToSendQueue( &( backgroundBackendComm->dataToSendQueue ) );
+    backendCommSpillFile_close( &( backgroundBackendComm->spillFile ) );
+    ELASTIC_APM_FREE_AND_SET_TO_NULL( char, backgroundBackendComm->coalescedEventsBufferCapacity, backgroundBackendComm->coalescedEventsBuffer );
+    ELASTIC_APM_FREE_INSTANCE_AND_SET_TO_NULL( BackgroundBackendComm, *backgroundBackendCommOutPtr );
+
+    finally:
+    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT();
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+static BackgroundBackendComm* g_backgroundBackendComm = NULL;
+
+static bool deriveAsyncBackendComm( const ConfigSnapshot* config, String* dbgReason )
+{
+    if ( config->asyncBackendComm.isSet )
+    {
+        *dbgReason = config->asyncBackendComm.value ? "explicitly set to true" : "explicitly set to false";
+        return config->asyncBackendComm.value;
+    }
+
+    *dbgReason = "implicitly set to true";
+    return true;
+}
+
+ResultCode newBackgroundBackendComm( const ConfigSnapshot* config, BackgroundBackendComm** backgroundBackendCommOut )
+{
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY();
+
+    ResultCode resultCode;
+    BackgroundBackendComm* backgroundBackendComm = NULL;
+
+    ELASTIC_APM_MALLOC_INSTANCE_IF_FAILED_GOTO( BackgroundBackendComm, /* out */ backgroundBackendComm );
+    backgroundBackendComm->wakeupEvent = NULL;
+    backgroundBackendComm->thread = NULL;
+    initDataToSendQueue( &( backgroundBackendComm->dataToSendQueue ) );
+    backgroundBackendComm->shouldExit.store( false );
+    backgroundBackendComm->coalescedEventsBuffer = NULL;
+    backgroundBackendComm->coalescedEventsBufferCapacity = 0;
+    backgroundBackendComm->spillFile = ELASTIC_APM_DEFAULT_BACKEND_COMM_SPILL_FILE;
+    backgroundBackendComm->isSpillEnabled.store( false );
+    backgroundBackendComm->firstSpilledBatchFailedReplaysCount = 0;
+    backgroundBackendComm->retry = ELASTIC_APM_DEFAULT_BACKEND_COMM_RETRY;
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( newWakeupEvent( &( backgroundBackendComm->wakeupEvent ), /* dbgDesc */ "Background backend communications" ) );
+
+    resultCode = newThread( &( backgroundBackendComm->thread )
+                            , &backgroundBackendCommThreadFunc
+                            , /* threadFuncArg: */ backgroundBackendComm
+                            , /* thread's dbgDesc */ "Background backend communications" );
+    if ( resultCode == resultSuccess )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Started thread for background backend communications; thread ID: %" PRIu64 , getThreadId( backgroundBackendComm->thread ) );
+    }
+
+    resultCode = resultSuccess;
+    *backgroundBackendCommOut = backgroundBackendComm;
+
+    finally:
+    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT();
+    return resultCode;
+
+    failure:
+    unwindBackgroundBackendComm( &backgroundBackendComm, /* timeoutAbsUtc: */ NULL, /* isCreatedByThisProcess */ true );
+    goto finally;
+}
+
+ResultCode backgroundBackendCommEnsureInited( const ConfigSnapshot* config )
+{
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY();
+
+    ResultCode resultCode;
+
+    if ( g_backgroundBackendComm == NULL )
+    {
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( newBackgroundBackendComm( config, &g_backgroundBackendComm ) );
+    }
+
+    resultCode = resultSuccess;
+
+    finally:
+    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT();
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+static
+ResultCode signalBackgroundBackendCommThreadToExit( const ConfigSnapshot* config
+                                                    , BackgroundBackendComm* backgroundBackendComm
+                                                    , /* out */ TimeSpec* shouldExitBy )
+{
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY();
+
+    ResultCode resultCode;
+    char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE ];
+    TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
+
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( getCurrentAbsTimeSpec( /* out */ shouldExitBy ) );
+    addDelayToAbsTimeSpec( /* in, out */ shouldExitBy, (long)durationToMilliseconds( config->serverTimeout ) * ELASTIC_APM_NUMBER_OF_NANOSECONDS_IN_MILLISECOND );
+    // shouldExitBy should be set before shouldExit because the background thread reads shouldExitBy only after it sees shouldExit set
+    backgroundBackendComm->shouldExitBy = *shouldExitBy;
+    backgroundBackendComm->shouldExit.store( true );
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( signalWakeupEvent( backgroundBackendComm->wakeupEvent, __FUNCTION__ ) );
+
+    resultCode = resultSuccess;
+    finally:
+    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT_MSG(
+            "shouldExitBy: %s, serverTimeout: %s"
+            , streamUtcTimeSpecAsLocal( shouldExitBy, &txtOutStream ), streamDuration( config->serverTimeout, &txtOutStream ) );
+    textOutputStreamRewind( &txtOutStream );
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+static BackendCommSharedRing* g_sharedRing = NULL;
+static Thread* g_sharedRingDrainerThread = NULL;
+static std::atomic< bool > g_sharedRingDrainerShouldExit;
+
+void backgroundBackendCommOnModuleInit( const ConfigSnapshot* config )
+{
+    // Handles work without the share object, they just don't reuse DNS cache and TLS sessions
+    initBackendCommCurlShare();
+
+    if ( config->backendCommSharedBackoff )
+    {
+        // Shared memory is created before worker processes are forked so all of them share the backoff state
+        g_sharedBackoff = ELASTICAPM_G( globals )->sharedMemory_.get();
+    }
+
+    Int64 sharedRingSize = sizeToBytes( config->backendCommSharedRingSize );
+    if ( sharedRingSize <= 0 )
+    {
+        return;
+    }
 
-    ResultCode resultCode;
-    bool shouldUnlockMutex = false;
-    char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE ];
-    TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
+    // Shared ring buffer is created before worker processes are forked so that all of them share it
+    if ( newBackendCommSharedRing( (size_t) sharedRingSize, /* out */ &g_sharedRing ) != resultSuccess )
+    {
+        ELASTIC_APM_LOG_ERROR( "Failed to create shared ring buffer - each process will send its events to APM Server"
+                               "; backendCommSharedRingSize: %" PRId64 " bytes", sharedRingSize );
+        return;
+    }
 
-    ELASTIC_APM_CALL_IF_FAILED_GOTO( lockMutex( backgroundBackendComm->mutex, &shouldUnlockMutex, __FUNCTION__ ) );
+    ELASTIC_APM_LOG_DEBUG( "Created shared ring buffer; backendCommSharedRingSize: %" PRId64 " bytes", sharedRingSize );
+}
 
-    backgroundBackendComm->shouldExit = true;
+void backgroundBackendCommOnRequestInit( const ConfigSnapshot* config )
+{
+    String dbgAsyncBackendCommReason = NULL;
 
-    ELASTIC_APM_CALL_IF_FAILED_GOTO( getCurrentAbsTimeSpec( /* out */ shouldExitBy ) );
-    addDelayToAbsTimeSpec( /* in, out */ shouldExitBy, (long)durationToMilliseconds( config->serverTimeout ) * ELASTIC_APM_NUMBER_OF_NANOSECONDS_IN_MILLISECOND );
-    backgroundBackendComm->shouldExitBy = *shouldExitBy;
-    ELASTIC_APM_CALL_IF_FAILED_GOTO( signalConditionVariable( backgroundBackendComm->condVar, __FUNCTION__ ) );
+    if ( ! config->backendCommWarmUpConnection || config->disableSend || g_backgroundBackendComm != NULL )
+    {
+        return;
+    }
 
-    resultCode = resultSuccess;
-    finally:
-    unlockMutex( backgroundBackendComm->mutex, &shouldUnlockMutex, __FUNCTION__ );
-    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT_MSG(
-            "shouldExitBy: %s, serverTimeout: %s"
-            , streamUtcTimeSpecAsLocal( shouldExitBy, &txtOutStream ), streamDuration( config->serverTimeout, &txtOutStream ) );
-    textOutputStreamRewind( &txtOutStream );
-    return resultCode;
+    // Events are not sent by this process' background thread
+    // or (in the case of the shared ring buffer) the thread is started when this process is elected as the sender
+    if ( config->backendCommSidecarSocket != NULL || g_sharedRing != NULL || ! deriveAsyncBackendComm( config, &dbgAsyncBackendCommReason ) )
+    {
+        return;
+    }
 
-    failure:
-    goto finally;
+    ELASTIC_APM_LOG_DEBUG( "Starting background backend communications thread early to warm up connection to APM Server" );
+    if ( backgroundBackendCommEnsureInited( config ) != resultSuccess )
+    {
+        ELASTIC_APM_LOG_ERROR( "Failed to start background backend communications thread" );
+    }
 }
 
+static void stopSharedRingDrainer( const ConfigSnapshot* config );
+
 void backgroundBackendCommOnModuleShutdown( const ConfigSnapshot* config )
 {
     BackgroundBackendComm* backgroundBackendComm = g_backgroundBackendComm;
     ResultCode resultCode;
 
+    // Normally deferred events are sent at the end of each request
+    sendDeferredEventsToApmServer( config );
+
+    // Events are moved from the shared ring buffer to this process' queue before the queue is flushed
+    stopSharedRingDrainer( config );
+    deleteBackendCommSharedRingAndSetToNull( &g_sharedRing );
+
     if ( backgroundBackendComm != NULL )
     {
         TimeSpec shouldExitBy;
@@ -1154,6 +2154,10 @@ void backgroundBackendCommOnModuleShutdown( const ConfigSnapshot* config )
     resultCode = resultSuccess;
     finally:
     cleanupConnectionData( &g_connectionData );
+    cleanupConnectionData( &g_streamingConnectionData );
+    cleanupBackendCommCurlShare();
+    closeSidecarConnection();
+    g_sharedBackoff = NULL;
     g_backgroundBackendComm = NULL;
     return;
 
@@ -1161,6 +2165,63 @@ void backgroundBackendCommOnModuleShutdown( const ConfigSnapshot* config )
     goto finally;
 }
 
+/**
+ * Events of a class are queued only while the total size of already queued events is below the limit for the class.
+ * So when the queue fills up spans are shed first, then metricsets, while errors and transactions are retained for as long as possible.
+ * When spilling is enabled the limits are raised by the overflow that the background thread spills to the file.
+ */
+static
+size_t getMaxQueueSizeToAdmitEventClass( BackendCommEventClass eventClass, bool isSpillEnabled )
+{
+    size_t overflowToSpill = isSpillEnabled ? ELASTIC_APM_MAX_QUEUE_OVERFLOW_TO_SPILL_IN_BYTES : 0;
+    switch ( eventClass )
+    {
+        case backendCommEventClass_span:
+            return ( ELASTIC_APM_MAX_QUEUE_SIZE_IN_BYTES / 10 ) * 6 + overflowToSpill;
+
+        case backendCommEventClass_metricset:
+            return ( ELASTIC_APM_MAX_QUEUE_SIZE_IN_BYTES / 10 ) * 8 + overflowToSpill;
+
+        default:
+            return ELASTIC_APM_MAX_QUEUE_SIZE_IN_BYTES + overflowToSpill;
+    }
+}
+
+static std::atomic< UInt64 > g_droppedEventsCounts[ numberOfBackendCommEventClasses ];
+
+UInt64 getBackendCommDroppedEventsCount( BackendCommEventClass eventClass )
+{
+    ELASTIC_APM_ASSERT( 0 <= eventClass && eventClass < numberOfBackendCommEventClasses, "eventClass: %d", (int) eventClass );
+
+    return g_droppedEventsCounts[ eventClass ].load( std::memory_order_relaxed );
+}
+
+UInt64 getBackendCommQueuedEventsSize()
+{
+    BackgroundBackendComm* backgroundBackendComm = g_backgroundBackendComm;
+    return backgroundBackendComm == NULL ? 0 : (UInt64) getDataToSendQueueTotalSize( &( backgroundBackendComm->dataToSendQueue ) );
+}
+
+static
+void countDroppedEvents( const SerializedEventsClassification* classification, int beginEventClass, int endEventClass )
+{
+    char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE ];
+    TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
+
+    for ( int eventClass = beginEventClass; eventClass < endEventClass; ++eventClass )
+    {
+        if ( classification->eventsCount[ eventClass ] == 0 )
+        {
+            continue;
+        }
+        UInt64 droppedSoFar = g_droppedEventsCounts[ eventClass ].fetch_add( classification->eventsCount[ eventClass ], std::memory_order_relaxed ) + classification->eventsCount[ eventClass ];
+        ELASTIC_APM_LOG_DEBUG( "Dropped events; class: %s; count: %" PRIu64 "; size: %" PRIu64 "; dropped events of this class so far: %" PRIu64
+                               , streamBackendCommEventClass( (BackendCommEventClass) eventClass, &txtOutStream )
+                               , (UInt64) classification->eventsCount[ eventClass ], (UInt64) classification->eventsSize[ eventClass ], droppedSoFar );
+        textOutputStreamRewind( &txtOutStream );
+    }
+}
+
 static
 ResultCode enqueueEventsToSendToApmServer( StringView userAgentHttpHeader, StringView serializedEvents )
 {
@@ -1176,30 +2237,79 @@ ResultCode enqueueEventsToSendToApmServer( StringView userAgentHttpHeader, Strin
     textOutputStreamRewind( &txtOutStream );
 
     ResultCode resultCode;
-    bool shouldUnlockMutex = false;
-    UInt64 id;
+    size_t dataToSendTotalSize = 0;
     BackgroundBackendComm* backgroundBackendComm = g_backgroundBackendComm;
+    DataToSendNode* newNode = NULL;
+    UInt64 id = 0;
+    SerializedEventsClassification classification;
+    int lowestEventClassInBatch = backendCommEventClass_other;
+    int minEventClassToKeep;
+    bool isSpillEnabled = backgroundBackendComm->isSpillEnabled.load();
+
+    classifySerializedEvents( serializedEvents, /* out */ &classification );
+    for ( int eventClass = 0; eventClass < numberOfBackendCommEventClasses; ++eventClass )
+    {
+        if ( classification.eventsCount[ eventClass ] != 0 )
+        {
+            lowestEventClassInBatch = eventClass;
+            break;
+        }
+    }
+
+    // If the whole batch cannot be queued the events of the lowest priority class left in the batch are removed and queueing is retried
+    minEventClassToKeep = lowestEventClassInBatch;
+    while ( true )
+    {
+        size_t maxTotalSize = getMaxQueueSizeToAdmitEventClass( (BackendCommEventClass) minEventClassToKeep, isSpillEnabled );
+        // There is no point in building the node if the queue is already above the limit
+        dataToSendTotalSize = getDataToSendQueueTotalSize( &( backgroundBackendComm->dataToSendQueue ) );
+        if ( dataToSendTotalSize < maxTotalSize )
+        {
+            // Events are copied before the node is pushed so that pushing only links the new node to the queue
+            if ( minEventClassToKeep == lowestEventClassInBatch )
+            {
+                ELASTIC_APM_CALL_IF_FAILED_GOTO( newDataToSendNode( userAgentHttpHeader, serializedEvents, /* out */ &newNode ) );
+            }
+            else
+            {
+                ELASTIC_APM_CALL_IF_FAILED_GOTO( newFilteredDataToSendNode( userAgentHttpHeader, serializedEvents, &classification, (BackendCommEventClass) minEventClassToKeep, /* out */ &newNode ) );
+            }
+
+            if ( tryPushNodeToDataToSendQueue( &( backgroundBackendComm->dataToSendQueue ), maxTotalSize, newNode, /* out */ &id, /* out */ &dataToSendTotalSize ) )
+            {
+                // The node is owned (and might be already freed) by the queue after it's pushed
+                newNode = NULL;
+                break;
+            }
+            freeDataToSendNode( &newNode );
+        }
+
+        do {
+            ++minEventClassToKeep;
+        } while ( minEventClassToKeep < numberOfBackendCommEventClasses && classification.eventsCount[ minEventClassToKeep ] == 0 );
 
-    ELASTIC_APM_CALL_IF_FAILED_GOTO( lockMutex( backgroundBackendComm->mutex, &shouldUnlockMutex, __FUNCTION__ ) );
+        if ( minEventClassToKeep == numberOfBackendCommEventClasses )
+        {
+            ELASTIC_APM_LOG_ERROR(
+                    "Already queued events are above max queue size - dropping these events"
+                    "; size of already queued events: %" PRIu64 "; isSpillEnabled: %s"
+                    , (UInt64) dataToSendTotalSize, boolToString( isSpillEnabled ) );
+            countDroppedEvents( &classification, /* beginEventClass */ 0, /* endEventClass */ numberOfBackendCommEventClasses );
+            ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+        }
+    }
 
-    if ( backgroundBackendComm->dataToSendTotalSize >= ELASTIC_APM_MAX_QUEUE_SIZE_IN_BYTES )
+    if ( minEventClassToKeep != lowestEventClassInBatch )
     {
-        ELASTIC_APM_LOG_ERROR(
-                "Already queued events are above max queue size - dropping these events"
+        ELASTIC_APM_LOG_WARNING(
+                "Queue is under memory pressure - queued only events of classes with priority not lower than %s and dropped the rest"
                 "; size of already queued events: %" PRIu64
-                , (UInt64) backgroundBackendComm->dataToSendTotalSize );
-        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+                , backendCommEventClassNames[ minEventClassToKeep ]
+                , (UInt64) dataToSendTotalSize );
+        countDroppedEvents( &classification, /* beginEventClass */ 0, /* endEventClass */ minEventClassToKeep );
     }
 
-    id = backgroundBackendComm->nextEventsBatchId;
-    ELASTIC_APM_CALL_IF_FAILED_GOTO(
-            addCopyToDataToSendQueue( &( backgroundBackendComm->dataToSendQueue )
-                                      , id
-                                      , userAgentHttpHeader
-                                      , serializedEvents ) );
-
-    backgroundBackendComm->dataToSendTotalSize += serializedEvents.length;
-    ++backgroundBackendComm->nextEventsBatchId;
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( signalWakeupEvent( backgroundBackendComm->wakeupEvent, __FUNCTION__ ) );
 
     ELASTIC_APM_LOG_DEBUG(
             "Queued a batch of events"
@@ -1208,14 +2318,15 @@ ResultCode enqueueEventsToSendToApmServer( StringView userAgentHttpHeader, Strin
             "; total size of queued events: %" PRIu64
             , (UInt64) id
             , (UInt64) serializedEvents.length
-            , (UInt64) backgroundBackendComm->dataToSendTotalSize );
-
-    ELASTIC_APM_CALL_IF_FAILED_GOTO( signalConditionVariable( backgroundBackendComm->condVar, __FUNCTION__ ) );
+            , (UInt64) dataToSendTotalSize );
 
     resultCode = resultSuccess;
 
     finally:
-    unlockMutex( backgroundBackendComm->mutex, &shouldUnlockMutex, __FUNCTION__ );
+    if ( newNode != NULL )
+    {
+        freeDataToSendNode( &newNode );
+    }
 
     ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT_MSG(
             "Finished queueing events to send asynchronously"
@@ -1228,6 +2339,253 @@ ResultCode enqueueEventsToSendToApmServer( StringView userAgentHttpHeader, Strin
     goto finally;
 }
 
+/**
+ * Runs only in the process elected as the sender.
+ * Moves batches from the shared ring buffer to this process' queue so they are sent the same way as the batches of this process.
+ */
+static
+void* sharedRingDrainerThreadFunc( void* arg )
+{
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY();
+
+    ELASTIC_APM_UNUSED( arg );
+
+    ResultCode resultCode;
+    TimeSpec timeoutAbsUtc;
+    bool shouldExit;
+    bool hasFirst;
+    bool isSender;
+    Int64 currentTime;
+    StringView userAgentHttpHeader;
+    StringView serializedEvents;
+
+    while ( true )
+    {
+        if ( getMonotonicTimeInNanoseconds( /* out */ &currentTime ) )
+        {
+            ELASTIC_APM_CALL_IF_FAILED_GOTO( backendCommSharedRing_onSenderHeartbeat( g_sharedRing, getCurrentProcessId(), currentTime, /* out */ &isSender ) );
+            if ( ! isSender )
+            {
+                // Only one process is allowed to remove batches from the shared ring buffer
+                ELASTIC_APM_LOG_WARNING( "Another process took over as the sender for shared ring buffer - stopping draining it" );
+                break;
+            }
+        }
+
+        shouldExit = g_sharedRingDrainerShouldExit.load();
+        // Batches left in the shared ring buffer when exiting are moved without waiting for new ones
+        timeoutAbsUtc = (TimeSpec) { .tv_sec = 0, .tv_nsec = 0 };
+        if ( ! shouldExit )
+        {
+            ELASTIC_APM_CALL_IF_FAILED_GOTO( getCurrentAbsTimeSpec( /* out */ &timeoutAbsUtc ) );
+            addDelayToAbsTimeSpec( /* in, out */ &timeoutAbsUtc, (long)ELASTIC_APM_SHARED_RING_DRAINER_WAIT_IN_MILLISECONDS * ELASTIC_APM_NUMBER_OF_NANOSECONDS_IN_MILLISECOND );
+        }
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( backendCommSharedRing_waitForFirst( g_sharedRing, &timeoutAbsUtc, /* out */ &hasFirst, /* out */ &userAgentHttpHeader, /* out */ &serializedEvents ) );
+        if ( ! hasFirst )
+        {
+            if ( shouldExit )
+            {
+                break;
+            }
+            continue;
+        }
+
+        // Batch is copied to the queue so it can be removed from the shared ring buffer right away
+        // If the queue is full the batch is dropped (and counted) the same way as batches of this process
+        enqueueEventsToSendToApmServer( userAgentHttpHeader, serializedEvents );
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( backendCommSharedRing_removeFirst( g_sharedRing ) );
+    }
+
+    resultCode = resultSuccess;
+
+    finally:
+    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT();
+    return NULL;
+
+    failure:
+    goto finally;
+}
+
+/**
+ * If there is no live sender the current process becomes the sender and starts the threads to drain the shared ring buffer and to send events
+ */
+static
+ResultCode sharedRingEnsureSenderElected( const ConfigSnapshot* config )
+{
+    ResultCode resultCode;
+    bool isSender = false;
+    Int64 currentTime;
+
+    if ( g_sharedRingDrainerThread != NULL )
+    {
+        ELASTIC_APM_SET_RESULT_CODE_TO_SUCCESS_AND_GOTO_FINALLY();
+    }
+
+    if ( ! getMonotonicTimeInNanoseconds( /* out */ &currentTime ) )
+    {
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( backendCommSharedRing_tryBecomeSender( g_sharedRing
+                                                                            , getCurrentProcessId()
+                                                                            , currentTime
+                                                                            , ( (Int64) ELASTIC_APM_SHARED_RING_SENDER_HEARTBEAT_TIMEOUT_IN_MILLISECONDS ) * ELASTIC_APM_NUMBER_OF_NANOSECONDS_IN_MILLISECOND
+                                                                            , /* out */ &isSender ) );
+    if ( ! isSender )
+    {
+        ELASTIC_APM_SET_RESULT_CODE_TO_SUCCESS_AND_GOTO_FINALLY();
+    }
+
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( backgroundBackendCommEnsureInited( config ) );
+    g_sharedRingDrainerShouldExit.store( false );
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( newThread( &g_sharedRingDrainerThread
+                                                , &sharedRingDrainerThreadFunc
+                                                , /* threadFuncArg: */ NULL
+                                                , /* thread's dbgDesc */ "Shared ring buffer drainer" ) );
+    ELASTIC_APM_LOG_DEBUG( "Current process is the sender for shared ring buffer; thread ID: %" PRIu64, getThreadId( g_sharedRingDrainerThread ) );
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    if ( isSender )
+    {
+        backendCommSharedRing_resignSender( g_sharedRing, getCurrentProcessId() );
+    }
+    goto finally;
+}
+
+static
+void stopSharedRingDrainer( const ConfigSnapshot* config )
+{
+    ResultCode resultCode;
+    TimeSpec timeoutAbsUtc;
+    void* threadFuncRetVal = NULL;
+    bool hasTimedOut = false;
+
+    if ( g_sharedRingDrainerThread == NULL )
+    {
+        ELASTIC_APM_SET_RESULT_CODE_TO_SUCCESS_AND_GOTO_FINALLY();
+    }
+
+    g_sharedRingDrainerShouldExit.store( true );
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( backendCommSharedRing_wakeUpSender( g_sharedRing ) );
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( getCurrentAbsTimeSpec( /* out */ &timeoutAbsUtc ) );
+    addDelayToAbsTimeSpec( /* in, out */ &timeoutAbsUtc, (long)durationToMilliseconds( config->serverTimeout ) * ELASTIC_APM_NUMBER_OF_NANOSECONDS_IN_MILLISECOND );
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( timedJoinAndDeleteThread( &g_sharedRingDrainerThread, &threadFuncRetVal, &timeoutAbsUtc, /* isCreatedByThisProcess */ true, /* out */ &hasTimedOut, __FUNCTION__ ) );
+    if ( hasTimedOut )
+    {
+        ELASTIC_APM_LOG_ERROR( "Join to shared ring buffer drainer thread timed out" );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    // Next process to send events becomes the sender
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( backendCommSharedRing_resignSender( g_sharedRing, getCurrentProcessId() ) );
+
+    resultCode = resultSuccess;
+    finally:
+    return;
+
+    failure:
+    goto finally;
+}
+
+static
+ResultCode appendEventsToSharedRing( StringView userAgentHttpHeader, StringView serializedEvents )
+{
+    SerializedEventsClassification classification;
+
+    if ( backendCommSharedRing_append( g_sharedRing, userAgentHttpHeader, serializedEvents ) == resultSuccess )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Appended a batch of events to shared ring buffer; batch size: %" PRIu64, (UInt64) serializedEvents.length );
+        return resultSuccess;
+    }
+
+    ELASTIC_APM_LOG_ERROR( "Shared ring buffer is full - dropping these events; batch size: %" PRIu64, (UInt64) serializedEvents.length );
+    classifySerializedEvents( serializedEvents, /* out */ &classification );
+    countDroppedEvents( &classification, /* beginEventClass */ 0, /* endEventClass */ numberOfBackendCommEventClasses );
+    return resultFailure;
+}
+
+/**
+ * Batches of events kept until the request is finished - see backend_comm_defer_sync_send configuration option.
+ * They are accessed only by the thread handling the request.
+ */
+static DataToSendNode* g_deferredSyncSendFirstNode = NULL;
+static DataToSendNode* g_deferredSyncSendLastNode = NULL;
+
+static
+ResultCode deferSyncSendEventsToApmServer( StringView userAgentHttpHeader, StringView serializedEvents )
+{
+    ResultCode resultCode;
+    DataToSendNode* newNode = NULL;
+
+    // Request scoped memory might be already released when deferred events are sent so the batch is copied to persistent memory
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( newDataToSendNode( userAgentHttpHeader, serializedEvents, /* out */ &newNode ) );
+    newNode->next = NULL;
+    if ( g_deferredSyncSendLastNode == NULL )
+    {
+        g_deferredSyncSendFirstNode = newNode;
+    }
+    else
+    {
+        g_deferredSyncSendLastNode->next = newNode;
+    }
+    g_deferredSyncSendLastNode = newNode;
+
+    ELASTIC_APM_LOG_DEBUG( "Deferred sending events until the request is finished; serializedEvents.length: %" PRIu64, (UInt64) serializedEvents.length );
+    resultCode = resultSuccess;
+
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+static
+void discardDeferredSyncSendEvents()
+{
+    while ( g_deferredSyncSendFirstNode != NULL )
+    {
+        DataToSendNode* node = g_deferredSyncSendFirstNode;
+        g_deferredSyncSendFirstNode = node->next;
+        freeDataToSendNode( &node );
+    }
+    g_deferredSyncSendLastNode = NULL;
+}
+
+bool hasDeferredEventsToApmServer()
+{
+    return g_deferredSyncSendFirstNode != NULL;
+}
+
+void sendDeferredEventsToApmServer( const ConfigSnapshot* config )
+{
+    if ( g_deferredSyncSendFirstNode == NULL )
+    {
+        return;
+    }
+
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY();
+
+    while ( g_deferredSyncSendFirstNode != NULL )
+    {
+        DataToSendNode* node = g_deferredSyncSendFirstNode;
+        g_deferredSyncSendFirstNode = node->next;
+        bool isFailureRetriable;
+        // Failure is already logged and there is nobody to report it to at this point
+        if ( syncSendEventsToApmServer( config, stringBufferToView( node->userAgentHttpHeader ), stringBufferToView( node->serializedEvents ), /* batchesCount */ 1, /* isBackoffAlreadyChecked */ false, /* out */ &isFailureRetriable ) != resultSuccess )
+        {
+            backendCommStats_onBatchesDropped( 1 );
+        }
+        freeDataToSendNode( &node );
+    }
+    g_deferredSyncSendLastNode = NULL;
+
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_EXIT();
+}
+
 ResultCode sendEventsToApmServer( const ConfigSnapshot* config, StringView userAgentHttpHeader, StringView serializedEvents )
 {
     ResultCode resultCode;
@@ -1250,14 +2608,45 @@ ResultCode sendEventsToApmServer( const ConfigSnapshot* config, StringView userA
     bool shouldSendAsync = deriveAsyncBackendComm( config, &dbgAsyncBackendCommReason );
     ELASTIC_APM_LOG_DEBUG( "async_backend_comm (asyncBackendComm) configuration option is %s - sending events %s"
                            , dbgAsyncBackendCommReason, ( shouldSendAsync ? "asynchronously" : "synchronously" ) );
-    if ( shouldSendAsync )
+
+    // When the sidecar is not available events are sent by this process as if the sidecar was not configured
+    if ( config->backendCommSidecarSocket != NULL )
+    {
+        if ( sendEventsToSidecar( config->backendCommSidecarSocket, userAgentHttpHeader, serializedEvents ) == resultSuccess )
+        {
+            ELASTIC_APM_SET_RESULT_CODE_TO_SUCCESS_AND_GOTO_FINALLY();
+        }
+        ELASTIC_APM_LOG_DEBUG( "Failed to pass events to sidecar - sending them from this process; backendCommSidecarSocket: %s", config->backendCommSidecarSocket );
+    }
+
+    if ( shouldSendAsync && g_sharedRing != NULL )
+    {
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( sharedRingEnsureSenderElected( config ) );
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( appendEventsToSharedRing( userAgentHttpHeader, serializedEvents ) );
+    }
+    else if ( shouldSendAsync )
     {
         ELASTIC_APM_CALL_IF_FAILED_GOTO( backgroundBackendCommEnsureInited( config ) );
         ELASTIC_APM_CALL_IF_FAILED_GOTO( enqueueEventsToSendToApmServer( userAgentHttpHeader, serializedEvents ) );
     }
+    else if ( config->backendCommDeferSyncSend )
+    {
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( deferSyncSendEventsToApmServer( userAgentHttpHeader, serializedEvents ) );
+    }
     else
     {
-        ELASTIC_APM_CALL_IF_FAILED_GOTO( syncSendEventsToApmServer( config, userAgentHttpHeader, serializedEvents ) );
+        bool isFailureRetriable;
+        resultCode = syncSendEventsToApmServer( config, userAgentHttpHeader, serializedEvents, /* batchesCount */ 1, /* isBackoffAlreadyChecked */ false, /* out */ &isFailureRetriable );
+        if ( resultCode != resultSuccess )
+        {
+            backendCommStats_onBatchesDropped( 1 );
+            // There is no queue to keep the events in when sending synchronously so during backoff they are discarded
+            if ( resultCode == resultBackingOff )
+            {
+                ELASTIC_APM_SET_RESULT_CODE_TO_SUCCESS_AND_GOTO_FINALLY();
+            }
+            goto failure;
+        }
     }
 
     resultCode = resultSuccess;
@@ -1280,7 +2669,26 @@ ResultCode resetBackgroundBackendCommStateInForkedChild()
         ELASTIC_APM_CALL_IF_FAILED_GOTO( unwindBackgroundBackendComm( &g_backgroundBackendComm, /* timeoutAbsUtc: */ NULL, /* isCreatedByThisProcess */ false ) );
     }
 
+    // Shared ring buffer is kept since it's shared with the parent process - only the parent can be its sender
+    if ( g_sharedRingDrainerThread != NULL )
+    {
+        void* threadFuncRetVal = NULL;
+        bool hasTimedOut;
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( timedJoinAndDeleteThread( &g_sharedRingDrainerThread, &threadFuncRetVal, /* timeoutAbsUtc: */ NULL, /* isCreatedByThisProcess */ false, /* out */ &hasTimedOut, __FUNCTION__ ) );
+    }
+
+    // Share object's locks are used when handles are cleaned up
+    resetBackendCommCurlShareInForkedChild();
     cleanupConnectionData( &g_connectionData );
+    cleanupConnectionData( &g_streamingConnectionData );
+    resetSidecarConnectionInForkedChild();
+    // Parent process sends them
+    discardDeferredSyncSendEvents();
+    ELASTIC_APM_FOR_EACH_INDEX( eventClass, numberOfBackendCommEventClasses )
+    {
+        g_droppedEventsCounts[ eventClass ].store( 0, std::memory_order_relaxed );
+    }
+    backendCommStats_reset();
 
     resultCode = resultSuccess;
     finally:
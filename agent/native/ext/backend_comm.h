@@ -22,12 +22,39 @@
 #include "StringView.h"
 #include "ConfigSnapshot_forward_decl.h"
 #include "ResultCode.h"
+#include "backend_comm_queue.h"
 
 ResultCode sendEventsToApmServer(
         const ConfigSnapshot* config
         , StringView userAgentHttpHeader
         , StringView serializedEvents );
 
+/**
+ * Sends events deferred by sendEventsToApmServer when backend_comm_defer_sync_send configuration option is set.
+ * Should be called after the request is finished (see fastcgi_finish_request) so the client does not wait for it.
+ */
+void sendDeferredEventsToApmServer( const ConfigSnapshot* config );
+
+bool hasDeferredEventsToApmServer();
+
+void backgroundBackendCommOnModuleInit( const ConfigSnapshot* config );
 void backgroundBackendCommOnModuleShutdown( const ConfigSnapshot* config );
 
+/**
+ * Starts the background thread before there are any events to send
+ * when backend_comm_warm_up_connection configuration option is set
+ * so that the thread warms up connection to APM Server while the first request is handled.
+ */
+void backgroundBackendCommOnRequestInit( const ConfigSnapshot* config );
+
 ResultCode resetBackgroundBackendCommStateInForkedChild();
+
+/**
+ * Number of events dropped (in this process) because the queue of events to send was above the limit for the event class
+ */
+UInt64 getBackendCommDroppedEventsCount( BackendCommEventClass eventClass );
+
+/**
+ * Total size of serialized events queued (in this process) to be sent by the background backend communication thread
+ */
+UInt64 getBackendCommQueuedEventsSize();
@@ -20,6 +20,7 @@
 #include "backend_comm_backoff.h"
 #include <stdlib.h>
 #include <math.h>
+#include <algorithm>
 #include "basic_macros.h"
 #include "log.h"
 #include "time_util.h"
@@ -83,6 +84,31 @@ void backendCommBackoff_onError( BackendCommBackoff* thisObj )
     addDelayToAbsTimeSpec( /* in, out */ &thisObj->waitEndTime, /* delayInNanoseconds */ (long)backendCommBackoff_getTimeToWaitInSeconds( thisObj ) * ELASTIC_APM_NUMBER_OF_NANOSECONDS_IN_SECOND );
 }
 
+void backendCommBackoff_onErrorWithRetryAfter( BackendCommBackoff* thisObj, UInt retryAfterInSeconds )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj );
+
+    backendCommBackoff_onError( thisObj );
+    // errorCount is 0 if onError failed to get current time
+    if ( thisObj->errorCount == 0 )
+    {
+        return;
+    }
+
+    TimeSpec retryAfterEndTime;
+    if ( ! backendCommBackoff_getCurrentTime( thisObj, /* out */ &retryAfterEndTime ) )
+    {
+        return;
+    }
+    UInt cappedRetryAfterInSeconds = std::min( retryAfterInSeconds, (UInt) ELASTIC_APM_BACKEND_COMM_MAX_RETRY_AFTER_IN_SECONDS );
+    addDelayToAbsTimeSpec( /* in, out */ &retryAfterEndTime, /* delayInNanoseconds */ (long)cappedRetryAfterInSeconds * ELASTIC_APM_NUMBER_OF_NANOSECONDS_IN_SECOND );
+    if ( compareAbsTimeSpecs( &retryAfterEndTime, &thisObj->waitEndTime ) > 0 )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Wait time is extended to honor Retry-After; retryAfterInSeconds: %u, honored: %u", retryAfterInSeconds, cappedRetryAfterInSeconds );
+        thisObj->waitEndTime = retryAfterEndTime;
+    }
+}
+
 int backendCommBackoff_convertRandomUIntToJitter( UInt randomVal, UInt jitterHalfRange )
 {
     double diff = randomVal - ( RAND_MAX / 2.0 );
@@ -139,3 +165,84 @@ bool backendCommBackoff_shouldWait( BackendCommBackoff* thisObj )
     ELASTIC_APM_LOG_TRACE( "Left to wait: %s, errorCount: %u", streamTimeSpecDiff( &currentTime, &thisObj->waitEndTime, &txtOutStream ), thisObj->errorCount );
     return true;
 }
+
+UInt64 backendCommBackoff_getTimeLeftToWaitInMilliseconds( BackendCommBackoff* thisObj )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj );
+
+    if ( ! backendCommBackoff_shouldWait( thisObj ) )
+    {
+        return 0;
+    }
+
+    TimeSpec currentTime;
+    if ( ! backendCommBackoff_getCurrentTime( thisObj, /* out */ &currentTime ) )
+    {
+        return 0;
+    }
+
+    Int64 timeLeftInNanoseconds = ( (Int64) ( thisObj->waitEndTime.tv_sec - currentTime.tv_sec ) ) * ELASTIC_APM_NUMBER_OF_NANOSECONDS_IN_SECOND
+                                  + ( thisObj->waitEndTime.tv_nsec - currentTime.tv_nsec );
+    if ( timeLeftInNanoseconds <= 0 )
+    {
+        return 0;
+    }
+    // Rounded up so that waiting for the returned time is enough for the backoff to end
+    return (UInt64) ( ( timeLeftInNanoseconds + ELASTIC_APM_NUMBER_OF_NANOSECONDS_IN_MILLISECOND - 1 ) / ELASTIC_APM_NUMBER_OF_NANOSECONDS_IN_MILLISECOND );
+}
+
+bool isBackendCommFailureRetriable( long httpStatusCode )
+{
+    // Request failed without HTTP response - for example connection was refused or reset, or timed out
+    if ( httpStatusCode == 0 )
+    {
+        return true;
+    }
+
+    // 408 Request Timeout and 429 Too Many Requests are the only client errors that are expected to go away on retry
+    if ( ( httpStatusCode / 100 ) == 4 )
+    {
+        return httpStatusCode == 408 || httpStatusCode == 429;
+    }
+
+    return true;
+}
+
+bool backendCommRetry_onFailure( BackendCommRetry* thisObj, UInt64 batchId, bool isRetriable, const TimeSpec* currentTime )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj );
+    ELASTIC_APM_ASSERT_VALID_PTR( currentTime );
+
+    if ( ! isRetriable )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Failure is not retriable - batch should be dropped; batch ID: %" PRIu64, batchId );
+        backendCommRetry_onSuccess( thisObj );
+        return false;
+    }
+
+    if ( thisObj->failedAttemptsCount == 0 || thisObj->batchId != batchId )
+    {
+        thisObj->batchId = batchId;
+        thisObj->failedAttemptsCount = 0;
+        thisObj->firstFailureTime = *currentTime;
+    }
+    ++thisObj->failedAttemptsCount;
+
+    TimeSpec retryEndTime = thisObj->firstFailureTime;
+    addDelayToAbsTimeSpec( /* in, out */ &retryEndTime, /* delayInNanoseconds */ (long)ELASTIC_APM_BACKEND_COMM_MAX_RETRY_DURATION_IN_SECONDS * ELASTIC_APM_NUMBER_OF_NANOSECONDS_IN_SECOND );
+    if ( thisObj->failedAttemptsCount >= ELASTIC_APM_BACKEND_COMM_MAX_SEND_ATTEMPTS || compareAbsTimeSpecs( &retryEndTime, currentTime ) <= 0 )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Reached limit for retrying - batch should be dropped; batch ID: %" PRIu64 "; failed attempts: %u", batchId, thisObj->failedAttemptsCount );
+        backendCommRetry_onSuccess( thisObj );
+        return false;
+    }
+
+    return true;
+}
+
+void backendCommRetry_onSuccess( BackendCommRetry* thisObj )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj );
+
+    *thisObj = ELASTIC_APM_DEFAULT_BACKEND_COMM_RETRY;
+}
@@ -35,12 +35,23 @@ typedef struct BackendCommBackoff BackendCommBackoff;
 
 void backendCommBackoff_onSuccess( BackendCommBackoff* thisObj );
 void backendCommBackoff_onError( BackendCommBackoff* thisObj );
+/**
+ * Same as backendCommBackoff_onError but the wait lasts at least as long as APM Server asked in Retry-After HTTP response header
+ */
+void backendCommBackoff_onErrorWithRetryAfter( BackendCommBackoff* thisObj, UInt retryAfterInSeconds );
 bool backendCommBackoff_shouldWait( BackendCommBackoff* thisObj );
+/**
+ * @return 0 if there is no need to wait
+ */
+UInt64 backendCommBackoff_getTimeLeftToWaitInMilliseconds( BackendCommBackoff* thisObj );
 
 UInt backendCommBackoff_getTimeToWaitInSeconds( const BackendCommBackoff* thisObj );
 int backendCommBackoff_convertRandomUIntToJitter( UInt randomVal, UInt jitterHalfRange );
 UInt backendCommBackoff_defaultGenerateRandomUInt( void* ctx );
 
+// Retry-After values above this limit are not honored as is to avoid suspending communication with APM Server for too long
+#define ELASTIC_APM_BACKEND_COMM_MAX_RETRY_AFTER_IN_SECONDS 300
+
 #define ELASTIC_APM_DEFAULT_BACKEND_COMM_BACKOFF \
     ((BackendCommBackoff) \
     { \
@@ -50,3 +61,44 @@ UInt backendCommBackoff_defaultGenerateRandomUInt( void* ctx );
         .waitEndTime = { .tv_sec = 0, .tv_nsec = 0 } \
     }) \
     /**/
+
+/**
+ * Failure to send events is retriable if there is a chance that sending the same events again succeeds
+ * - for example connection was reset or APM Server is overloaded (HTTP status 503 or 429).
+ * Other 4xx HTTP statuses mean that the request itself is rejected so there is no point in sending it again.
+ *
+ * @param httpStatusCode 0 if the request failed without receiving HTTP response
+ */
+bool isBackendCommFailureRetriable( long httpStatusCode );
+
+// Failed batch of events is retried until one of these limits is reached
+#define ELASTIC_APM_BACKEND_COMM_MAX_SEND_ATTEMPTS 10
+#define ELASTIC_APM_BACKEND_COMM_MAX_RETRY_DURATION_IN_SECONDS 300
+
+/**
+ * Keeps track of failed attempts to send the batch of events at the head of the queue
+ */
+struct BackendCommRetry
+{
+    UInt64 batchId;
+    UInt failedAttemptsCount;
+    TimeSpec firstFailureTime;
+};
+typedef struct BackendCommRetry BackendCommRetry;
+
+/**
+ * @param currentTime monotonic clock time
+ *
+ * @return true if the failed batch should be kept to be retried and false if it should be dropped
+ */
+bool backendCommRetry_onFailure( BackendCommRetry* thisObj, UInt64 batchId, bool isRetriable, const TimeSpec* currentTime );
+void backendCommRetry_onSuccess( BackendCommRetry* thisObj );
+
+#define ELASTIC_APM_DEFAULT_BACKEND_COMM_RETRY \
+    ((BackendCommRetry) \
+    { \
+        .batchId = 0, \
+        .failedAttemptsCount = 0, \
+        .firstFailureTime = { .tv_sec = 0, .tv_nsec = 0 } \
+    }) \
+    /**/
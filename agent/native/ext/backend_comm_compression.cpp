@@ -0,0 +1,270 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "backend_comm_compression.h"
+#include <limits.h>
+#include <string.h>
+#include <zlib.h>
+#include "elastic_apm_alloc.h"
+#include "elastic_apm_assert.h"
+#include "log.h"
+#include "TextOutputStream.h"
+
+#define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_BACKEND_COMM
+
+const char* backendCommCompressionNames[ numberOfBackendCommCompressions ] =
+{
+    [ backendCommCompression_off ] = "off",
+    [ backendCommCompression_gzip ] = "gzip",
+    [ backendCommCompression_deflate ] = "deflate"
+};
+
+String streamBackendCommCompression( BackendCommCompression compression, TextOutputStream* txtOutStream )
+{
+    if ( compression < 0 || compression >= numberOfBackendCommCompressions )
+    {
+        return streamInt( compression, txtOutStream );
+    }
+
+    return streamString( backendCommCompressionNames[ compression ], txtOutStream );
+}
+
+String backendCommCompressionToContentEncoding( BackendCommCompression compression )
+{
+    switch ( compression )
+    {
+        case backendCommCompression_gzip:
+            return "gzip";
+
+        case backendCommCompression_deflate:
+            return "deflate";
+
+        default:
+            return NULL;
+    }
+}
+
+static
+int backendCommCompressionToZlibWindowBits( BackendCommCompression compression )
+{
+    // Adding 16 to windowBits makes zlib write gzip header and trailer instead of zlib wrapper
+    // HTTP's "deflate" content coding is the "zlib" format (RFC 1950) so default (zlib) wrapper is used for it
+    //
+    // @link https://www.zlib.net/manual.html#Advanced
+    // @link https://www.rfc-editor.org/rfc/rfc9110#name-deflate-coding
+    enum { maxWindowBits = 15, gzipWrapperWindowBitsIncrement = 16 };
+
+    return compression == backendCommCompression_gzip ? ( maxWindowBits + gzipWrapperWindowBitsIncrement ) : maxWindowBits;
+}
+
+ResultCode backendCommCompressor_init( BackendCommCompressor* thisObj, BackendCommCompression compression, int level )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj );
+    ELASTIC_APM_ASSERT_PTR_IS_NULL( thisObj->zStream );
+    ELASTIC_APM_ASSERT( compression != backendCommCompression_off, "" );
+
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY_MSG( "compression: %s, level: %d", backendCommCompressionNames[ compression ], level );
+
+    ResultCode resultCode;
+    z_stream* zStream = NULL;
+    int zlibRetVal;
+    enum { memLevel = 8 };
+
+    if ( ! ELASTIC_APM_IS_IN_INCLUSIVE_RANGE( ELASTIC_APM_BACKEND_COMM_COMPRESSION_MIN_LEVEL, level, ELASTIC_APM_BACKEND_COMM_COMPRESSION_MAX_LEVEL ) )
+    {
+        ELASTIC_APM_LOG_ERROR( "Compression level is out of range - using default instead. level: %d, default level: %d"
+                               , level, ELASTIC_APM_BACKEND_COMM_COMPRESSION_DEFAULT_LEVEL );
+        level = ELASTIC_APM_BACKEND_COMM_COMPRESSION_DEFAULT_LEVEL;
+    }
+
+    ELASTIC_APM_MALLOC_INSTANCE_IF_FAILED_GOTO( z_stream, /* out */ zStream );
+    ELASTIC_APM_ZERO_STRUCT( zStream );
+    zStream->zalloc = Z_NULL;
+    zStream->zfree = Z_NULL;
+    zStream->opaque = Z_NULL;
+
+    zlibRetVal = deflateInit2( zStream, level, Z_DEFLATED, backendCommCompressionToZlibWindowBits( compression ), memLevel, Z_DEFAULT_STRATEGY );
+    if ( zlibRetVal != Z_OK )
+    {
+        ELASTIC_APM_LOG_ERROR( "deflateInit2 failed; return value: %d, zlib version: %s", zlibRetVal, zlibVersion() );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    thisObj->compression = compression;
+    thisObj->level = level;
+    thisObj->zStream = zStream;
+    zStream = NULL;
+
+    resultCode = resultSuccess;
+    finally:
+    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT();
+    return resultCode;
+
+    failure:
+    ELASTIC_APM_FREE_INSTANCE_AND_SET_TO_NULL( z_stream, zStream );
+    goto finally;
+}
+
+static
+ResultCode backendCommCompressor_ensureOutputBufferCapacity( BackendCommCompressor* thisObj, size_t requiredCapacity, size_t usedLength )
+{
+    ResultCode resultCode;
+    char* newOutputBuffer = NULL;
+
+    if ( thisObj->outputBufferCapacity >= requiredCapacity )
+    {
+        ELASTIC_APM_SET_RESULT_CODE_TO_SUCCESS_AND_GOTO_FINALLY();
+    }
+
+    ELASTIC_APM_MALLOC_IF_FAILED_GOTO( char, requiredCapacity, /* out */ newOutputBuffer );
+    if ( usedLength != 0 )
+    {
+        memcpy( newOutputBuffer, thisObj->outputBuffer, usedLength );
+    }
+
+    ELASTIC_APM_FREE_AND_SET_TO_NULL( char, thisObj->outputBufferCapacity, thisObj->outputBuffer );
+    thisObj->outputBuffer = newOutputBuffer;
+    thisObj->outputBufferCapacity = requiredCapacity;
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+ResultCode backendCommCompressor_beginStream( BackendCommCompressor* thisObj )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj );
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj->zStream );
+
+    int zlibRetVal = deflateReset( (z_stream*)( thisObj->zStream ) );
+    if ( zlibRetVal != Z_OK )
+    {
+        ELASTIC_APM_LOG_ERROR( "deflateReset failed; return value: %d", zlibRetVal );
+        return resultFailure;
+    }
+
+    return resultSuccess;
+}
+
+ResultCode backendCommCompressor_compressStreamChunk( BackendCommCompressor* thisObj, StringView input, bool isLastChunk, /* out */ StringView* output )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj );
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj->zStream );
+    ELASTIC_APM_ASSERT( input.length == 0 || input.begin != NULL, "" );
+    ELASTIC_APM_ASSERT_VALID_PTR( output );
+
+    ResultCode resultCode;
+    z_stream* zStream = (z_stream*)( thisObj->zStream );
+    int zlibRetVal;
+    // Z_SYNC_FLUSH makes all the input compressed so far available to the receiving side
+    // without terminating the stream - it costs at most a few bytes per flush
+    int flush = isLastChunk ? Z_FINISH : Z_SYNC_FLUSH;
+    size_t outputLength = 0;
+
+    if ( input.length > UINT_MAX )
+    {
+        ELASTIC_APM_LOG_ERROR( "Input is too large to compress in one pass; input.length: %" PRIu64, (UInt64)input.length );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    // deflateBound() takes into account the wrapper (gzip or zlib) selected in deflateInit2()
+    // so for the whole input compressed with Z_FINISH deflate() is guaranteed to complete in a single call.
+    // Flush markers are not accounted for by deflateBound() so the buffer is grown below if it turns out to be too small.
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( backendCommCompressor_ensureOutputBufferCapacity( thisObj, deflateBound( zStream, (uLong)input.length ), /* usedLength */ 0 ) );
+
+    zStream->next_in = (Bytef*)( input.begin );
+    zStream->avail_in = (uInt)( input.length );
+    while ( true )
+    {
+        zStream->next_out = (Bytef*)( thisObj->outputBuffer + outputLength );
+        zStream->avail_out = (uInt)( thisObj->outputBufferCapacity - outputLength );
+
+        zlibRetVal = deflate( zStream, flush );
+        outputLength = (size_t)( (char*)( zStream->next_out ) - thisObj->outputBuffer );
+        if ( zlibRetVal != Z_OK && zlibRetVal != Z_BUF_ERROR && zlibRetVal != Z_STREAM_END )
+        {
+            ELASTIC_APM_LOG_ERROR( "deflate failed; return value: %d, message: %s", zlibRetVal, zStream->msg == NULL ? "N/A" : zStream->msg );
+            ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+        }
+        if ( zlibRetVal == Z_STREAM_END || ( ! isLastChunk && zStream->avail_out != 0 ) )
+        {
+            break;
+        }
+        // deflate() has to be called again with more output space only if it used up all of the space given to it
+        if ( zStream->avail_out != 0 )
+        {
+            ELASTIC_APM_LOG_ERROR( "deflate did not finish the stream; return value: %d, avail_out: %u", zlibRetVal, (UInt)( zStream->avail_out ) );
+            ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+        }
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( backendCommCompressor_ensureOutputBufferCapacity( thisObj, thisObj->outputBufferCapacity * 2, /* usedLength */ outputLength ) );
+    }
+
+    *output = makeStringView( thisObj->outputBuffer, outputLength );
+    thisObj->uncompressedBytesTotal += input.length;
+    thisObj->compressedBytesTotal += output->length;
+
+    ELASTIC_APM_LOG_DEBUG(
+            "Compressed events; compression: %s, level: %d, isLastChunk: %s"
+            ", uncompressed size: %" PRIu64 ", compressed size: %" PRIu64
+            ", total uncompressed: %" PRIu64 ", total compressed: %" PRIu64
+            , backendCommCompressionNames[ thisObj->compression ], thisObj->level, boolToString( isLastChunk )
+            , (UInt64)input.length, (UInt64)output->length
+            , thisObj->uncompressedBytesTotal, thisObj->compressedBytesTotal );
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+ResultCode backendCommCompressor_compress( BackendCommCompressor* thisObj, StringView input, /* out */ StringView* output )
+{
+    ResultCode resultCode;
+
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( backendCommCompressor_beginStream( thisObj ) );
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( backendCommCompressor_compressStreamChunk( thisObj, input, /* isLastChunk */ true, /* out */ output ) );
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+void backendCommCompressor_cleanup( BackendCommCompressor* thisObj )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj );
+
+    if ( thisObj->zStream != NULL )
+    {
+        z_stream* zStream = (z_stream*)( thisObj->zStream );
+        deflateEnd( zStream );
+        ELASTIC_APM_FREE_INSTANCE_AND_SET_TO_NULL( z_stream, zStream );
+        thisObj->zStream = NULL;
+    }
+
+    ELASTIC_APM_FREE_AND_SET_TO_NULL( char, thisObj->outputBufferCapacity, thisObj->outputBuffer );
+    thisObj->outputBufferCapacity = 0;
+}
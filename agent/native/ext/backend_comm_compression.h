@@ -0,0 +1,101 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include "basic_types.h"
+#include "StringView.h"
+#include "ResultCode.h"
+#include "TextOutputStream_forward_decl.h"
+
+enum BackendCommCompression
+{
+    backendCommCompression_off,
+    backendCommCompression_gzip,
+    backendCommCompression_deflate,
+
+    numberOfBackendCommCompressions
+};
+typedef enum BackendCommCompression BackendCommCompression;
+
+extern const char* backendCommCompressionNames[ numberOfBackendCommCompressions ];
+
+String streamBackendCommCompression( BackendCommCompression compression, TextOutputStream* txtOutStream );
+
+/**
+ * Returns value for Content-Encoding HTTP header or NULL if compression is `off'
+ */
+String backendCommCompressionToContentEncoding( BackendCommCompression compression );
+
+#define ELASTIC_APM_BACKEND_COMM_COMPRESSION_MIN_LEVEL 0
+#define ELASTIC_APM_BACKEND_COMM_COMPRESSION_MAX_LEVEL 9
+#define ELASTIC_APM_BACKEND_COMM_COMPRESSION_DEFAULT_LEVEL 6
+
+/**
+ * Compressor is intended to be long-lived (it is reset between batches)
+ * so that zlib's internal state and the output buffer are allocated only once.
+ * It's not thread safe - it's used only by the thread sending events to APM Server.
+ */
+struct BackendCommCompressor
+{
+    BackendCommCompression compression;
+    int level;
+    void* zStream;
+
+    char* outputBuffer;
+    size_t outputBufferCapacity;
+
+    UInt64 uncompressedBytesTotal;
+    UInt64 compressedBytesTotal;
+};
+typedef struct BackendCommCompressor BackendCommCompressor;
+
+#define ELASTIC_APM_DEFAULT_BACKEND_COMM_COMPRESSOR \
+    ((BackendCommCompressor) \
+    { \
+        .compression = backendCommCompression_off, \
+        .level = ELASTIC_APM_BACKEND_COMM_COMPRESSION_DEFAULT_LEVEL, \
+        .zStream = NULL, \
+        .outputBuffer = NULL, \
+        .outputBufferCapacity = 0, \
+        .uncompressedBytesTotal = 0, \
+        .compressedBytesTotal = 0 \
+    }) \
+    /**/
+
+ResultCode backendCommCompressor_init( BackendCommCompressor* thisObj, BackendCommCompression compression, int level );
+
+/**
+ * Compressed output is owned by the compressor and is valid until the next call to backendCommCompressor_compress
+ * or backendCommCompressor_cleanup
+ */
+ResultCode backendCommCompressor_compress( BackendCommCompressor* thisObj, StringView input, /* out */ StringView* output );
+
+/**
+ * Streaming counterpart of backendCommCompressor_compress:
+ * backendCommCompressor_beginStream starts a new compressed stream (one per request)
+ * and each chunk is flushed so that it can be sent before the rest of the request body is known.
+ * The last chunk (possibly empty) terminates the stream.
+ * Compressed output has the same lifetime as the one returned by backendCommCompressor_compress.
+ */
+ResultCode backendCommCompressor_beginStream( BackendCommCompressor* thisObj );
+ResultCode backendCommCompressor_compressStreamChunk( BackendCommCompressor* thisObj, StringView input, bool isLastChunk, /* out */ StringView* output );
+
+void backendCommCompressor_cleanup( BackendCommCompressor* thisObj );
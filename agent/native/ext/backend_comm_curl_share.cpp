@@ -0,0 +1,162 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "backend_comm_curl_share.h"
+#include <pthread.h>
+#include "elastic_apm_assert.h"
+#include "log.h"
+#include "util.h"
+
+#define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_BACKEND_COMM
+
+static CURLSH* g_curlShare = NULL;
+// libcurl locks the share object itself (CURL_LOCK_DATA_SHARE) in addition to the shared data
+static pthread_mutex_t g_curlShareLocks[ CURL_LOCK_DATA_LAST ];
+
+static
+void initCurlShareLocks()
+{
+    ELASTIC_APM_FOR_EACH_INDEX( i, CURL_LOCK_DATA_LAST )
+    {
+        pthread_mutex_init( &( g_curlShareLocks[ i ] ), /* attr: */ NULL );
+    }
+}
+
+static
+void destroyCurlShareLocks()
+{
+    ELASTIC_APM_FOR_EACH_INDEX( i, CURL_LOCK_DATA_LAST )
+    {
+        pthread_mutex_destroy( &( g_curlShareLocks[ i ] ) );
+    }
+}
+
+/**
+ * @link https://curl.se/libcurl/c/CURLSHOPT_LOCKFUNC.html
+ */
+static
+void lockCurlShareData( CURL* curlHandle, curl_lock_data data, curl_lock_access access, void* userPtr )
+{
+    ELASTIC_APM_UNUSED( curlHandle );
+    ELASTIC_APM_UNUSED( access );
+    ELASTIC_APM_UNUSED( userPtr );
+
+    pthread_mutex_lock( &( g_curlShareLocks[ data ] ) );
+}
+
+/**
+ * @link https://curl.se/libcurl/c/CURLSHOPT_UNLOCKFUNC.html
+ */
+static
+void unlockCurlShareData( CURL* curlHandle, curl_lock_data data, void* userPtr )
+{
+    ELASTIC_APM_UNUSED( curlHandle );
+    ELASTIC_APM_UNUSED( userPtr );
+
+    pthread_mutex_unlock( &( g_curlShareLocks[ data ] ) );
+}
+
+#define ELASTIC_APM_CURL_SHARE_SETOPT( curlShare, curlShareOptionId, ... ) \
+    do { \
+        CURLSHcode curl_share_setopt_ret_val = curl_share_setopt( curlShare, curlShareOptionId, __VA_ARGS__ ); \
+        if ( curl_share_setopt_ret_val != CURLSHE_OK ) \
+        { \
+            ELASTIC_APM_LOG_ERROR( "Failed to set curl share option; curlShareOptionId: %d (used constant: %s); error: %s" \
+                                   , (int) curlShareOptionId, #curlShareOptionId, curl_share_strerror( curl_share_setopt_ret_val ) ); \
+            ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE_EX( resultCurlFailure ); \
+        } \
+    } while ( false ) \
+    /**/
+
+ResultCode initBackendCommCurlShare()
+{
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY();
+
+    ResultCode resultCode;
+    CURLSH* curlShare = NULL;
+
+    ELASTIC_APM_ASSERT( g_curlShare == NULL, "" );
+
+    initCurlShareLocks();
+
+    curlShare = curl_share_init();
+    if ( curlShare == NULL )
+    {
+        ELASTIC_APM_LOG_ERROR( "curl_share_init() returned NULL" );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE_EX( resultCurlFailure );
+    }
+
+    ELASTIC_APM_CURL_SHARE_SETOPT( curlShare, CURLSHOPT_LOCKFUNC, &lockCurlShareData );
+    ELASTIC_APM_CURL_SHARE_SETOPT( curlShare, CURLSHOPT_UNLOCKFUNC, &unlockCurlShareData );
+    ELASTIC_APM_CURL_SHARE_SETOPT( curlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS );
+    ELASTIC_APM_CURL_SHARE_SETOPT( curlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION );
+
+    g_curlShare = curlShare;
+    curlShare = NULL;
+    resultCode = resultSuccess;
+
+    finally:
+    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT();
+    return resultCode;
+
+    failure:
+    if ( curlShare != NULL )
+    {
+        curl_share_cleanup( curlShare );
+    }
+    destroyCurlShareLocks();
+    goto finally;
+}
+
+#undef ELASTIC_APM_CURL_SHARE_SETOPT
+
+CURLSH* getBackendCommCurlShare()
+{
+    return g_curlShare;
+}
+
+void cleanupBackendCommCurlShare()
+{
+    if ( g_curlShare == NULL )
+    {
+        return;
+    }
+
+    CURLSHcode curlShareResult = curl_share_cleanup( g_curlShare );
+    if ( curlShareResult != CURLSHE_OK )
+    {
+        // The share object is still in use - it's better to leak it than to free memory that is still referenced
+        ELASTIC_APM_LOG_ERROR( "curl_share_cleanup() failed; error: %s", curl_share_strerror( curlShareResult ) );
+        return;
+    }
+
+    g_curlShare = NULL;
+    destroyCurlShareLocks();
+}
+
+void resetBackendCommCurlShareInForkedChild()
+{
+    if ( g_curlShare == NULL )
+    {
+        return;
+    }
+
+    initCurlShareLocks();
+}
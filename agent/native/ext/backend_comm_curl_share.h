@@ -0,0 +1,52 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#pragma once
+
+#include <curl/curl.h>
+#include "ResultCode.h"
+
+/**
+ * curl share object attached to all the handles used to send events to APM Server.
+ * It keeps the DNS cache and TLS sessions so that a handle re-created after a failure
+ * does not have to resolve APM Server's host name and to do the full TLS handshake again.
+ *
+ * Connections are not shared because libcurl does not support sharing them between concurrent threads.
+ *
+ * The share object is created on module init so that the processes forked after that
+ * (for example PHP-FPM workers) inherit it.
+ */
+ResultCode initBackendCommCurlShare();
+
+/**
+ * @return NULL if the share object was not created - the handles work without it
+ */
+CURLSH* getBackendCommCurlShare();
+
+/**
+ * Should be called only after all the handles using the share object are cleaned up
+ */
+void cleanupBackendCommCurlShare();
+
+/**
+ * Parent's threads might have held the share's locks at the moment of fork
+ * so forked child re-initializes them before using the inherited share object
+ */
+void resetBackendCommCurlShareInForkedChild();
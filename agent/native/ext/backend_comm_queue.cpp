@@ -0,0 +1,381 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "backend_comm_queue.h"
+#include <string.h>
+#include "elastic_apm_alloc.h"
+#include "elastic_apm_assert.h"
+#include "log.h"
+#include "TextOutputStream.h"
+
+#define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_BACKEND_COMM
+
+static
+size_t calcDataToSendNodeMemBlockSize( size_t userAgentHttpHeaderBufferSize, size_t serializedEventsBufferSize )
+{
+    return sizeof( DataToSendNode ) + userAgentHttpHeaderBufferSize + serializedEventsBufferSize;
+}
+
+static
+char* copyToStringBuffer( StringView src, char* dst, /* out */ StringBuffer* strBuf )
+{
+    memcpy( dst, src.begin, src.length );
+    dst[ src.length ] = '\0';
+    // +1 for terminating '\0'
+    *strBuf = ELASTIC_APM_MAKE_STRING_BUFFER( dst, src.length + 1 );
+    return dst + strBuf->size;
+}
+
+/**
+ * Allocates node with User-Agent HTTP header already copied and space for serialized events of the given length (including terminating '\0')
+ */
+static
+ResultCode allocDataToSendNode( StringView userAgentHttpHeader, size_t serializedEventsLength, /* out */ DataToSendNode** newNode )
+{
+    ResultCode resultCode;
+    char* memBlock = NULL;
+    char* stringsBegin = NULL;
+    DataToSendNode* node = NULL;
+
+    // +1 for terminating '\0'
+    ELASTIC_APM_MALLOC_IF_FAILED_GOTO( char, calcDataToSendNodeMemBlockSize( userAgentHttpHeader.length + 1, serializedEventsLength + 1 ), /* out */ memBlock );
+    node = (DataToSendNode*)memBlock;
+    ELASTIC_APM_ZERO_STRUCT( node );
+
+    stringsBegin = memBlock + sizeof( DataToSendNode );
+    stringsBegin = copyToStringBuffer( userAgentHttpHeader, stringsBegin, /* out */ &( node->userAgentHttpHeader ) );
+    stringsBegin[ serializedEventsLength ] = '\0';
+    node->serializedEvents = ELASTIC_APM_MAKE_STRING_BUFFER( stringsBegin, serializedEventsLength + 1 );
+
+    *newNode = node;
+    resultCode = resultSuccess;
+
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+ResultCode newDataToSendNode( StringView userAgentHttpHeader, StringView serializedEvents, /* out */ DataToSendNode** newNode )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( userAgentHttpHeader.begin );
+    ELASTIC_APM_ASSERT_VALID_PTR( serializedEvents.begin );
+    ELASTIC_APM_ASSERT_VALID_OUT_PTR_TO_PTR( newNode );
+
+    ResultCode resultCode;
+    DataToSendNode* node = NULL;
+
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( allocDataToSendNode( userAgentHttpHeader, serializedEvents.length, /* out */ &node ) );
+    memcpy( node->serializedEvents.begin, serializedEvents.begin, serializedEvents.length );
+
+    *newNode = node;
+    resultCode = resultSuccess;
+
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+const char* backendCommEventClassNames[ numberOfBackendCommEventClasses ] =
+{
+    [ backendCommEventClass_span ] = "span",
+    [ backendCommEventClass_metricset ] = "metricset",
+    [ backendCommEventClass_error ] = "error",
+    [ backendCommEventClass_transaction ] = "transaction",
+    [ backendCommEventClass_other ] = "other"
+};
+
+String streamBackendCommEventClass( BackendCommEventClass eventClass, TextOutputStream* txtOutStream )
+{
+    if ( eventClass < 0 || eventClass >= numberOfBackendCommEventClasses )
+    {
+        return streamInt( eventClass, txtOutStream );
+    }
+
+    return streamString( backendCommEventClassNames[ eventClass ], txtOutStream );
+}
+
+/**
+ * Each event line is a JSON object with a single property named after the event type - for example {"span":{...}}
+ */
+static
+BackendCommEventClass classifyEventLine( StringView eventLine )
+{
+    static const StringView prefixes[ numberOfBackendCommEventClasses - 1 ] =
+    {
+        [ backendCommEventClass_span ] = ELASTIC_APM_STRING_LITERAL_TO_VIEW( "{\"span\":" ),
+        [ backendCommEventClass_metricset ] = ELASTIC_APM_STRING_LITERAL_TO_VIEW( "{\"metricset\":" ),
+        [ backendCommEventClass_error ] = ELASTIC_APM_STRING_LITERAL_TO_VIEW( "{\"error\":" ),
+        [ backendCommEventClass_transaction ] = ELASTIC_APM_STRING_LITERAL_TO_VIEW( "{\"transaction\":" )
+    };
+
+    ELASTIC_APM_FOR_EACH_INDEX( i, ELASTIC_APM_STATIC_ARRAY_SIZE( prefixes ) )
+    {
+        if ( isStringViewPrefix( eventLine, prefixes[ i ], /* shouldIgnoreCase */ false ) )
+        {
+            return (BackendCommEventClass) i;
+        }
+    }
+    return backendCommEventClass_other;
+}
+
+static
+size_t findMetadataLineLength( StringView serializedEvents )
+{
+    const char* newLine = (const char*) memchr( serializedEvents.begin, '\n', serializedEvents.length );
+    return newLine == NULL ? serializedEvents.length : (size_t) ( newLine - serializedEvents.begin );
+}
+
+/**
+ * offset should point to '\n' preceding the next event line (or to the end of serialized events) - it's initially the length of the metadata line
+ */
+static
+bool getNextEventLine( StringView serializedEvents, /* in,out */ size_t* offset, /* out */ StringView* eventLine )
+{
+    if ( *offset >= serializedEvents.length )
+    {
+        return false;
+    }
+
+    const char* end = serializedEvents.begin + serializedEvents.length;
+    const char* lineBegin = serializedEvents.begin + *offset + 1;
+    const char* lineEnd = (const char*) memchr( lineBegin, '\n', (size_t) ( end - lineBegin ) );
+    if ( lineEnd == NULL )
+    {
+        lineEnd = end;
+    }
+
+    *eventLine = makeStringViewFromBeginEnd( lineBegin, lineEnd );
+    *offset = (size_t) ( lineEnd - serializedEvents.begin );
+    return true;
+}
+
+void classifySerializedEvents( StringView serializedEvents, /* out */ SerializedEventsClassification* classification )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( classification );
+
+    ELASTIC_APM_ZERO_STRUCT( classification );
+    classification->metadataLineLength = findMetadataLineLength( serializedEvents );
+
+    size_t offset = classification->metadataLineLength;
+    StringView eventLine;
+    while ( getNextEventLine( serializedEvents, /* in,out */ &offset, /* out */ &eventLine ) )
+    {
+        BackendCommEventClass eventClass = classifyEventLine( eventLine );
+        ++classification->eventsCount[ eventClass ];
+        // +1 for the preceding '\n'
+        classification->eventsSize[ eventClass ] += eventLine.length + 1;
+    }
+}
+
+ResultCode newFilteredDataToSendNode(
+        StringView userAgentHttpHeader
+        , StringView serializedEvents
+        , const SerializedEventsClassification* classification
+        , BackendCommEventClass minEventClassToKeep
+        , /* out */ DataToSendNode** newNode )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( userAgentHttpHeader.begin );
+    ELASTIC_APM_ASSERT_VALID_PTR( serializedEvents.begin );
+    ELASTIC_APM_ASSERT_VALID_PTR( classification );
+    ELASTIC_APM_ASSERT_VALID_OUT_PTR_TO_PTR( newNode );
+
+    ResultCode resultCode;
+    DataToSendNode* node = NULL;
+    char* dst = NULL;
+    size_t offset = classification->metadataLineLength;
+    StringView eventLine;
+    size_t filteredLength = classification->metadataLineLength;
+    for ( int eventClass = minEventClassToKeep; eventClass < numberOfBackendCommEventClasses; ++eventClass )
+    {
+        filteredLength += classification->eventsSize[ eventClass ];
+    }
+
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( allocDataToSendNode( userAgentHttpHeader, filteredLength, /* out */ &node ) );
+    dst = node->serializedEvents.begin;
+    memcpy( dst, serializedEvents.begin, classification->metadataLineLength );
+    dst += classification->metadataLineLength;
+    while ( getNextEventLine( serializedEvents, /* in,out */ &offset, /* out */ &eventLine ) )
+    {
+        if ( classifyEventLine( eventLine ) >= minEventClassToKeep )
+        {
+            *dst = '\n';
+            memcpy( dst + 1, eventLine.begin, eventLine.length );
+            dst += eventLine.length + 1;
+        }
+    }
+    ELASTIC_APM_ASSERT_EQ_UINT64( (UInt64) ( dst - node->serializedEvents.begin ), filteredLength );
+
+    *newNode = node;
+    resultCode = resultSuccess;
+
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+void freeDataToSendNode( DataToSendNode** nodeOutPtr )
+{
+    ELASTIC_APM_ASSERT_VALID_IN_PTR_TO_PTR( nodeOutPtr );
+
+    char* memBlock = (char*)( *nodeOutPtr );
+    ELASTIC_APM_FREE_AND_SET_TO_NULL( char, calcDataToSendNodeMemBlockSize( (*nodeOutPtr)->userAgentHttpHeader.size, (*nodeOutPtr)->serializedEvents.size ), memBlock );
+    *nodeOutPtr = NULL;
+}
+
+void initDataToSendQueue( DataToSendQueue* dataQueue )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( dataQueue );
+
+    dataQueue->head.prev =  NULL;
+    dataQueue->head.next =  &dataQueue->tail;
+    dataQueue->tail.prev =  &dataQueue->head;
+    dataQueue->tail.next =  NULL;
+
+    dataQueue->intakeStackTop.store( NULL );
+    dataQueue->totalSize.store( 0 );
+    dataQueue->nextNodeId.store( 1 );
+}
+
+bool tryPushNodeToDataToSendQueue( DataToSendQueue* dataQueue, size_t maxTotalSize, DataToSendNode* node, /* out */ UInt64* id, /* out */ size_t* totalSize )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( dataQueue );
+    ELASTIC_APM_ASSERT_VALID_PTR( node );
+    ELASTIC_APM_ASSERT_VALID_PTR( id );
+    ELASTIC_APM_ASSERT_VALID_PTR( totalSize );
+
+    // -1 since terminating '\0' is counted in buffer's size but not in string's length
+    size_t nodeDataSize = node->serializedEvents.size - 1;
+
+    // The size is reserved before the node is pushed so that the queue doesn't go above max size
+    // even if there are concurrent producers
+    size_t currentTotalSize = dataQueue->totalSize.load();
+    do {
+        if ( currentTotalSize >= maxTotalSize )
+        {
+            *totalSize = currentTotalSize;
+            return false;
+        }
+    } while ( ! dataQueue->totalSize.compare_exchange_weak( currentTotalSize, currentTotalSize + nodeDataSize ) );
+    *totalSize = currentTotalSize + nodeDataSize;
+
+    node->id = dataQueue->nextNodeId.fetch_add( 1 );
+    // The node can be removed by the consumer as soon as it's pushed so it should not be accessed after that
+    *id = node->id;
+    node->prev = NULL;
+    // Nodes are only pushed to the intake stack concurrently while it's emptied as a whole (exchange with NULL) by the consumer
+    // so there's no ABA problem
+    node->next = dataQueue->intakeStackTop.load();
+    while ( ! dataQueue->intakeStackTop.compare_exchange_weak( node->next, node ) ) {}
+
+    return true;
+}
+
+bool isDataToSendQueueIntakeEmpty( const DataToSendQueue* dataQueue )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( dataQueue );
+
+    return dataQueue->intakeStackTop.load() == NULL;
+}
+
+size_t getDataToSendQueueTotalSize( const DataToSendQueue* dataQueue )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( dataQueue );
+
+    return dataQueue->totalSize.load();
+}
+
+size_t moveDataToSendQueueIntakeToList( DataToSendQueue* dataQueue )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( dataQueue );
+
+    if ( isDataToSendQueueIntakeEmpty( dataQueue ) )
+    {
+        return 0;
+    }
+
+    // Intake stack is in LIFO order so the nodes are inserted one by one before the same node
+    // which is the current tail of the list
+    DataToSendNode* insertBefore = &( dataQueue->tail );
+    DataToSendNode* lastInListBefore = dataQueue->tail.prev;
+    DataToSendNode* node = dataQueue->intakeStackTop.exchange( NULL );
+    size_t movedCount = 0;
+    while ( node != NULL )
+    {
+        DataToSendNode* nextInStack = node->next;
+        node->next = insertBefore;
+        insertBefore->prev = node;
+        insertBefore = node;
+        node = nextInStack;
+        ++movedCount;
+    }
+    lastInListBefore->next = insertBefore;
+    insertBefore->prev = lastInListBefore;
+
+    return movedCount;
+}
+
+bool isDataToSendQueueEmpty( const DataToSendQueue* dataQueue )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( dataQueue );
+
+    return dataQueue->head.next == &( dataQueue->tail );
+}
+
+DataToSendNode* getFirstNodeInDataToSendQueue( DataToSendQueue* dataQueue )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( dataQueue );
+
+    return isDataToSendQueueEmpty( dataQueue ) ? NULL : dataQueue->head.next;
+}
+
+size_t removeFirstNodeInDataToSendQueue( DataToSendQueue* dataQueue )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( dataQueue );
+    ELASTIC_APM_ASSERT( ! isDataToSendQueueEmpty( dataQueue ), "" );
+
+    DataToSendNode* firstNode = dataQueue->head.next;
+    // -1 since terminating '\0' is counted in buffer's size but not in string's length
+    size_t firstNodeDataSize = firstNode->serializedEvents.size - 1;
+    DataToSendNode* newFirstNode = firstNode->next;
+
+    dataQueue->head.next = newFirstNode;
+    newFirstNode->prev = &( dataQueue->head );
+
+    freeDataToSendNode( &firstNode );
+    dataQueue->totalSize.fetch_sub( firstNodeDataSize );
+
+    return firstNodeDataSize;
+}
+
+void freeDataToSendQueue( DataToSendQueue* dataQueue )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( dataQueue );
+
+    moveDataToSendQueueIntakeToList( dataQueue );
+    while ( ! isDataToSendQueueEmpty( dataQueue ) )
+    {
+        removeFirstNodeInDataToSendQueue( dataQueue );
+    }
+}
@@ -0,0 +1,145 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <atomic>
+#include "basic_types.h"
+#include "StringView.h"
+#include "util.h" // StringBuffer
+#include "ResultCode.h"
+#include "TextOutputStream_forward_decl.h"
+
+struct DataToSendNode;
+typedef struct DataToSendNode DataToSendNode;
+
+/**
+ * Node and the strings it holds are allocated as a single memory block
+ * so that creating a node costs one allocation and it's all done before the node is pushed to the queue.
+ */
+struct DataToSendNode
+{
+    UInt64 id;
+
+    DataToSendNode* prev;
+    DataToSendNode* next;
+
+    StringBuffer userAgentHttpHeader;
+    StringBuffer serializedEvents;
+};
+
+/**
+ * Bounded multi-producer/single-consumer queue that doesn't require locking.
+ * Any thread can push nodes - pushed nodes are linked to the lock-free intake stack.
+ * Only the consumer thread moves nodes from the intake stack to the list (restoring FIFO order)
+ * and only the consumer thread accesses the list.
+ */
+struct DataToSendQueue
+{
+    // The list is accessed only by the consumer thread
+    DataToSendNode head;
+    DataToSendNode tail;
+
+    // Nodes pushed by producers in LIFO order linked by next
+    std::atomic< DataToSendNode* > intakeStackTop;
+    // Total size of serialized events in all the nodes including the ones still on the intake stack
+    std::atomic< size_t > totalSize;
+    std::atomic< UInt64 > nextNodeId;
+};
+typedef struct DataToSendQueue DataToSendQueue;
+
+/**
+ * Copies userAgentHttpHeader and serializedEvents into a newly allocated node.
+ * This function does not access any queue so it should be called before the node is pushed.
+ */
+ResultCode newDataToSendNode( StringView userAgentHttpHeader, StringView serializedEvents, /* out */ DataToSendNode** newNode );
+
+/**
+ * Classes of events ordered by priority - the lower the priority the sooner events of the class are shed when the queue is under memory pressure
+ */
+enum BackendCommEventClass
+{
+    backendCommEventClass_span,
+    backendCommEventClass_metricset,
+    backendCommEventClass_error,
+    backendCommEventClass_transaction,
+    // Events that are not recognized are shed only together with errors and transactions
+    backendCommEventClass_other,
+
+    numberOfBackendCommEventClasses
+};
+typedef enum BackendCommEventClass BackendCommEventClass;
+
+extern const char* backendCommEventClassNames[ numberOfBackendCommEventClasses ];
+
+String streamBackendCommEventClass( BackendCommEventClass eventClass, TextOutputStream* txtOutStream );
+
+/**
+ * Serialized events are a metadata line followed by event lines - each event line is preceded by '\n'
+ */
+struct SerializedEventsClassification
+{
+    size_t metadataLineLength;
+    size_t eventsCount[ numberOfBackendCommEventClasses ];
+    // Including the '\n' preceding each event line
+    size_t eventsSize[ numberOfBackendCommEventClasses ];
+};
+typedef struct SerializedEventsClassification SerializedEventsClassification;
+
+void classifySerializedEvents( StringView serializedEvents, /* out */ SerializedEventsClassification* classification );
+
+/**
+ * Same as newDataToSendNode but only the metadata line and the events of the classes with priority not lower than minEventClassToKeep are copied.
+ * The classification should be the one for the given serializedEvents.
+ */
+ResultCode newFilteredDataToSendNode(
+        StringView userAgentHttpHeader
+        , StringView serializedEvents
+        , const SerializedEventsClassification* classification
+        , BackendCommEventClass minEventClassToKeep
+        , /* out */ DataToSendNode** newNode );
+void freeDataToSendNode( DataToSendNode** nodeOutPtr );
+
+void initDataToSendQueue( DataToSendQueue* dataQueue );
+
+/**
+ * Can be called by any thread.
+ * If the total size of the already queued events is below maxTotalSize the queue takes ownership of the node and assigns its id,
+ * otherwise the node is not pushed and false is returned.
+ * The node should not be accessed by the caller after it was pushed since it can be removed by the consumer at any moment.
+ */
+bool tryPushNodeToDataToSendQueue( DataToSendQueue* dataQueue, size_t maxTotalSize, DataToSendNode* node, /* out */ UInt64* id, /* out */ size_t* totalSize );
+bool isDataToSendQueueIntakeEmpty( const DataToSendQueue* dataQueue );
+size_t getDataToSendQueueTotalSize( const DataToSendQueue* dataQueue );
+
+// The rest of the functions can be called only by the consumer thread
+
+/**
+ * @return number of nodes moved from the intake stack to the end of the list
+ */
+size_t moveDataToSendQueueIntakeToList( DataToSendQueue* dataQueue );
+bool isDataToSendQueueEmpty( const DataToSendQueue* dataQueue );
+DataToSendNode* getFirstNodeInDataToSendQueue( DataToSendQueue* dataQueue );
+
+/**
+ * @return size of serialized events in the removed node
+ */
+size_t removeFirstNodeInDataToSendQueue( DataToSendQueue* dataQueue );
+void freeDataToSendQueue( DataToSendQueue* dataQueue );
@@ -0,0 +1,106 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "backend_comm_server_url.h"
+#include <stdio.h>
+#include <string.h>
+#include "elastic_apm_assert.h"
+#include "log.h"
+#include "util.h"
+
+#define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_BACKEND_COMM
+
+/**
+ * Host part of the URL is not used to connect when the request is sent over Unix domain socket
+ * but it's still sent in Host HTTP request header
+ */
+#define ELASTIC_APM_UNIX_SOCKET_INTAKE_API_URL_BASE "http://localhost/"
+
+bool isUnixSocketServerUrl( String serverUrl, /* out */ String* socketPath )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( socketPath );
+
+    if ( serverUrl == NULL || ! isStringViewPrefixIgnoringCase( stringToView( serverUrl ), ELASTIC_APM_STRING_LITERAL_TO_VIEW( ELASTIC_APM_UNIX_SOCKET_SERVER_URL_PREFIX ) ) )
+    {
+        return false;
+    }
+
+    *socketPath = serverUrl + ELASTIC_APM_STATIC_ARRAY_SIZE( ELASTIC_APM_UNIX_SOCKET_SERVER_URL_PREFIX ) - 1;
+    return true;
+}
+
+ResultCode buildIntakeApiUrl( String serverUrl, /* out */ char url[ intakeApiUrlBufferSize ] )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( serverUrl );
+
+    String socketPath = NULL;
+    String urlBase = isUnixSocketServerUrl( serverUrl, /* out */ &socketPath ) ? ELASTIC_APM_UNIX_SOCKET_INTAKE_API_URL_BASE : serverUrl;
+    const char* serverUrlAndQuerySeparator = isStringViewSuffix( stringToView( urlBase ), ELASTIC_APM_STRING_LITERAL_TO_VIEW( "/" ) ) ? "" : "/";
+
+    int snprintfRetVal = snprintf( url, intakeApiUrlBufferSize, "%s%sintake/v2/events", urlBase, serverUrlAndQuerySeparator );
+    if ( snprintfRetVal < 0 || snprintfRetVal >= intakeApiUrlBufferSize )
+    {
+        ELASTIC_APM_LOG_ERROR( "Failed to build full URL to APM Server's intake API. snprintfRetVal: %d", snprintfRetVal );
+        return resultFailure;
+    }
+
+    return resultSuccess;
+}
+
+ResultCode setIntakeApiUrlCurlOptions( CURL* curlHandle, String serverUrl, /* out */ char url[ intakeApiUrlBufferSize ] )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( curlHandle );
+
+    ResultCode resultCode;
+    CURLcode curlResult;
+    String socketPath = NULL;
+
+    if ( isUnixSocketServerUrl( serverUrl, /* out */ &socketPath ) )
+    {
+        if ( isEmtpyString( socketPath ) )
+        {
+            ELASTIC_APM_LOG_ERROR( "Socket path is missing in server_url; server_url: `%s'", serverUrl );
+            ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+        }
+
+        // libcurl copies the string so it's enough for socketPath to be valid only during the call
+        curlResult = curl_easy_setopt( curlHandle, CURLOPT_UNIX_SOCKET_PATH, socketPath );
+        if ( curlResult != CURLE_OK )
+        {
+            ELASTIC_APM_LOG_ERROR( "Failed to set CURLOPT_UNIX_SOCKET_PATH; error message: `%s'; socketPath: `%s'", curl_easy_strerror( curlResult ), socketPath );
+            ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE_EX( resultCurlFailure );
+        }
+    }
+
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( buildIntakeApiUrl( serverUrl, /* out */ url ) );
+
+    curlResult = curl_easy_setopt( curlHandle, CURLOPT_URL, url );
+    if ( curlResult != CURLE_OK )
+    {
+        ELASTIC_APM_LOG_ERROR( "Failed to set CURLOPT_URL; error message: `%s'; url: `%s'", curl_easy_strerror( curlResult ), url );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE_EX( resultCurlFailure );
+    }
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
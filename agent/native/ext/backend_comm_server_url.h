@@ -0,0 +1,45 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#pragma once
+
+#include "basic_types.h"
+#include "StringView.h"
+#include "ResultCode.h"
+#include <curl/curl.h>
+
+enum { intakeApiUrlBufferSize = 256 };
+
+#define ELASTIC_APM_UNIX_SOCKET_SERVER_URL_PREFIX "unix://"
+
+/**
+ * server_url in the form unix:///path/to/socket means that APM Server (or Elastic Agent) runs on the same host
+ * and listens on the Unix domain socket instead of TCP port
+ *
+ * @param socketPath set only if it returns true - points into serverUrl so it's null terminated
+ */
+bool isUnixSocketServerUrl( String serverUrl, /* out */ String* socketPath );
+
+ResultCode buildIntakeApiUrl( String serverUrl, /* out */ char url[ intakeApiUrlBufferSize ] );
+
+/**
+ * Sets URL of APM Server's intake API for the next request.
+ * For unix:// form of server_url requests are sent over the Unix domain socket so there are no TCP and TLS handshakes.
+ */
+ResultCode setIntakeApiUrlCurlOptions( CURL* curlHandle, String serverUrl, /* out */ char url[ intakeApiUrlBufferSize ] );
@@ -0,0 +1,544 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "backend_comm_shared_ring.h"
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "elastic_apm_assert.h"
+#include "log.h"
+#include "util.h"
+#include "TextOutputStream.h"
+
+#define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_BACKEND_COMM
+
+/**
+ * Each record is a header followed by User-Agent HTTP header and serialized events.
+ * Records are aligned so that the header can be accessed directly in the shared memory.
+ */
+struct BackendCommSharedRingRecordHeader
+{
+    UInt64 userAgentHttpHeaderLength;
+    UInt64 serializedEventsLength;
+};
+typedef struct BackendCommSharedRingRecordHeader BackendCommSharedRingRecordHeader;
+
+enum { backendCommSharedRingRecordAlignment = sizeof( UInt64 ) };
+
+// Written instead of a record header when the rest of the buffer is skipped because the next record does not fit before the end of the buffer
+#define ELASTIC_APM_BACKEND_COMM_SHARED_RING_WRAP_MARKER UINT64_MAX
+
+/**
+ * The struct is at the beginning of the shared memory and the records follow it
+ */
+struct BackendCommSharedRing
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t recordAppended;
+    pid_t senderProcessId;
+    // Monotonic time (in nanoseconds) when the sender last signaled that it's still draining the buffer
+    Int64 senderHeartbeatTime;
+    size_t capacity;
+    size_t readOffset;
+    size_t writeOffset;
+    // Includes the space skipped at the end of the buffer when wrapping
+    size_t usedSize;
+    size_t recordsCount;
+};
+
+static
+char* backendCommSharedRing_data( const BackendCommSharedRing* thisObj )
+{
+    return ( (char*) thisObj ) + calcAlignedSize( sizeof( BackendCommSharedRing ), backendCommSharedRingRecordAlignment );
+}
+
+static
+size_t backendCommSharedRing_calcRecordSize( size_t userAgentHttpHeaderLength, size_t serializedEventsLength )
+{
+    return calcAlignedSize( sizeof( BackendCommSharedRingRecordHeader ) + userAgentHttpHeaderLength + serializedEventsLength, backendCommSharedRingRecordAlignment );
+}
+
+static
+size_t backendCommSharedRing_calcMappedSize( size_t capacity )
+{
+    return calcAlignedSize( sizeof( BackendCommSharedRing ), backendCommSharedRingRecordAlignment ) + capacity;
+}
+
+static
+ResultCode backendCommSharedRing_lock( BackendCommSharedRing* thisObj )
+{
+    int pthreadResultCode = pthread_mutex_lock( &( thisObj->mutex ) );
+    if ( pthreadResultCode == EOWNERDEAD )
+    {
+        // State protected by the mutex is consistent at any point because it's changed only after the data is written
+        ELASTIC_APM_LOG_WARNING( "Process holding shared ring buffer lock died - recovering the lock" );
+        pthreadResultCode = pthread_mutex_consistent( &( thisObj->mutex ) );
+    }
+    if ( pthreadResultCode != 0 )
+    {
+        char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE ];
+        TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
+        ELASTIC_APM_LOG_ERROR( "Failed to lock shared ring buffer mutex; error: `%s'", streamErrNo( pthreadResultCode, &txtOutStream ) );
+        return resultFailure;
+    }
+
+    return resultSuccess;
+}
+
+static
+void backendCommSharedRing_unlock( BackendCommSharedRing* thisObj )
+{
+    pthread_mutex_unlock( &( thisObj->mutex ) );
+}
+
+static
+ResultCode initBackendCommSharedRingSyncPrimitives( BackendCommSharedRing* thisObj )
+{
+    ResultCode resultCode;
+    int pthreadResultCode = 0;
+    pthread_mutexattr_t mutexAttr;
+    pthread_condattr_t condAttr;
+    bool isMutexAttrInited = false;
+    bool isCondAttrInited = false;
+    char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE ];
+    TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
+
+    pthreadResultCode = pthread_mutexattr_init( &mutexAttr );
+    if ( pthreadResultCode != 0 )
+    {
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+    isMutexAttrInited = true;
+    pthreadResultCode = pthread_mutexattr_setpshared( &mutexAttr, PTHREAD_PROCESS_SHARED );
+    if ( pthreadResultCode != 0 )
+    {
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+    pthreadResultCode = pthread_mutexattr_setrobust( &mutexAttr, PTHREAD_MUTEX_ROBUST );
+    if ( pthreadResultCode != 0 )
+    {
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+    pthreadResultCode = pthread_mutex_init( &( thisObj->mutex ), &mutexAttr );
+    if ( pthreadResultCode != 0 )
+    {
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    pthreadResultCode = pthread_condattr_init( &condAttr );
+    if ( pthreadResultCode != 0 )
+    {
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+    isCondAttrInited = true;
+    pthreadResultCode = pthread_condattr_setpshared( &condAttr, PTHREAD_PROCESS_SHARED );
+    if ( pthreadResultCode != 0 )
+    {
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+    pthreadResultCode = pthread_cond_init( &( thisObj->recordAppended ), &condAttr );
+    if ( pthreadResultCode != 0 )
+    {
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    resultCode = resultSuccess;
+
+    finally:
+    if ( isCondAttrInited )
+    {
+        pthread_condattr_destroy( &condAttr );
+    }
+    if ( isMutexAttrInited )
+    {
+        pthread_mutexattr_destroy( &mutexAttr );
+    }
+    return resultCode;
+
+    failure:
+    ELASTIC_APM_LOG_ERROR( "Failed to initialize shared ring buffer synchronization primitives; error: `%s'", streamErrNo( pthreadResultCode, &txtOutStream ) );
+    goto finally;
+}
+
+ResultCode newBackendCommSharedRing( size_t capacity, /* out */ BackendCommSharedRing** thisObjOut )
+{
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY_MSG( "capacity: %" PRIu64, (UInt64) capacity );
+
+    ELASTIC_APM_ASSERT_VALID_OUT_PTR_TO_PTR( thisObjOut );
+
+    ResultCode resultCode;
+    char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE ];
+    TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
+    int errnoValue = 0;
+    size_t alignedCapacity = capacity - ( capacity % backendCommSharedRingRecordAlignment );
+    void* mappedBegin = MAP_FAILED;
+    BackendCommSharedRing* thisObj = NULL;
+
+    if ( alignedCapacity < sizeof( BackendCommSharedRingRecordHeader ) )
+    {
+        ELASTIC_APM_LOG_ERROR( "Shared ring buffer capacity is too small; capacity: %" PRIu64, (UInt64) capacity );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    // Anonymous shared mapping is inherited by the processes forked after it's created
+    mappedBegin = mmap( /* addr */ NULL, backendCommSharedRing_calcMappedSize( alignedCapacity ), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, /* fd */ -1, /* offset */ 0 );
+    if ( mappedBegin == MAP_FAILED )
+    {
+        errnoValue = errno;
+        ELASTIC_APM_LOG_ERROR( "Failed to map shared memory for ring buffer; capacity: %" PRIu64 "; errno: %d (%s)", (UInt64) alignedCapacity, errnoValue, streamErrNo( errnoValue, &txtOutStream ) );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    thisObj = (BackendCommSharedRing*) mappedBegin;
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( initBackendCommSharedRingSyncPrimitives( thisObj ) );
+    thisObj->senderProcessId = 0;
+    thisObj->senderHeartbeatTime = 0;
+    thisObj->capacity = alignedCapacity;
+    thisObj->readOffset = 0;
+    thisObj->writeOffset = 0;
+    thisObj->usedSize = 0;
+    thisObj->recordsCount = 0;
+
+    *thisObjOut = thisObj;
+    resultCode = resultSuccess;
+
+    finally:
+    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT();
+    return resultCode;
+
+    failure:
+    if ( mappedBegin != MAP_FAILED )
+    {
+        munmap( mappedBegin, backendCommSharedRing_calcMappedSize( alignedCapacity ) );
+    }
+    goto finally;
+}
+
+void deleteBackendCommSharedRingAndSetToNull( /* in,out */ BackendCommSharedRing** thisObjOut )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObjOut );
+
+    BackendCommSharedRing* thisObj = *thisObjOut;
+    if ( thisObj == NULL )
+    {
+        return;
+    }
+
+    // Synchronization primitives are not destroyed since other processes might still be using them
+    munmap( thisObj, backendCommSharedRing_calcMappedSize( thisObj->capacity ) );
+    *thisObjOut = NULL;
+}
+
+/**
+ * Should be called with the lock held
+ *
+ * @return offset for the record or capacity if there is not enough space
+ */
+static
+size_t backendCommSharedRing_findSpaceForRecord( const BackendCommSharedRing* thisObj, size_t recordSize, /* out */ size_t* skippedSize )
+{
+    *skippedSize = 0;
+
+    if ( thisObj->recordsCount == 0 )
+    {
+        return recordSize <= thisObj->capacity ? 0 : thisObj->capacity;
+    }
+
+    if ( thisObj->writeOffset > thisObj->readOffset )
+    {
+        // Free space is [writeOffset, capacity) and [0, readOffset)
+        if ( recordSize <= thisObj->capacity - thisObj->writeOffset )
+        {
+            return thisObj->writeOffset;
+        }
+        if ( recordSize <= thisObj->readOffset )
+        {
+            *skippedSize = thisObj->capacity - thisObj->writeOffset;
+            return 0;
+        }
+        return thisObj->capacity;
+    }
+
+    // Free space is [writeOffset, readOffset) - it's empty if writeOffset is equal to readOffset
+    return recordSize <= thisObj->readOffset - thisObj->writeOffset ? thisObj->writeOffset : thisObj->capacity;
+}
+
+ResultCode backendCommSharedRing_append( BackendCommSharedRing* thisObj, StringView userAgentHttpHeader, StringView serializedEvents )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj );
+
+    size_t recordSize = backendCommSharedRing_calcRecordSize( userAgentHttpHeader.length, serializedEvents.length );
+    size_t skippedSize;
+    size_t recordOffset;
+    char* recordBegin;
+    BackendCommSharedRingRecordHeader* header;
+
+    if ( backendCommSharedRing_lock( thisObj ) != resultSuccess )
+    {
+        return resultFailure;
+    }
+
+    if ( thisObj->recordsCount == 0 )
+    {
+        // When there are no records left the buffer is reused from the beginning
+        thisObj->readOffset = 0;
+        thisObj->writeOffset = 0;
+        thisObj->usedSize = 0;
+    }
+
+    recordOffset = backendCommSharedRing_findSpaceForRecord( thisObj, recordSize, /* out */ &skippedSize );
+    if ( recordOffset == thisObj->capacity )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Not enough space left in shared ring buffer; record size: %" PRIu64 "; capacity: %" PRIu64 "; used size: %" PRIu64
+                               , (UInt64) recordSize, (UInt64) thisObj->capacity, (UInt64) thisObj->usedSize );
+        backendCommSharedRing_unlock( thisObj );
+        return resultFailure;
+    }
+
+    // The rest of the buffer is too small for the header - the reader skips it without the marker
+    if ( skippedSize >= sizeof( BackendCommSharedRingRecordHeader ) )
+    {
+        ( (BackendCommSharedRingRecordHeader*) ( backendCommSharedRing_data( thisObj ) + thisObj->writeOffset ) )->userAgentHttpHeaderLength = ELASTIC_APM_BACKEND_COMM_SHARED_RING_WRAP_MARKER;
+    }
+
+    recordBegin = backendCommSharedRing_data( thisObj ) + recordOffset;
+    header = (BackendCommSharedRingRecordHeader*) recordBegin;
+    header->userAgentHttpHeaderLength = userAgentHttpHeader.length;
+    header->serializedEventsLength = serializedEvents.length;
+    memcpy( recordBegin + sizeof( BackendCommSharedRingRecordHeader ), userAgentHttpHeader.begin, userAgentHttpHeader.length );
+    memcpy( recordBegin + sizeof( BackendCommSharedRingRecordHeader ) + userAgentHttpHeader.length, serializedEvents.begin, serializedEvents.length );
+
+    // The record becomes visible to the sender only now when all of its data is written
+    thisObj->writeOffset = recordOffset + recordSize;
+    thisObj->usedSize += skippedSize + recordSize;
+    ++thisObj->recordsCount;
+
+    pthread_cond_signal( &( thisObj->recordAppended ) );
+    backendCommSharedRing_unlock( thisObj );
+    return resultSuccess;
+}
+
+/**
+ * Should be called with the lock held
+ */
+static
+size_t backendCommSharedRing_findFirstRecordOffset( const BackendCommSharedRing* thisObj )
+{
+    if ( thisObj->capacity - thisObj->readOffset < sizeof( BackendCommSharedRingRecordHeader ) )
+    {
+        return 0;
+    }
+
+    const BackendCommSharedRingRecordHeader* header = (const BackendCommSharedRingRecordHeader*) ( backendCommSharedRing_data( thisObj ) + thisObj->readOffset );
+    return header->userAgentHttpHeaderLength == ELASTIC_APM_BACKEND_COMM_SHARED_RING_WRAP_MARKER ? 0 : thisObj->readOffset;
+}
+
+ResultCode backendCommSharedRing_waitForFirst( BackendCommSharedRing* thisObj
+                                               , const TimeSpec* timeoutAbsUtc
+                                               , /* out */ bool* hasFirst
+                                               , /* out */ StringView* userAgentHttpHeader
+                                               , /* out */ StringView* serializedEvents )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj );
+    ELASTIC_APM_ASSERT_VALID_PTR( hasFirst );
+    ELASTIC_APM_ASSERT_VALID_PTR( userAgentHttpHeader );
+    ELASTIC_APM_ASSERT_VALID_PTR( serializedEvents );
+
+    int pthreadResultCode = 0;
+    const char* recordBegin;
+    const BackendCommSharedRingRecordHeader* header;
+
+    if ( backendCommSharedRing_lock( thisObj ) != resultSuccess )
+    {
+        return resultFailure;
+    }
+
+    if ( thisObj->recordsCount == 0 )
+    {
+        pthreadResultCode = ( timeoutAbsUtc == NULL )
+                            ? pthread_cond_wait( &( thisObj->recordAppended ), &( thisObj->mutex ) )
+                            : pthread_cond_timedwait( &( thisObj->recordAppended ), &( thisObj->mutex ), timeoutAbsUtc );
+        if ( pthreadResultCode == EOWNERDEAD )
+        {
+            pthread_mutex_consistent( &( thisObj->mutex ) );
+        }
+    }
+
+    *hasFirst = ( thisObj->recordsCount != 0 );
+    if ( *hasFirst )
+    {
+        recordBegin = backendCommSharedRing_data( thisObj ) + backendCommSharedRing_findFirstRecordOffset( thisObj );
+        header = (const BackendCommSharedRingRecordHeader*) recordBegin;
+        *userAgentHttpHeader = makeStringView( recordBegin + sizeof( BackendCommSharedRingRecordHeader ), (size_t) header->userAgentHttpHeaderLength );
+        *serializedEvents = makeStringView( recordBegin + sizeof( BackendCommSharedRingRecordHeader ) + header->userAgentHttpHeaderLength, (size_t) header->serializedEventsLength );
+    }
+
+    backendCommSharedRing_unlock( thisObj );
+    return resultSuccess;
+}
+
+ResultCode backendCommSharedRing_removeFirst( BackendCommSharedRing* thisObj )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj );
+
+    size_t recordOffset;
+    const BackendCommSharedRingRecordHeader* header;
+    size_t recordSize;
+
+    if ( backendCommSharedRing_lock( thisObj ) != resultSuccess )
+    {
+        return resultFailure;
+    }
+
+    ELASTIC_APM_ASSERT( thisObj->recordsCount != 0, "" );
+
+    recordOffset = backendCommSharedRing_findFirstRecordOffset( thisObj );
+    header = (const BackendCommSharedRingRecordHeader*) ( backendCommSharedRing_data( thisObj ) + recordOffset );
+    recordSize = backendCommSharedRing_calcRecordSize( (size_t) header->userAgentHttpHeaderLength, (size_t) header->serializedEventsLength );
+    if ( recordOffset != thisObj->readOffset )
+    {
+        thisObj->usedSize -= thisObj->capacity - thisObj->readOffset;
+    }
+    thisObj->readOffset = recordOffset + recordSize;
+    thisObj->usedSize -= recordSize;
+    --thisObj->recordsCount;
+
+    backendCommSharedRing_unlock( thisObj );
+    return resultSuccess;
+}
+
+ResultCode backendCommSharedRing_wakeUpSender( BackendCommSharedRing* thisObj )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj );
+
+    if ( backendCommSharedRing_lock( thisObj ) != resultSuccess )
+    {
+        return resultFailure;
+    }
+    pthread_cond_broadcast( &( thisObj->recordAppended ) );
+    backendCommSharedRing_unlock( thisObj );
+    return resultSuccess;
+}
+
+static
+bool isProcessAlive( pid_t processId )
+{
+    // Signal 0 only checks if the process exists - EPERM means the process exists but belongs to another user
+    return kill( processId, 0 ) == 0 || errno == EPERM;
+}
+
+/**
+ * Should be called with the lock held.
+ * PID of a dead sender can be reused by another process so a sender that is seemingly alive
+ * is considered gone if it has not signaled heartbeat within the timeout.
+ */
+static
+bool backendCommSharedRing_isSenderGone( const BackendCommSharedRing* thisObj, Int64 currentTime, Int64 senderHeartbeatTimeout )
+{
+    return ( ! isProcessAlive( thisObj->senderProcessId ) ) || ( currentTime - thisObj->senderHeartbeatTime > senderHeartbeatTimeout );
+}
+
+ResultCode backendCommSharedRing_tryBecomeSender( BackendCommSharedRing* thisObj, pid_t currentProcessId, Int64 currentTime, Int64 senderHeartbeatTimeout, /* out */ bool* isSender )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj );
+    ELASTIC_APM_ASSERT_VALID_PTR( isSender );
+
+    pid_t previousSenderProcessId;
+
+    if ( backendCommSharedRing_lock( thisObj ) != resultSuccess )
+    {
+        return resultFailure;
+    }
+
+    previousSenderProcessId = thisObj->senderProcessId;
+    if ( previousSenderProcessId == 0
+         || ( previousSenderProcessId != currentProcessId && backendCommSharedRing_isSenderGone( thisObj, currentTime, senderHeartbeatTimeout ) ) )
+    {
+        thisObj->senderProcessId = currentProcessId;
+        thisObj->senderHeartbeatTime = currentTime;
+    }
+    *isSender = ( thisObj->senderProcessId == currentProcessId );
+
+    backendCommSharedRing_unlock( thisObj );
+
+    if ( *isSender && previousSenderProcessId != currentProcessId )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Current process became the sender for shared ring buffer; previous sender PID: %d", (int) previousSenderProcessId );
+    }
+    return resultSuccess;
+}
+
+ResultCode backendCommSharedRing_onSenderHeartbeat( BackendCommSharedRing* thisObj, pid_t currentProcessId, Int64 currentTime, /* out */ bool* isSender )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj );
+    ELASTIC_APM_ASSERT_VALID_PTR( isSender );
+
+    if ( backendCommSharedRing_lock( thisObj ) != resultSuccess )
+    {
+        return resultFailure;
+    }
+
+    *isSender = ( thisObj->senderProcessId == currentProcessId );
+    if ( *isSender )
+    {
+        thisObj->senderHeartbeatTime = currentTime;
+    }
+
+    backendCommSharedRing_unlock( thisObj );
+    return resultSuccess;
+}
+
+ResultCode backendCommSharedRing_resignSender( BackendCommSharedRing* thisObj, pid_t currentProcessId )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj );
+
+    if ( backendCommSharedRing_lock( thisObj ) != resultSuccess )
+    {
+        return resultFailure;
+    }
+
+    if ( thisObj->senderProcessId == currentProcessId )
+    {
+        thisObj->senderProcessId = 0;
+    }
+
+    backendCommSharedRing_unlock( thisObj );
+    return resultSuccess;
+}
+
+ResultCode backendCommSharedRing_getStats( BackendCommSharedRing* thisObj, /* out */ BackendCommSharedRingStats* stats )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj );
+    ELASTIC_APM_ASSERT_VALID_PTR( stats );
+
+    if ( backendCommSharedRing_lock( thisObj ) != resultSuccess )
+    {
+        return resultFailure;
+    }
+
+    stats->capacity = thisObj->capacity;
+    stats->usedSize = thisObj->usedSize;
+    stats->batchesCount = thisObj->recordsCount;
+    stats->senderProcessId = thisObj->senderProcessId;
+
+    backendCommSharedRing_unlock( thisObj );
+    return resultSuccess;
+}
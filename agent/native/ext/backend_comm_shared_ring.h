@@ -0,0 +1,99 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include "basic_types.h"
+#include "StringView.h"
+#include "ResultCode.h"
+#include "platform.h"
+#include "time_util.h"
+
+/**
+ * Bounded ring buffer of batches of events in anonymous shared memory.
+ * It's created before worker processes are forked so all the workers in the pool share it:
+ * any worker appends batches and only the worker elected as the sender removes them and sends them to APM Server.
+ *
+ * Batches are stored contiguously (a batch that does not fit before the end of the buffer is stored at the beginning)
+ * so the sender can read a batch in place. The data of a batch is not modified until the batch is removed
+ * so the sender reads it without holding the lock.
+ *
+ * The lock is a robust process-shared mutex so a worker that dies while holding it does not block the rest of the pool.
+ * A batch is made visible only after all of its data is written so a worker dying in the middle of appending leaves the buffer consistent.
+ */
+struct BackendCommSharedRing;
+typedef struct BackendCommSharedRing BackendCommSharedRing;
+
+ResultCode newBackendCommSharedRing( size_t capacity, /* out */ BackendCommSharedRing** thisObjOut );
+
+/**
+ * Should be called by each process to release its mapping of the shared memory
+ */
+void deleteBackendCommSharedRingAndSetToNull( /* in,out */ BackendCommSharedRing** thisObjOut );
+
+/**
+ * Fails without changing the buffer if there is not enough space left for the batch
+ */
+ResultCode backendCommSharedRing_append( BackendCommSharedRing* thisObj, StringView userAgentHttpHeader, StringView serializedEvents );
+
+/**
+ * Waits until there is at least one batch in the buffer or timeoutAbsUtc is reached.
+ * Returned views point to the shared memory and are valid only until the batch is removed.
+ * Should be called only by the sender.
+ *
+ * @param timeoutAbsUtc NULL means no timeout (only for tests) - the wait also ends when backendCommSharedRing_wakeUpSender is called
+ */
+ResultCode backendCommSharedRing_waitForFirst( BackendCommSharedRing* thisObj
+                                               , const TimeSpec* timeoutAbsUtc
+                                               , /* out */ bool* hasFirst
+                                               , /* out */ StringView* userAgentHttpHeader
+                                               , /* out */ StringView* serializedEvents );
+ResultCode backendCommSharedRing_removeFirst( BackendCommSharedRing* thisObj );
+ResultCode backendCommSharedRing_wakeUpSender( BackendCommSharedRing* thisObj );
+
+/**
+ * The current process becomes the sender if there is no sender or the process that was the sender is gone -
+ * either it's not alive anymore or it has not signaled heartbeat for longer than senderHeartbeatTimeout
+ * (its PID might have been reused by an unrelated process).
+ *
+ * @param currentTime monotonic time in nanoseconds
+ * @param senderHeartbeatTimeout in nanoseconds
+ */
+ResultCode backendCommSharedRing_tryBecomeSender( BackendCommSharedRing* thisObj, pid_t currentProcessId, Int64 currentTime, Int64 senderHeartbeatTimeout, /* out */ bool* isSender );
+
+/**
+ * Should be called by the sender more often than senderHeartbeatTimeout passed to backendCommSharedRing_tryBecomeSender.
+ *
+ * @param currentTime monotonic time in nanoseconds
+ * @param isSender set to false if another process has taken over because the heartbeat was not signaled in time
+ */
+ResultCode backendCommSharedRing_onSenderHeartbeat( BackendCommSharedRing* thisObj, pid_t currentProcessId, Int64 currentTime, /* out */ bool* isSender );
+ResultCode backendCommSharedRing_resignSender( BackendCommSharedRing* thisObj, pid_t currentProcessId );
+
+struct BackendCommSharedRingStats
+{
+    size_t capacity;
+    size_t usedSize;
+    size_t batchesCount;
+    pid_t senderProcessId;
+};
+typedef struct BackendCommSharedRingStats BackendCommSharedRingStats;
+
+ResultCode backendCommSharedRing_getStats( BackendCommSharedRing* thisObj, /* out */ BackendCommSharedRingStats* stats );
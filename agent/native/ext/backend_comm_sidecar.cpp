@@ -0,0 +1,207 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "backend_comm_sidecar.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include "SidecarProtocol.h"
+#include "elastic_apm_assert.h"
+#include "log.h"
+#include "util.h"
+#include "TextOutputStream.h"
+
+#define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_BACKEND_COMM
+
+/**
+ * The sidecar is on the same host so it should read quickly - if it does not, it's better to fall back
+ * than to block the PHP process
+ */
+enum { sidecarSendTimeoutInSeconds = 1 };
+
+static int g_sidecarConnectionFd = -1;
+
+static
+ResultCode connectToSidecar( String socketPath )
+{
+    ResultCode resultCode;
+    char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE ];
+    TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
+    struct sockaddr_un address;
+    struct timeval sendTimeout;
+    int fd = -1;
+    size_t socketPathLength = strlen( socketPath );
+
+    if ( socketPathLength == 0 || socketPathLength >= sizeof( address.sun_path ) )
+    {
+        ELASTIC_APM_LOG_ERROR( "Invalid sidecar socket path; length: %" PRIu64 "; socketPath: `%s'", (UInt64) socketPathLength, socketPath );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    memset( &address, 0, sizeof( address ) );
+    address.sun_family = AF_UNIX;
+    memcpy( address.sun_path, socketPath, socketPathLength + 1 );
+
+    fd = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+    if ( fd < 0 )
+    {
+        int errnoValue = errno;
+        ELASTIC_APM_LOG_ERROR( "socket failed; errno: %d (%s)", errnoValue, streamErrNo( errnoValue, &txtOutStream ) );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    sendTimeout.tv_sec = sidecarSendTimeoutInSeconds;
+    sendTimeout.tv_usec = 0;
+    if ( setsockopt( fd, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof( sendTimeout ) ) != 0 )
+    {
+        int errnoValue = errno;
+        ELASTIC_APM_LOG_ERROR( "setsockopt(SO_SNDTIMEO) failed; errno: %d (%s)", errnoValue, streamErrNo( errnoValue, &txtOutStream ) );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    if ( connect( fd, (const struct sockaddr*) &address, sizeof( address ) ) != 0 )
+    {
+        // Expected when the sidecar is not running - the caller falls back so it's not an error
+        int errnoValue = errno;
+        ELASTIC_APM_LOG_DEBUG( "Failed to connect to sidecar; socketPath: `%s'; errno: %d (%s)", socketPath, errnoValue, streamErrNo( errnoValue, &txtOutStream ) );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    ELASTIC_APM_LOG_DEBUG( "Connected to sidecar; socketPath: `%s'", socketPath );
+    g_sidecarConnectionFd = fd;
+    resultCode = resultSuccess;
+
+    finally:
+    return resultCode;
+
+    failure:
+    if ( fd >= 0 )
+    {
+        close( fd );
+    }
+    goto finally;
+}
+
+static
+ResultCode writeAllToSidecar( struct iovec* ioVectors, size_t ioVectorsCount )
+{
+    char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE ];
+    TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
+    struct msghdr message;
+    memset( &message, 0, sizeof( message ) );
+    message.msg_iov = ioVectors;
+    message.msg_iovlen = ioVectorsCount;
+
+    while ( message.msg_iovlen != 0 )
+    {
+        // MSG_NOSIGNAL - if the sidecar exits the write should fail instead of killing the PHP process with SIGPIPE
+        ssize_t sentSize = sendmsg( g_sidecarConnectionFd, &message, MSG_NOSIGNAL );
+        if ( sentSize < 0 )
+        {
+            int errnoValue = errno;
+            if ( errnoValue == EINTR )
+            {
+                continue;
+            }
+            ELASTIC_APM_LOG_ERROR( "Failed to write to sidecar; errno: %d (%s)", errnoValue, streamErrNo( errnoValue, &txtOutStream ) );
+            return resultFailure;
+        }
+
+        // Skip what was written - the write might have been partial
+        size_t leftToSkip = (size_t) sentSize;
+        while ( message.msg_iovlen != 0 && leftToSkip >= message.msg_iov->iov_len )
+        {
+            leftToSkip -= message.msg_iov->iov_len;
+            ++message.msg_iov;
+            --message.msg_iovlen;
+        }
+        if ( message.msg_iovlen != 0 )
+        {
+            message.msg_iov->iov_base = ( (char*) message.msg_iov->iov_base ) + leftToSkip;
+            message.msg_iov->iov_len -= leftToSkip;
+        }
+    }
+
+    return resultSuccess;
+}
+
+ResultCode sendEventsToSidecar( String socketPath, StringView userAgentHttpHeader, StringView serializedEvents )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( socketPath );
+
+    ResultCode resultCode;
+    elasticapm::sidecar::FrameHeader header;
+    struct iovec ioVectors[ 3 ];
+
+    // Batches the sidecar would reject are sent from this process
+    if ( userAgentHttpHeader.length > elasticapm::sidecar::maxUserAgentLength || serializedEvents.length > elasticapm::sidecar::maxSerializedEventsLength )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Batch is too large for sidecar; userAgentHttpHeader.length: %" PRIu64 "; serializedEvents.length: %" PRIu64
+                               , (UInt64) userAgentHttpHeader.length, (UInt64) serializedEvents.length );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    if ( g_sidecarConnectionFd < 0 )
+    {
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( connectToSidecar( socketPath ) );
+    }
+
+    header.magic = elasticapm::sidecar::frameMagic;
+    header.version = elasticapm::sidecar::protocolVersion;
+    header.userAgentLength = (UInt32) userAgentHttpHeader.length;
+    header.serializedEventsLength = (UInt32) serializedEvents.length;
+    ioVectors[ 0 ] = (struct iovec){ .iov_base = &header, .iov_len = sizeof( header ) };
+    ioVectors[ 1 ] = (struct iovec){ .iov_base = (void*) userAgentHttpHeader.begin, .iov_len = userAgentHttpHeader.length };
+    ioVectors[ 2 ] = (struct iovec){ .iov_base = (void*) serializedEvents.begin, .iov_len = serializedEvents.length };
+
+    if ( writeAllToSidecar( ioVectors, ELASTIC_APM_STATIC_ARRAY_SIZE( ioVectors ) ) != resultSuccess )
+    {
+        // The sidecar drops a partially written frame when the connection is closed
+        closeSidecarConnection();
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    ELASTIC_APM_LOG_DEBUG( "Passed events to sidecar; serializedEvents.length: %" PRIu64, (UInt64) serializedEvents.length );
+    resultCode = resultSuccess;
+
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+void closeSidecarConnection()
+{
+    if ( g_sidecarConnectionFd >= 0 )
+    {
+        close( g_sidecarConnectionFd );
+        g_sidecarConnectionFd = -1;
+    }
+}
+
+void resetSidecarConnectionInForkedChild()
+{
+    // Closing the child's copy of the descriptor does not affect the parent's connection
+    closeSidecarConnection();
+}
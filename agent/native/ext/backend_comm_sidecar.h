@@ -0,0 +1,41 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#pragma once
+
+#include "basic_types.h"
+#include "StringView.h"
+#include "ResultCode.h"
+
+/**
+ * Passes batches of events to the local sidecar process (elastic_apm_sidecar) over a Unix domain socket.
+ * The sidecar batches, compresses and sends events to APM Server so the PHP process only writes to the socket.
+ *
+ * Each process keeps one connection - it's opened on the first send and re-opened after a failure.
+ * It fails if the socket does not exist or the sidecar does not read fast enough
+ * so the caller can fall back to sending events from this process.
+ */
+ResultCode sendEventsToSidecar( String socketPath, StringView userAgentHttpHeader, StringView serializedEvents );
+
+void closeSidecarConnection();
+
+/**
+ * Forked child should not write to the connection inherited from the parent process
+ */
+void resetSidecarConnectionInForkedChild();
@@ -0,0 +1,262 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "backend_comm_spill.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "elastic_apm_assert.h"
+#include "log.h"
+#include "platform.h"
+#include "util.h"
+#include "TextOutputStream.h"
+
+#define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_BACKEND_COMM
+
+/**
+ * Each record is a header followed by User-Agent HTTP header and serialized events.
+ * Records are aligned so that the header can be accessed directly in the mapped memory.
+ */
+struct BackendCommSpillRecordHeader
+{
+    UInt64 userAgentHttpHeaderLength;
+    UInt64 serializedEventsLength;
+};
+typedef struct BackendCommSpillRecordHeader BackendCommSpillRecordHeader;
+
+enum { backendCommSpillRecordAlignment = sizeof( UInt64 ) };
+
+static
+size_t backendCommSpillFile_calcRecordSize( size_t userAgentHttpHeaderLength, size_t serializedEventsLength )
+{
+    return calcAlignedSize( sizeof( BackendCommSpillRecordHeader ) + userAgentHttpHeaderLength + serializedEventsLength, backendCommSpillRecordAlignment );
+}
+
+/**
+ * Releases pages in [beginOffset, endOffset) from the process - the data stays in the file
+ */
+static
+void backendCommSpillFile_releasePages( BackendCommSpillFile* thisObj, size_t beginOffset, size_t endOffset )
+{
+    size_t pageSize = (size_t) sysconf( _SC_PAGESIZE );
+    // Only the pages that are completely inside the range are released
+    size_t alignedBeginOffset = calcAlignedSize( beginOffset, pageSize );
+    size_t alignedEndOffset = endOffset - ( endOffset % pageSize );
+    if ( alignedBeginOffset >= alignedEndOffset )
+    {
+        return;
+    }
+
+    if ( madvise( thisObj->mappedBegin + alignedBeginOffset, alignedEndOffset - alignedBeginOffset, MADV_DONTNEED ) != 0 )
+    {
+        int errnoValue = errno;
+        char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE ];
+        TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
+        ELASTIC_APM_LOG_DEBUG( "madvise failed; errno: %d (%s)", errnoValue, streamErrNo( errnoValue, &txtOutStream ) );
+    }
+}
+
+ResultCode backendCommSpillFile_open( BackendCommSpillFile* thisObj, String dirPath, size_t capacity )
+{
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY_MSG( "dirPath: %s; capacity: %" PRIu64, dirPath, (UInt64) capacity );
+
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj );
+    ELASTIC_APM_ASSERT_VALID_STRING( dirPath );
+    ELASTIC_APM_ASSERT( ! backendCommSpillFile_isOpen( thisObj ), "" );
+
+    ResultCode resultCode;
+    char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE ];
+    TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
+    char filePath[ PATH_MAX ];
+    int errnoValue = 0;
+    int fd = -1;
+    void* mappedBegin = MAP_FAILED;
+    int snprintfRetVal = snprintf( filePath, sizeof( filePath ), "%s/elastic_apm_spill_%d_XXXXXX", dirPath, (int) getCurrentProcessId() );
+
+    if ( snprintfRetVal < 0 || snprintfRetVal >= (int) sizeof( filePath ) )
+    {
+        ELASTIC_APM_LOG_ERROR( "Failed to build spill file path; dirPath: %s; snprintfRetVal: %d", dirPath, snprintfRetVal );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    if ( capacity < sizeof( BackendCommSpillRecordHeader ) )
+    {
+        ELASTIC_APM_LOG_ERROR( "Spill file capacity is too small; capacity: %" PRIu64, (UInt64) capacity );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    fd = mkostemp( filePath, O_CLOEXEC );
+    if ( fd < 0 )
+    {
+        errnoValue = errno;
+        ELASTIC_APM_LOG_ERROR( "Failed to create spill file; filePath: %s; errno: %d (%s)", filePath, errnoValue, streamErrNo( errnoValue, &txtOutStream ) );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    // The file is used only through the descriptor so it's unlinked right away to make sure it's removed even if the process crashes
+    if ( unlink( filePath ) != 0 )
+    {
+        errnoValue = errno;
+        ELASTIC_APM_LOG_ERROR( "Failed to unlink spill file; filePath: %s; errno: %d (%s)", filePath, errnoValue, streamErrNo( errnoValue, &txtOutStream ) );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    if ( ftruncate( fd, (off_t) capacity ) != 0 )
+    {
+        errnoValue = errno;
+        ELASTIC_APM_LOG_ERROR( "Failed to resize spill file; capacity: %" PRIu64 "; errno: %d (%s)", (UInt64) capacity, errnoValue, streamErrNo( errnoValue, &txtOutStream ) );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    mappedBegin = mmap( /* addr */ NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, /* offset */ 0 );
+    if ( mappedBegin == MAP_FAILED )
+    {
+        errnoValue = errno;
+        ELASTIC_APM_LOG_ERROR( "Failed to map spill file to memory; capacity: %" PRIu64 "; errno: %d (%s)", (UInt64) capacity, errnoValue, streamErrNo( errnoValue, &txtOutStream ) );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    thisObj->fd = fd;
+    thisObj->mappedBegin = (char*) mappedBegin;
+    thisObj->capacity = capacity;
+    thisObj->readOffset = 0;
+    thisObj->writeOffset = 0;
+    thisObj->recordsCount = 0;
+    resultCode = resultSuccess;
+
+    finally:
+    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT();
+    return resultCode;
+
+    failure:
+    if ( fd >= 0 )
+    {
+        close( fd );
+    }
+    goto finally;
+}
+
+bool backendCommSpillFile_isOpen( const BackendCommSpillFile* thisObj )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj );
+
+    return thisObj->mappedBegin != NULL;
+}
+
+bool backendCommSpillFile_isEmpty( const BackendCommSpillFile* thisObj )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj );
+
+    return thisObj->recordsCount == 0;
+}
+
+ResultCode backendCommSpillFile_append( BackendCommSpillFile* thisObj, StringView userAgentHttpHeader, StringView serializedEvents )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj );
+    ELASTIC_APM_ASSERT( backendCommSpillFile_isOpen( thisObj ), "" );
+
+    size_t recordSize = backendCommSpillFile_calcRecordSize( userAgentHttpHeader.length, serializedEvents.length );
+    if ( recordSize > thisObj->capacity - thisObj->writeOffset )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Not enough space left in spill file; record size: %" PRIu64 "; capacity: %" PRIu64 "; write offset: %" PRIu64
+                               , (UInt64) recordSize, (UInt64) thisObj->capacity, (UInt64) thisObj->writeOffset );
+        return resultFailure;
+    }
+
+    char* recordBegin = thisObj->mappedBegin + thisObj->writeOffset;
+    BackendCommSpillRecordHeader* header = (BackendCommSpillRecordHeader*) recordBegin;
+    header->userAgentHttpHeaderLength = userAgentHttpHeader.length;
+    header->serializedEventsLength = serializedEvents.length;
+    char* data = recordBegin + sizeof( BackendCommSpillRecordHeader );
+    memcpy( data, userAgentHttpHeader.begin, userAgentHttpHeader.length );
+    memcpy( data + userAgentHttpHeader.length, serializedEvents.begin, serializedEvents.length );
+
+    size_t recordBeginOffset = thisObj->writeOffset;
+    thisObj->writeOffset += recordSize;
+    ++thisObj->recordsCount;
+
+    // Data written to the pages is kept by the file, so they don't have to stay in the process' memory until the record is replayed
+    backendCommSpillFile_releasePages( thisObj, recordBeginOffset, thisObj->writeOffset );
+
+    return resultSuccess;
+}
+
+void backendCommSpillFile_peekFirst( const BackendCommSpillFile* thisObj, /* out */ StringView* userAgentHttpHeader, /* out */ StringView* serializedEvents )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj );
+    ELASTIC_APM_ASSERT( ! backendCommSpillFile_isEmpty( thisObj ), "" );
+    ELASTIC_APM_ASSERT_VALID_PTR( userAgentHttpHeader );
+    ELASTIC_APM_ASSERT_VALID_PTR( serializedEvents );
+
+    const char* recordBegin = thisObj->mappedBegin + thisObj->readOffset;
+    const BackendCommSpillRecordHeader* header = (const BackendCommSpillRecordHeader*) recordBegin;
+    const char* data = recordBegin + sizeof( BackendCommSpillRecordHeader );
+    *userAgentHttpHeader = makeStringView( data, (size_t) header->userAgentHttpHeaderLength );
+    *serializedEvents = makeStringView( data + header->userAgentHttpHeaderLength, (size_t) header->serializedEventsLength );
+}
+
+void backendCommSpillFile_removeFirst( BackendCommSpillFile* thisObj )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj );
+    ELASTIC_APM_ASSERT( ! backendCommSpillFile_isEmpty( thisObj ), "" );
+
+    const BackendCommSpillRecordHeader* header = (const BackendCommSpillRecordHeader*) ( thisObj->mappedBegin + thisObj->readOffset );
+    size_t recordSize = backendCommSpillFile_calcRecordSize( (size_t) header->userAgentHttpHeaderLength, (size_t) header->serializedEventsLength );
+    size_t recordBeginOffset = thisObj->readOffset;
+    thisObj->readOffset += recordSize;
+    --thisObj->recordsCount;
+
+    if ( thisObj->recordsCount == 0 )
+    {
+        // When there are no records left the file is reused from the beginning
+        backendCommSpillFile_releasePages( thisObj, /* beginOffset */ 0, thisObj->writeOffset );
+        thisObj->readOffset = 0;
+        thisObj->writeOffset = 0;
+    }
+    else
+    {
+        backendCommSpillFile_releasePages( thisObj, recordBeginOffset, thisObj->readOffset );
+    }
+}
+
+void backendCommSpillFile_close( BackendCommSpillFile* thisObj )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj );
+
+    if ( thisObj->mappedBegin != NULL )
+    {
+        if ( thisObj->recordsCount != 0 )
+        {
+            ELASTIC_APM_LOG_DEBUG( "Closing spill file that still has batches of events - they will be dropped; number of batches: %" PRIu64, (UInt64) thisObj->recordsCount );
+        }
+        munmap( thisObj->mappedBegin, thisObj->capacity );
+    }
+
+    if ( thisObj->fd >= 0 )
+    {
+        close( thisObj->fd );
+    }
+
+    *thisObj = ELASTIC_APM_DEFAULT_BACKEND_COMM_SPILL_FILE;
+}
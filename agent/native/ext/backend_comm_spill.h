@@ -0,0 +1,75 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include "basic_types.h"
+#include "StringView.h"
+#include "ResultCode.h"
+
+/**
+ * Bounded append-only file mapped to memory that holds batches of events
+ * which could not be sent to APM Server (for example while backing off after a failure).
+ * Batches are appended at the end and removed from the beginning so they are replayed in the order they were spilled.
+ * When all the batches are removed the file is reused from the beginning.
+ * Pages that are not accessed anymore are released from the process so spilled events don't increase the process' resident memory.
+ *
+ * The file is unlinked right after it's created so it's not visible to other processes and it's removed when the process exits.
+ * It's not thread safe - it's used only by the thread sending events to APM Server.
+ */
+struct BackendCommSpillFile
+{
+    int fd;
+    char* mappedBegin;
+    size_t capacity;
+    size_t readOffset;
+    size_t writeOffset;
+    size_t recordsCount;
+};
+typedef struct BackendCommSpillFile BackendCommSpillFile;
+
+#define ELASTIC_APM_DEFAULT_BACKEND_COMM_SPILL_FILE \
+    ((BackendCommSpillFile) \
+    { \
+        .fd = -1, \
+        .mappedBegin = NULL, \
+        .capacity = 0, \
+        .readOffset = 0, \
+        .writeOffset = 0, \
+        .recordsCount = 0 \
+    }) \
+    /**/
+
+ResultCode backendCommSpillFile_open( BackendCommSpillFile* thisObj, String dirPath, size_t capacity );
+bool backendCommSpillFile_isOpen( const BackendCommSpillFile* thisObj );
+bool backendCommSpillFile_isEmpty( const BackendCommSpillFile* thisObj );
+
+/**
+ * Fails without changing the file if there is not enough space left for the batch
+ */
+ResultCode backendCommSpillFile_append( BackendCommSpillFile* thisObj, StringView userAgentHttpHeader, StringView serializedEvents );
+
+/**
+ * Returned views point to the mapped memory and are valid only until the batch is removed
+ */
+void backendCommSpillFile_peekFirst( const BackendCommSpillFile* thisObj, /* out */ StringView* userAgentHttpHeader, /* out */ StringView* serializedEvents );
+void backendCommSpillFile_removeFirst( BackendCommSpillFile* thisObj );
+
+void backendCommSpillFile_close( BackendCommSpillFile* thisObj );
@@ -0,0 +1,149 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "backend_comm_stats.h"
+#include <atomic>
+#include "basic_macros.h"
+#include "util.h"
+
+const char* backendCommHttpStatusClassNames[ numberOfBackendCommHttpStatusClasses ] =
+{
+    "no_response", "1xx", "2xx", "3xx", "4xx", "5xx"
+};
+
+const UInt64 backendCommLatencyHistogramUpperBoundsInMilliseconds[ numberOfBackendCommLatencyHistogramBuckets - 1 ] =
+{
+    1, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000
+};
+
+const char* backendCommLatencyHistogramBucketNames[ numberOfBackendCommLatencyHistogramBuckets ] =
+{
+    "1", "5", "10", "25", "50", "100", "250", "500", "1000", "2500", "5000", "+Inf"
+};
+
+struct BackendCommStatsCounters
+{
+    std::atomic< UInt64 > requestsCount;
+    std::atomic< UInt64 > failedRequestsCount;
+    std::atomic< UInt64 > sentBytesCount;
+    std::atomic< UInt64 > httpStatusClassCounts[ numberOfBackendCommHttpStatusClasses ];
+    std::atomic< UInt64 > latencyHistogram[ numberOfBackendCommLatencyHistogramBuckets ];
+    std::atomic< UInt64 > latencySumInMilliseconds;
+    std::atomic< UInt64 > sentBatchesCount;
+    std::atomic< UInt64 > droppedBatchesCount;
+};
+typedef struct BackendCommStatsCounters BackendCommStatsCounters;
+
+static BackendCommStatsCounters g_backendCommStatsCounters;
+
+static inline
+void incrementCounter( std::atomic< UInt64 >* counter, UInt64 delta )
+{
+    counter->fetch_add( delta, std::memory_order_relaxed );
+}
+
+static inline
+UInt64 loadCounter( const std::atomic< UInt64 >* counter )
+{
+    return counter->load( std::memory_order_relaxed );
+}
+
+size_t backendCommStats_getHttpStatusClass( long httpStatusCode )
+{
+    long statusClass = httpStatusCode / 100;
+    return ( 1 <= statusClass && statusClass < numberOfBackendCommHttpStatusClasses ) ? (size_t) statusClass : 0;
+}
+
+size_t backendCommStats_getLatencyHistogramBucket( UInt64 latencyInMilliseconds )
+{
+    ELASTIC_APM_FOR_EACH_INDEX( i, numberOfBackendCommLatencyHistogramBuckets - 1 )
+    {
+        if ( latencyInMilliseconds <= backendCommLatencyHistogramUpperBoundsInMilliseconds[ i ] )
+        {
+            return i;
+        }
+    }
+    return numberOfBackendCommLatencyHistogramBuckets - 1;
+}
+
+void backendCommStats_onRequest( UInt64 sentBytesCount, long httpStatusCode, bool isFailed, UInt64 latencyInMilliseconds )
+{
+    BackendCommStatsCounters* counters = &g_backendCommStatsCounters;
+
+    incrementCounter( &counters->requestsCount, 1 );
+    if ( isFailed )
+    {
+        incrementCounter( &counters->failedRequestsCount, 1 );
+    }
+    incrementCounter( &counters->sentBytesCount, sentBytesCount );
+    incrementCounter( &counters->httpStatusClassCounts[ backendCommStats_getHttpStatusClass( httpStatusCode ) ], 1 );
+    incrementCounter( &counters->latencyHistogram[ backendCommStats_getLatencyHistogramBucket( latencyInMilliseconds ) ], 1 );
+    incrementCounter( &counters->latencySumInMilliseconds, latencyInMilliseconds );
+}
+
+void backendCommStats_onBatchesSent( size_t batchesCount )
+{
+    incrementCounter( &g_backendCommStatsCounters.sentBatchesCount, batchesCount );
+}
+
+void backendCommStats_onBatchesDropped( size_t batchesCount )
+{
+    incrementCounter( &g_backendCommStatsCounters.droppedBatchesCount, batchesCount );
+}
+
+void backendCommStats_get( /* out */ BackendCommStats* stats )
+{
+    const BackendCommStatsCounters* counters = &g_backendCommStatsCounters;
+
+    stats->requestsCount = loadCounter( &counters->requestsCount );
+    stats->failedRequestsCount = loadCounter( &counters->failedRequestsCount );
+    stats->sentBytesCount = loadCounter( &counters->sentBytesCount );
+    ELASTIC_APM_FOR_EACH_INDEX( i, numberOfBackendCommHttpStatusClasses )
+    {
+        stats->httpStatusClassCounts[ i ] = loadCounter( &counters->httpStatusClassCounts[ i ] );
+    }
+    ELASTIC_APM_FOR_EACH_INDEX( i, numberOfBackendCommLatencyHistogramBuckets )
+    {
+        stats->latencyHistogram[ i ] = loadCounter( &counters->latencyHistogram[ i ] );
+    }
+    stats->latencySumInMilliseconds = loadCounter( &counters->latencySumInMilliseconds );
+    stats->sentBatchesCount = loadCounter( &counters->sentBatchesCount );
+    stats->droppedBatchesCount = loadCounter( &counters->droppedBatchesCount );
+}
+
+void backendCommStats_reset()
+{
+    BackendCommStatsCounters* counters = &g_backendCommStatsCounters;
+
+    counters->requestsCount.store( 0, std::memory_order_relaxed );
+    counters->failedRequestsCount.store( 0, std::memory_order_relaxed );
+    counters->sentBytesCount.store( 0, std::memory_order_relaxed );
+    ELASTIC_APM_FOR_EACH_INDEX( i, numberOfBackendCommHttpStatusClasses )
+    {
+        counters->httpStatusClassCounts[ i ].store( 0, std::memory_order_relaxed );
+    }
+    ELASTIC_APM_FOR_EACH_INDEX( i, numberOfBackendCommLatencyHistogramBuckets )
+    {
+        counters->latencyHistogram[ i ].store( 0, std::memory_order_relaxed );
+    }
+    counters->latencySumInMilliseconds.store( 0, std::memory_order_relaxed );
+    counters->sentBatchesCount.store( 0, std::memory_order_relaxed );
+    counters->droppedBatchesCount.store( 0, std::memory_order_relaxed );
+}
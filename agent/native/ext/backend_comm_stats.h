@@ -0,0 +1,75 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#pragma once
+
+#include <stddef.h>
+#include "basic_types.h"
+
+/**
+ * Statistics of communication with APM Server in the current process.
+ * Counters are updated by the thread sending events and can be read by any thread at any time
+ * so each counter is consistent but a snapshot might include a request in one counter and not yet in another.
+ */
+
+/**
+ * Index 0 is for requests that failed without receiving HTTP response
+ */
+enum { numberOfBackendCommHttpStatusClasses = 6 };
+extern const char* backendCommHttpStatusClassNames[ numberOfBackendCommHttpStatusClasses ];
+
+/**
+ * Upper bounds (inclusive) of latency histogram buckets - the last bucket is for latencies above the last upper bound
+ */
+enum { numberOfBackendCommLatencyHistogramBuckets = 12 };
+extern const UInt64 backendCommLatencyHistogramUpperBoundsInMilliseconds[ numberOfBackendCommLatencyHistogramBuckets - 1 ];
+extern const char* backendCommLatencyHistogramBucketNames[ numberOfBackendCommLatencyHistogramBuckets ];
+
+struct BackendCommStats
+{
+    UInt64 requestsCount;
+    UInt64 failedRequestsCount;
+    // Size of request bodies as sent (i.e., after compression)
+    UInt64 sentBytesCount;
+    UInt64 httpStatusClassCounts[ numberOfBackendCommHttpStatusClasses ];
+    UInt64 latencyHistogram[ numberOfBackendCommLatencyHistogramBuckets ];
+    UInt64 latencySumInMilliseconds;
+    UInt64 sentBatchesCount;
+    // Batches dropped because sending failed or because the process was backing off
+    UInt64 droppedBatchesCount;
+};
+typedef struct BackendCommStats BackendCommStats;
+
+size_t backendCommStats_getHttpStatusClass( long httpStatusCode );
+size_t backendCommStats_getLatencyHistogramBucket( UInt64 latencyInMilliseconds );
+
+/**
+ * @param httpStatusCode 0 if the request failed without receiving HTTP response
+ */
+void backendCommStats_onRequest( UInt64 sentBytesCount, long httpStatusCode, bool isFailed, UInt64 latencyInMilliseconds );
+void backendCommStats_onBatchesSent( size_t batchesCount );
+void backendCommStats_onBatchesDropped( size_t batchesCount );
+
+void backendCommStats_get( /* out */ BackendCommStats* stats );
+
+/**
+ * Forked child starts with statistics of its own
+ */
+void backendCommStats_reset();
@@ -0,0 +1,252 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "deferred_call_records.h"
+#include <inttypes.h> // PRIu64
+#include "elastic_apm_alloc.h"
+#include "log.h"
+#include "util.h"
+
+#define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_AUTO_INSTRUMENT
+
+struct DeferredCallRecord
+{
+    uint32_t interceptRegistrationId;
+    bool hasExitedByException;
+    uint32_t capturedArgsCount;
+    UInt64 timestamp;
+    Int64 durationInMicroseconds;
+    // 0 if the call does not have $this - objects' IDs start from 1
+    zend_long thisObjId;
+    uint32_t capturedThisPropsCount;
+    zval capturedThisProps[ maxDeferredCallCapturedThisPropsCount ];
+    zval capturedArgs[ maxDeferredCallCapturedArgsCount ];
+    zval returnValueOrThrown;
+};
+typedef struct DeferredCallRecord DeferredCallRecord;
+
+enum { deferredCallRecordsCapacity = 4096 };
+
+/**
+ * Records hold zvals so the buffer is allocated on request heap (on the first record in the request)
+ * and freed at request shutdown.
+ */
+static DeferredCallRecord* g_deferredCallRecords = NULL;
+static uint32_t g_deferredCallRecordsCount = 0;
+static UInt64 g_droppedDeferredCallRecordsCount = 0;
+
+static
+void copyCapturedValue( zval* src, /* out */ zval* dst )
+{
+    if ( src == NULL || Z_ISUNDEF_P( src ) )
+    {
+        ZVAL_NULL( dst );
+        return;
+    }
+
+    ZVAL_DEREF( src );
+    ZVAL_COPY( dst, src );
+}
+
+static
+void captureThisProp( zval* thisObj, const char* propName, /* out */ zval* dst )
+{
+    zval readValueBuffer;
+    ZVAL_UNDEF( &readValueBuffer );
+    // silent: missing property is captured as null
+#   if PHP_VERSION_ID < ELASTIC_APM_BUILD_PHP_VERSION_ID( 8, 0, 0 ) /* if PHP version before 8.0.0 */
+    zval* value = zend_read_property( Z_OBJCE_P( thisObj ), thisObj, propName, strlen( propName ), /* silent */ 1, &readValueBuffer );
+#   else
+    zval* value = zend_read_property( Z_OBJCE_P( thisObj ), Z_OBJ_P( thisObj ), propName, strlen( propName ), /* silent */ 1, &readValueBuffer );
+#   endif
+    copyCapturedValue( value, /* out */ dst );
+    zval_ptr_dtor( &readValueBuffer );
+}
+
+static
+void destroyDeferredCallRecord( DeferredCallRecord* record )
+{
+    ELASTIC_APM_FOR_EACH_INDEX( i, record->capturedThisPropsCount )
+    {
+        zval_ptr_dtor( &( record->capturedThisProps[ i ] ) );
+    }
+    ELASTIC_APM_FOR_EACH_INDEX( i, record->capturedArgsCount )
+    {
+        zval_ptr_dtor( &( record->capturedArgs[ i ] ) );
+    }
+    zval_ptr_dtor( &( record->returnValueOrThrown ) );
+}
+
+static
+ResultCode ensureDeferredCallRecordsAllocated()
+{
+    ResultCode resultCode;
+
+    if ( g_deferredCallRecords != NULL )
+    {
+        return resultSuccess;
+    }
+
+    ELASTIC_APM_EMALLOC_ARRAY_IF_FAILED_GOTO( DeferredCallRecord, deferredCallRecordsCapacity, /* out */ g_deferredCallRecords );
+    g_deferredCallRecordsCount = 0;
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+void deferredCallRecords_append(
+        uint32_t interceptRegistrationId
+        , const DeferredCallRecordingSpec* spec
+        , zend_execute_data* execute_data
+        , const TimePoint* startTime
+        , bool hasExitedByException
+        , zval* retValOrThrown )
+{
+    TimePoint endTime;
+    getCurrentTime( &endTime );
+
+    if ( ensureDeferredCallRecordsAllocated() != resultSuccess )
+    {
+        return;
+    }
+
+    if ( g_deferredCallRecordsCount == deferredCallRecordsCapacity )
+    {
+        if ( g_droppedDeferredCallRecordsCount == 0 )
+        {
+            ELASTIC_APM_LOG_DEBUG( "Deferred call records buffer is full - new records will be dropped until the buffered ones are taken"
+                                   "; capacity: %u", (UInt)deferredCallRecordsCapacity );
+        }
+        ++g_droppedDeferredCallRecordsCount;
+        return;
+    }
+
+    DeferredCallRecord* record = &( g_deferredCallRecords[ g_deferredCallRecordsCount ] );
+    ++g_deferredCallRecordsCount;
+
+    record->interceptRegistrationId = interceptRegistrationId;
+    record->hasExitedByException = hasExitedByException;
+    record->timestamp = timePointToEpochMicroseconds( startTime );
+    record->durationInMicroseconds = durationMicroseconds( startTime, &endTime );
+
+    // Only $this object's ID is recorded - keeping a reference would extend the object's lifetime until the records are taken
+    const bool hasThisObj = ( Z_TYPE( execute_data->This ) == IS_OBJECT );
+    record->thisObjId = hasThisObj ? (zend_long) Z_OBJ_HANDLE( execute_data->This ) : 0;
+    record->capturedThisPropsCount = spec->thisPropsToCaptureCount;
+    ELASTIC_APM_FOR_EACH_INDEX( i, spec->thisPropsToCaptureCount )
+    {
+        if ( hasThisObj )
+        {
+            captureThisProp( &( execute_data->This ), spec->thisPropsToCaptureNames[ i ], /* out */ &( record->capturedThisProps[ i ] ) );
+        }
+        else
+        {
+            ZVAL_NULL( &( record->capturedThisProps[ i ] ) );
+        }
+    }
+
+    const uint32_t callArgsCount = ZEND_CALL_NUM_ARGS( execute_data );
+    record->capturedArgsCount = spec->argsToCaptureCount;
+    ELASTIC_APM_FOR_EACH_INDEX( i, spec->argsToCaptureCount )
+    {
+        const uint32_t argIndex = spec->argsToCaptureIndexes[ i ];
+        copyCapturedValue( ( argIndex < callArgsCount ) ? ZEND_CALL_ARG( execute_data, argIndex + 1 ) : NULL, /* out */ &( record->capturedArgs[ i ] ) );
+    }
+
+    // The thrown object is always captured so PHP part can create error for it
+    copyCapturedValue( ( hasExitedByException || spec->shouldCaptureReturnValue ) ? retValOrThrown : NULL, /* out */ &( record->returnValueOrThrown ) );
+}
+
+void deferredCallRecords_take( /* out */ zval* records )
+{
+    array_init_size( records, g_deferredCallRecordsCount );
+
+    ELASTIC_APM_FOR_EACH_INDEX( i, g_deferredCallRecordsCount )
+    {
+        DeferredCallRecord* record = &( g_deferredCallRecords[ i ] );
+        zval recordAsArray;
+        zval capturedThisProps;
+        zval capturedArgs;
+
+        array_init_size( &capturedThisProps, record->capturedThisPropsCount );
+        ELASTIC_APM_FOR_EACH_INDEX( propIndex, record->capturedThisPropsCount )
+        {
+            // Ownership of the captured values is moved to the returned array
+            add_next_index_zval( &capturedThisProps, &( record->capturedThisProps[ propIndex ] ) );
+        }
+
+        array_init_size( &capturedArgs, record->capturedArgsCount );
+        ELASTIC_APM_FOR_EACH_INDEX( argIndex, record->capturedArgsCount )
+        {
+            // Ownership of the captured values is moved to the returned array
+            add_next_index_zval( &capturedArgs, &( record->capturedArgs[ argIndex ] ) );
+        }
+
+        array_init_size( &recordAsArray, 8 );
+        add_next_index_long( &recordAsArray, (zend_long) record->interceptRegistrationId );
+        add_next_index_double( &recordAsArray, (double) record->timestamp );
+        add_next_index_double( &recordAsArray, durationMicrosecondsToMilliseconds( record->durationInMicroseconds ) );
+        add_next_index_bool( &recordAsArray, record->hasExitedByException );
+        if ( record->thisObjId == 0 )
+        {
+            add_next_index_null( &recordAsArray );
+        }
+        else
+        {
+            add_next_index_long( &recordAsArray, record->thisObjId );
+        }
+        add_next_index_zval( &recordAsArray, &capturedThisProps );
+        add_next_index_zval( &recordAsArray, &capturedArgs );
+        add_next_index_zval( &recordAsArray, &( record->returnValueOrThrown ) );
+
+        add_next_index_zval( records, &recordAsArray );
+    }
+
+    if ( g_droppedDeferredCallRecordsCount != 0 )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Deferred call records were dropped because the buffer was full; dropped: %" PRIu64 ", taken: %u"
+                               , g_droppedDeferredCallRecordsCount, g_deferredCallRecordsCount );
+    }
+
+    g_deferredCallRecordsCount = 0;
+    g_droppedDeferredCallRecordsCount = 0;
+}
+
+void deferredCallRecords_onRequestShutdown()
+{
+    if ( g_deferredCallRecords == NULL )
+    {
+        return;
+    }
+
+    // Records that were not taken (for example because the transaction was not ended)
+    ELASTIC_APM_FOR_EACH_INDEX( i, g_deferredCallRecordsCount )
+    {
+        destroyDeferredCallRecord( &( g_deferredCallRecords[ i ] ) );
+    }
+
+    ELASTIC_APM_EFREE_ARRAY_AND_SET_TO_NULL( DeferredCallRecord, deferredCallRecordsCapacity, g_deferredCallRecords );
+    g_deferredCallRecordsCount = 0;
+    g_droppedDeferredCallRecordsCount = 0;
+}
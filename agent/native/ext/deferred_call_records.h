@@ -0,0 +1,81 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <php.h>
+#include "basic_types.h"
+#include "time_util.h"
+
+enum { maxDeferredCallCapturedArgsCount = 4 };
+enum { maxDeferredCallCapturedThisPropsCount = 2 };
+enum { maxDeferredCallCapturedThisPropNameLength = 63 };
+
+/**
+ * Registration can ask the extension to only record intercepted calls instead of calling into PHP part before and after each call.
+ * The record has call's start time, duration, $this object's ID (see spl_object_id), the values of the declared $this properties,
+ * the arguments at the declared indexes, the return value (if declared) or the thrown object.
+ * PHP part takes the records in bulk (when the transaction ends) and builds spans from them.
+ *
+ * $this itself is not kept so recording a call does not change the lifetime of the object (for example PDOStatement with open result set).
+ * Captured values are kept alive until the records are taken so only the values needed to process the record should be declared.
+ */
+struct DeferredCallRecordingSpec
+{
+    bool isEnabled;
+    bool shouldCaptureReturnValue;
+    uint32_t argsToCaptureCount;
+    uint32_t argsToCaptureIndexes[ maxDeferredCallCapturedArgsCount ];
+    uint32_t thisPropsToCaptureCount;
+    char thisPropsToCaptureNames[ maxDeferredCallCapturedThisPropsCount ][ maxDeferredCallCapturedThisPropNameLength + 1 ];
+};
+typedef struct DeferredCallRecordingSpec DeferredCallRecordingSpec;
+
+static inline
+DeferredCallRecordingSpec makeDisabledDeferredCallRecordingSpec()
+{
+    DeferredCallRecordingSpec result = { 0 };
+    result.isEnabled = false;
+    return result;
+}
+
+/**
+ * Records are kept in a per-request buffer with fixed capacity.
+ * When the buffer is full new records are dropped (and counted) until PHP part takes the buffered ones.
+ *
+ * @param retValOrThrown can be NULL
+ */
+void deferredCallRecords_append(
+        uint32_t interceptRegistrationId
+        , const DeferredCallRecordingSpec* spec
+        , zend_execute_data* execute_data
+        , const TimePoint* startTime
+        , bool hasExitedByException
+        , zval* retValOrThrown );
+
+/**
+ * Returns array of records (the oldest first) and empties the buffer.
+ * Each record is array [interceptRegistrationId, timestamp (in microseconds since epoch), duration (in milliseconds),
+ * hasExitedByException, thisObjId (or null), capturedThisProps, capturedArgs, returnValueOrThrown]
+ */
+void deferredCallRecords_take( /* out */ zval* records );
+
+void deferredCallRecords_onRequestShutdown();
@@ -140,6 +140,9 @@ PHP_INI_BEGIN()
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_ALLOW_ABORT_DIALOG )
     #endif
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_API_KEY )
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_API_REQUEST_MAX_EVENTS_BATCHES )
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_API_REQUEST_SIZE )
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_API_REQUEST_TIME )
     #if ( ELASTIC_APM_ASSERT_ENABLED_01 != 0 )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_ASSERT_LEVEL )
     #endif
@@ -148,11 +151,19 @@ PHP_INI_BEGIN()
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_AST_PROCESS_DEBUG_DUMP_FOR_PATH_PREFIX )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_AST_PROCESS_DEBUG_DUMP_OUT_DIR )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_ASYNC_BACKEND_COMM )
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_BACKEND_COMM_DEFER_SYNC_SEND )
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_BACKEND_COMM_SHARED_BACKOFF )
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_BACKEND_COMM_SHARED_RING_SIZE )
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_BACKEND_COMM_SIDECAR_SOCKET )
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_BACKEND_COMM_SPILL_DIR )
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_BACKEND_COMM_SPILL_MAX_SIZE )
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_BACKEND_COMM_WARM_UP_CONNECTION )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_BOOTSTRAP_PHP_PART_FILE )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_BREAKDOWN_METRICS )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_CAPTURE_ERRORS )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_CAPTURE_ERRORS_WITH_PHP_PART )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_CAPTURE_EXCEPTIONS )
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_DEFERRED_HOOK_RECORDING_ENABLED )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_DEV_INTERNAL )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_DEV_INTERNAL_BACKEND_COMM_LOG_VERBOSE )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_DEV_INTERNAL_CAPTURE_ERRORS_ONLY_TO_LOG )
@@ -162,6 +173,7 @@ PHP_INI_BEGIN()
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_GLOBAL_LABELS )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_ENVIRONMENT )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_HOSTNAME )
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_INSTRUMENTATION_BACKEND )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_INTERNAL_CHECKS_LEVEL )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_LOG_FILE )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_LOG_LEVEL )
@@ -182,6 +194,8 @@ PHP_INI_BEGIN()
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_PROFILING_INFERRED_SPANS_SAMPLING_INTERVAL )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_SANITIZE_FIELD_NAMES )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_SECRET_TOKEN )
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_SERVER_REQUEST_COMPRESSION )
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_SERVER_REQUEST_COMPRESSION_LEVEL )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_SERVER_TIMEOUT )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_SERVER_URL )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_SERVICE_NAME )
@@ -192,6 +206,7 @@ PHP_INI_BEGIN()
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_SPAN_COMPRESSION_SAME_KIND_MAX_DURATION )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_SPAN_STACK_TRACE_MIN_DURATION )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_STACK_TRACE_LIMIT )
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_STREAMING_BACKEND_COMM )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_TRANSACTION_IGNORE_URLS )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_TRANSACTION_MAX_SPANS )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_TRANSACTION_SAMPLE_RATE )
@@ -508,6 +523,146 @@ PHP_FUNCTION( elastic_apm_intercept_calls_to_internal_function )
 }
 /* }}} */
 
+ZEND_BEGIN_ARG_INFO_EX( elastic_apm_record_intercepted_calls_deferred_arginfo, /* _unused */ 0, /* return_reference: */ 0, /* required_num_args: */ 3 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, interceptRegistrationId, IS_LONG, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, argsToCapture, IS_ARRAY, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, shouldCaptureReturnValue, _IS_BOOL, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, thisPropsToCapture, IS_ARRAY, /* allow_null: */ 0 )
+ZEND_END_ARG_INFO()
+/* {{{ elastic_apm_record_intercepted_calls_deferred( int $interceptRegistrationId, int[] $argsToCapture, bool $shouldCaptureReturnValue, string[] $thisPropsToCapture = [] ): bool
+ */
+PHP_FUNCTION( elastic_apm_record_intercepted_calls_deferred )
+{
+    RETVAL_FALSE;
+
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    if ( elasticApmApiEntered( __FILE__, __LINE__, __FUNCTION__ ) != resultSuccess )
+    {
+        return;
+    }
+
+    zend_long interceptRegistrationId = 0;
+    zend_array* argsToCapture = NULL;
+    zend_bool shouldCaptureReturnValue = 0;
+    zend_array* thisPropsToCapture = NULL;
+    DeferredCallRecordingSpec spec = makeDisabledDeferredCallRecordingSpec();
+    zval* argToCapture;
+    zval* thisPropToCapture;
+
+    ZEND_PARSE_PARAMETERS_START( /* min_num_args: */ 3, /* max_num_args: */ 4 )
+        Z_PARAM_LONG( interceptRegistrationId )
+        Z_PARAM_ARRAY_HT( argsToCapture )
+        Z_PARAM_BOOL( shouldCaptureReturnValue )
+        Z_PARAM_OPTIONAL
+        Z_PARAM_ARRAY_HT( thisPropsToCapture )
+    ZEND_PARSE_PARAMETERS_END();
+
+    if ( interceptRegistrationId < 0 || zend_hash_num_elements( argsToCapture ) > maxDeferredCallCapturedArgsCount )
+    {
+        return;
+    }
+
+    if ( thisPropsToCapture != NULL )
+    {
+        if ( zend_hash_num_elements( thisPropsToCapture ) > maxDeferredCallCapturedThisPropsCount )
+        {
+            return;
+        }
+        ZEND_HASH_FOREACH_VAL( thisPropsToCapture, thisPropToCapture )
+        {
+            if ( Z_TYPE_P( thisPropToCapture ) != IS_STRING || Z_STRLEN_P( thisPropToCapture ) == 0 || Z_STRLEN_P( thisPropToCapture ) > maxDeferredCallCapturedThisPropNameLength )
+            {
+                return;
+            }
+            char* propName = spec.thisPropsToCaptureNames[ spec.thisPropsToCaptureCount++ ];
+            memcpy( propName, Z_STRVAL_P( thisPropToCapture ), Z_STRLEN_P( thisPropToCapture ) );
+            propName[ Z_STRLEN_P( thisPropToCapture ) ] = '\0';
+        }
+        ZEND_HASH_FOREACH_END();
+    }
+
+    ZEND_HASH_FOREACH_VAL( argsToCapture, argToCapture )
+    {
+        if ( Z_TYPE_P( argToCapture ) != IS_LONG || Z_LVAL_P( argToCapture ) < 0 )
+        {
+            return;
+        }
+        spec.argsToCaptureIndexes[ spec.argsToCaptureCount++ ] = (uint32_t) Z_LVAL_P( argToCapture );
+    }
+    ZEND_HASH_FOREACH_END();
+    spec.shouldCaptureReturnValue = ( shouldCaptureReturnValue != 0 );
+
+    if ( elasticApmRecordInterceptedCallsDeferred( (uint32_t) interceptRegistrationId, &spec ) != resultSuccess )
+    {
+        return;
+    }
+
+    RETURN_TRUE;
+}
+/* }}} */
+
+ZEND_BEGIN_ARG_INFO_EX( elastic_apm_set_intercepted_call_arg_filter_arginfo, /* _unused */ 0, /* return_reference: */ 0, /* required_num_args: */ 4 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, interceptRegistrationId, IS_LONG, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, argIndex, IS_LONG, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, kind, IS_STRING, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, values, IS_ARRAY, /* allow_null: */ 0 )
+ZEND_END_ARG_INFO()
+/* {{{ elastic_apm_set_intercepted_call_arg_filter( int $interceptRegistrationId, int $argIndex, string $kind, array $values ): bool
+ */
+PHP_FUNCTION( elastic_apm_set_intercepted_call_arg_filter )
+{
+    RETVAL_FALSE;
+
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    if ( elasticApmApiEntered( __FILE__, __LINE__, __FUNCTION__ ) != resultSuccess )
+    {
+        return;
+    }
+
+    zend_long interceptRegistrationId = 0;
+    zend_long argIndex = 0;
+    char* kind = NULL;
+    size_t kindLength = 0;
+    zend_array* values = NULL;
+
+    ZEND_PARSE_PARAMETERS_START( /* min_num_args: */ 4, /* max_num_args: */ 4 )
+        Z_PARAM_LONG( interceptRegistrationId )
+        Z_PARAM_LONG( argIndex )
+        Z_PARAM_STRING( kind, kindLength )
+        Z_PARAM_ARRAY_HT( values )
+    ZEND_PARSE_PARAMETERS_END();
+
+    if ( interceptRegistrationId < 0 || argIndex < 0 )
+    {
+        return;
+    }
+
+    if ( elasticApmSetInterceptedCallArgFilter( (uint32_t) interceptRegistrationId, (uint32_t) argIndex, makeStringView( kind, kindLength ), values ) != resultSuccess )
+    {
+        return;
+    }
+
+    RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ elastic_apm_take_deferred_call_records(): array
+ */
+PHP_FUNCTION( elastic_apm_take_deferred_call_records )
+{
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    if ( elasticApmApiEntered( __FILE__, __LINE__, __FUNCTION__ ) != resultSuccess )
+    {
+        RETURN_EMPTY_ARRAY();
+    }
+
+    elasticApmTakeDeferredCallRecords( /* out */ return_value );
+}
+/* }}} */
+
 ZEND_BEGIN_ARG_INFO_EX( elastic_apm_send_to_server_arginfo, /* _unused: */ 0, /* return_reference: */ 0, /* required_num_args: */ 2 )
     ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, userAgentHttpHeader, IS_STRING, /* allow_null: */ 0 )
     ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, serializedEvents, IS_STRING, /* allow_null: */ 0 )
@@ -543,6 +698,333 @@ PHP_FUNCTION( elastic_apm_send_to_server ) {
 }
 /* }}} */
 
+ZEND_BEGIN_ARG_INFO_EX( elastic_apm_serialize_events_arginfo, /* _unused: */ 0, /* return_reference: */ 0, /* required_num_args: */ 5 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, serializedMetadata, IS_STRING, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, spans, IS_ARRAY, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, errors, IS_ARRAY, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, metricSets, IS_ARRAY, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, transaction, IS_OBJECT, /* allow_null: */ 1 )
+ZEND_END_ARG_INFO()
+
+/* {{{ elastic_apm_serialize_events(
+ *          string $serializedMetadata,
+ *          array $spans,
+ *          array $errors,
+ *          array $metricSets,
+ *          ?object $transaction ): ?string
+ */
+PHP_FUNCTION( elastic_apm_serialize_events )
+{
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    if ( elasticApmApiEntered( __FILE__, __LINE__, __FUNCTION__ ) != resultSuccess )
+    {
+        RETURN_NULL();
+    }
+
+    char* serializedMetadata = NULL;
+    size_t serializedMetadataLength = 0;
+    zend_array* spans = NULL;
+    zend_array* errors = NULL;
+    zend_array* metricSets = NULL;
+    zval* transaction = NULL;
+
+    ZEND_PARSE_PARAMETERS_START( /* min_num_args: */ 5, /* max_num_args: */ 5 )
+        Z_PARAM_STRING( serializedMetadata, serializedMetadataLength )
+        Z_PARAM_ARRAY_HT( spans )
+        Z_PARAM_ARRAY_HT( errors )
+        Z_PARAM_ARRAY_HT( metricSets )
+        Z_PARAM_OBJECT_EX( transaction, /* check_null: */ 1, /* separate: */ 0 )
+    ZEND_PARSE_PARAMETERS_END();
+
+    elasticApmSerializeEvents( makeStringView( serializedMetadata, serializedMetadataLength ), spans, errors, metricSets, transaction, /* out */ return_value );
+}
+/* }}} */
+
+ZEND_BEGIN_ARG_INFO_EX( elastic_apm_get_cached_metadata_arginfo, /* _unused: */ 0, /* return_reference: */ 0, /* required_num_args: */ 1 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, key, IS_STRING, /* allow_null: */ 0 )
+ZEND_END_ARG_INFO()
+
+/* {{{ elastic_apm_get_cached_metadata( string $key ): ?array
+ */
+PHP_FUNCTION( elastic_apm_get_cached_metadata )
+{
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    if ( elasticApmApiEntered( __FILE__, __LINE__, __FUNCTION__ ) != resultSuccess )
+    {
+        RETURN_NULL();
+    }
+
+    char* key = NULL;
+    size_t keyLength = 0;
+
+    ZEND_PARSE_PARAMETERS_START( /* min_num_args: */ 1, /* max_num_args: */ 1 )
+        Z_PARAM_STRING( key, keyLength )
+    ZEND_PARSE_PARAMETERS_END();
+
+    elasticApmGetCachedMetadata( makeStringView( key, keyLength ), /* out */ return_value );
+}
+/* }}} */
+
+ZEND_BEGIN_ARG_INFO_EX( elastic_apm_cache_metadata_arginfo, /* _unused: */ 0, /* return_reference: */ 0, /* required_num_args: */ 3 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, key, IS_STRING, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, serializedMetadata, IS_STRING, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, userAgentHttpHeader, IS_STRING, /* allow_null: */ 0 )
+ZEND_END_ARG_INFO()
+
+/* {{{ elastic_apm_cache_metadata(
+ *          string $key,
+ *          string $serializedMetadata,
+ *          string $userAgentHttpHeader ): bool
+ */
+PHP_FUNCTION( elastic_apm_cache_metadata )
+{
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    if ( elasticApmApiEntered( __FILE__, __LINE__, __FUNCTION__ ) != resultSuccess )
+    {
+        RETURN_BOOL( false );
+    }
+
+    char* key = NULL;
+    size_t keyLength = 0;
+    char* serializedMetadata = NULL;
+    size_t serializedMetadataLength = 0;
+    char* userAgentHttpHeader = NULL;
+    size_t userAgentHttpHeaderLength = 0;
+
+    ZEND_PARSE_PARAMETERS_START( /* min_num_args: */ 3, /* max_num_args: */ 3 )
+        Z_PARAM_STRING( key, keyLength )
+        Z_PARAM_STRING( serializedMetadata, serializedMetadataLength )
+        Z_PARAM_STRING( userAgentHttpHeader, userAgentHttpHeaderLength )
+    ZEND_PARSE_PARAMETERS_END();
+
+    RETURN_BOOL( elasticApmCacheMetadata( makeStringView( key, keyLength )
+                                          , makeStringView( serializedMetadata, serializedMetadataLength )
+                                          , makeStringView( userAgentHttpHeader, userAgentHttpHeaderLength ) ) == resultSuccess );
+}
+/* }}} */
+
+ZEND_BEGIN_ARG_INFO_EX( elastic_apm_event_buffer_append_arginfo, /* _unused: */ 0, /* return_reference: */ 0, /* required_num_args: */ 4 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, type, IS_STRING, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, event, IS_OBJECT, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, serializedMetadata, IS_STRING, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, userAgentHttpHeader, IS_STRING, /* allow_null: */ 0 )
+ZEND_END_ARG_INFO()
+
+/* {{{ elastic_apm_event_buffer_append(
+ *          string $type,
+ *          object $event,
+ *          string $serializedMetadata,
+ *          string $userAgentHttpHeader ): bool
+ */
+PHP_FUNCTION( elastic_apm_event_buffer_append )
+{
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    if ( elasticApmApiEntered( __FILE__, __LINE__, __FUNCTION__ ) != resultSuccess )
+    {
+        RETURN_BOOL( false );
+    }
+
+    char* type = NULL;
+    size_t typeLength = 0;
+    zval* event = NULL;
+    char* serializedMetadata = NULL;
+    size_t serializedMetadataLength = 0;
+    char* userAgentHttpHeader = NULL;
+    size_t userAgentHttpHeaderLength = 0;
+
+    ZEND_PARSE_PARAMETERS_START( /* min_num_args: */ 4, /* max_num_args: */ 4 )
+        Z_PARAM_STRING( type, typeLength )
+        Z_PARAM_OBJECT( event )
+        Z_PARAM_STRING( serializedMetadata, serializedMetadataLength )
+        Z_PARAM_STRING( userAgentHttpHeader, userAgentHttpHeaderLength )
+    ZEND_PARSE_PARAMETERS_END();
+
+    RETURN_BOOL( elasticApmEventBufferAppend( makeStringView( type, typeLength )
+                                              , event
+                                              , makeStringView( serializedMetadata, serializedMetadataLength )
+                                              , makeStringView( userAgentHttpHeader, userAgentHttpHeaderLength ) ) == resultSuccess );
+}
+/* }}} */
+
+ZEND_BEGIN_ARG_INFO_EX( elastic_apm_event_buffer_flush_arginfo, /* _unused: */ 0, /* return_reference: */ 0, /* required_num_args: */ 0 )
+ZEND_END_ARG_INFO()
+
+/* {{{ elastic_apm_event_buffer_flush(): bool
+ */
+PHP_FUNCTION( elastic_apm_event_buffer_flush )
+{
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    if ( elasticApmApiEntered( __FILE__, __LINE__, __FUNCTION__ ) != resultSuccess )
+    {
+        RETURN_BOOL( false );
+    }
+
+    ZEND_PARSE_PARAMETERS_NONE();
+
+    RETURN_BOOL( elasticApmEventBufferFlush() == resultSuccess );
+}
+/* }}} */
+
+ZEND_BEGIN_ARG_INFO_EX( elastic_apm_generate_id_arginfo, /* _unused: */ 0, /* return_reference: */ 0, /* required_num_args: */ 1 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, bytes, IS_LONG, /* allow_null: */ 0 )
+ZEND_END_ARG_INFO()
+
+/* {{{ elastic_apm_generate_id( int $bytes ): ?string
+ */
+PHP_FUNCTION( elastic_apm_generate_id )
+{
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    if ( elasticApmApiEntered( __FILE__, __LINE__, __FUNCTION__ ) != resultSuccess )
+    {
+        RETURN_NULL();
+    }
+
+    zend_long bytes = 0;
+
+    ZEND_PARSE_PARAMETERS_START( /* min_num_args: */ 1, /* max_num_args: */ 1 )
+        Z_PARAM_LONG( bytes )
+    ZEND_PARSE_PARAMETERS_END();
+
+    elasticApmGenerateId( bytes, /* out */ return_value );
+}
+/* }}} */
+
+ZEND_BEGIN_ARG_INFO_EX( elastic_apm_parse_traceparent_header_arginfo, /* _unused: */ 0, /* return_reference: */ 0, /* required_num_args: */ 1 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, headerValue, IS_STRING, /* allow_null: */ 0 )
+ZEND_END_ARG_INFO()
+
+/* {{{ elastic_apm_parse_traceparent_header( string $headerValue ): ?array
+ */
+PHP_FUNCTION( elastic_apm_parse_traceparent_header )
+{
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    if ( elasticApmApiEntered( __FILE__, __LINE__, __FUNCTION__ ) != resultSuccess )
+    {
+        RETURN_NULL();
+    }
+
+    char* headerValue = NULL;
+    size_t headerValueLength = 0;
+
+    ZEND_PARSE_PARAMETERS_START( /* min_num_args: */ 1, /* max_num_args: */ 1 )
+        Z_PARAM_STRING( headerValue, headerValueLength )
+    ZEND_PARSE_PARAMETERS_END();
+
+    elasticApmParseTraceParentHeader( makeStringView( headerValue, headerValueLength ), /* out */ return_value );
+}
+/* }}} */
+
+ZEND_BEGIN_ARG_INFO_EX( elastic_apm_parse_tracestate_headers_arginfo, /* _unused: */ 0, /* return_reference: */ 0, /* required_num_args: */ 1 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, headerValues, IS_ARRAY, /* allow_null: */ 0 )
+ZEND_END_ARG_INFO()
+
+/* {{{ elastic_apm_parse_tracestate_headers( array $headerValues ): ?array
+ */
+PHP_FUNCTION( elastic_apm_parse_tracestate_headers )
+{
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    if ( elasticApmApiEntered( __FILE__, __LINE__, __FUNCTION__ ) != resultSuccess )
+    {
+        RETURN_NULL();
+    }
+
+    zend_array* headerValues = NULL;
+
+    ZEND_PARSE_PARAMETERS_START( /* min_num_args: */ 1, /* max_num_args: */ 1 )
+        Z_PARAM_ARRAY_HT( headerValues )
+    ZEND_PARSE_PARAMETERS_END();
+
+    elasticApmParseTraceStateHeaders( headerValues, /* out */ return_value );
+}
+/* }}} */
+
+ZEND_BEGIN_ARG_INFO_EX( elastic_apm_build_traceparent_header_arginfo, /* _unused: */ 0, /* return_reference: */ 0, /* required_num_args: */ 3 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, traceId, IS_STRING, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, parentId, IS_STRING, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, isSampled, _IS_BOOL, /* allow_null: */ 0 )
+ZEND_END_ARG_INFO()
+
+/* {{{ elastic_apm_build_traceparent_header( string $traceId, string $parentId, bool $isSampled ): ?string
+ */
+PHP_FUNCTION( elastic_apm_build_traceparent_header )
+{
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    if ( elasticApmApiEntered( __FILE__, __LINE__, __FUNCTION__ ) != resultSuccess )
+    {
+        RETURN_NULL();
+    }
+
+    char* traceId = NULL;
+    size_t traceIdLength = 0;
+    char* parentId = NULL;
+    size_t parentIdLength = 0;
+    zend_bool isSampled = 0;
+
+    ZEND_PARSE_PARAMETERS_START( /* min_num_args: */ 3, /* max_num_args: */ 3 )
+        Z_PARAM_STRING( traceId, traceIdLength )
+        Z_PARAM_STRING( parentId, parentIdLength )
+        Z_PARAM_BOOL( isSampled )
+    ZEND_PARSE_PARAMETERS_END();
+
+    elasticApmBuildTraceParentHeader( makeStringView( traceId, traceIdLength ), makeStringView( parentId, parentIdLength ), isSampled, /* out */ return_value );
+}
+/* }}} */
+
+ZEND_BEGIN_ARG_INFO_EX( elastic_apm_format_sample_rate_arginfo, /* _unused: */ 0, /* return_reference: */ 0, /* required_num_args: */ 1 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, sampleRate, IS_DOUBLE, /* allow_null: */ 0 )
+ZEND_END_ARG_INFO()
+
+/* {{{ elastic_apm_format_sample_rate( float $sampleRate ): ?string
+ */
+PHP_FUNCTION( elastic_apm_format_sample_rate )
+{
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    if ( elasticApmApiEntered( __FILE__, __LINE__, __FUNCTION__ ) != resultSuccess )
+    {
+        RETURN_NULL();
+    }
+
+    double sampleRate = 0;
+
+    ZEND_PARSE_PARAMETERS_START( /* min_num_args: */ 1, /* max_num_args: */ 1 )
+        Z_PARAM_DOUBLE( sampleRate )
+    ZEND_PARSE_PARAMETERS_END();
+
+    elasticApmFormatSampleRate( sampleRate, /* out */ return_value );
+}
+/* }}} */
+
+/* {{{ elastic_apm_get_backend_comm_stats(): array
+ */
+PHP_FUNCTION( elastic_apm_get_backend_comm_stats )
+{
+    ResultCode resultCode;
+    ZVAL_NULL( /* out */ return_value );
+
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( elasticApmApiEntered( __FILE__, __LINE__, __FUNCTION__ ) );
+
+    elasticApmGetBackendCommStats( /* out */ return_value );
+
+    finally:
+    return;
+
+    failure:
+    goto finally;
+}
+/* }}} */
+
 ZEND_BEGIN_ARG_INFO_EX( elastic_apm_log_arginfo, /* _unused: */ 0, /* return_reference: */ 0, /* required_num_args: */ 7 )
                 ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, isForced, IS_LONG, /* allow_null: */ 0 )
                 ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, level, IS_LONG, /* allow_null: */ 0 )
@@ -719,7 +1201,21 @@ static const zend_function_entry elastic_apm_functions[] =
     PHP_FE( elastic_apm_get_number_of_dynamic_config_options, elastic_apm_no_paramters_arginfo )
     PHP_FE( elastic_apm_intercept_calls_to_internal_method, elastic_apm_intercept_calls_to_internal_method_arginfo )
     PHP_FE( elastic_apm_intercept_calls_to_internal_function, elastic_apm_intercept_calls_to_internal_function_arginfo )
+    PHP_FE( elastic_apm_record_intercepted_calls_deferred, elastic_apm_record_intercepted_calls_deferred_arginfo )
+    PHP_FE( elastic_apm_set_intercepted_call_arg_filter, elastic_apm_set_intercepted_call_arg_filter_arginfo )
+    PHP_FE( elastic_apm_take_deferred_call_records, elastic_apm_no_paramters_arginfo )
     PHP_FE( elastic_apm_send_to_server, elastic_apm_send_to_server_arginfo )
+    PHP_FE( elastic_apm_serialize_events, elastic_apm_serialize_events_arginfo )
+    PHP_FE( elastic_apm_get_cached_metadata, elastic_apm_get_cached_metadata_arginfo )
+    PHP_FE( elastic_apm_cache_metadata, elastic_apm_cache_metadata_arginfo )
+    PHP_FE( elastic_apm_event_buffer_append, elastic_apm_event_buffer_append_arginfo )
+    PHP_FE( elastic_apm_event_buffer_flush, elastic_apm_event_buffer_flush_arginfo )
+    PHP_FE( elastic_apm_generate_id, elastic_apm_generate_id_arginfo )
+    PHP_FE( elastic_apm_parse_traceparent_header, elastic_apm_parse_traceparent_header_arginfo )
+    PHP_FE( elastic_apm_parse_tracestate_headers, elastic_apm_parse_tracestate_headers_arginfo )
+    PHP_FE( elastic_apm_build_traceparent_header, elastic_apm_build_traceparent_header_arginfo )
+    PHP_FE( elastic_apm_format_sample_rate, elastic_apm_format_sample_rate_arginfo )
+    PHP_FE( elastic_apm_get_backend_comm_stats, elastic_apm_no_paramters_arginfo )
     PHP_FE( elastic_apm_log, elastic_apm_log_arginfo )
     PHP_FE( elastic_apm_get_last_thrown, elastic_apm_get_last_thrown_arginfo )
     PHP_FE( elastic_apm_get_last_php_error, elastic_apm_get_last_php_error_arginfo )
@@ -24,11 +24,22 @@
 #include "log.h"
 #include "Tracer.h"
 #include "elastic_apm_alloc.h"
-#include "numbered_intercepting_callbacks.h"
 #include "tracer_PHP_part.h"
 #include "backend_comm.h"
+#include "backend_comm_stats.h"
+#include "deferred_call_records.h"
+#include "event_buffer.h"
+#include "events_serialization.h"
+#include "id_generator.h"
+#include "intercepted_call_arg_filter.h"
+#include "metadata_cache.h"
+#include "observer_instrumentation.h"
+#include "ptr_to_id_map.h"
+#include "w3c_trace_context.h"
+#include "util_for_PHP.h"
 #include "lifecycle.h"
 #include "ConfigSnapshot.h"
+#include "ConfigManager.h"
 
 #define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_EXT_API
 
@@ -83,22 +94,74 @@ UInt elasticApmGetNumberOfDynamicConfigOptions()
     return result;
 }
 
-enum { maxFunctionsToIntercept = numberedInterceptingCallbacksCount };
-static uint32_t g_nextFreeFunctionToInterceptId = 0;
+/**
+ * Handlers of all intercepted functions are replaced with the same elasticApmInterceptingCallback
+ * which finds the registration by the called function's entry (EX( func )).
+ *
+ * Handlers of intercepted functions are replaced only once per process (internal functions' entries live as long as the process)
+ * and the registrations are kept across requests - the PHP part registers the same functions on every request
+ * and gets back the same registration IDs, it only enables the registrations for the current request.
+ * Calls to functions with registrations that are not enabled for the current request go directly to the original handler.
+ *
+ * Original handlers are restored and the registrations are freed on module shutdown
+ * because internal functions' entries outlive the extension (for example when the module is shut down and started again in the same process).
+ *
+ * When zend_observer API is used for internal functions (see observer_instrumentation.h) handlers are not replaced at all
+ * and the observer looks up the registration for the call the same way.
+ *
+ * Calls that do not match the registration's argument filter (see intercepted_call_arg_filter.h)
+ * go directly to the original handler without calling PHP part.
+ *
+ * Calls for registrations with deferred call recording enabled (see deferred_call_records.h) do not call PHP part at all
+ * - they are only recorded so they are not affected by the limitation on nesting intercepted calls.
+ */
+static const uint32_t noInterceptRegistrationId = UINT32_MAX;
+enum { functionsToInterceptDataMinCapacity = 64 };
 struct CallToInterceptData
 {
     zif_handler originalHandler;
     zend_function* funcEntry;
+    bool isEnabledForCurrentRequest;
+    // Registration created earlier for the same function or noInterceptRegistrationId
+    uint32_t previousRegistrationIdForSameFunction;
+    DeferredCallRecordingSpec deferredCallRecordingSpec;
+    InterceptedCallArgFilter argFilter;
 };
 typedef struct CallToInterceptData CallToInterceptData;
-static CallToInterceptData g_functionsToInterceptData[maxFunctionsToIntercept];
+static CallToInterceptData* g_functionsToInterceptData = NULL;
+static uint32_t g_functionsToInterceptDataCapacity = 0;
+static uint32_t g_nextFreeFunctionToInterceptId = 0;
+// Function entry -> ID of the latest registration for the function
+static PtrToIdMap g_funcEntryToInterceptRegistrationId = ELASTIC_APM_PTR_TO_ID_MAP_INITIALIZER;
 
 static uint32_t g_interceptedCallInProgressRegistrationId = 0;
 
+static
+void recordInterceptedCallDeferred( uint32_t interceptRegistrationId, zif_handler originalHandler, zend_execute_data* execute_data, zval* return_value )
+{
+    // Registrations array might be reallocated if the original handler calls userland code that registers more functions
+    const DeferredCallRecordingSpec deferredCallRecordingSpec = g_functionsToInterceptData[ interceptRegistrationId ].deferredCallRecordingSpec;
+    TimePoint startTime;
+    getCurrentTime( &startTime );
+
+    originalHandler( execute_data, return_value );
+
+    zval thrown;
+    const bool hasExitedByException = ( EG( exception ) != NULL );
+    if ( hasExitedByException )
+    {
+        ZVAL_OBJ( &thrown, EG( exception ) );
+    }
+    deferredCallRecords_append( interceptRegistrationId, &deferredCallRecordingSpec, execute_data, &startTime, hasExitedByException, hasExitedByException ? &thrown : return_value );
+}
+
 static
 void internalFunctionCallInterceptingImpl( uint32_t interceptRegistrationId, zend_execute_data* execute_data, zval* return_value )
 {
     ResultCode resultCode;
+    bool shouldCallPostHook;
+    // Registrations array might be reallocated if hooks register more functions
+    const zif_handler originalHandler = g_functionsToInterceptData[ interceptRegistrationId ].originalHandler;
 
     // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
     // which might deadlock in forked child
@@ -106,7 +169,17 @@ void internalFunctionCallInterceptingImpl( uint32_t interceptRegistrationId, zen
 
     ELASTIC_APM_LOG_TRACE_FUNCTION_ENTRY_MSG( "interceptRegistrationId: %u", interceptRegistrationId );
 
-    bool shouldCallPostHook;
+    if ( ! interceptedCallArgFilter_matches( &( g_functionsToInterceptData[ interceptRegistrationId ].argFilter ), execute_data ) )
+    {
+        originalHandler( execute_data, return_value );
+        return;
+    }
+
+    if ( g_functionsToInterceptData[ interceptRegistrationId ].deferredCallRecordingSpec.isEnabled )
+    {
+        recordInterceptedCallDeferred( interceptRegistrationId, originalHandler, execute_data, return_value );
+        return;
+    }
 
     if ( g_interceptedCallInProgressRegistrationId != 0 )
     {
@@ -114,16 +187,16 @@ void internalFunctionCallInterceptingImpl( uint32_t interceptRegistrationId, zen
                 "There's already an intercepted call in progress with interceptRegistrationId: %u."
                 "Nesting intercepted calls is not supported yet so invoking the original handler directly..."
                 , g_interceptedCallInProgressRegistrationId );
-        g_functionsToInterceptData[ interceptRegistrationId ].originalHandler( execute_data, return_value );
+        originalHandler( execute_data, return_value );
         return;
     }
 
     g_interceptedCallInProgressRegistrationId = interceptRegistrationId;
 
     shouldCallPostHook = tracerPhpPartInternalFuncCallPreHook( interceptRegistrationId, execute_data );
-    g_functionsToInterceptData[ interceptRegistrationId ].originalHandler( execute_data, return_value );
+    originalHandler( execute_data, return_value );
     if ( shouldCallPostHook ) {
-        tracerPhpPartInternalFuncCallPostHook( interceptRegistrationId, return_value );
+        tracerPhpPartInternalFuncCallPostHook( interceptRegistrationId, /* hasExitedByException */ false, return_value );
     }
 
     g_interceptedCallInProgressRegistrationId = 0;
@@ -137,36 +210,296 @@ void internalFunctionCallInterceptingImpl( uint32_t interceptRegistrationId, zen
     goto finally;
 }
 
+static
+bool isCopyOfInterceptedFunction( zend_function* funcEntry, zend_function* registeredFuncEntry, uint32_t registrationId )
+{
+    // A copy keeps the handler the registered entry had when the copy was made
+    // - it is either the replaced handler or the original one (if the copy was made before the handler was replaced or with zend_observer API)
+    return funcEntry->internal_function.handler == registeredFuncEntry->internal_function.handler
+           || funcEntry->internal_function.handler == g_functionsToInterceptData[ registrationId ].originalHandler;
+}
+
+static
+bool findLatestInterceptRegistrationId( zend_function* funcEntry, /* out */ uint32_t* interceptRegistrationId )
+{
+    if ( ptrToIdMap_get( &g_funcEntryToInterceptRegistrationId, funcEntry, /* out */ interceptRegistrationId ) )
+    {
+        return true;
+    }
+
+    // Calls via closure created from an internal function (for example by Closure::fromCallable)
+    // and calls to internal methods inherited by a subclass (for example class MyPdo extends PDO)
+    // use a copy of the function's entry (see zend_duplicate_internal_function) so the registered entry is looked up by name.
+    // Inherited method's copy keeps the declaring class as its scope but the registration might be for an ancestor of that class.
+    if ( funcEntry->type != ZEND_INTERNAL_FUNCTION || funcEntry->common.function_name == NULL || g_funcEntryToInterceptRegistrationId.count == 0 )
+    {
+        return false;
+    }
+    bool isFound = false;
+    zend_string* lowerCaseName = zend_string_tolower( funcEntry->common.function_name );
+    for ( zend_class_entry* scope = funcEntry->common.scope ; ; scope = scope->parent )
+    {
+        HashTable* functionTable = ( scope == NULL ) ? CG( function_table ) : &( scope->function_table );
+        auto registeredFuncEntry = static_cast<zend_function *>( zend_hash_find_ptr( functionTable, lowerCaseName ) );
+        if ( registeredFuncEntry != NULL
+             && ptrToIdMap_get( &g_funcEntryToInterceptRegistrationId, registeredFuncEntry, /* out */ interceptRegistrationId )
+             && isCopyOfInterceptedFunction( funcEntry, registeredFuncEntry, *interceptRegistrationId ) )
+        {
+            isFound = true;
+            break;
+        }
+        if ( scope == NULL || scope->parent == NULL )
+        {
+            break;
+        }
+    }
+    zend_string_release( lowerCaseName );
+    return isFound;
+}
+
+/**
+ * Last resort for the intercepting callback when the called function's entry cannot be matched to its registration
+ * - the callback has to call the original handler anyway so it is looked up among all the registrations by the function's name.
+ */
+static
+zif_handler findOriginalHandlerByFunctionName( zend_function* funcEntry )
+{
+    if ( funcEntry->common.function_name == NULL )
+    {
+        return NULL;
+    }
+    ELASTIC_APM_FOR_EACH_INDEX_EX( uint32_t, i, g_nextFreeFunctionToInterceptId )
+    {
+        const zend_function* registeredFuncEntry = g_functionsToInterceptData[ i ].funcEntry;
+        if ( registeredFuncEntry->common.function_name != NULL
+             && zend_string_equals_ci( registeredFuncEntry->common.function_name, funcEntry->common.function_name ) )
+        {
+            return g_functionsToInterceptData[ i ].originalHandler;
+        }
+    }
+    return NULL;
+}
+
+static
+uint32_t findInterceptRegistrationIdEnabledForCurrentRequest( uint32_t latestRegistrationId )
+{
+    // If the same function is registered more than once the latest registration enabled for the current request handles the call
+    uint32_t interceptRegistrationId = latestRegistrationId;
+    while ( interceptRegistrationId != noInterceptRegistrationId && ! g_functionsToInterceptData[ interceptRegistrationId ].isEnabledForCurrentRequest )
+    {
+        interceptRegistrationId = g_functionsToInterceptData[ interceptRegistrationId ].previousRegistrationIdForSameFunction;
+    }
+    return interceptRegistrationId;
+}
+
+bool isInterceptedFunction( zend_function* funcEntry )
+{
+    uint32_t latestRegistrationId;
+    return findLatestInterceptRegistrationId( funcEntry, /* out */ &latestRegistrationId );
+}
+
+bool doesInterceptedCallMatchArgFilter( uint32_t interceptRegistrationId, zend_execute_data* execute_data )
+{
+    return ( interceptRegistrationId >= g_nextFreeFunctionToInterceptId )
+           || interceptedCallArgFilter_matches( &( g_functionsToInterceptData[ interceptRegistrationId ].argFilter ), execute_data );
+}
+
+const DeferredCallRecordingSpec* findDeferredCallRecordingSpec( uint32_t interceptRegistrationId )
+{
+    if ( interceptRegistrationId >= g_nextFreeFunctionToInterceptId || ! g_functionsToInterceptData[ interceptRegistrationId ].deferredCallRecordingSpec.isEnabled )
+    {
+        return NULL;
+    }
+    return &( g_functionsToInterceptData[ interceptRegistrationId ].deferredCallRecordingSpec );
+}
+
+bool findInterceptRegistrationForCall( zend_function* funcEntry, /* out */ uint32_t* interceptRegistrationId )
+{
+    uint32_t latestRegistrationId;
+    if ( ! findLatestInterceptRegistrationId( funcEntry, /* out */ &latestRegistrationId ) )
+    {
+        return false;
+    }
+
+    *interceptRegistrationId = findInterceptRegistrationIdEnabledForCurrentRequest( latestRegistrationId );
+    return *interceptRegistrationId != noInterceptRegistrationId;
+}
+
+static
+ZEND_NAMED_FUNCTION( elasticApmInterceptingCallback )
+{
+    uint32_t latestRegistrationId;
+    if ( ! findLatestInterceptRegistrationId( EX( func ), /* out */ &latestRegistrationId ) )
+    {
+        // The call must not be lost even if the registration cannot be found - the original handler is called without interception
+        const zif_handler originalHandler = findOriginalHandlerByFunctionName( EX( func ) );
+        ELASTIC_APM_LOG_ERROR( "Intercepting callback was called for a function without registration; function: %s%s%s; original handler found: %s"
+                               , EX( func )->common.scope == NULL ? "" : ZSTR_VAL( EX( func )->common.scope->name )
+                               , EX( func )->common.scope == NULL ? "" : "::"
+                               , EX( func )->common.function_name == NULL ? "<N/A>" : ZSTR_VAL( EX( func )->common.function_name )
+                               , boolToString( originalHandler != NULL ) );
+        if ( originalHandler == NULL )
+        {
+            zend_throw_error( NULL, "Elastic APM failed to find the original implementation of intercepted function" );
+            return;
+        }
+        originalHandler( execute_data, return_value );
+        return;
+    }
+
+    uint32_t interceptRegistrationId = findInterceptRegistrationIdEnabledForCurrentRequest( latestRegistrationId );
+    if ( interceptRegistrationId == noInterceptRegistrationId )
+    {
+        g_functionsToInterceptData[ latestRegistrationId ].originalHandler( execute_data, return_value );
+        return;
+    }
+
+    internalFunctionCallInterceptingImpl( interceptRegistrationId, execute_data, return_value );
+}
+
 void resetCallInterceptionOnRequestShutdown()
 {
-    // We restore original handlers in the reverse order
-    // so that if the same function is registered for interception more than once
-    // the original handler will be restored correctly
-    ELASTIC_APM_FOR_EACH_BACKWARDS( i, g_nextFreeFunctionToInterceptId )
+    // Handlers stay replaced - registrations are only disabled until the PHP part registers them again in the next request
+    ELASTIC_APM_FOR_EACH_INDEX( i, g_nextFreeFunctionToInterceptId )
     {
-        CallToInterceptData* data = &( g_functionsToInterceptData[ i ] );
+        g_functionsToInterceptData[ i ].isEnabledForCurrentRequest = false;
+        g_functionsToInterceptData[ i ].deferredCallRecordingSpec = makeDisabledDeferredCallRecordingSpec();
+        g_functionsToInterceptData[ i ].argFilter = makeDisabledInterceptedCallArgFilter();
+    }
+}
+
+static
+void restoreOriginalHandlerIfIntercepted( zend_function* funcEntry )
+{
+    uint32_t latestRegistrationId;
+    if ( funcEntry->type != ZEND_INTERNAL_FUNCTION || ! ptrToIdMap_get( &g_funcEntryToInterceptRegistrationId, funcEntry, /* out */ &latestRegistrationId ) )
+    {
+        return;
+    }
 
-        data->funcEntry->internal_function.handler = data->originalHandler;
+    // All the registrations for the same function keep the handler the function had before the first registration
+    funcEntry->internal_function.handler = g_functionsToInterceptData[ latestRegistrationId ].originalHandler;
+}
+
+void resetCallInterceptionOnModuleShutdown()
+{
+    // Entries of extensions that were already shut down might be freed
+    // so handlers are restored only for the entries that are still in the function and class tables
+    if ( g_nextFreeFunctionToInterceptId != 0 )
+    {
+        zend_function* funcEntry;
+        zend_class_entry* classEntry;
+        ZEND_HASH_FOREACH_PTR( CG( function_table ), funcEntry )
+        {
+            restoreOriginalHandlerIfIntercepted( funcEntry );
+        }
+        ZEND_HASH_FOREACH_END();
+        ZEND_HASH_FOREACH_PTR( CG( class_table ), classEntry )
+        {
+            if ( classEntry->type != ZEND_INTERNAL_CLASS )
+            {
+                continue;
+            }
+            ZEND_HASH_FOREACH_PTR( &( classEntry->function_table ), funcEntry )
+            {
+                restoreOriginalHandlerIfIntercepted( funcEntry );
+            }
+            ZEND_HASH_FOREACH_END();
+        }
+        ZEND_HASH_FOREACH_END();
     }
 
+    ptrToIdMap_free( &g_funcEntryToInterceptRegistrationId );
+    ELASTIC_APM_FREE_AND_SET_TO_NULL( CallToInterceptData, sizeof( CallToInterceptData ) * g_functionsToInterceptDataCapacity, g_functionsToInterceptData );
+    g_functionsToInterceptDataCapacity = 0;
     g_nextFreeFunctionToInterceptId = 0;
+    g_interceptedCallInProgressRegistrationId = 0;
+}
+
+static
+ResultCode ensureCapacityForFunctionToInterceptData()
+{
+    ResultCode resultCode;
+    CallToInterceptData* newData = NULL;
+    const uint32_t newCapacity = ( g_functionsToInterceptDataCapacity == 0 ) ? (uint32_t) functionsToInterceptDataMinCapacity : ( g_functionsToInterceptDataCapacity * 2 );
+
+    if ( g_nextFreeFunctionToInterceptId < g_functionsToInterceptDataCapacity )
+    {
+        return resultSuccess;
+    }
+
+    ELASTIC_APM_MALLOC_IF_FAILED_GOTO( CallToInterceptData, sizeof( CallToInterceptData ) * newCapacity, /* out */ newData );
+    if ( g_nextFreeFunctionToInterceptId != 0 )
+    {
+        memcpy( newData, g_functionsToInterceptData, sizeof( CallToInterceptData ) * g_nextFreeFunctionToInterceptId );
+    }
+    ELASTIC_APM_FREE_AND_SET_TO_NULL( CallToInterceptData, sizeof( CallToInterceptData ) * g_functionsToInterceptDataCapacity, g_functionsToInterceptData );
+    g_functionsToInterceptData = newData;
+    g_functionsToInterceptDataCapacity = newCapacity;
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    ELASTIC_APM_LOG_ERROR( "Failed to grow intercepted functions registrations; current capacity: %u", g_functionsToInterceptDataCapacity );
+    goto finally;
 }
 
 bool addToFunctionsToInterceptData( zend_function* funcEntry, uint32_t* interceptRegistrationId, zif_handler replacementFunc )
 {
-    if ( g_nextFreeFunctionToInterceptId >= maxFunctionsToIntercept )
+    uint32_t latestRegistrationId = noInterceptRegistrationId;
+    const bool isAlreadyIntercepted = ptrToIdMap_get( &g_funcEntryToInterceptRegistrationId, funcEntry, /* out */ &latestRegistrationId );
+    uint32_t newRegistrationId;
+
+    if ( isAlreadyIntercepted )
+    {
+        // If the same function is registered for interception more than once in the same request
+        // then each registration gets its own ID so the oldest registration not enabled yet is reused
+        uint32_t registrationToReuseId = noInterceptRegistrationId;
+        for ( uint32_t id = latestRegistrationId ; id != noInterceptRegistrationId ; id = g_functionsToInterceptData[ id ].previousRegistrationIdForSameFunction )
+        {
+            if ( ! g_functionsToInterceptData[ id ].isEnabledForCurrentRequest )
+            {
+                registrationToReuseId = id;
+            }
+        }
+        if ( registrationToReuseId != noInterceptRegistrationId )
+        {
+            g_functionsToInterceptData[ registrationToReuseId ].isEnabledForCurrentRequest = true;
+            *interceptRegistrationId = registrationToReuseId;
+            ELASTIC_APM_LOG_TRACE( "Reusing registration from a previous request; interceptRegistrationId: %u", *interceptRegistrationId );
+            return true;
+        }
+    }
+
+    if ( ensureCapacityForFunctionToInterceptData() != resultSuccess )
     {
-        ELASTIC_APM_LOG_ERROR( "Reached maxFunctionsToIntercept."
-                               " maxFunctionsToIntercept: %u. g_nextFreeFunctionToInterceptId: %u."
-                               , maxFunctionsToIntercept, g_nextFreeFunctionToInterceptId );
         return false;
     }
 
-    *interceptRegistrationId = g_nextFreeFunctionToInterceptId ++;
-    g_functionsToInterceptData[ *interceptRegistrationId ].funcEntry = funcEntry;
-    g_functionsToInterceptData[ *interceptRegistrationId ].originalHandler = funcEntry->internal_function.handler;
-    funcEntry->internal_function.handler = ( replacementFunc == NULL ) ? g_numberedInterceptingCallback[ *interceptRegistrationId ] : replacementFunc;
+    newRegistrationId = g_nextFreeFunctionToInterceptId;
+    if ( ptrToIdMap_set( &g_funcEntryToInterceptRegistrationId, funcEntry, newRegistrationId ) != resultSuccess )
+    {
+        return false;
+    }
+    ++g_nextFreeFunctionToInterceptId;
+
+    CallToInterceptData* data = &( g_functionsToInterceptData[ newRegistrationId ] );
+    data->funcEntry = funcEntry;
+    // Handler is replaced only for the first registration of the function
+    data->originalHandler = isAlreadyIntercepted ? g_functionsToInterceptData[ latestRegistrationId ].originalHandler : funcEntry->internal_function.handler;
+    data->isEnabledForCurrentRequest = true;
+    data->previousRegistrationIdForSameFunction = isAlreadyIntercepted ? latestRegistrationId : noInterceptRegistrationId;
+    data->deferredCallRecordingSpec = makeDisabledDeferredCallRecordingSpec();
+    data->argFilter = makeDisabledInterceptedCallArgFilter();
+    // With zend_observer API the handler is not replaced - observer_instrumentation finds the registration by the function's entry
+    if ( ! isAlreadyIntercepted && ! isObserverInstrumentationOfInternalFunctionsActive() )
+    {
+        funcEntry->internal_function.handler = ( replacementFunc == NULL ) ? elasticApmInterceptingCallback : replacementFunc;
+    }
 
+    *interceptRegistrationId = newRegistrationId;
     return true;
 }
 
@@ -239,6 +572,68 @@ ResultCode elasticApmInterceptCallsToInternalFunction( String functionName, uint
     return elasticApmInterceptCallsToInternalFunctionEx( functionName, interceptRegistrationId, /* replacementFunc */ NULL );
 }
 
+ResultCode elasticApmRecordInterceptedCallsDeferred( uint32_t interceptRegistrationId, const DeferredCallRecordingSpec* spec )
+{
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY_MSG( "interceptRegistrationId: %u; argsToCaptureCount: %u; shouldCaptureReturnValue: %s; thisPropsToCaptureCount: %u"
+                                              , interceptRegistrationId, spec->argsToCaptureCount, boolToString( spec->shouldCaptureReturnValue ), spec->thisPropsToCaptureCount );
+
+    ResultCode resultCode;
+
+    if ( ! getTracerCurrentConfigSnapshot( getGlobalTracer() )->deferredHookRecordingEnabled )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Configuration option %s is not enabled", ELASTIC_APM_CFG_OPT_NAME_DEFERRED_HOOK_RECORDING_ENABLED );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    if ( interceptRegistrationId >= g_nextFreeFunctionToInterceptId || ! g_functionsToInterceptData[ interceptRegistrationId ].isEnabledForCurrentRequest )
+    {
+        ELASTIC_APM_LOG_ERROR( "There is no registration enabled for the current request with the given interceptRegistrationId: %u", interceptRegistrationId );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    g_functionsToInterceptData[ interceptRegistrationId ].deferredCallRecordingSpec = *spec;
+    g_functionsToInterceptData[ interceptRegistrationId ].deferredCallRecordingSpec.isEnabled = true;
+
+    resultCode = resultSuccess;
+    finally:
+    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT();
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+ResultCode elasticApmSetInterceptedCallArgFilter( uint32_t interceptRegistrationId, uint32_t argIndex, StringView kindName, zend_array* values )
+{
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY_MSG( "interceptRegistrationId: %u; argIndex: %u; kind: `%.*s'"
+                                              , interceptRegistrationId, argIndex, (int) kindName.length, kindName.begin );
+
+    ResultCode resultCode;
+    InterceptedCallArgFilter argFilter;
+
+    if ( interceptRegistrationId >= g_nextFreeFunctionToInterceptId || ! g_functionsToInterceptData[ interceptRegistrationId ].isEnabledForCurrentRequest )
+    {
+        ELASTIC_APM_LOG_ERROR( "There is no registration enabled for the current request with the given interceptRegistrationId: %u", interceptRegistrationId );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( interceptedCallArgFilter_build( argIndex, kindName, values, /* out */ &argFilter ) );
+    g_functionsToInterceptData[ interceptRegistrationId ].argFilter = argFilter;
+
+    resultCode = resultSuccess;
+    finally:
+    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT();
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+void elasticApmTakeDeferredCallRecords( zval* return_value )
+{
+    deferredCallRecords_take( /* out */ return_value );
+}
+
 static inline bool longToBool( long longVal )
 {
     return longVal != 0;
@@ -261,3 +656,194 @@ ResultCode elasticApmSendToServer( StringView userAgentHttpHeader, StringView se
     failure:
     goto finally;
 }
+
+static
+void addBackendCommStatsArray( zval* map, String key, size_t count, const char* const* names, const UInt64* values )
+{
+    zval subMap;
+    array_init( &subMap );
+    ELASTIC_APM_FOR_EACH_INDEX( i, count )
+    {
+        add_assoc_long( &subMap, names[ i ], (zend_long) values[ i ] );
+    }
+    add_assoc_zval( map, key, &subMap );
+}
+
+void elasticApmGetBackendCommStats( zval* return_value )
+{
+    BackendCommStats stats;
+    UInt64 droppedEventsCounts[ numberOfBackendCommEventClasses ];
+
+    backendCommStats_get( /* out */ &stats );
+    ELASTIC_APM_FOR_EACH_INDEX( eventClass, numberOfBackendCommEventClasses )
+    {
+        droppedEventsCounts[ eventClass ] = getBackendCommDroppedEventsCount( (BackendCommEventClass) eventClass );
+    }
+
+    array_init( return_value );
+    ELASTIC_APM_ZEND_ADD_ASSOC( return_value, "queued_events_size", long, (zend_long) getBackendCommQueuedEventsSize() );
+    ELASTIC_APM_ZEND_ADD_ASSOC( return_value, "requests", long, (zend_long) stats.requestsCount );
+    ELASTIC_APM_ZEND_ADD_ASSOC( return_value, "failed_requests", long, (zend_long) stats.failedRequestsCount );
+    ELASTIC_APM_ZEND_ADD_ASSOC( return_value, "sent_bytes", long, (zend_long) stats.sentBytesCount );
+    ELASTIC_APM_ZEND_ADD_ASSOC( return_value, "sent_batches", long, (zend_long) stats.sentBatchesCount );
+    ELASTIC_APM_ZEND_ADD_ASSOC( return_value, "dropped_batches", long, (zend_long) stats.droppedBatchesCount );
+    addBackendCommStatsArray( return_value, "dropped_events", numberOfBackendCommEventClasses, backendCommEventClassNames, droppedEventsCounts );
+    addBackendCommStatsArray( return_value, "http_status_classes", numberOfBackendCommHttpStatusClasses, backendCommHttpStatusClassNames, stats.httpStatusClassCounts );
+    addBackendCommStatsArray( return_value, "latency_histogram_ms", numberOfBackendCommLatencyHistogramBuckets, backendCommLatencyHistogramBucketNames, stats.latencyHistogram );
+    ELASTIC_APM_ZEND_ADD_ASSOC( return_value, "latency_sum_ms", long, (zend_long) stats.latencySumInMilliseconds );
+}
+
+void elasticApmSerializeEvents( StringView serializedMetadata, zend_array* spans, zend_array* errors, zend_array* metricSets, zval* transaction, zval* return_value )
+{
+    JsonWriter writer = ELASTIC_APM_DEFAULT_JSON_WRITER;
+
+    if ( serializeEvents( serializedMetadata, spans, errors, metricSets, transaction, /* out */ &writer ) == resultSuccess )
+    {
+        RETVAL_STRINGL( writer.buffer, writer.length );
+    }
+    else
+    {
+        RETVAL_NULL();
+    }
+
+    jsonWriter_free( &writer );
+}
+
+void elasticApmGetCachedMetadata( StringView key, zval* return_value )
+{
+    StringView serializedMetadata;
+    StringView userAgentHttpHeader;
+
+    if ( ! metadataCache_get( key, /* out */ &serializedMetadata, /* out */ &userAgentHttpHeader ) )
+    {
+        RETURN_NULL();
+    }
+
+    array_init_size( return_value, 2 );
+    add_next_index_stringl( return_value, serializedMetadata.begin, serializedMetadata.length );
+    add_next_index_stringl( return_value, userAgentHttpHeader.begin, userAgentHttpHeader.length );
+}
+
+ResultCode elasticApmCacheMetadata( StringView key, StringView serializedMetadata, StringView userAgentHttpHeader )
+{
+    return metadataCache_set( key, serializedMetadata, userAgentHttpHeader );
+}
+
+ResultCode elasticApmEventBufferAppend( StringView eventType, zval* event, StringView serializedMetadata, StringView userAgentHttpHeader )
+{
+    return eventBuffer_append( getTracerCurrentConfigSnapshot( getGlobalTracer() ), eventType, event, serializedMetadata, userAgentHttpHeader );
+}
+
+ResultCode elasticApmEventBufferFlush()
+{
+    return eventBuffer_flush( getTracerCurrentConfigSnapshot( getGlobalTracer() ) );
+}
+
+void elasticApmGenerateId( zend_long idSizeInBytes, zval* return_value )
+{
+    if ( idSizeInBytes <= 0 || idSizeInBytes > maxGeneratedIdSizeInBytes )
+    {
+        ELASTIC_APM_LOG_ERROR( "Invalid ID size; idSizeInBytes: %" PRId64, (Int64) idSizeInBytes );
+        RETURN_NULL();
+    }
+
+    // Hex digits are written directly to the returned string
+    zend_string* hexId = zend_string_alloc( 2 * (size_t) idSizeInBytes, /* persistent: */ 0 );
+    idGenerator_generateHexId( (size_t) idSizeInBytes, /* out */ ZSTR_VAL( hexId ) );
+    ZSTR_VAL( hexId )[ 2 * idSizeInBytes ] = '\0';
+    RETURN_STR( hexId );
+}
+
+static
+void addNextIndexLowerCaseString( zval* array, StringView str )
+{
+    zend_string* lowerCaseStr = zend_string_alloc( str.length, /* persistent: */ 0 );
+    zend_str_tolower_copy( ZSTR_VAL( lowerCaseStr ), str.begin, str.length );
+    add_next_index_str( array, lowerCaseStr );
+}
+
+void elasticApmParseTraceParentHeader( StringView headerValue, zval* return_value )
+{
+    TraceParentData data;
+    if ( ! w3cTraceContext_parseTraceParent( headerValue, /* out */ &data ) )
+    {
+        RETURN_NULL();
+    }
+
+    array_init_size( return_value, 3 );
+    addNextIndexLowerCaseString( return_value, data.traceId );
+    addNextIndexLowerCaseString( return_value, data.parentId );
+    add_next_index_bool( return_value, data.isSampled );
+}
+
+void elasticApmParseTraceStateHeaders( zend_array* headerValues, zval* return_value )
+{
+    TraceStateData data;
+    TraceStateParsingStatus status = traceStateParsing_continue;
+    zval* headerValue;
+
+    w3cTraceContext_initTraceState( /* out */ &data );
+    ZEND_HASH_FOREACH_VAL( headerValues, headerValue )
+    {
+        if ( Z_TYPE_P( headerValue ) != IS_STRING )
+        {
+            ELASTIC_APM_LOG_ERROR( "tracestate HTTP header value is not a string; type: %d", (int) Z_TYPE_P( headerValue ) );
+            RETURN_NULL();
+        }
+        status = w3cTraceContext_parseTraceStateHeaderValue( zStringToStringView( Z_STR_P( headerValue ) ), /* in,out */ &data );
+        if ( status != traceStateParsing_continue )
+        {
+            break;
+        }
+    }
+    ZEND_HASH_FOREACH_END();
+
+    if ( status == traceStateParsing_invalid || ! w3cTraceContext_finishTraceState( /* in,out */ &data ) )
+    {
+        RETURN_NULL();
+    }
+
+    array_init_size( return_value, 2 );
+    if ( data.hasSampleRate )
+    {
+        add_next_index_double( return_value, data.sampleRate );
+    }
+    else
+    {
+        add_next_index_null( return_value );
+    }
+    const size_t outgoingTraceStateLength = w3cTraceContext_calcOutgoingTraceStateLength( &data );
+    if ( outgoingTraceStateLength == 0 )
+    {
+        add_next_index_null( return_value );
+    }
+    else
+    {
+        // Outgoing tracestate is written directly to the returned string
+        zend_string* outgoingTraceState = zend_string_alloc( outgoingTraceStateLength, /* persistent: */ 0 );
+        w3cTraceContext_buildOutgoingTraceState( &data, /* out */ ZSTR_VAL( outgoingTraceState ) );
+        ZSTR_VAL( outgoingTraceState )[ outgoingTraceStateLength ] = '\0';
+        add_next_index_str( return_value, outgoingTraceState );
+    }
+}
+
+void elasticApmBuildTraceParentHeader( StringView traceId, StringView parentId, bool isSampled, zval* return_value )
+{
+    zend_string* headerValue = zend_string_alloc( w3cTraceContext_traceParentHeaderLength, /* persistent: */ 0 );
+    if ( ! w3cTraceContext_buildTraceParent( traceId, parentId, isSampled, /* out */ ZSTR_VAL( headerValue ) ) )
+    {
+        zend_string_release( headerValue );
+        ELASTIC_APM_LOG_ERROR( "Invalid trace ID or parent ID; traceId: %.*s, parentId: %.*s"
+                               , (int) traceId.length, traceId.begin, (int) parentId.length, parentId.begin );
+        RETURN_NULL();
+    }
+    ZSTR_VAL( headerValue )[ w3cTraceContext_traceParentHeaderLength ] = '\0';
+    RETURN_STR( headerValue );
+}
+
+void elasticApmFormatSampleRate( double sampleRate, zval* return_value )
+{
+    char buffer[ w3cTraceContext_sampleRateAsStringBufferSize ];
+    const size_t length = w3cTraceContext_formatSampleRate( sampleRate, /* out */ buffer, sizeof( buffer ) );
+    RETURN_STRINGL( buffer, length );
+}
@@ -24,6 +24,7 @@
 #include "basic_types.h"
 #include "StringView.h"
 #include "ResultCode.h"
+#include "deferred_call_records.h"
 
 ResultCode elasticApmApiEntered( String dbgCalledFromFile, int dbgCalledFromLine, String dbgCalledFromFunction );
 
@@ -39,7 +40,80 @@ ResultCode elasticApmInterceptCallsToInternalFunction( String functionName, uint
 
 void resetCallInterceptionOnRequestShutdown();
 
+/**
+ * Restores original handlers of intercepted functions and frees the registrations
+ */
+void resetCallInterceptionOnModuleShutdown();
+
+bool isInterceptedFunction( zend_function* funcEntry );
+
+/**
+ * @return false if the function is not intercepted or none of its registrations is enabled for the current request
+ */
+bool findInterceptRegistrationForCall( zend_function* funcEntry, /* out */ uint32_t* interceptRegistrationId );
+
+/**
+ * @return false if the call should go directly to the original function without calling PHP part's pre-hook
+ */
+bool doesInterceptedCallMatchArgFilter( uint32_t interceptRegistrationId, zend_execute_data* execute_data );
+
+/**
+ * @return NULL if deferred call recording is not enabled for the registration
+ */
+const DeferredCallRecordingSpec* findDeferredCallRecordingSpec( uint32_t interceptRegistrationId );
+
+ResultCode elasticApmRecordInterceptedCallsDeferred( uint32_t interceptRegistrationId, const DeferredCallRecordingSpec* spec );
+
+ResultCode elasticApmSetInterceptedCallArgFilter( uint32_t interceptRegistrationId, uint32_t argIndex, StringView kindName, zend_array* values );
+
+/**
+ * Returns array of the records of intercepted calls with deferred recording (see deferredCallRecords_take)
+ */
+void elasticApmTakeDeferredCallRecords( zval* return_value );
+
 ResultCode elasticApmSendToServer( StringView userAgentHttpHeader, StringView serializedEvents );
 
+void elasticApmGetBackendCommStats( zval* return_value );
+
+/**
+ * Returns serialized events as string or null if they could not be serialized
+ *
+ * @param transaction can be NULL
+ */
+void elasticApmSerializeEvents( StringView serializedMetadata, zend_array* spans, zend_array* errors, zend_array* metricSets, zval* transaction, zval* return_value );
+
+/**
+ * Returns [serializedMetadata, userAgentHttpHeader] array or null if there is no metadata cached for the key
+ */
+void elasticApmGetCachedMetadata( StringView key, zval* return_value );
+
+ResultCode elasticApmCacheMetadata( StringView key, StringView serializedMetadata, StringView userAgentHttpHeader );
+
+ResultCode elasticApmEventBufferAppend( StringView eventType, zval* event, StringView serializedMetadata, StringView userAgentHttpHeader );
+
+ResultCode elasticApmEventBufferFlush();
+
+/**
+ * Returns ID as lower case hex string or null if idSizeInBytes is not valid
+ */
+void elasticApmGenerateId( zend_long idSizeInBytes, zval* return_value );
+
+/**
+ * Returns [traceId, parentId, isSampled] (IDs as lower case hex strings) or null if traceparent HTTP header value is not valid
+ */
+void elasticApmParseTraceParentHeader( StringView headerValue, zval* return_value );
+
+/**
+ * Returns [?float sampleRate, ?string outgoingTraceState] or null if tracestate HTTP header values are not valid
+ */
+void elasticApmParseTraceStateHeaders( zend_array* headerValues, zval* return_value );
+
+/**
+ * Returns traceparent HTTP header value or null if traceId or parentId do not have the expected length
+ */
+void elasticApmBuildTraceParentHeader( StringView traceId, StringView parentId, bool isSampled, zval* return_value );
+
+void elasticApmFormatSampleRate( double sampleRate, zval* return_value );
+
 void elasticApmBeforeLoadingAgentPhpCode();
 void elasticApmAfterLoadingAgentPhpCode();
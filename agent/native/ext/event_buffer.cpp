@@ -0,0 +1,175 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "event_buffer.h"
+#include "backend_comm.h"
+#include "ConfigSnapshot.h"
+#include "events_serialization.h"
+#include "json_writer.h"
+#include "log.h"
+#include "util.h"
+
+#define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_BACKEND_COMM
+
+#define ELASTIC_APM_EVENT_BUFFER_METADATA_LINE_PREFIX "{\"metadata\":"
+
+/**
+ * Buffer starts with metadata line so it can be sent as is.
+ * Writers are not freed when the buffer is flushed so memory allocated by one request is reused by the next ones.
+ */
+static JsonWriter g_eventBufferWriter = ELASTIC_APM_DEFAULT_JSON_WRITER;
+static JsonWriter g_eventBufferUserAgentHttpHeader = ELASTIC_APM_DEFAULT_JSON_WRITER;
+static size_t g_eventBufferMetadataLineLength = 0;
+static size_t g_eventBufferEventsCount = 0;
+
+static
+bool isValidEventType( StringView eventType )
+{
+    return areStringViewsEqual( eventType, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "span" ) )
+           || areStringViewsEqual( eventType, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "error" ) )
+           || areStringViewsEqual( eventType, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "metricset" ) )
+           || areStringViewsEqual( eventType, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "transaction" ) );
+}
+
+static
+bool doesBufferedMetadataMatch( StringView serializedMetadata, StringView userAgentHttpHeader )
+{
+    size_t metadataLinePrefixLength = ELASTIC_APM_STATIC_ARRAY_SIZE( ELASTIC_APM_EVENT_BUFFER_METADATA_LINE_PREFIX ) - 1;
+    // Metadata line is metadata line prefix, serialized metadata and closing '}'
+    StringView bufferedMetadata = makeStringView( g_eventBufferWriter.buffer + metadataLinePrefixLength, g_eventBufferMetadataLineLength - metadataLinePrefixLength - 1 );
+
+    return areStringViewsEqual( jsonWriter_getText( &g_eventBufferUserAgentHttpHeader ), userAgentHttpHeader )
+           && areStringViewsEqual( bufferedMetadata, serializedMetadata );
+}
+
+static
+void clearEventBuffer()
+{
+    jsonWriter_clear( &g_eventBufferWriter );
+    jsonWriter_clear( &g_eventBufferUserAgentHttpHeader );
+    g_eventBufferMetadataLineLength = 0;
+    g_eventBufferEventsCount = 0;
+}
+
+ResultCode eventBuffer_append( const ConfigSnapshot* config, StringView eventType, zval* event, StringView serializedMetadata, StringView userAgentHttpHeader )
+{
+    ResultCode resultCode;
+    size_t lengthBeforeEvent;
+
+    if ( ! isValidEventType( eventType ) )
+    {
+        ELASTIC_APM_LOG_ERROR( "Unexpected event type: %.*s", (int) eventType.length, eventType.begin );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    if ( g_eventBufferEventsCount != 0 && ! doesBufferedMetadataMatch( serializedMetadata, userAgentHttpHeader ) )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Metadata changed - flushing events buffered with the previous metadata" );
+        // The buffer is cleared even if the flush fails (the flushed events are counted as dropped by backend comm)
+        // so the failure is not propagated - the event passed to this call can still be buffered
+        if ( eventBuffer_flush( config ) != resultSuccess )
+        {
+            ELASTIC_APM_LOG_ERROR( "Failed to flush events buffered with the previous metadata" );
+        }
+    }
+
+    if ( g_eventBufferEventsCount == 0 )
+    {
+        clearEventBuffer();
+        jsonWriter_appendRaw( &g_eventBufferUserAgentHttpHeader, userAgentHttpHeader );
+        jsonWriter_appendRaw( &g_eventBufferWriter, ELASTIC_APM_STRING_LITERAL_TO_VIEW( ELASTIC_APM_EVENT_BUFFER_METADATA_LINE_PREFIX ) );
+        jsonWriter_appendRaw( &g_eventBufferWriter, serializedMetadata );
+        jsonWriter_appendChar( &g_eventBufferWriter, '}' );
+        if ( g_eventBufferWriter.isOutOfMemory || g_eventBufferUserAgentHttpHeader.isOutOfMemory )
+        {
+            clearEventBuffer();
+            ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE_EX( resultOutOfMemory );
+        }
+        g_eventBufferMetadataLineLength = g_eventBufferWriter.length;
+    }
+
+    lengthBeforeEvent = g_eventBufferWriter.length;
+    jsonWriter_appendChar( &g_eventBufferWriter, '\n' );
+    resultCode = serializeEventOfType( eventType, event, /* out */ &g_eventBufferWriter );
+    if ( resultCode != resultSuccess )
+    {
+        jsonWriter_truncate( &g_eventBufferWriter, lengthBeforeEvent );
+        ELASTIC_APM_LOG_DEBUG( "Failed to serialize event; eventType: %.*s", (int) eventType.length, eventType.begin );
+        goto failure;
+    }
+    ++g_eventBufferEventsCount;
+
+    if ( (Int64) g_eventBufferWriter.length >= sizeToBytes( config->apiRequestSize ) )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Buffered events reached api_request_size - flushing; length: %" PRIu64, (UInt64) g_eventBufferWriter.length );
+        // The event is already appended so it must not be reported as not appended (the caller would send it again)
+        if ( eventBuffer_flush( config ) != resultSuccess )
+        {
+            ELASTIC_APM_LOG_ERROR( "Failed to flush buffered events that reached api_request_size" );
+        }
+    }
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+ResultCode eventBuffer_flush( const ConfigSnapshot* config )
+{
+    ResultCode resultCode;
+
+    if ( g_eventBufferEventsCount == 0 )
+    {
+        ELASTIC_APM_SET_RESULT_CODE_TO_SUCCESS_AND_GOTO_FINALLY();
+    }
+
+    ELASTIC_APM_LOG_DEBUG( "Flushing buffered events; count: %" PRIu64 "; length: %" PRIu64, (UInt64) g_eventBufferEventsCount, (UInt64) g_eventBufferWriter.length );
+
+    // Events are dropped (and counted as dropped by backend comm) if they could not be sent so the buffer is cleared in any case
+    resultCode = sendEventsToApmServer( config, jsonWriter_getText( &g_eventBufferUserAgentHttpHeader ), jsonWriter_getText( &g_eventBufferWriter ) );
+    clearEventBuffer();
+    if ( resultCode != resultSuccess )
+    {
+        goto failure;
+    }
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+void eventBuffer_discard()
+{
+    clearEventBuffer();
+}
+
+void eventBuffer_free()
+{
+    jsonWriter_free( &g_eventBufferWriter );
+    jsonWriter_free( &g_eventBufferUserAgentHttpHeader );
+    g_eventBufferMetadataLineLength = 0;
+    g_eventBufferEventsCount = 0;
+}
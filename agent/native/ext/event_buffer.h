@@ -0,0 +1,56 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#pragma once
+
+#include <php.h>
+#include "StringView.h"
+#include "ConfigSnapshot_forward_decl.h"
+#include "ResultCode.h"
+
+/**
+ * Per-request buffer events are serialized to as soon as they are finished.
+ * Instead of passing each event to APM Server as a separate batch (metadata line plus one event)
+ * events are accumulated in native memory and the whole buffer is passed to sendEventsToApmServer as one batch
+ * when it's flushed (PHP part flushes it when the transaction ends), when it reaches api_request_size or at request shutdown.
+ * Serialized events are never copied to PHP heap.
+ *
+ * The buffer is accessed only by the thread handling the request.
+ */
+
+/**
+ * If the buffer already has events with different metadata or User-Agent HTTP header it's flushed first.
+ *
+ * @param eventType should be one of span, error, metricset or transaction
+ *
+ * Fails (leaving the buffer as it was) if the event could not be serialized
+ * so the caller can fall back on serializing it in PHP (which reports the reason).
+ * Failure to flush the buffer (either before or after appending) is only logged since the event itself is buffered.
+ */
+ResultCode eventBuffer_append( const ConfigSnapshot* config, StringView eventType, zval* event, StringView serializedMetadata, StringView userAgentHttpHeader );
+
+ResultCode eventBuffer_flush( const ConfigSnapshot* config );
+
+/**
+ * Forked child should not send events buffered by the parent process
+ */
+void eventBuffer_discard();
+
+void eventBuffer_free();
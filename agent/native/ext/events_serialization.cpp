@@ -0,0 +1,376 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "events_serialization.h"
+#include <zend_exceptions.h>
+#include <php_globals.h>
+#include "basic_macros.h"
+#include "log.h"
+#include "util.h"
+#include "util_for_PHP.h"
+
+#define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_BACKEND_COMM
+
+// The same as json_encode()'s default depth
+enum { maxEventNestingDepth = 512 };
+
+struct EventsSerializer
+{
+    JsonWriter* writer;
+    zend_class_entry* jsonSerializableClass;
+    zval jsonSerializeMethodName;
+};
+typedef struct EventsSerializer EventsSerializer;
+
+static ResultCode serializeValue( EventsSerializer* serializer, zval* value, int depth );
+
+/**
+ * The same criteria as json_encode() uses to decide whether array is written as JSON array or as JSON object
+ */
+static
+bool isZarrayList( zend_array* zArray )
+{
+    zend_string* key;
+    zend_ulong index;
+    zend_ulong expectedIndex = 0;
+
+    ZEND_HASH_FOREACH_KEY( zArray, index, key )
+    {
+        if ( key != NULL || index != expectedIndex )
+        {
+            return false;
+        }
+        ++expectedIndex;
+    }
+    ZEND_HASH_FOREACH_END();
+
+    return true;
+}
+
+/**
+ * @param isObjectProperties true if members are object's properties - then protected and private properties (the ones with mangled names) are skipped
+ */
+static
+ResultCode serializeMembers( EventsSerializer* serializer, zend_array* members, bool isObjectProperties, int depth )
+{
+    ResultCode resultCode;
+    JsonWriter* writer = serializer->writer;
+    bool isList = ( ! isObjectProperties ) && isZarrayList( members );
+    bool isFirstMember = true;
+    zend_string* key;
+    zend_ulong index;
+    zval* member;
+
+    if ( depth >= maxEventNestingDepth )
+    {
+        ELASTIC_APM_LOG_ERROR( "Maximum nesting depth exceeded; maxEventNestingDepth: %d", (int) maxEventNestingDepth );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    jsonWriter_appendChar( writer, isList ? '[' : '{' );
+    ZEND_HASH_FOREACH_KEY_VAL_IND( members, index, key, member )
+    {
+        if ( isObjectProperties && key != NULL && ZSTR_LEN( key ) != 0 && ZSTR_VAL( key )[ 0 ] == '\0' )
+        {
+            continue;
+        }
+
+        if ( ! isFirstMember )
+        {
+            jsonWriter_appendChar( writer, ',' );
+        }
+        isFirstMember = false;
+
+        if ( ! isList )
+        {
+            if ( key == NULL )
+            {
+                jsonWriter_appendChar( writer, '"' );
+                jsonWriter_appendInt( writer, (Int64) index );
+                jsonWriter_appendChar( writer, '"' );
+            }
+            else
+            {
+                jsonWriter_appendString( writer, zStringToStringView( key ) );
+            }
+            jsonWriter_appendChar( writer, ':' );
+        }
+
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( serializeValue( serializer, member, depth + 1 ) );
+    }
+    ZEND_HASH_FOREACH_END();
+    jsonWriter_appendChar( writer, isList ? ']' : '}' );
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+static
+ResultCode serializeObjectProperties( EventsSerializer* serializer, zval* object, int depth )
+{
+    ResultCode resultCode;
+
+#if PHP_VERSION_ID >= ELASTIC_APM_BUILD_PHP_VERSION_ID( 7, 4, 0 ) /* if PHP version from 7.4.0 */
+    zend_array* properties = zend_get_properties_for( object, ZEND_PROP_PURPOSE_JSON );
+#else
+    zend_array* properties = Z_OBJPROP_P( object );
+#endif
+
+    if ( properties == NULL )
+    {
+        jsonWriter_appendRaw( serializer->writer, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "{}" ) );
+        return resultSuccess;
+    }
+
+    resultCode = serializeMembers( serializer, properties, /* isObjectProperties */ true, depth );
+
+#if PHP_VERSION_ID >= ELASTIC_APM_BUILD_PHP_VERSION_ID( 7, 4, 0 ) /* if PHP version from 7.4.0 */
+    zend_release_properties( properties );
+#endif
+
+    return resultCode;
+}
+
+static
+ResultCode serializeObject( EventsSerializer* serializer, zval* object, int depth )
+{
+    ResultCode resultCode;
+    zend_class_entry* objectClass = Z_OBJCE_P( object );
+    zval jsonSerializeRetVal;
+    ZVAL_UNDEF( &jsonSerializeRetVal );
+
+#if PHP_VERSION_ID >= ELASTIC_APM_BUILD_PHP_VERSION_ID( 8, 1, 0 ) /* if PHP version from 8.1.0 */
+    if ( ( objectClass->ce_flags & ZEND_ACC_ENUM ) != 0 )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Enums are not supported; class: %s", ZSTR_VAL( objectClass->name ) );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+#endif
+
+    if ( serializer->jsonSerializableClass == NULL || ! instanceof_function( objectClass, serializer->jsonSerializableClass ) )
+    {
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( serializeObjectProperties( serializer, object, depth ) );
+        ELASTIC_APM_SET_RESULT_CODE_TO_SUCCESS_AND_GOTO_FINALLY();
+    }
+
+    if ( call_user_function( /* function_table: */ NULL, object, &serializer->jsonSerializeMethodName, /* out */ &jsonSerializeRetVal, /* param_count: */ 0, /* params: */ NULL ) != SUCCESS
+         || EG( exception ) != NULL )
+    {
+        ELASTIC_APM_LOG_ERROR( "Call to jsonSerialize() failed; class: %s", ZSTR_VAL( objectClass->name ) );
+        // Exception is thrown again when the events are serialized by the PHP part of the agent which then reports it
+        zend_clear_exception();
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    // The same as json_encode() - if jsonSerialize() returns the object itself its properties are written
+    if ( Z_TYPE( jsonSerializeRetVal ) == IS_OBJECT && Z_OBJ( jsonSerializeRetVal ) == Z_OBJ_P( object ) )
+    {
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( serializeObjectProperties( serializer, object, depth ) );
+    }
+    else
+    {
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( serializeValue( serializer, &jsonSerializeRetVal, depth ) );
+    }
+
+    resultCode = resultSuccess;
+    finally:
+    zval_ptr_dtor( &jsonSerializeRetVal );
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+static
+ResultCode serializeDouble( EventsSerializer* serializer, double value )
+{
+    // The same format as json_encode() uses (see php_json_encode_double())
+    char buffer[ 64 ];
+
+    if ( ! zend_finite( value ) )
+    {
+        ELASTIC_APM_LOG_DEBUG( "INF and NAN cannot be serialized as JSON" );
+        return resultFailure;
+    }
+
+    php_gcvt( value, (int) PG( serialize_precision ), '.', 'e', buffer );
+    jsonWriter_appendRaw( serializer->writer, makeStringViewFromString( buffer ) );
+    return resultSuccess;
+}
+
+static
+ResultCode serializeValue( EventsSerializer* serializer, zval* value, int depth )
+{
+    ZVAL_DEREF( value );
+    switch ( Z_TYPE_P( value ) )
+    {
+        case IS_NULL:
+            jsonWriter_appendRaw( serializer->writer, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "null" ) );
+            return resultSuccess;
+
+        case IS_FALSE:
+            jsonWriter_appendRaw( serializer->writer, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "false" ) );
+            return resultSuccess;
+
+        case IS_TRUE:
+            jsonWriter_appendRaw( serializer->writer, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "true" ) );
+            return resultSuccess;
+
+        case IS_LONG:
+            jsonWriter_appendInt( serializer->writer, (Int64) Z_LVAL_P( value ) );
+            return resultSuccess;
+
+        case IS_DOUBLE:
+            return serializeDouble( serializer, Z_DVAL_P( value ) );
+
+        case IS_STRING:
+            jsonWriter_appendString( serializer->writer, zStringToStringView( Z_STR_P( value ) ) );
+            return resultSuccess;
+
+        case IS_ARRAY:
+            return serializeMembers( serializer, Z_ARRVAL_P( value ), /* isObjectProperties */ false, depth );
+
+        case IS_OBJECT:
+            return serializeObject( serializer, value, depth );
+
+        default:
+            ELASTIC_APM_LOG_DEBUG( "Value type is not supported; type: %d", (int) Z_TYPE_P( value ) );
+            return resultFailure;
+    }
+}
+
+static
+ResultCode serializeEvent( EventsSerializer* serializer, StringView eventLinePrefix, zval* event )
+{
+    ResultCode resultCode;
+
+    jsonWriter_appendRaw( serializer->writer, eventLinePrefix );
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( serializeValue( serializer, event, /* depth */ 0 ) );
+    jsonWriter_appendChar( serializer->writer, '}' );
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+static
+ResultCode serializeEventsOfType( EventsSerializer* serializer, StringView eventLinePrefix, zend_array* events )
+{
+    ResultCode resultCode;
+    zval* event;
+
+    ZEND_HASH_FOREACH_VAL( events, event )
+    {
+        jsonWriter_appendChar( serializer->writer, '\n' );
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( serializeEvent( serializer, eventLinePrefix, event ) );
+    }
+    ZEND_HASH_FOREACH_END();
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+static
+void initEventsSerializer( EventsSerializer* serializer, JsonWriter* writer )
+{
+    serializer->writer = writer;
+    serializer->jsonSerializableClass = (zend_class_entry*) zend_hash_str_find_ptr( CG( class_table ), ZEND_STRL( "jsonserializable" ) );
+    ZVAL_STRINGL( &serializer->jsonSerializeMethodName, "jsonSerialize", sizeof( "jsonSerialize" ) - 1 );
+}
+
+static
+void destructEventsSerializer( EventsSerializer* serializer )
+{
+    zval_ptr_dtor( &serializer->jsonSerializeMethodName );
+}
+
+ResultCode serializeEvents( StringView serializedMetadata, zend_array* spans, zend_array* errors, zend_array* metricSets, zval* transaction, /* out */ JsonWriter* writer )
+{
+    ResultCode resultCode;
+    EventsSerializer serializer;
+    initEventsSerializer( &serializer, writer );
+
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY_MSG( "number of spans: %u, errors: %u, metric sets: %u, transaction: %s"
+                                              , zend_hash_num_elements( spans ), zend_hash_num_elements( errors ), zend_hash_num_elements( metricSets )
+                                              , transaction == NULL ? "no" : "yes" );
+
+    jsonWriter_appendRaw( writer, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "{\"metadata\":" ) );
+    jsonWriter_appendRaw( writer, serializedMetadata );
+    jsonWriter_appendChar( writer, '}' );
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( serializeEventsOfType( &serializer, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "{\"span\":" ), spans ) );
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( serializeEventsOfType( &serializer, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "{\"error\":" ), errors ) );
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( serializeEventsOfType( &serializer, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "{\"metricset\":" ), metricSets ) );
+    if ( transaction != NULL )
+    {
+        jsonWriter_appendChar( writer, '\n' );
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( serializeEvent( &serializer, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "{\"transaction\":" ), transaction ) );
+    }
+
+    if ( writer->isOutOfMemory )
+    {
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE_EX( resultOutOfMemory );
+    }
+
+    resultCode = resultSuccess;
+    finally:
+    destructEventsSerializer( &serializer );
+    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT_MSG( "serialized events length: %" PRIu64, (UInt64) writer->length );
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+ResultCode serializeEventOfType( StringView eventType, zval* event, /* out */ JsonWriter* writer )
+{
+    ResultCode resultCode;
+    EventsSerializer serializer;
+    initEventsSerializer( &serializer, writer );
+
+    jsonWriter_appendRaw( writer, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "{\"" ) );
+    jsonWriter_appendRaw( writer, eventType );
+    jsonWriter_appendRaw( writer, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "\":" ) );
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( serializeValue( &serializer, event, /* depth */ 0 ) );
+    jsonWriter_appendChar( writer, '}' );
+
+    if ( writer->isOutOfMemory )
+    {
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE_EX( resultOutOfMemory );
+    }
+
+    resultCode = resultSuccess;
+    finally:
+    destructEventsSerializer( &serializer );
+    return resultCode;
+
+    failure:
+    goto finally;
+}
@@ -0,0 +1,45 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#pragma once
+
+#include <php.h>
+#include "ResultCode.h"
+#include "json_writer.h"
+
+/**
+ * Writes events in NDJSON format expected by APM Server intake API - one event per line (metadata is the first line).
+ * The output is the same as the PHP part of the agent produces by passing each event to json_encode() with JSON_INVALID_UTF8_SUBSTITUTE
+ * but values are written directly to the native buffer without intermediate PHP strings.
+ * Objects implementing JsonSerializable are written using the value returned by their jsonSerialize() method.
+ *
+ * @param serializedMetadata is metadata already serialized as JSON (it's cached for the process lifetime - see metadata_cache.h)
+ * @param transaction can be NULL
+ *
+ * Fails for anything json_encode() would fail for (for example float INF or NAN, resource or too deeply nested value)
+ * so the caller can fall back on json_encode() that reports the reason.
+ */
+ResultCode serializeEvents( StringView serializedMetadata, zend_array* spans, zend_array* errors, zend_array* metricSets, zval* transaction, /* out */ JsonWriter* writer );
+
+/**
+ * Writes one event line (without line separator) - for example {"span":{...}} for eventType span.
+ * On failure the event might be partially written so the caller should discard the text written by this call.
+ */
+ResultCode serializeEventOfType( StringView eventType, zval* event, /* out */ JsonWriter* writer );
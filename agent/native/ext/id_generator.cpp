@@ -0,0 +1,193 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "id_generator.h"
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined( __SSE2__ )
+#   include <emmintrin.h>
+#endif
+#include "elastic_apm_assert.h"
+#include "log.h"
+#include "platform.h"
+
+#define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_UTIL
+
+struct IdGeneratorState
+{
+    bool isSeeded;
+    UInt64 s[ 4 ];
+};
+typedef struct IdGeneratorState IdGeneratorState;
+
+static IdGeneratorState g_idGeneratorState = { .isSeeded = false, .s = { 0, 0, 0, 0 } };
+
+static inline
+UInt64 rotateLeft( UInt64 x, int k )
+{
+    return ( x << k ) | ( x >> ( 64 - k ) );
+}
+
+/**
+ * Used to scramble seed before it's used as generator's state (xoshiro256** state should not be all zeros)
+ */
+static inline
+UInt64 splitMix64Next( UInt64* x )
+{
+    UInt64 z = ( *x += 0x9E3779B97F4A7C15ULL );
+    z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+    z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+    return z ^ ( z >> 31 );
+}
+
+static
+bool readSeedFromUrandom( /* out */ UInt64 seed[ 4 ] )
+{
+    int fd = open( "/dev/urandom", O_RDONLY | O_CLOEXEC );
+    if ( fd < 0 )
+    {
+        return false;
+    }
+
+    size_t readSoFar = 0;
+    while ( readSoFar < sizeof( UInt64 ) * 4 )
+    {
+        ssize_t readRetVal = read( fd, ( (Byte*) seed ) + readSoFar, sizeof( UInt64 ) * 4 - readSoFar );
+        if ( readRetVal <= 0 )
+        {
+            break;
+        }
+        readSoFar += (size_t) readRetVal;
+    }
+    close( fd );
+
+    return readSoFar == sizeof( UInt64 ) * 4;
+}
+
+static
+void seedIdGenerator( IdGeneratorState* state )
+{
+    UInt64 seed[ 4 ] = { 0, 0, 0, 0 };
+    if ( ! readSeedFromUrandom( /* out */ seed ) )
+    {
+        struct timespec currentTime;
+        clock_gettime( CLOCK_REALTIME, &currentTime );
+        ELASTIC_APM_LOG_WARNING( "Failed to read seed from /dev/urandom - using current time and process ID instead" );
+        seed[ 0 ] = (UInt64) currentTime.tv_sec;
+        seed[ 1 ] = (UInt64) currentTime.tv_nsec;
+        seed[ 2 ] = (UInt64) (uintptr_t) &currentTime;
+    }
+    // Process ID is mixed in so that processes forked at the same time get different sequences even if /dev/urandom is not available
+    seed[ 3 ] ^= (UInt64) getCurrentProcessId();
+
+    ELASTIC_APM_FOR_EACH_INDEX( i, 4 )
+    {
+        UInt64 splitMixState = seed[ i ];
+        state->s[ i ] = splitMix64Next( &splitMixState );
+    }
+    state->isSeeded = true;
+}
+
+/**
+ * xoshiro256** by David Blackman and Sebastiano Vigna (public domain)
+ */
+static inline
+UInt64 idGeneratorNext( IdGeneratorState* state )
+{
+    UInt64* s = state->s;
+    const UInt64 result = rotateLeft( s[ 1 ] * 5, 7 ) * 9;
+    const UInt64 t = s[ 1 ] << 17;
+
+    s[ 2 ] ^= s[ 0 ];
+    s[ 3 ] ^= s[ 1 ];
+    s[ 1 ] ^= s[ 2 ];
+    s[ 0 ] ^= s[ 3 ];
+    s[ 2 ] ^= t;
+    s[ 3 ] = rotateLeft( s[ 3 ], 45 );
+
+    return result;
+}
+
+void idGenerator_generateBinaryId( size_t idSizeInBytes, /* out */ Byte* binaryId )
+{
+    if ( ! g_idGeneratorState.isSeeded )
+    {
+        seedIdGenerator( &g_idGeneratorState );
+    }
+
+    size_t generatedSoFar = 0;
+    while ( generatedSoFar < idSizeInBytes )
+    {
+        UInt64 randomBits = idGeneratorNext( &g_idGeneratorState );
+        size_t bytesToCopy = ( idSizeInBytes - generatedSoFar < sizeof( randomBits ) ) ? ( idSizeInBytes - generatedSoFar ) : sizeof( randomBits );
+        memcpy( binaryId + generatedSoFar, &randomBits, bytesToCopy );
+        generatedSoFar += bytesToCopy;
+    }
+}
+
+static const char lowerCaseHexDigits[] = "0123456789abcdef";
+
+void idGenerator_convertBinaryIdToHex( const Byte* binaryId, size_t binaryIdSize, /* out */ char* hexId )
+{
+    size_t i = 0;
+
+#if defined( __SSE2__ )
+    // 16 bytes at a time: split bytes to nibbles, interleave them (high nibble first) and map 0-9 to '0'-'9' and 10-15 to 'a'-'f'
+    const __m128i lowNibbleMask = _mm_set1_epi8( 0x0F );
+    const __m128i nine = _mm_set1_epi8( 9 );
+    const __m128i digitZero = _mm_set1_epi8( '0' );
+    const __m128i lettersOffset = _mm_set1_epi8( 'a' - '0' - 10 );
+    for ( ; i + 16 <= binaryIdSize; i += 16 )
+    {
+        __m128i bytes = _mm_loadu_si128( (const __m128i*) ( binaryId + i ) );
+        __m128i highNibbles = _mm_and_si128( _mm_srli_epi16( bytes, 4 ), lowNibbleMask );
+        __m128i lowNibbles = _mm_and_si128( bytes, lowNibbleMask );
+        __m128i nibbles[ 2 ] = { _mm_unpacklo_epi8( highNibbles, lowNibbles ), _mm_unpackhi_epi8( highNibbles, lowNibbles ) };
+        ELASTIC_APM_FOR_EACH_INDEX( half, 2 )
+        {
+            __m128i isLetter = _mm_cmpgt_epi8( nibbles[ half ], nine );
+            __m128i hexDigits = _mm_add_epi8( _mm_add_epi8( nibbles[ half ], digitZero ), _mm_and_si128( isLetter, lettersOffset ) );
+            _mm_storeu_si128( (__m128i*) ( hexId + 2 * i + 16 * half ), hexDigits );
+        }
+    }
+#endif
+
+    for ( ; i < binaryIdSize; ++i )
+    {
+        hexId[ 2 * i ] = lowerCaseHexDigits[ binaryId[ i ] >> 4 ];
+        hexId[ 2 * i + 1 ] = lowerCaseHexDigits[ binaryId[ i ] & 0x0F ];
+    }
+}
+
+void idGenerator_generateHexId( size_t idSizeInBytes, /* out */ char* hexId )
+{
+    ELASTIC_APM_ASSERT( idSizeInBytes <= maxGeneratedIdSizeInBytes, "idSizeInBytes: %" PRIu64, (UInt64) idSizeInBytes );
+
+    Byte binaryId[ maxGeneratedIdSizeInBytes ];
+    idGenerator_generateBinaryId( idSizeInBytes, /* out */ binaryId );
+    idGenerator_convertBinaryIdToHex( binaryId, idSizeInBytes, /* out */ hexId );
+}
+
+void idGenerator_resetInForkedChild()
+{
+    g_idGeneratorState.isSeeded = false;
+}
@@ -0,0 +1,46 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#pragma once
+
+#include <stddef.h>
+#include "basic_types.h"
+
+/**
+ * Generates trace/span/transaction IDs.
+ * Uses per-process xoshiro256** pseudo-random generator seeded from /dev/urandom on first use
+ * (IDs need to be unique, not unpredictable, so there is no need for a cryptographically secure generator for each ID).
+ * Forked child reseeds the generator - otherwise it would generate the same IDs as its parent and its other children.
+ */
+enum { maxGeneratedIdSizeInBytes = 64 };
+
+void idGenerator_generateBinaryId( size_t idSizeInBytes, /* out */ Byte* binaryId );
+
+/**
+ * Writes 2 * binaryIdSize lower case hex digits (without terminating '\0')
+ */
+void idGenerator_convertBinaryIdToHex( const Byte* binaryId, size_t binaryIdSize, /* out */ char* hexId );
+
+/**
+ * Writes 2 * idSizeInBytes lower case hex digits (without terminating '\0')
+ */
+void idGenerator_generateHexId( size_t idSizeInBytes, /* out */ char* hexId );
+
+void idGenerator_resetInForkedChild();
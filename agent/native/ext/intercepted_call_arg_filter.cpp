@@ -0,0 +1,249 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "intercepted_call_arg_filter.h"
+#include "log.h"
+#include "util.h"
+
+#define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_AUTO_INSTRUMENT
+
+const char* interceptedCallArgFilterKindNames[ numberOfInterceptedCallArgFilterKinds ] =
+{
+    [ interceptedCallArgFilterKind_type ] = "type",
+    [ interceptedCallArgFilterKind_intValueIn ] = "int_value_in",
+    [ interceptedCallArgFilterKind_stringPrefix ] = "string_prefix"
+};
+
+struct TypeNameToZvalType
+{
+    String typeName;
+    zend_uchar zvalType;
+};
+typedef struct TypeNameToZvalType TypeNameToZvalType;
+
+// Type names are the ones returned by gettype()
+static const TypeNameToZvalType g_typeNameToZvalType[] =
+{
+    { "NULL", IS_NULL },
+    { "boolean", _IS_BOOL },
+    { "integer", IS_LONG },
+    { "double", IS_DOUBLE },
+    { "string", IS_STRING },
+    { "array", IS_ARRAY },
+    { "object", IS_OBJECT },
+    { "resource", IS_RESOURCE }
+};
+
+static
+bool findInterceptedCallArgFilterKind( StringView kindName, /* out */ InterceptedCallArgFilterKind* kind )
+{
+    ELASTIC_APM_FOR_EACH_INDEX( i, numberOfInterceptedCallArgFilterKinds )
+    {
+        if ( areStringViewsEqual( kindName, stringToView( interceptedCallArgFilterKindNames[ i ] ) ) )
+        {
+            *kind = (InterceptedCallArgFilterKind) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static
+bool findZvalTypeByName( StringView typeName, /* out */ zend_uchar* zvalType )
+{
+    ELASTIC_APM_FOR_EACH_INDEX( i, ELASTIC_APM_STATIC_ARRAY_SIZE( g_typeNameToZvalType ) )
+    {
+        if ( areStringViewsEqual( typeName, stringToView( g_typeNameToZvalType[ i ].typeName ) ) )
+        {
+            *zvalType = g_typeNameToZvalType[ i ].zvalType;
+            return true;
+        }
+    }
+    return false;
+}
+
+static
+ResultCode addValueToInterceptedCallArgFilter( zval* value, /* in,out */ InterceptedCallArgFilter* filter )
+{
+    ResultCode resultCode;
+    zend_uchar zvalType;
+
+    switch ( filter->kind )
+    {
+        case interceptedCallArgFilterKind_type:
+            if ( Z_TYPE_P( value ) != IS_STRING || ! findZvalTypeByName( makeStringView( Z_STRVAL_P( value ), Z_STRLEN_P( value ) ), /* out */ &zvalType ) )
+            {
+                ELASTIC_APM_LOG_ERROR( "Value for filter kind `%s' should be type name as returned by gettype()", interceptedCallArgFilterKindNames[ filter->kind ] );
+                ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+            }
+            filter->values[ filter->valuesCount++ ] = zvalType;
+            break;
+
+        case interceptedCallArgFilterKind_intValueIn:
+            if ( Z_TYPE_P( value ) != IS_LONG )
+            {
+                ELASTIC_APM_LOG_ERROR( "Value for filter kind `%s' should be int; type: %u", interceptedCallArgFilterKindNames[ filter->kind ], (UInt) Z_TYPE_P( value ) );
+                ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+            }
+            filter->values[ filter->valuesCount++ ] = Z_LVAL_P( value );
+            break;
+
+        case interceptedCallArgFilterKind_stringPrefix:
+            if ( Z_TYPE_P( value ) != IS_STRING || Z_STRLEN_P( value ) > maxInterceptedCallArgFilterStringPrefixLength )
+            {
+                ELASTIC_APM_LOG_ERROR( "Value for filter kind `%s' should be string not longer than %u"
+                                       , interceptedCallArgFilterKindNames[ filter->kind ], (UInt) maxInterceptedCallArgFilterStringPrefixLength );
+                ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+            }
+            filter->stringPrefixes[ filter->valuesCount ].length = (uint32_t) Z_STRLEN_P( value );
+            memcpy( filter->stringPrefixes[ filter->valuesCount ].chars, Z_STRVAL_P( value ), Z_STRLEN_P( value ) );
+            ++filter->valuesCount;
+            break;
+
+        default:
+            ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+ResultCode interceptedCallArgFilter_build( uint32_t argIndex, StringView kindName, zend_array* values, /* out */ InterceptedCallArgFilter* filter )
+{
+    ResultCode resultCode;
+    uint32_t maxValuesCount;
+    zval* value;
+    *filter = makeDisabledInterceptedCallArgFilter();
+
+    if ( ! findInterceptedCallArgFilterKind( kindName, /* out */ &( filter->kind ) ) )
+    {
+        ELASTIC_APM_LOG_ERROR( "Unknown filter kind: `%.*s'", (int) kindName.length, kindName.begin );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    maxValuesCount = ( filter->kind == interceptedCallArgFilterKind_stringPrefix ) ? (uint32_t) maxInterceptedCallArgFilterStringPrefixesCount : (uint32_t) maxInterceptedCallArgFilterValuesCount;
+    if ( zend_hash_num_elements( values ) == 0 || zend_hash_num_elements( values ) > maxValuesCount )
+    {
+        ELASTIC_APM_LOG_ERROR( "Number of values for filter kind `%s' should be between 1 and %u; actual: %u"
+                               , interceptedCallArgFilterKindNames[ filter->kind ], maxValuesCount, zend_hash_num_elements( values ) );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    ZEND_HASH_FOREACH_VAL( values, value )
+    {
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( addValueToInterceptedCallArgFilter( value, /* in,out */ filter ) );
+    }
+    ZEND_HASH_FOREACH_END();
+
+    filter->argIndex = argIndex;
+    filter->isEnabled = true;
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    *filter = makeDisabledInterceptedCallArgFilter();
+    goto finally;
+}
+
+static
+bool doesArgTypeMatch( const InterceptedCallArgFilter* filter, const zval* arg )
+{
+    const zend_uchar argType = ( Z_TYPE_P( arg ) == IS_TRUE || Z_TYPE_P( arg ) == IS_FALSE ) ? _IS_BOOL : Z_TYPE_P( arg );
+    ELASTIC_APM_FOR_EACH_INDEX( i, filter->valuesCount )
+    {
+        if ( filter->values[ i ] == argType )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static
+bool doesArgIntValueMatch( const InterceptedCallArgFilter* filter, const zval* arg )
+{
+    if ( Z_TYPE_P( arg ) != IS_LONG )
+    {
+        return false;
+    }
+
+    ELASTIC_APM_FOR_EACH_INDEX( i, filter->valuesCount )
+    {
+        if ( filter->values[ i ] == Z_LVAL_P( arg ) )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static
+bool doesArgStringPrefixMatch( const InterceptedCallArgFilter* filter, const zval* arg )
+{
+    if ( Z_TYPE_P( arg ) != IS_STRING )
+    {
+        return false;
+    }
+
+    const StringView argAsStringView = makeStringView( Z_STRVAL_P( arg ), Z_STRLEN_P( arg ) );
+    ELASTIC_APM_FOR_EACH_INDEX( i, filter->valuesCount )
+    {
+        const InterceptedCallArgFilterStringPrefix* prefix = &( filter->stringPrefixes[ i ] );
+        if ( isStringViewPrefix( argAsStringView, makeStringView( prefix->chars, prefix->length ), /* shouldIgnoreCase */ false ) )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool interceptedCallArgFilter_matches( const InterceptedCallArgFilter* filter, zend_execute_data* execute_data )
+{
+    if ( ! filter->isEnabled )
+    {
+        return true;
+    }
+
+    zval nullArg;
+    ZVAL_NULL( &nullArg );
+    zval* arg = ( filter->argIndex < ZEND_CALL_NUM_ARGS( execute_data ) ) ? ZEND_CALL_ARG( execute_data, filter->argIndex + 1 ) : &nullArg;
+    ZVAL_DEREF( arg );
+
+    switch ( filter->kind )
+    {
+        case interceptedCallArgFilterKind_type:
+            return doesArgTypeMatch( filter, arg );
+
+        case interceptedCallArgFilterKind_intValueIn:
+            return doesArgIntValueMatch( filter, arg );
+
+        case interceptedCallArgFilterKind_stringPrefix:
+            return doesArgStringPrefixMatch( filter, arg );
+
+        default:
+            return true;
+    }
+}
@@ -0,0 +1,92 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <php.h>
+#include "basic_types.h"
+#include "ResultCode.h"
+#include "StringView.h"
+
+/**
+ * Registration can ask the extension to call PHP part's pre-hook only for calls with an argument matching a cheap predicate
+ * - the rest of the calls go directly to the original function without copying the arguments and calling into PHP.
+ * For example curl_setopt is relevant only for a few options.
+ *
+ * Predicate kinds:
+ *      type            - the argument's type is one of the given types (names as returned by gettype())
+ *      int_value_in    - the argument is int equal to one of the given values
+ *      string_prefix   - the argument is string starting with one of the given prefixes
+ *
+ * Argument that was not passed is treated as null.
+ */
+enum InterceptedCallArgFilterKind
+{
+    interceptedCallArgFilterKind_type,
+    interceptedCallArgFilterKind_intValueIn,
+    interceptedCallArgFilterKind_stringPrefix,
+
+    numberOfInterceptedCallArgFilterKinds
+};
+typedef enum InterceptedCallArgFilterKind InterceptedCallArgFilterKind;
+
+extern const char* interceptedCallArgFilterKindNames[ numberOfInterceptedCallArgFilterKinds ];
+
+enum { maxInterceptedCallArgFilterValuesCount = 16 };
+enum { maxInterceptedCallArgFilterStringPrefixesCount = 4 };
+enum { maxInterceptedCallArgFilterStringPrefixLength = 32 };
+
+struct InterceptedCallArgFilterStringPrefix
+{
+    uint32_t length;
+    char chars[ maxInterceptedCallArgFilterStringPrefixLength ];
+};
+typedef struct InterceptedCallArgFilterStringPrefix InterceptedCallArgFilterStringPrefix;
+
+struct InterceptedCallArgFilter
+{
+    bool isEnabled;
+    InterceptedCallArgFilterKind kind;
+    uint32_t argIndex;
+    uint32_t valuesCount;
+    // zval types for interceptedCallArgFilterKind_type and int values for interceptedCallArgFilterKind_intValueIn
+    zend_long values[ maxInterceptedCallArgFilterValuesCount ];
+    InterceptedCallArgFilterStringPrefix stringPrefixes[ maxInterceptedCallArgFilterStringPrefixesCount ];
+};
+typedef struct InterceptedCallArgFilter InterceptedCallArgFilter;
+
+static inline
+InterceptedCallArgFilter makeDisabledInterceptedCallArgFilter()
+{
+    InterceptedCallArgFilter result = { 0 };
+    result.isEnabled = false;
+    return result;
+}
+
+/**
+ * Builds enabled filter from the arguments passed to elastic_apm_set_intercepted_call_arg_filter()
+ */
+ResultCode interceptedCallArgFilter_build( uint32_t argIndex, StringView kindName, zend_array* values, /* out */ InterceptedCallArgFilter* filter );
+
+/**
+ * Disabled filter matches any call
+ */
+bool interceptedCallArgFilter_matches( const InterceptedCallArgFilter* filter, zend_execute_data* execute_data );
@@ -0,0 +1,375 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "json_writer.h"
+#include <string.h>
+#if defined( __SSE2__ )
+#   include <emmintrin.h>
+#endif
+#include "elastic_apm_alloc.h"
+#include "log.h"
+#include "util.h"
+
+#define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_BACKEND_COMM
+
+enum { jsonWriterMinCapacity = 4 * 1024 };
+
+static const char lowerCaseHexDigits[] = "0123456789abcdef";
+
+ResultCode jsonWriter_reserve( JsonWriter* thisObj, size_t minCapacity )
+{
+    ResultCode resultCode;
+    char* newBuffer = NULL;
+    size_t newCapacity = ( thisObj->capacity < jsonWriterMinCapacity / 2 ) ? (size_t) jsonWriterMinCapacity : ( thisObj->capacity * 2 );
+
+    if ( thisObj->isOutOfMemory )
+    {
+        return resultOutOfMemory;
+    }
+    if ( minCapacity <= thisObj->capacity )
+    {
+        return resultSuccess;
+    }
+
+    if ( newCapacity < minCapacity )
+    {
+        newCapacity = minCapacity;
+    }
+    ELASTIC_APM_MALLOC_IF_FAILED_GOTO( char, newCapacity, /* out */ newBuffer );
+    if ( thisObj->length != 0 )
+    {
+        memcpy( newBuffer, thisObj->buffer, thisObj->length );
+    }
+    ELASTIC_APM_FREE_AND_SET_TO_NULL( char, thisObj->capacity, thisObj->buffer );
+    thisObj->buffer = newBuffer;
+    thisObj->capacity = newCapacity;
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    ELASTIC_APM_LOG_ERROR( "Failed to grow JSON writer buffer; current capacity: %" PRIu64 "; requested capacity: %" PRIu64, (UInt64) thisObj->capacity, (UInt64) newCapacity );
+    thisObj->isOutOfMemory = true;
+    goto finally;
+}
+
+static inline
+bool jsonWriter_ensureSpaceFor( JsonWriter* thisObj, size_t length )
+{
+    if ( thisObj->capacity - thisObj->length < length )
+    {
+        jsonWriter_reserve( thisObj, thisObj->length + length );
+    }
+    return ! thisObj->isOutOfMemory;
+}
+
+void jsonWriter_appendRaw( JsonWriter* thisObj, StringView text )
+{
+    if ( text.length == 0 || ! jsonWriter_ensureSpaceFor( thisObj, text.length ) )
+    {
+        return;
+    }
+
+    memcpy( thisObj->buffer + thisObj->length, text.begin, text.length );
+    thisObj->length += text.length;
+}
+
+void jsonWriter_appendChar( JsonWriter* thisObj, char c )
+{
+    if ( ! jsonWriter_ensureSpaceFor( thisObj, 1 ) )
+    {
+        return;
+    }
+
+    thisObj->buffer[ thisObj->length++ ] = c;
+}
+
+void jsonWriter_appendInt( JsonWriter* thisObj, Int64 value )
+{
+    // Enough for 20 digits of UInt64 and the sign
+    char digits[ 24 ];
+    size_t digitsBegin = ELASTIC_APM_STATIC_ARRAY_SIZE( digits );
+    UInt64 absValue = ( value < 0 ) ? ( ~( (UInt64) value ) + 1 ) : (UInt64) value;
+
+    do
+    {
+        digits[ --digitsBegin ] = (char) ( '0' + ( absValue % 10 ) );
+        absValue /= 10;
+    } while ( absValue != 0 );
+    if ( value < 0 )
+    {
+        digits[ --digitsBegin ] = '-';
+    }
+
+    jsonWriter_appendRaw( thisObj, makeStringView( digits + digitsBegin, ELASTIC_APM_STATIC_ARRAY_SIZE( digits ) - digitsBegin ) );
+}
+
+static inline
+bool isByteToEscapeInJsonString( unsigned char c )
+{
+    return c < 0x20 || c >= 0x80 || c == '"' || c == '\\' || c == '/';
+}
+
+size_t findFirstByteToEscapeInJsonString( StringView str )
+{
+    size_t i = 0;
+
+#if defined( __SSE2__ )
+    // Signed comparison with 0x20 catches both control characters and non-ASCII bytes (which are negative as signed)
+    const __m128i controlCharsUpperBound = _mm_set1_epi8( 0x20 );
+    const __m128i quote = _mm_set1_epi8( '"' );
+    const __m128i backslash = _mm_set1_epi8( '\\' );
+    const __m128i slash = _mm_set1_epi8( '/' );
+    for ( ; i + sizeof( __m128i ) <= str.length ; i += sizeof( __m128i ) )
+    {
+        __m128i chunk = _mm_loadu_si128( (const __m128i*) ( str.begin + i ) );
+        __m128i toEscape = _mm_or_si128( _mm_cmplt_epi8( chunk, controlCharsUpperBound )
+                                         , _mm_or_si128( _mm_cmpeq_epi8( chunk, quote )
+                                                         , _mm_or_si128( _mm_cmpeq_epi8( chunk, backslash ), _mm_cmpeq_epi8( chunk, slash ) ) ) );
+        int toEscapeMask = _mm_movemask_epi8( toEscape );
+        if ( toEscapeMask != 0 )
+        {
+            return i + (size_t) __builtin_ctz( (unsigned int) toEscapeMask );
+        }
+    }
+#endif
+
+    for ( ; i < str.length ; ++i )
+    {
+        if ( isByteToEscapeInJsonString( (unsigned char) str.begin[ i ] ) )
+        {
+            return i;
+        }
+    }
+    return str.length;
+}
+
+static inline
+bool isUtf8TrailByte( unsigned char c )
+{
+    return 0x80 <= c && c <= 0xBF;
+}
+
+static inline
+bool isUtf8LeadByte( unsigned char c )
+{
+    return c < 0x80 || ( 0xC2 <= c && c <= 0xF4 );
+}
+
+/**
+ * Decodes UTF-8 sequence the same way as php_next_utf8_char() does
+ * including the number of bytes skipped for an invalid sequence (which is substituted by a single U+FFFD)
+ *
+ * @return false if the sequence is invalid
+ */
+static
+bool decodeUtf8Char( const unsigned char* seq, size_t available, /* out */ UInt32* codePoint, /* out */ size_t* consumed )
+{
+    unsigned char c = seq[ 0 ];
+
+#   define ELASTIC_APM_INVALID_UTF8_SEQUENCE( bytesToSkip ) \
+        do { \
+            *consumed = (bytesToSkip); \
+            return false; \
+        } while ( 0 )
+
+    if ( c < 0x80 )
+    {
+        *codePoint = c;
+        *consumed = 1;
+        return true;
+    }
+
+    if ( c < 0xC2 )
+    {
+        ELASTIC_APM_INVALID_UTF8_SEQUENCE( 1 );
+    }
+
+    if ( c < 0xE0 )
+    {
+        if ( available < 2 )
+        {
+            ELASTIC_APM_INVALID_UTF8_SEQUENCE( 1 );
+        }
+        if ( ! isUtf8TrailByte( seq[ 1 ] ) )
+        {
+            ELASTIC_APM_INVALID_UTF8_SEQUENCE( isUtf8LeadByte( seq[ 1 ] ) ? 1 : 2 );
+        }
+        *codePoint = ( ( c & 0x1F ) << 6 ) | ( seq[ 1 ] & 0x3F );
+        *consumed = 2;
+        return true;
+    }
+
+    if ( c < 0xF0 )
+    {
+        if ( available < 3 || ! isUtf8TrailByte( seq[ 1 ] ) || ! isUtf8TrailByte( seq[ 2 ] ) )
+        {
+            if ( available < 2 || isUtf8LeadByte( seq[ 1 ] ) )
+            {
+                ELASTIC_APM_INVALID_UTF8_SEQUENCE( 1 );
+            }
+            ELASTIC_APM_INVALID_UTF8_SEQUENCE( ( available < 3 || isUtf8LeadByte( seq[ 2 ] ) ) ? 2 : 3 );
+        }
+        *codePoint = ( ( c & 0x0F ) << 12 ) | ( ( seq[ 1 ] & 0x3F ) << 6 ) | ( seq[ 2 ] & 0x3F );
+        // Overlong encoding or surrogate
+        if ( *codePoint < 0x800 || ( 0xD800 <= *codePoint && *codePoint <= 0xDFFF ) )
+        {
+            ELASTIC_APM_INVALID_UTF8_SEQUENCE( 3 );
+        }
+        *consumed = 3;
+        return true;
+    }
+
+    if ( c < 0xF5 )
+    {
+        if ( available < 4 || ! isUtf8TrailByte( seq[ 1 ] ) || ! isUtf8TrailByte( seq[ 2 ] ) || ! isUtf8TrailByte( seq[ 3 ] ) )
+        {
+            if ( available < 2 || isUtf8LeadByte( seq[ 1 ] ) )
+            {
+                ELASTIC_APM_INVALID_UTF8_SEQUENCE( 1 );
+            }
+            if ( available < 3 || isUtf8LeadByte( seq[ 2 ] ) )
+            {
+                ELASTIC_APM_INVALID_UTF8_SEQUENCE( 2 );
+            }
+            ELASTIC_APM_INVALID_UTF8_SEQUENCE( ( available < 4 || isUtf8LeadByte( seq[ 3 ] ) ) ? 3 : 4 );
+        }
+        *codePoint = ( ( c & 0x07 ) << 18 ) | ( ( seq[ 1 ] & 0x3F ) << 12 ) | ( ( seq[ 2 ] & 0x3F ) << 6 ) | ( seq[ 3 ] & 0x3F );
+        // Overlong encoding or beyond Unicode range
+        if ( *codePoint < 0x10000 || *codePoint > 0x10FFFF )
+        {
+            ELASTIC_APM_INVALID_UTF8_SEQUENCE( 4 );
+        }
+        *consumed = 4;
+        return true;
+    }
+
+    ELASTIC_APM_INVALID_UTF8_SEQUENCE( 1 );
+
+#   undef ELASTIC_APM_INVALID_UTF8_SEQUENCE
+}
+
+static
+void jsonWriter_appendUnicodeEscape( JsonWriter* thisObj, UInt32 utf16CodeUnit )
+{
+    char escape[] = { '\\', 'u'
+                      , lowerCaseHexDigits[ ( utf16CodeUnit >> 12 ) & 0xF ]
+                      , lowerCaseHexDigits[ ( utf16CodeUnit >> 8 ) & 0xF ]
+                      , lowerCaseHexDigits[ ( utf16CodeUnit >> 4 ) & 0xF ]
+                      , lowerCaseHexDigits[ utf16CodeUnit & 0xF ] };
+    jsonWriter_appendRaw( thisObj, makeStringView( escape, ELASTIC_APM_STATIC_ARRAY_SIZE( escape ) ) );
+}
+
+/**
+ * @return Number of bytes consumed from str
+ */
+static
+size_t jsonWriter_appendEscaped( JsonWriter* thisObj, const unsigned char* str, size_t available )
+{
+    UInt32 codePoint;
+    size_t consumed;
+
+    switch ( str[ 0 ] )
+    {
+        case '"':
+            jsonWriter_appendRaw( thisObj, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "\\\"" ) );
+            return 1;
+        case '\\':
+            jsonWriter_appendRaw( thisObj, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "\\\\" ) );
+            return 1;
+        case '/':
+            jsonWriter_appendRaw( thisObj, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "\\/" ) );
+            return 1;
+        case '\b':
+            jsonWriter_appendRaw( thisObj, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "\\b" ) );
+            return 1;
+        case '\f':
+            jsonWriter_appendRaw( thisObj, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "\\f" ) );
+            return 1;
+        case '\n':
+            jsonWriter_appendRaw( thisObj, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "\\n" ) );
+            return 1;
+        case '\r':
+            jsonWriter_appendRaw( thisObj, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "\\r" ) );
+            return 1;
+        case '\t':
+            jsonWriter_appendRaw( thisObj, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "\\t" ) );
+            return 1;
+        default:
+            break;
+    }
+
+    if ( ! decodeUtf8Char( str, available, /* out */ &codePoint, /* out */ &consumed ) )
+    {
+        // JSON_INVALID_UTF8_SUBSTITUTE
+        jsonWriter_appendRaw( thisObj, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "\\ufffd" ) );
+        return consumed;
+    }
+
+    // Code points outside of Basic Multilingual Plane are escaped as UTF-16 surrogate pair
+    if ( codePoint >= 0x10000 )
+    {
+        codePoint -= 0x10000;
+        jsonWriter_appendUnicodeEscape( thisObj, 0xD800 | ( codePoint >> 10 ) );
+        codePoint = 0xDC00 | ( codePoint & 0x3FF );
+    }
+    jsonWriter_appendUnicodeEscape( thisObj, codePoint );
+    return consumed;
+}
+
+void jsonWriter_appendString( JsonWriter* thisObj, StringView str )
+{
+    size_t pos = 0;
+
+    jsonWriter_appendChar( thisObj, '"' );
+    while ( pos < str.length )
+    {
+        StringView rest = makeStringView( str.begin + pos, str.length - pos );
+        size_t charsToCopyCount = findFirstByteToEscapeInJsonString( rest );
+        jsonWriter_appendRaw( thisObj, makeStringView( rest.begin, charsToCopyCount ) );
+        pos += charsToCopyCount;
+        if ( pos < str.length )
+        {
+            pos += jsonWriter_appendEscaped( thisObj, (const unsigned char*) ( str.begin + pos ), str.length - pos );
+        }
+    }
+    jsonWriter_appendChar( thisObj, '"' );
+}
+
+void jsonWriter_clear( JsonWriter* thisObj )
+{
+    thisObj->length = 0;
+    thisObj->isOutOfMemory = false;
+}
+
+void jsonWriter_truncate( JsonWriter* thisObj, size_t length )
+{
+    ELASTIC_APM_ASSERT( length <= thisObj->length, "length: %" PRIu64 ", thisObj->length: %" PRIu64, (UInt64) length, (UInt64) thisObj->length );
+
+    thisObj->length = length;
+    thisObj->isOutOfMemory = false;
+}
+
+void jsonWriter_free( JsonWriter* thisObj )
+{
+    ELASTIC_APM_FREE_AND_SET_TO_NULL( char, thisObj->capacity, thisObj->buffer );
+    *thisObj = ELASTIC_APM_DEFAULT_JSON_WRITER;
+}
@@ -0,0 +1,84 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "basic_types.h"
+#include "StringView.h"
+#include "ResultCode.h"
+
+/**
+ * Growable buffer JSON text is written to.
+ * Strings are escaped the same way as json_encode() with JSON_INVALID_UTF8_SUBSTITUTE (and without any other flags) escapes them
+ * so that the output is identical to the one produced by the PHP part of the agent.
+ *
+ * Allocation failure is sticky - appending after it does nothing and isOutOfMemory stays set until the writer is cleared
+ * so callers check it only once after the whole text is written.
+ */
+struct JsonWriter
+{
+    char* buffer;
+    size_t length;
+    size_t capacity;
+    bool isOutOfMemory;
+};
+typedef struct JsonWriter JsonWriter;
+
+#define ELASTIC_APM_DEFAULT_JSON_WRITER \
+    ((JsonWriter) \
+    { \
+        .buffer = NULL, \
+        .length = 0, \
+        .capacity = 0, \
+        .isOutOfMemory = false \
+    }) \
+    /**/
+
+ResultCode jsonWriter_reserve( JsonWriter* thisObj, size_t minCapacity );
+void jsonWriter_appendRaw( JsonWriter* thisObj, StringView text );
+void jsonWriter_appendChar( JsonWriter* thisObj, char c );
+
+/**
+ * Appends string as JSON string literal (i.e., quoted and escaped)
+ */
+void jsonWriter_appendString( JsonWriter* thisObj, StringView str );
+void jsonWriter_appendInt( JsonWriter* thisObj, Int64 value );
+
+static inline
+StringView jsonWriter_getText( const JsonWriter* thisObj )
+{
+    return makeStringView( thisObj->buffer, thisObj->length );
+}
+
+void jsonWriter_clear( JsonWriter* thisObj );
+
+/**
+ * Discards text written after the first length bytes (for example a partially written value) - it also resets out-of-memory state
+ */
+void jsonWriter_truncate( JsonWriter* thisObj, size_t length );
+void jsonWriter_free( JsonWriter* thisObj );
+
+/**
+ * @return Index of the first byte that cannot be copied to JSON string literal as is
+ *         (control character, '"', '\\', '/' or any non-ASCII byte) or str.length if there is no such byte
+ */
+size_t findFirstByteToEscapeInJsonString( StringView str );
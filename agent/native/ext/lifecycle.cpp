@@ -41,7 +41,12 @@
 #include "elastic_apm_API.h"
 #include "tracer_PHP_part.h"
 #include "backend_comm.h"
+#include "metadata_cache.h"
+#include "deferred_call_records.h"
+#include "event_buffer.h"
+#include "id_generator.h"
 #include "AST_instrumentation.h"
+#include "observer_instrumentation.h"
 #include "Hooking.h"
 #include "CommonUtils.h"
 #include "Diagnostics.h"
@@ -295,6 +300,10 @@ void elasticApmModuleInit( int moduleType, int moduleNumber )
     }
     tracer->curlInited = true;
 
+    backgroundBackendCommOnModuleInit( config );
+
+    // Has to be called before astInstrumentationOnModuleInit because zend_ast_process is not used when userland code is observed
+    observerInstrumentationOnModuleInit( config );
     astInstrumentationOnModuleInit( config );
 
     elasticapm::php::Hooking::getInstance().replaceHooks(config->captureErrors, config->captureErrorsWithPhpPart, config->profilingInferredSpansEnabled);
@@ -342,10 +351,13 @@ void elasticApmModuleShutdown( int moduleType, int moduleNumber )
 
     elasticapm::php::Hooking::getInstance().restoreOriginalHooks();
     astInstrumentationOnModuleShutdown();
+    resetCallInterceptionOnModuleShutdown();
 
     unregisterExceptionHooks();
 
+    eventBuffer_free();
     backgroundBackendCommOnModuleShutdown( config );
+    metadataCache_clear();
 
     if ( tracer->curlInited )
     {
@@ -509,6 +521,9 @@ void elasticApmRequestInit()
     {
         astInstrumentationOnRequestInit( config );
     }
+    observerInstrumentationOnRequestInit();
+
+    backgroundBackendCommOnRequestInit( config );
 
     ELASTIC_APM_CALL_IF_FAILED_GOTO( tracerPhpPartOnRequestInit( config, &requestInitStartTime ) );
 
@@ -570,6 +585,40 @@ void elasticApmRequestInit()
 //             , timePointToEpochMicroseconds( currentTime ) );
 // }
 
+/**
+ * Events deferred by backend_comm_defer_sync_send are sent in post deactivate which PHP calls before SAPI deactivate
+ * so the request has to be finished the same way fastcgi_finish_request() does for the client not to wait for them.
+ */
+static
+void finishRequestBeforeSendingDeferredEvents()
+{
+    StringView finishRequestFuncNames[] =
+    {
+        ELASTIC_APM_STRING_LITERAL_TO_VIEW( "fastcgi_finish_request" ),
+        ELASTIC_APM_STRING_LITERAL_TO_VIEW( "litespeed_finish_request" )
+    };
+
+    ELASTIC_APM_FOR_EACH_INDEX( i, ELASTIC_APM_STATIC_ARRAY_SIZE( finishRequestFuncNames ) )
+    {
+        StringView funcName = finishRequestFuncNames[ i ];
+        if ( ! zend_hash_str_exists( EG( function_table ), funcName.begin, funcName.length ) )
+        {
+            continue;
+        }
+
+        // Return value is false if the request is already finished (for example by the application) which is fine
+        bool isFinished = false;
+        if ( callPhpFunctionRetBool( funcName, /* argsCount */ 0, /* args */ NULL, /* out */ &isFinished ) == resultSuccess )
+        {
+            ELASTIC_APM_LOG_DEBUG( "Finished the request before sending deferred events; funcName: %.*s, isFinished: %s"
+                                   , (int) funcName.length, funcName.begin, boolToString( isFinished ) );
+        }
+        return;
+    }
+
+    ELASTIC_APM_LOG_DEBUG( "SAPI does not support finishing the request early - the client waits for deferred events to be sent" );
+}
+
 void elasticApmRequestShutdown()
 {
     if (!ELASTICAPM_G(globals)->sapi_.isSupported()) {
@@ -608,7 +657,18 @@ void elasticApmRequestShutdown()
 
     ELASTICAPM_G(captureErrorsUsingNative) = false; // disabling error capturing on shutdown
 
+    observerInstrumentationOnRequestShutdown();
     tracerPhpPartOnRequestShutdown();
+    // PHP part takes the records when the transaction ends - these are records of a transaction that was not ended
+    deferredCallRecords_onRequestShutdown();
+
+    // PHP part flushes the buffer when the transaction ends - these are events of a transaction that was not ended
+    eventBuffer_flush( config );
+
+    if ( hasDeferredEventsToApmServer() )
+    {
+        finishRequestBeforeSendingDeferredEvents();
+    }
 
     // there is no guarantee that following code will be executed - in case of error on php side
 
@@ -643,6 +703,12 @@ int  elasticApmRequestPostDeactivate(void) {
 
     resetCallInterceptionOnRequestShutdown();
 
+    // Request shutdown already finished the request if SAPI supports it (see finishRequestBeforeSendingDeferredEvents)
+    if ( tracer->isInited )
+    {
+        sendDeferredEventsToApmServer( config );
+    }
+
     ELASTICAPM_G(lastErrorData).reset(nullptr);
     resetLastThrown();
 
@@ -681,6 +747,10 @@ ResultCode resetStateIfForkedChild( String dbgCalledFromFile, int dbgCalledFromL
                            "; old PID: %d; parent PID: %d"
                            , (int)lastDetectedCurrentProcessIdSaved, (int)(getParentProcessId()) );
     ELASTIC_APM_CALL_IF_FAILED_GOTO( resetBackgroundBackendCommStateInForkedChild() );
+    eventBuffer_discard();
+    idGenerator_resetInForkedChild();
+    // Metadata includes process ID
+    metadataCache_clear();
 
     resultCode = resultSuccess;
     finally:
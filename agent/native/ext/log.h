@@ -306,6 +306,7 @@ ResultCode resetLoggingStateInForkedChild();
 #define ELASTIC_APM_LOG_CATEGORY_BACKEND_COMM "Backend-Comm"
 #define ELASTIC_APM_LOG_CATEGORY_CONFIG "Configuration"
 #define ELASTIC_APM_LOG_CATEGORY_C_TO_PHP "C-to-PHP"
+#define ELASTIC_APM_LOG_CATEGORY_DISTRIBUTED_TRACING "Distributed-Tracing"
 #define ELASTIC_APM_LOG_CATEGORY_EXT_API "Ext-API"
 #define ELASTIC_APM_LOG_CATEGORY_EXT_INFRA "Ext-Infra"
 #define ELASTIC_APM_LOG_CATEGORY_LIFECYCLE "Lifecycle"
@@ -0,0 +1,85 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "metadata_cache.h"
+#include <string.h>
+#include "elastic_apm_alloc.h"
+#include "log.h"
+#include "util.h"
+
+#define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_BACKEND_COMM
+
+/**
+ * Key, serialized metadata and User-Agent HTTP header are stored one after another in a single buffer
+ */
+static char* g_metadataCacheBuffer = NULL;
+static StringView g_metadataCacheKey = { NULL, 0 };
+static StringView g_cachedSerializedMetadata = { NULL, 0 };
+static StringView g_cachedUserAgentHttpHeader = { NULL, 0 };
+
+ResultCode metadataCache_set( StringView key, StringView serializedMetadata, StringView userAgentHttpHeader )
+{
+    ResultCode resultCode;
+    char* buffer = NULL;
+    size_t bufferSize = key.length + serializedMetadata.length + userAgentHttpHeader.length;
+
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY_MSG( "key: %.*s, serializedMetadata length: %" PRIu64
+                                              , (int) key.length, key.begin, (UInt64) serializedMetadata.length );
+
+    metadataCache_clear();
+
+    ELASTIC_APM_MALLOC_IF_FAILED_GOTO( char, bufferSize == 0 ? 1 : bufferSize, /* out */ buffer );
+    memcpy( buffer, key.begin, key.length );
+    memcpy( buffer + key.length, serializedMetadata.begin, serializedMetadata.length );
+    memcpy( buffer + key.length + serializedMetadata.length, userAgentHttpHeader.begin, userAgentHttpHeader.length );
+
+    g_metadataCacheBuffer = buffer;
+    g_metadataCacheKey = makeStringView( buffer, key.length );
+    g_cachedSerializedMetadata = makeStringView( buffer + key.length, serializedMetadata.length );
+    g_cachedUserAgentHttpHeader = makeStringView( buffer + key.length + serializedMetadata.length, userAgentHttpHeader.length );
+
+    resultCode = resultSuccess;
+    finally:
+    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT();
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+bool metadataCache_get( StringView key, /* out */ StringView* serializedMetadata, /* out */ StringView* userAgentHttpHeader )
+{
+    if ( g_metadataCacheBuffer == NULL || ! areStringViewsEqual( g_metadataCacheKey, key ) )
+    {
+        return false;
+    }
+
+    *serializedMetadata = g_cachedSerializedMetadata;
+    *userAgentHttpHeader = g_cachedUserAgentHttpHeader;
+    return true;
+}
+
+void metadataCache_clear()
+{
+    ELASTIC_APM_FREE_AND_SET_TO_NULL( char, /* requestedSizeInBytes */ 0, g_metadataCacheBuffer );
+    g_metadataCacheKey = makeStringView( NULL, 0 );
+    g_cachedSerializedMetadata = makeStringView( NULL, 0 );
+    g_cachedUserAgentHttpHeader = makeStringView( NULL, 0 );
+}
@@ -0,0 +1,45 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#pragma once
+
+#include <stdbool.h>
+#include "basic_types.h"
+#include "StringView.h"
+#include "ResultCode.h"
+
+/**
+ * Serialized metadata (the first line of each batch of events sent to APM Server) and User-Agent HTTP header
+ * do not change during the process lifetime unless configuration changes so they are cached per process.
+ *
+ * The key is provided by the PHP part of the agent and covers everything metadata is built from
+ * except the values that are the same for the whole process (process ID, hostname, container ID, etc.).
+ * The cache is cleared when configuration changes and in forked child because metadata includes process ID.
+ */
+ResultCode metadataCache_set( StringView key, StringView serializedMetadata, StringView userAgentHttpHeader );
+
+/**
+ * Returned views are valid until the next call to metadataCache_set or metadataCache_clear
+ *
+ * @return false if there is no cached metadata for the key
+ */
+bool metadataCache_get( StringView key, /* out */ StringView* serializedMetadata, /* out */ StringView* userAgentHttpHeader );
+
+void metadataCache_clear();
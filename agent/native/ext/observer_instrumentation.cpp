@@ -0,0 +1,442 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "observer_instrumentation.h"
+#include <php_version.h>
+#include <zend_API.h>
+#include "ConfigSnapshot.h"
+#include "ConfigManager.h"
+#include "WordPress_instrumentation.h"
+#include "basic_macros.h"
+#include "deferred_call_records.h"
+#include "elastic_apm_API.h"
+#include "lifecycle.h"
+#include "log.h"
+#include "tracer_PHP_part.h"
+#if PHP_VERSION_ID >= ELASTIC_APM_BUILD_PHP_VERSION_ID( 8, 0, 0 ) /* if PHP version from 8.0.0 */
+#   include <zend_observer.h>
+#endif
+
+#define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_AUTO_INSTRUMENT
+
+static bool g_isObservingInternalFunctions = false;
+static bool g_isObservingUserlandCode = false;
+
+bool isObserverInstrumentationOfInternalFunctionsActive()
+{
+    return g_isObservingInternalFunctions;
+}
+
+bool isObserverInstrumentationOfUserlandCodeActive()
+{
+    return g_isObservingUserlandCode;
+}
+
+static
+zval* getUserlandCallArg( zend_execute_data* execute_data, uint32_t argIndex )
+{
+    // The same layout as the one used by func_get_args():
+    // declared parameters are the first compiled variables
+    // and extra arguments are placed after all the compiled and temporary variables
+    const zend_op_array* opArray = &( EX( func )->op_array );
+    return ( argIndex < opArray->num_args )
+           ? ZEND_CALL_VAR_NUM( execute_data, argIndex )
+           : ZEND_CALL_VAR_NUM( execute_data, opArray->last_var + opArray->T + ( argIndex - opArray->num_args ) );
+}
+
+static
+void addArgValueToArray( zval* arg, /* in,out */ zval* array )
+{
+    if ( arg == NULL || Z_ISUNDEF_P( arg ) )
+    {
+        add_next_index_null( array );
+        return;
+    }
+
+    zval* value = arg;
+    ZVAL_DEREF( value );
+    Z_TRY_ADDREF_P( value );
+    add_next_index_zval( array, value );
+}
+
+void observerInstrumentationCaptureUserlandCallArgs( zend_execute_data* execute_data, ArgCaptureSpecArrayView argCaptureSpecs, /* out */ zval* capturedArgs )
+{
+    const uint32_t declaredParamsCount = EX( func )->op_array.num_args;
+
+    array_init_size( capturedArgs, (uint32_t) argCaptureSpecs.count );
+    ELASTIC_APM_FOR_EACH_INDEX( i, argCaptureSpecs.count )
+    {
+        ArgCaptureSpec argCaptureSpec = argCaptureSpecs.values[ i ];
+        if ( argCaptureSpec == dontCaptureArg )
+        {
+            continue;
+        }
+
+        zval* arg = ( i < declaredParamsCount ) ? getUserlandCallArg( execute_data, (uint32_t) i ) : NULL;
+        if ( argCaptureSpec == captureArgByRef && arg != NULL && ! Z_ISUNDEF_P( arg ) )
+        {
+            // The same as &$param in the array inserted by AST instrumentation - pre-hook can replace the argument
+            ZVAL_MAKE_REF( arg );
+            Z_ADDREF_P( arg );
+            add_next_index_zval( capturedArgs, arg );
+            continue;
+        }
+
+        addArgValueToArray( arg, /* in,out */ capturedArgs );
+    }
+}
+
+void observerInstrumentationGetAllUserlandCallArgs( zend_execute_data* execute_data, /* out */ zval* args )
+{
+    const uint32_t argsCount = ZEND_CALL_NUM_ARGS( execute_data );
+
+    array_init_size( args, argsCount );
+    ELASTIC_APM_FOR_EACH_INDEX( i, argsCount )
+    {
+        addArgValueToArray( getUserlandCallArg( execute_data, (uint32_t) i ), /* in,out */ args );
+    }
+}
+
+#if PHP_VERSION_ID >= ELASTIC_APM_BUILD_PHP_VERSION_ID( 8, 0, 0 ) /* if PHP version from 8.0.0 */
+
+enum ObservedCallKind
+{
+    observedCallKind_notHooked,
+    observedCallKind_internalFunction,
+    observedCallKind_deferredInternalFunction,
+    observedCallKind_userlandCode
+};
+typedef enum ObservedCallKind ObservedCallKind;
+
+struct ObservedCall
+{
+    ObservedCallKind kind;
+    uint32_t interceptRegistrationId;
+    bool shouldCallPostHook;
+    zval postHook;
+    // Used only for calls recorded without calling PHP part (see deferred_call_records.h)
+    TimePoint startTime;
+};
+typedef struct ObservedCall ObservedCall;
+
+/**
+ * Each observed call begins and ends in LIFO order so the state passed from begin to end handler is kept in a stack.
+ * Calls nested deeper than the stack's capacity are not hooked - they are only counted to keep begin/end pairs balanced.
+ * Calls made from inside the hooks (by the agent's PHP part) are not hooked at all.
+ */
+enum { maxObservedCallsNestingDepth = 64 };
+static ObservedCall g_observedCallsStack[ maxObservedCallsNestingDepth ];
+static uint32_t g_observedCallsStackDepth = 0;
+static uint32_t g_observedCallsOverflowDepth = 0;
+static bool g_isInsideHook = false;
+
+static
+ObservedCall* pushObservedCall()
+{
+    if ( g_observedCallsStackDepth == maxObservedCallsNestingDepth )
+    {
+        ++g_observedCallsOverflowDepth;
+        ELASTIC_APM_LOG_TRACE( "Observed calls are nested too deep - the call will not be hooked; maxObservedCallsNestingDepth: %u", (UInt)maxObservedCallsNestingDepth );
+        return NULL;
+    }
+
+    ObservedCall* observedCall = &( g_observedCallsStack[ g_observedCallsStackDepth++ ] );
+    observedCall->kind = observedCallKind_notHooked;
+    observedCall->interceptRegistrationId = 0;
+    observedCall->shouldCallPostHook = false;
+    ZVAL_NULL( &( observedCall->postHook ) );
+    return observedCall;
+}
+
+static
+bool popObservedCall( /* out */ ObservedCall* observedCall )
+{
+    if ( g_observedCallsOverflowDepth != 0 )
+    {
+        --g_observedCallsOverflowDepth;
+        return false;
+    }
+
+    // The call might have begun before the current request was initialized
+    if ( g_observedCallsStackDepth == 0 )
+    {
+        return false;
+    }
+
+    // The slot is copied because hooks called by end handler can push new observed calls
+    *observedCall = g_observedCallsStack[ --g_observedCallsStackDepth ];
+    return true;
+}
+
+static
+void onInternalFunctionCallBegin( zend_execute_data* execute_data, ObservedCall* observedCall )
+{
+    uint32_t interceptRegistrationId;
+    if ( ! findInterceptRegistrationForCall( EX( func ), /* out */ &interceptRegistrationId ) )
+    {
+        return;
+    }
+
+    if ( ! doesInterceptedCallMatchArgFilter( interceptRegistrationId, execute_data ) )
+    {
+        return;
+    }
+
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    if ( elasticApmEnterAgentCode( __FILE__, __LINE__, __FUNCTION__ ) != resultSuccess )
+    {
+        return;
+    }
+
+    ELASTIC_APM_LOG_TRACE_FUNCTION_ENTRY_MSG( "interceptRegistrationId: %u, nesting depth: %u", interceptRegistrationId, g_observedCallsStackDepth );
+
+    observedCall->interceptRegistrationId = interceptRegistrationId;
+    if ( findDeferredCallRecordingSpec( interceptRegistrationId ) != NULL )
+    {
+        observedCall->kind = observedCallKind_deferredInternalFunction;
+        getCurrentTime( &( observedCall->startTime ) );
+        return;
+    }
+
+    observedCall->kind = observedCallKind_internalFunction;
+    g_isInsideHook = true;
+    observedCall->shouldCallPostHook = tracerPhpPartInternalFuncCallPreHook( interceptRegistrationId, execute_data );
+    g_isInsideHook = false;
+}
+
+static
+void onInternalFunctionCallEnd( const ObservedCall* observedCall, zval* retVal )
+{
+    if ( ! observedCall->shouldCallPostHook )
+    {
+        return;
+    }
+
+    zval retValOrThrown;
+    bool hasExitedByException = ( EG( exception ) != NULL );
+    if ( hasExitedByException )
+    {
+        ZVAL_OBJ( &retValOrThrown, EG( exception ) );
+    }
+    else if ( retVal == NULL )
+    {
+        ZVAL_NULL( &retValOrThrown );
+    }
+    else
+    {
+        ZVAL_COPY_VALUE( &retValOrThrown, retVal );
+    }
+
+    g_isInsideHook = true;
+    tracerPhpPartInternalFuncCallPostHook( observedCall->interceptRegistrationId, hasExitedByException, &retValOrThrown );
+    g_isInsideHook = false;
+}
+
+static
+void onDeferredInternalFunctionCallEnd( zend_execute_data* execute_data, const ObservedCall* observedCall, zval* retVal )
+{
+    const DeferredCallRecordingSpec* spec = findDeferredCallRecordingSpec( observedCall->interceptRegistrationId );
+    if ( spec == NULL )
+    {
+        return;
+    }
+
+    zval thrown;
+    const bool hasExitedByException = ( EG( exception ) != NULL );
+    if ( hasExitedByException )
+    {
+        ZVAL_OBJ( &thrown, EG( exception ) );
+    }
+    deferredCallRecords_append( observedCall->interceptRegistrationId, spec, execute_data, &( observedCall->startTime ), hasExitedByException, hasExitedByException ? &thrown : retVal );
+}
+
+static
+void onUserlandCallBegin( zend_execute_data* execute_data, ObservedCall* observedCall )
+{
+    observedCall->kind = observedCallKind_userlandCode;
+    g_isInsideHook = true;
+    wordPressInstrumentationOnObservedCallBegin( execute_data, /* out */ &( observedCall->postHook ) );
+    g_isInsideHook = false;
+}
+
+static
+void onUserlandCallEnd( ObservedCall* observedCall, zval* retVal )
+{
+    if ( Z_TYPE( observedCall->postHook ) == IS_NULL )
+    {
+        return;
+    }
+
+    zval thrown;
+    zval retValOrNull;
+    ZVAL_NULL( &thrown );
+    ZVAL_NULL( &retValOrNull );
+    if ( EG( exception ) != NULL )
+    {
+        ZVAL_OBJ( &thrown, EG( exception ) );
+    }
+    else if ( retVal != NULL )
+    {
+        ZVAL_COPY_VALUE( &retValOrNull, retVal );
+    }
+
+    g_isInsideHook = true;
+    tracerPhpPartAstInstrumentationPostHook( &( observedCall->postHook ), &thrown, &retValOrNull );
+    g_isInsideHook = false;
+
+    zval_ptr_dtor( &( observedCall->postHook ) );
+    ZVAL_NULL( &( observedCall->postHook ) );
+}
+
+static
+void observerInstrumentationOnCallBegin( zend_execute_data* execute_data )
+{
+    if ( g_isInsideHook )
+    {
+        return;
+    }
+
+    ObservedCall* observedCall = pushObservedCall();
+    if ( observedCall == NULL )
+    {
+        return;
+    }
+
+    if ( EX( func )->type == ZEND_INTERNAL_FUNCTION )
+    {
+        onInternalFunctionCallBegin( execute_data, observedCall );
+    }
+    else
+    {
+        onUserlandCallBegin( execute_data, observedCall );
+    }
+}
+
+static
+void observerInstrumentationOnCallEnd( zend_execute_data* execute_data, zval* retVal )
+{
+    if ( g_isInsideHook )
+    {
+        return;
+    }
+
+    ObservedCall observedCall;
+    if ( ! popObservedCall( /* out */ &observedCall ) )
+    {
+        return;
+    }
+
+    switch ( observedCall.kind )
+    {
+        case observedCallKind_internalFunction:
+            onInternalFunctionCallEnd( &observedCall, retVal );
+            break;
+
+        case observedCallKind_deferredInternalFunction:
+            onDeferredInternalFunctionCallEnd( execute_data, &observedCall, retVal );
+            break;
+
+        case observedCallKind_userlandCode:
+            onUserlandCallEnd( &observedCall, retVal );
+            break;
+
+        default:
+            break;
+    }
+}
+
+static
+zend_observer_fcall_handlers observerInstrumentationInitCallHandlers( zend_execute_data* execute_data )
+{
+    zend_function* func = EX( func );
+    zend_observer_fcall_handlers handlers = { NULL, NULL };
+
+    const bool shouldObserve = ( func->type == ZEND_INTERNAL_FUNCTION )
+                               ? ( g_isObservingInternalFunctions && isInterceptedFunction( func ) )
+                               : ( g_isObservingUserlandCode && wordPressInstrumentationShouldObserveFunction( func ) );
+    if ( shouldObserve )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Observing calls to %s%s%s"
+                               , func->common.scope == NULL ? "" : ZSTR_VAL( func->common.scope->name )
+                               , func->common.scope == NULL ? "" : "::"
+                               , func->common.function_name == NULL ? "<N/A>" : ZSTR_VAL( func->common.function_name ) );
+        handlers.begin = observerInstrumentationOnCallBegin;
+        handlers.end = observerInstrumentationOnCallEnd;
+    }
+    return handlers;
+}
+
+#endif // #if PHP_VERSION_ID >= ELASTIC_APM_BUILD_PHP_VERSION_ID( 8, 0, 0 )
+
+void observerInstrumentationOnModuleInit( const ConfigSnapshot* config )
+{
+    if ( config->instrumentationBackend != instrumentationBackend_observer )
+    {
+        return;
+    }
+
+#if PHP_VERSION_ID >= ELASTIC_APM_BUILD_PHP_VERSION_ID( 8, 0, 0 ) /* if PHP version from 8.0.0 */
+    g_isObservingUserlandCode = config->astProcessEnabled;
+#   if PHP_VERSION_ID >= ELASTIC_APM_BUILD_PHP_VERSION_ID( 8, 2, 0 ) /* if PHP version from 8.2.0 */
+    g_isObservingInternalFunctions = true;
+#   else
+    ELASTIC_APM_LOG_DEBUG( "zend_observer API observes internal functions only since PHP 8.2 so internal functions will be intercepted by replacing their handlers" );
+#   endif
+
+    // zend_observer API disables some of the engine's optimizations so observer is registered only if there is anything to observe
+    if ( g_isObservingInternalFunctions || g_isObservingUserlandCode )
+    {
+        zend_observer_fcall_register( observerInstrumentationInitCallHandlers );
+    }
+    ELASTIC_APM_LOG_DEBUG( "Using zend_observer API; internal functions: %s, userland code: %s"
+                           , boolToString( g_isObservingInternalFunctions ), boolToString( g_isObservingUserlandCode ) );
+#else
+    ELASTIC_APM_LOG_WARNING( "Configuration option %s is set to `%s' but zend_observer API is available only since PHP 8.0"
+                             " - falling back to `%s'"
+                             , ELASTIC_APM_CFG_OPT_NAME_INSTRUMENTATION_BACKEND
+                             , instrumentationBackendNames[ instrumentationBackend_observer ]
+                             , instrumentationBackendNames[ instrumentationBackend_handlerAndAst ] );
+#endif
+}
+
+void observerInstrumentationOnRequestInit()
+{
+#if PHP_VERSION_ID >= ELASTIC_APM_BUILD_PHP_VERSION_ID( 8, 0, 0 ) /* if PHP version from 8.0.0 */
+    g_observedCallsStackDepth = 0;
+    g_observedCallsOverflowDepth = 0;
+    g_isInsideHook = false;
+#endif
+}
+
+void observerInstrumentationOnRequestShutdown()
+{
+#if PHP_VERSION_ID >= ELASTIC_APM_BUILD_PHP_VERSION_ID( 8, 0, 0 ) /* if PHP version from 8.0.0 */
+    // Calls that have not ended (for example because of exit() or a fatal error) still hold post-hooks
+    ELASTIC_APM_FOR_EACH_INDEX( i, g_observedCallsStackDepth )
+    {
+        zval_ptr_dtor( &( g_observedCallsStack[ i ].postHook ) );
+        ZVAL_NULL( &( g_observedCallsStack[ i ].postHook ) );
+    }
+    g_observedCallsStackDepth = 0;
+    g_observedCallsOverflowDepth = 0;
+    g_isInsideHook = false;
+#endif
+}
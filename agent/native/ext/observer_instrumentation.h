@@ -0,0 +1,60 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <zend_types.h>
+#include "ConfigSnapshot_forward_decl.h"
+#include "AST_instrumentation.h"
+
+/**
+ * Instrumentation backend based on zend_observer API (selected by instrumentation_backend configuration option).
+ *
+ * Instead of replacing internal functions' handlers and rewriting AST of userland code
+ * the observer's init callback is called by the engine once per function (per request)
+ * and it returns begin/end handlers only for instrumented functions so calls to other functions are not affected.
+ *
+ * zend_observer API is available since PHP 8.0 but it observes internal functions only since PHP 8.2
+ * so on PHP 8.0 and 8.1 internal functions are still intercepted by replacing their handlers.
+ *
+ * Unlike handler replacement, observed intercepted calls can be nested.
+ * Calls made by the agent's PHP part from inside the hooks are not observed.
+ */
+
+void observerInstrumentationOnModuleInit( const ConfigSnapshot* config );
+
+void observerInstrumentationOnRequestInit();
+void observerInstrumentationOnRequestShutdown();
+
+bool isObserverInstrumentationOfInternalFunctionsActive();
+bool isObserverInstrumentationOfUserlandCodeActive();
+
+/**
+ * Builds array of arguments of observed userland call the same way AST instrumentation captures them
+ * (the array is owned by the caller)
+ */
+void observerInstrumentationCaptureUserlandCallArgs( zend_execute_data* execute_data, ArgCaptureSpecArrayView argCaptureSpecs, /* out */ zval* capturedArgs );
+
+/**
+ * Builds array of all the arguments of observed userland call - the same as func_get_args()
+ * (the array is owned by the caller)
+ */
+void observerInstrumentationGetAllUserlandCallArgs( zend_execute_data* execute_data, /* out */ zval* args );
@@ -50,4 +50,19 @@ ResultCode timedWaitConditionVariable( ConditionVariable* condVar, Mutex* mtx, c
 ResultCode signalConditionVariable( ConditionVariable* condVar, String dbgDesc );
 ResultCode deleteConditionVariable( ConditionVariable** condVarOutPtr, bool isCreatedByThisProcess );
 
+/**
+ * Wakeup event for a single waiting thread that doesn't require producers to lock a mutex.
+ * Signaling is cheap when the waiting thread is not about to wait - the syscall is made only after
+ * the waiting thread called announceWaitWakeupEvent. The waiting thread should call announceWaitWakeupEvent,
+ * then re-check the condition it's waiting for and only then call timedWaitWakeupEvent.
+ */
+struct WakeupEvent;
+typedef struct WakeupEvent WakeupEvent;
+ResultCode newWakeupEvent( WakeupEvent** wakeupEventOutPtr, String dbgDesc );
+void announceWaitWakeupEvent( WakeupEvent* wakeupEvent );
+// timeoutAbsUtc can be NULL - in that case waits without timeout
+ResultCode timedWaitWakeupEvent( WakeupEvent* wakeupEvent, const TimeSpec* timeoutAbsUtc, /* out */ bool* hasTimedOut, String dbgDesc );
+ResultCode signalWakeupEvent( WakeupEvent* wakeupEvent, String dbgDesc );
+ResultCode deleteWakeupEvent( WakeupEvent** wakeupEventOutPtr );
+
 void registerCallbacksToLogFork();
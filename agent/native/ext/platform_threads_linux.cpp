@@ -26,6 +26,12 @@
 //#endif
 #include <pthread.h>
 #include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <limits.h>
+#include <algorithm>
+#include <atomic>
 #include "elastic_apm_assert.h"
 #include "elastic_apm_alloc.h"
 #include "log.h"
@@ -500,6 +506,160 @@ ResultCode signalConditionVariable( ConditionVariable* condVar, String dbgDesc )
     return resultSuccess;
 }
 
+struct WakeupEvent
+{
+    int eventFd;
+    std::atomic< bool > isWaitAnnounced;
+    String dbgDesc;
+};
+
+ResultCode newWakeupEvent( WakeupEvent** wakeupEventOutPtr, String dbgDesc )
+{
+    ELASTIC_APM_ASSERT_VALID_OUT_PTR_TO_PTR( wakeupEventOutPtr );
+
+    ResultCode resultCode;
+    WakeupEvent* wakeupEvent = NULL;
+    char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE ];
+    TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
+
+    ELASTIC_APM_MALLOC_INSTANCE_IF_FAILED_GOTO( WakeupEvent, /* out */ wakeupEvent );
+    wakeupEvent->isWaitAnnounced.store( false );
+    wakeupEvent->eventFd = eventfd( /* initval: */ 0, EFD_CLOEXEC | EFD_NONBLOCK );
+    if ( wakeupEvent->eventFd == -1 )
+    {
+        ELASTIC_APM_LOG_ERROR( "eventfd failed with error: `%s'; dbg desc: `%s'", streamErrNo( errno, &txtOutStream ), dbgDesc );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    wakeupEvent->dbgDesc = dbgDesc;
+    resultCode = resultSuccess;
+    *wakeupEventOutPtr = wakeupEvent;
+
+    finally:
+    return resultCode;
+
+    failure:
+    ELASTIC_APM_FREE_INSTANCE_AND_SET_TO_NULL( WakeupEvent, wakeupEvent );
+    goto finally;
+}
+
+ResultCode deleteWakeupEvent( WakeupEvent** wakeupEventOutPtr )
+{
+    ELASTIC_APM_ASSERT_VALID_IN_PTR_TO_PTR( wakeupEventOutPtr );
+
+    // Closing descriptor inherited from parent process is safe in child process - it doesn't affect the parent
+    close( (*wakeupEventOutPtr)->eventFd );
+    ELASTIC_APM_FREE_INSTANCE_AND_SET_TO_NULL( WakeupEvent, *wakeupEventOutPtr );
+
+    return resultSuccess;
+}
+
+void announceWaitWakeupEvent( WakeupEvent* wakeupEvent )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( wakeupEvent );
+
+    // Sequentially consistent order (the default) makes sure that either the waiting thread sees the change made by the signaling thread
+    // before signalWakeupEvent was called or the signaling thread sees that wait was announced
+    wakeupEvent->isWaitAnnounced.store( true );
+}
+
+static
+int calcWakeupEventPollTimeout( const TimeSpec* timeoutAbsUtc )
+{
+    if ( timeoutAbsUtc == NULL )
+    {
+        // infinite timeout
+        return -1;
+    }
+
+    TimeSpec now;
+    if ( getCurrentAbsTimeSpec( /* out */ &now ) != resultSuccess || compareAbsTimeSpecs( timeoutAbsUtc, &now ) <= 0 )
+    {
+        return 0;
+    }
+
+    Int64 diffInNanoseconds = ( (Int64) ( timeoutAbsUtc->tv_sec - now.tv_sec ) ) * ELASTIC_APM_NUMBER_OF_NANOSECONDS_IN_SECOND + ( timeoutAbsUtc->tv_nsec - now.tv_nsec );
+    // Round up so that we don't wake up before the timeout
+    Int64 diffInMilliseconds = ( diffInNanoseconds + ELASTIC_APM_NUMBER_OF_NANOSECONDS_IN_MILLISECOND - 1 ) / ELASTIC_APM_NUMBER_OF_NANOSECONDS_IN_MILLISECOND;
+    return (int) std::min( diffInMilliseconds, (Int64) INT_MAX );
+}
+
+ResultCode timedWaitWakeupEvent( WakeupEvent* wakeupEvent, const TimeSpec* timeoutAbsUtc, /* out */ bool* hasTimedOut, String dbgDesc )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( wakeupEvent );
+    ELASTIC_APM_ASSERT_VALID_PTR( hasTimedOut );
+
+    ResultCode resultCode;
+    char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE ];
+    TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
+    struct pollfd pollFd = { .fd = wakeupEvent->eventFd, .events = POLLIN, .revents = 0 };
+    int pollRetVal;
+    uint64_t eventFdCounter;
+
+    ELASTIC_APM_LOG_TRACE( "Waiting wakeup event... timeoutAbsUtc: %s; wakeup event address: %p, dbg desc: `%s'; call dbg desc: `%s'"
+                           , timeoutAbsUtc == NULL ? "N/A" : streamUtcTimeSpecAsLocal( timeoutAbsUtc, &txtOutStream ), wakeupEvent, wakeupEvent->dbgDesc, dbgDesc );
+    textOutputStreamRewind( &txtOutStream );
+
+    do {
+        pollRetVal = poll( &pollFd, /* nfds */ 1, calcWakeupEventPollTimeout( timeoutAbsUtc ) );
+    } while ( pollRetVal == -1 && errno == EINTR );
+    if ( pollRetVal == -1 )
+    {
+        ELASTIC_APM_LOG_ERROR( "poll failed with error: `%s'; wakeup event address: %p, dbg desc: `%s'; call dbg desc: `%s'"
+                               , streamErrNo( errno, &txtOutStream ), wakeupEvent, wakeupEvent->dbgDesc, dbgDesc );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    *hasTimedOut = ( pollRetVal == 0 );
+    if ( ! *hasTimedOut )
+    {
+        // Reset the counter - the descriptor is non-blocking so the read fails with EAGAIN if another read already reset it
+        if ( read( wakeupEvent->eventFd, &eventFdCounter, sizeof( eventFdCounter ) ) == -1 && errno != EAGAIN )
+        {
+            ELASTIC_APM_LOG_ERROR( "read from eventfd failed with error: `%s'; wakeup event address: %p, dbg desc: `%s'; call dbg desc: `%s'"
+                                   , streamErrNo( errno, &txtOutStream ), wakeupEvent, wakeupEvent->dbgDesc, dbgDesc );
+            ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+        }
+    }
+
+    ELASTIC_APM_LOG_TRACE( "Done waiting wakeup event. hasTimedOut: %s; wakeup event address: %p, dbg desc: `%s'; call dbg desc: `%s'"
+                           , boolToString( *hasTimedOut ), wakeupEvent, wakeupEvent->dbgDesc, dbgDesc );
+    resultCode = resultSuccess;
+
+    finally:
+    wakeupEvent->isWaitAnnounced.store( false );
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+ResultCode signalWakeupEvent( WakeupEvent* wakeupEvent, String dbgDesc )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( wakeupEvent );
+
+    char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE ];
+    TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
+    uint64_t increment = 1;
+
+    if ( ! wakeupEvent->isWaitAnnounced.exchange( false ) )
+    {
+        return resultSuccess;
+    }
+
+    ELASTIC_APM_LOG_TRACE( "Signaling wakeup event... wakeup event address: %p, dbg desc: `%s'; call dbg desc: `%s'", wakeupEvent, wakeupEvent->dbgDesc, dbgDesc );
+
+    // write fails with EAGAIN only if the counter is about to overflow which means there's a pending wakeup anyway
+    if ( write( wakeupEvent->eventFd, &increment, sizeof( increment ) ) == -1 && errno != EAGAIN )
+    {
+        ELASTIC_APM_LOG_ERROR( "write to eventfd failed with error: `%s'; wakeup event address: %p, dbg desc: `%s'; call dbg desc: `%s'"
+                               , streamErrNo( errno, &txtOutStream ), wakeupEvent, wakeupEvent->dbgDesc, dbgDesc );
+        return resultFailure;
+    }
+
+    return resultSuccess;
+}
+
 #ifndef ELASTIC_APM_NON_PROD_UNIT_TEST
 //TODO move to separate file
 
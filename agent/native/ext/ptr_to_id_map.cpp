@@ -0,0 +1,115 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "ptr_to_id_map.h"
+#include "elastic_apm_alloc.h"
+#include "elastic_apm_assert.h"
+#include "log.h"
+
+#define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_UTIL
+
+enum { ptrToIdMapMinCapacity = 64 };
+
+static
+void insertIntoEntries( PtrToIdMapEntry* entries, size_t capacity, const void* key, UInt32 id, /* out */ bool* isNewKey )
+{
+    const size_t mask = capacity - 1;
+    for ( size_t i = ptrToIdMap_hash( key ) & mask ; ; i = ( i + 1 ) & mask )
+    {
+        PtrToIdMapEntry* entry = &( entries[ i ] );
+        if ( entry->key == NULL || entry->key == key )
+        {
+            *isNewKey = ( entry->key == NULL );
+            entry->key = key;
+            entry->id = id;
+            return;
+        }
+    }
+}
+
+static
+ResultCode ptrToIdMap_grow( PtrToIdMap* thisObj )
+{
+    ResultCode resultCode;
+    const size_t newCapacity = ( thisObj->capacity == 0 ) ? (size_t) ptrToIdMapMinCapacity : ( thisObj->capacity * 2 );
+    PtrToIdMapEntry* newEntries = NULL;
+    bool isNewKey;
+
+    ELASTIC_APM_MALLOC_IF_FAILED_GOTO( PtrToIdMapEntry, sizeof( PtrToIdMapEntry ) * newCapacity, /* out */ newEntries );
+    ELASTIC_APM_FOR_EACH_INDEX( i, newCapacity )
+    {
+        newEntries[ i ].key = NULL;
+    }
+    ELASTIC_APM_FOR_EACH_INDEX( i, thisObj->capacity )
+    {
+        if ( thisObj->entries[ i ].key != NULL )
+        {
+            insertIntoEntries( newEntries, newCapacity, thisObj->entries[ i ].key, thisObj->entries[ i ].id, /* out */ &isNewKey );
+        }
+    }
+    ELASTIC_APM_FREE_AND_SET_TO_NULL( PtrToIdMapEntry, sizeof( PtrToIdMapEntry ) * thisObj->capacity, thisObj->entries );
+    thisObj->entries = newEntries;
+    thisObj->capacity = newCapacity;
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    ELASTIC_APM_LOG_ERROR( "Failed to grow pointer to ID map; current capacity: %" PRIu64, (UInt64) thisObj->capacity );
+    goto finally;
+}
+
+ResultCode ptrToIdMap_set( PtrToIdMap* thisObj, const void* key, UInt32 id )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj );
+    ELASTIC_APM_ASSERT_VALID_PTR( key );
+
+    ResultCode resultCode;
+    bool isNewKey;
+
+    // Keep load factor at most 1/2 so that probe sequences stay short
+    if ( 2 * ( thisObj->count + 1 ) > thisObj->capacity )
+    {
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( ptrToIdMap_grow( thisObj ) );
+    }
+
+    insertIntoEntries( thisObj->entries, thisObj->capacity, key, id, /* out */ &isNewKey );
+    if ( isNewKey )
+    {
+        ++thisObj->count;
+    }
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+void ptrToIdMap_free( PtrToIdMap* thisObj )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( thisObj );
+
+    ELASTIC_APM_FREE_AND_SET_TO_NULL( PtrToIdMapEntry, sizeof( PtrToIdMapEntry ) * thisObj->capacity, thisObj->entries );
+    thisObj->capacity = 0;
+    thisObj->count = 0;
+}
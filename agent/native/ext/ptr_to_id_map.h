@@ -0,0 +1,88 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "basic_types.h"
+#include "ResultCode.h"
+
+/**
+ * Open-addressing (linear probing) hash map from a pointer to 32-bit ID.
+ * Lookup is inline because it's on the hot path of intercepted calls.
+ * Entries are never removed - keys are pointers to objects that live as long as the process.
+ */
+struct PtrToIdMapEntry
+{
+    // NULL for an empty slot
+    const void* key;
+    UInt32 id;
+};
+typedef struct PtrToIdMapEntry PtrToIdMapEntry;
+
+struct PtrToIdMap
+{
+    PtrToIdMapEntry* entries;
+    // Always 0 or a power of 2
+    size_t capacity;
+    size_t count;
+};
+typedef struct PtrToIdMap PtrToIdMap;
+
+#define ELASTIC_APM_PTR_TO_ID_MAP_INITIALIZER { .entries = NULL, .capacity = 0, .count = 0 }
+
+static inline
+size_t ptrToIdMap_hash( const void* key )
+{
+    // Fibonacci hashing - the low bits of pointers are mostly zeros because of alignment
+    return (size_t)( ( (UInt64)(uintptr_t) key * 0x9E3779B97F4A7C15ULL ) >> 32 );
+}
+
+static inline
+bool ptrToIdMap_get( const PtrToIdMap* thisObj, const void* key, /* out */ UInt32* id )
+{
+    if ( thisObj->capacity == 0 )
+    {
+        return false;
+    }
+
+    const size_t mask = thisObj->capacity - 1;
+    for ( size_t i = ptrToIdMap_hash( key ) & mask ; ; i = ( i + 1 ) & mask )
+    {
+        const PtrToIdMapEntry* entry = &( thisObj->entries[ i ] );
+        if ( entry->key == key )
+        {
+            *id = entry->id;
+            return true;
+        }
+        if ( entry->key == NULL )
+        {
+            return false;
+        }
+    }
+}
+
+/**
+ * Inserts or updates the entry for the key (key must not be NULL)
+ */
+ResultCode ptrToIdMap_set( PtrToIdMap* thisObj, const void* key, UInt32 id );
+
+void ptrToIdMap_free( PtrToIdMap* thisObj );
@@ -28,6 +28,8 @@
 #include "util_for_PHP.h"
 #include "elastic_apm_assert.h"
 #include "MemoryTracker.h"
+#include "backend_comm.h"
+#include "backend_comm_stats.h"
 
 #define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_SUPPORT
 
@@ -364,6 +366,85 @@ void printEffectiveLogLevels( StructuredTextPrinter* structTxtPrinter )
     structTxtPrinter->printTableEnd( structTxtPrinter, numberOfColumns );
 }
 
+static
+void printBackendCommStatsRow( StructuredTextPrinter* structTxtPrinter, String statName, UInt64 statValue )
+{
+    char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE ];
+    TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
+
+    String columns[] = { statName, streamPrintf( &txtOutStream, "%" PRIu64, statValue ) };
+    structTxtPrinter->printTableRow( structTxtPrinter, ELASTIC_APM_STATIC_ARRAY_SIZE( columns ), columns );
+}
+
+static
+void printBackendCommStats( StructuredTextPrinter* structTxtPrinter )
+{
+    char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE ];
+    TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
+    BackendCommStats stats;
+    backendCommStats_get( /* out */ &stats );
+
+    String columnHeaders[] = { "Statistic", "Value (this process)" };
+    enum { numberOfColumns = ELASTIC_APM_STATIC_ARRAY_SIZE( columnHeaders ) };
+
+    structTxtPrinter->printTableBegin( structTxtPrinter, numberOfColumns );
+    structTxtPrinter->printTableHeader( structTxtPrinter, numberOfColumns, columnHeaders );
+
+    printBackendCommStatsRow( structTxtPrinter, "Queued events size (bytes)", getBackendCommQueuedEventsSize() );
+    printBackendCommStatsRow( structTxtPrinter, "Requests", stats.requestsCount );
+    printBackendCommStatsRow( structTxtPrinter, "Failed requests", stats.failedRequestsCount );
+    printBackendCommStatsRow( structTxtPrinter, "Sent bytes", stats.sentBytesCount );
+    printBackendCommStatsRow( structTxtPrinter, "Sent batches", stats.sentBatchesCount );
+    printBackendCommStatsRow( structTxtPrinter, "Dropped batches", stats.droppedBatchesCount );
+    ELASTIC_APM_FOR_EACH_INDEX( statusClass, numberOfBackendCommHttpStatusClasses )
+    {
+        printBackendCommStatsRow( structTxtPrinter
+                                  , streamPrintf( &txtOutStream, "HTTP responses: %s", backendCommHttpStatusClassNames[ statusClass ] )
+                                  , stats.httpStatusClassCounts[ statusClass ] );
+        textOutputStreamRewind( &txtOutStream );
+    }
+    ELASTIC_APM_FOR_EACH_INDEX( bucket, numberOfBackendCommLatencyHistogramBuckets )
+    {
+        printBackendCommStatsRow( structTxtPrinter
+                                  , streamPrintf( &txtOutStream, "Latency <= %s ms", backendCommLatencyHistogramBucketNames[ bucket ] )
+                                  , stats.latencyHistogram[ bucket ] );
+        textOutputStreamRewind( &txtOutStream );
+    }
+    printBackendCommStatsRow( structTxtPrinter, "Latency sum (ms)", stats.latencySumInMilliseconds );
+
+    structTxtPrinter->printTableEnd( structTxtPrinter, numberOfColumns );
+}
+
+static
+void printBackendCommInfo( StructuredTextPrinter* structTxtPrinter )
+{
+    char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE ];
+    TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
+
+    structTxtPrinter->printSectionHeading( structTxtPrinter, "Backend communication" );
+
+    String columnHeaders[] = { "Event class", "Dropped events (this process)" };
+    enum { numberOfColumns = ELASTIC_APM_STATIC_ARRAY_SIZE( columnHeaders ) };
+
+    structTxtPrinter->printTableBegin( structTxtPrinter, numberOfColumns );
+    structTxtPrinter->printTableHeader( structTxtPrinter, numberOfColumns, columnHeaders );
+
+    ELASTIC_APM_FOR_EACH_INDEX( eventClass, numberOfBackendCommEventClasses )
+    {
+        String columns[ numberOfColumns ] =
+                {
+                        backendCommEventClassNames[ eventClass ]
+                        , streamPrintf( &txtOutStream, "%" PRIu64, getBackendCommDroppedEventsCount( (BackendCommEventClass) eventClass ) )
+                };
+        structTxtPrinter->printTableRow( structTxtPrinter, ELASTIC_APM_STATIC_ARRAY_SIZE( columns ), columns );
+        textOutputStreamRewind( &txtOutStream );
+    }
+
+    structTxtPrinter->printTableEnd( structTxtPrinter, numberOfColumns );
+
+    printBackendCommStats( structTxtPrinter );
+}
+
 static
 void printMiscInfo( StructuredTextPrinter* structTxtPrinter )
 {
@@ -390,6 +471,8 @@ void printSupportabilityInfo( StructuredTextPrinter* structTxtPrinter )
     printMiscSelfDiagnostics( structTxtPrinter );
     printEffectiveLogLevels( structTxtPrinter );
 
+    printBackendCommInfo( structTxtPrinter );
+
     ELASTIC_APM_LOG_TRACE_FUNCTION_EXIT();
 }
 
@@ -259,10 +259,10 @@ bool tracerPhpPartInternalFuncCallPreHook( uint32_t interceptRegistrationId, zen
     goto finally;
 }
 
-void tracerPhpPartInternalFuncCallPostHook( uint32_t dbgInterceptRegistrationId, zval* interceptedCallRetValOrThrown )
+void tracerPhpPartInternalFuncCallPostHook( uint32_t dbgInterceptRegistrationId, bool hasExitedByException, zval* interceptedCallRetValOrThrown )
 {
-    ELASTIC_APM_LOG_TRACE_FUNCTION_ENTRY_MSG( "dbgInterceptRegistrationId: %u; interceptedCallRetValOrThrown type: %u"
-                                              , dbgInterceptRegistrationId, Z_TYPE_P( interceptedCallRetValOrThrown ) );
+    ELASTIC_APM_LOG_TRACE_FUNCTION_ENTRY_MSG( "dbgInterceptRegistrationId: %u; hasExitedByException: %s; interceptedCallRetValOrThrown type: %u"
+                                              , dbgInterceptRegistrationId, boolToString( hasExitedByException ), Z_TYPE_P( interceptedCallRetValOrThrown ) );
 
     ResultCode resultCode;
     zval phpPartArgs[ 2 ];
@@ -279,7 +279,7 @@ void tracerPhpPartInternalFuncCallPostHook( uint32_t dbgInterceptRegistrationId,
 
 
     // The first argument to PHP part's interceptedCallPostHook() is $hasExitedByException (bool)
-    ZVAL_FALSE( &( phpPartArgs[ 0 ] ) );
+    ZVAL_BOOL( &( phpPartArgs[ 0 ] ), hasExitedByException );
 
     // The second argument to PHP part's interceptedCallPreHook() is $returnValueOrThrown (mixed|Throwable)
     phpPartArgs[ 1 ] = *interceptedCallRetValOrThrown;
@@ -403,6 +403,128 @@ void tracerPhpPartAstInstrumentationDirectCall( zend_execute_data* execute_data
     tracerPhpPartForwardCall( ELASTIC_APM_STRING_LITERAL_TO_VIEW( ELASTIC_APM_PHP_PART_AST_INSTRUMENTATION_DIRECT_CALL_FUNC ), execute_data, /* out */ &unusedRetVal, __FUNCTION__ );
 }
 
+void tracerPhpPartAstInstrumentationPreHook( zend_string* instrumentedClassFullName, zend_string* instrumentedFunction, zval* capturedArgs, /* out */ zval* postHook )
+{
+    ELASTIC_APM_LOG_TRACE_FUNCTION_ENTRY_MSG( "instrumentedClassFullName: %s, instrumentedFunction: %s"
+                                              , instrumentedClassFullName == NULL ? "NULL" : ZSTR_VAL( instrumentedClassFullName ), ZSTR_VAL( instrumentedFunction ) );
+
+    ResultCode resultCode;
+    zval phpPartArgs[ 3 ];
+    ZVAL_NULL( postHook );
+
+    if (!canInvokeTracerPhpPart()) {
+        if (switchTracerPhpPartStateToFailed( /* reason */ "Unexpected current tracer PHP part state", __FUNCTION__ )) {
+            ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+        } else {
+            ELASTIC_APM_SET_RESULT_CODE_TO_SUCCESS_AND_GOTO_FINALLY();
+        }
+    }
+
+    // Arguments are the same as in \elastic_apm_ast_instrumentation_pre_hook(<instrumented class full name>, __FUNCTION__, <captured args>)
+    if ( instrumentedClassFullName == NULL )
+    {
+        ZVAL_NULL( &( phpPartArgs[ 0 ] ) );
+    }
+    else
+    {
+        ZVAL_STR( &( phpPartArgs[ 0 ] ), instrumentedClassFullName );
+    }
+    ZVAL_STR( &( phpPartArgs[ 1 ] ), instrumentedFunction );
+    phpPartArgs[ 2 ] = *capturedArgs;
+
+    ELASTIC_APM_CALL_IF_FAILED_GOTO(
+            callPhpFunctionRetZval(
+                    ELASTIC_APM_STRING_LITERAL_TO_VIEW( ELASTIC_APM_PHP_PART_AST_INSTRUMENTATION_PRE_HOOK_FUNC )
+                    , ELASTIC_APM_STATIC_ARRAY_SIZE( phpPartArgs )
+                    , phpPartArgs
+                    , /* out */ postHook ) );
+
+    resultCode = resultSuccess;
+    finally:
+
+    ELASTIC_APM_LOG_TRACE_RESULT_CODE_FUNCTION_EXIT_MSG( "postHook type: %u", Z_TYPE_P( postHook ) );
+    ELASTIC_APM_UNUSED( resultCode );
+    return;
+
+    failure:
+    switchTracerPhpPartStateToFailed( /* reason */ "Failed to call tracer PHP part", __FUNCTION__ );
+    zval_ptr_dtor( postHook );
+    ZVAL_NULL( postHook );
+    goto finally;
+}
+
+void tracerPhpPartAstInstrumentationPostHook( zval* postHook, zval* thrown, zval* retVal )
+{
+    ELASTIC_APM_LOG_TRACE_FUNCTION_ENTRY_MSG( "thrown type: %u, retVal type: %u", Z_TYPE_P( thrown ), Z_TYPE_P( retVal ) );
+
+    ResultCode resultCode;
+    zval postHookArgs[ 2 ];
+
+    elasticapm::php::AutomaticExceptionStateRestorer restorer;
+
+    if (!canInvokeTracerPhpPart()) {
+        if (switchTracerPhpPartStateToFailed( /* reason */ "Unexpected current tracer PHP part state", __FUNCTION__ )) {
+            ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+        } else {
+            ELASTIC_APM_SET_RESULT_CODE_TO_SUCCESS_AND_GOTO_FINALLY();
+        }
+    }
+
+    // The same as $postHook($thrown, $retVal) inserted by AST instrumentation
+    postHookArgs[ 0 ] = *thrown;
+    postHookArgs[ 1 ] = *retVal;
+
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( callPhpCallableRetVoid( postHook, ELASTIC_APM_STATIC_ARRAY_SIZE( postHookArgs ), postHookArgs ) );
+
+    resultCode = resultSuccess;
+    finally:
+
+    ELASTIC_APM_LOG_TRACE_RESULT_CODE_FUNCTION_EXIT();
+    ELASTIC_APM_UNUSED( resultCode );
+    return;
+
+    failure:
+    switchTracerPhpPartStateToFailed( /* reason */ "Failed to call tracer PHP part", __FUNCTION__ );
+    goto finally;
+}
+
+void tracerPhpPartAstInstrumentationDirectCallMethod( StringView method )
+{
+    ELASTIC_APM_LOG_TRACE_FUNCTION_ENTRY_MSG( "method: %.*s", (int) method.length, method.begin );
+
+    ResultCode resultCode;
+    zval phpPartArgs[ 1 ];
+    ZVAL_UNDEF( &( phpPartArgs[ 0 ] ) );
+
+    if (!canInvokeTracerPhpPart()) {
+        if (switchTracerPhpPartStateToFailed( /* reason */ "Unexpected current tracer PHP part state", __FUNCTION__ )) {
+            ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+        } else {
+            ELASTIC_APM_SET_RESULT_CODE_TO_SUCCESS_AND_GOTO_FINALLY();
+        }
+    }
+
+    ZVAL_STRINGL( &( phpPartArgs[ 0 ] ), method.begin, method.length );
+
+    ELASTIC_APM_CALL_IF_FAILED_GOTO(
+            callPhpFunctionRetVoid(
+                    ELASTIC_APM_STRING_LITERAL_TO_VIEW( ELASTIC_APM_PHP_PART_AST_INSTRUMENTATION_DIRECT_CALL_FUNC )
+                    , ELASTIC_APM_STATIC_ARRAY_SIZE( phpPartArgs )
+                    , phpPartArgs ) );
+
+    resultCode = resultSuccess;
+    finally:
+    zval_dtor( &( phpPartArgs[ 0 ] ) );
+
+    ELASTIC_APM_LOG_TRACE_RESULT_CODE_FUNCTION_EXIT();
+    ELASTIC_APM_UNUSED( resultCode );
+    return;
+
+    failure:
+    switchTracerPhpPartStateToFailed( /* reason */ "Failed to call tracer PHP part", __FUNCTION__ );
+    goto finally;
+}
+
 void tracerPhpPartOnRequestInitSetInitialTracerState() {
     g_tracerPhpPartState = tracerPhpPartState_before_bootstrap;
 }
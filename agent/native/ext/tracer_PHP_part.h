@@ -23,15 +23,25 @@
 #include "ResultCode.h"
 #include "ConfigSnapshot_forward_decl.h"
 #include "time_util.h"
+#include "StringView.h"
 
 ResultCode tracerPhpPartOnRequestInit( const ConfigSnapshot* config, const TimePoint* requestInitStartTime );
 void tracerPhpPartOnRequestShutdown();
 
 bool tracerPhpPartInternalFuncCallPreHook( uint32_t interceptRegistrationId, zend_execute_data* execute_data );
-void tracerPhpPartInternalFuncCallPostHook( uint32_t dbgInterceptRegistrationId, zval* interceptedCallRetValOrThrown );
+void tracerPhpPartInternalFuncCallPostHook( uint32_t dbgInterceptRegistrationId, bool hasExitedByException, zval* interceptedCallRetValOrThrown );
 
 void tracerPhpPartInterceptedCallEmptyMethod();
 
 void tracerPhpPartAstInstrumentationCallPreHook( zend_execute_data* execute_data, zval* return_value );
 void tracerPhpPartAstInstrumentationDirectCall( zend_execute_data* execute_data );
+
+/**
+ * Counterparts of the calls inserted by AST instrumentation for the case when userland code is instrumented by zend_observer API
+ *
+ * @param instrumentedClassFullName can be NULL for standalone functions
+ */
+void tracerPhpPartAstInstrumentationPreHook( zend_string* instrumentedClassFullName, zend_string* instrumentedFunction, zval* capturedArgs, /* out */ zval* postHook );
+void tracerPhpPartAstInstrumentationPostHook( zval* postHook, zval* thrown, zval* retVal );
+void tracerPhpPartAstInstrumentationDirectCallMethod( StringView method );
 void tracerPhpPartOnRequestInitSetInitialTracerState();
\ No newline at end of file
@@ -144,12 +144,178 @@ void test_backendCommBackoff_getTimeToWaitInSeconds( void** testFixtureState )
     }
 }
 
+static
+void test_isBackendCommFailureRetriable( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    // 0 means that the request failed without HTTP response - for example connection was reset
+    ELASTIC_APM_CMOCKA_ASSERT( isBackendCommFailureRetriable( 0 ) );
+    ELASTIC_APM_CMOCKA_ASSERT( isBackendCommFailureRetriable( 408 ) );
+    ELASTIC_APM_CMOCKA_ASSERT( isBackendCommFailureRetriable( 429 ) );
+    ELASTIC_APM_CMOCKA_ASSERT( isBackendCommFailureRetriable( 500 ) );
+    ELASTIC_APM_CMOCKA_ASSERT( isBackendCommFailureRetriable( 502 ) );
+    ELASTIC_APM_CMOCKA_ASSERT( isBackendCommFailureRetriable( 503 ) );
+
+    ELASTIC_APM_CMOCKA_ASSERT( ! isBackendCommFailureRetriable( 400 ) );
+    ELASTIC_APM_CMOCKA_ASSERT( ! isBackendCommFailureRetriable( 401 ) );
+    ELASTIC_APM_CMOCKA_ASSERT( ! isBackendCommFailureRetriable( 403 ) );
+    ELASTIC_APM_CMOCKA_ASSERT( ! isBackendCommFailureRetriable( 404 ) );
+    ELASTIC_APM_CMOCKA_ASSERT( ! isBackendCommFailureRetriable( 413 ) );
+}
+
+static
+void test_backendCommBackoff_onErrorWithRetryAfter( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    GenerateRandomUIntForTests randomGenerator = { .valueToReturn = RAND_MAX / 2 };
+    BackendCommBackoff backoff = ELASTIC_APM_DEFAULT_BACKEND_COMM_BACKOFF;
+    backoff.generateRandomUInt = &generateRandomUIntForTests;
+    backoff.generateRandomUIntCtx = &randomGenerator;
+
+    ELASTIC_APM_CMOCKA_ASSERT( ! backendCommBackoff_shouldWait( &backoff ) );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( 0, backendCommBackoff_getTimeLeftToWaitInMilliseconds( &backoff ) );
+
+    // The wait after the first error is 0 seconds so the wait is only due to Retry-After
+    backendCommBackoff_onErrorWithRetryAfter( &backoff, /* retryAfterInSeconds */ 120 );
+    ELASTIC_APM_CMOCKA_ASSERT( backendCommBackoff_shouldWait( &backoff ) );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_IN_RANGE( 119 * 1000, backendCommBackoff_getTimeLeftToWaitInMilliseconds( &backoff ), 120 * 1000 );
+
+    // Retry-After shorter than the wait calculated by backoff does not shorten it
+    backendCommBackoff_onSuccess( &backoff );
+    ELASTIC_APM_REPEAT_N_TIMES( 10 )
+    {
+        backendCommBackoff_onError( &backoff );
+    }
+    backendCommBackoff_onErrorWithRetryAfter( &backoff, /* retryAfterInSeconds */ 1 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_IN_RANGE( 35 * 1000, backendCommBackoff_getTimeLeftToWaitInMilliseconds( &backoff ), 36 * 1000 );
+
+    // Retry-After is capped
+    backendCommBackoff_onErrorWithRetryAfter( &backoff, /* retryAfterInSeconds */ 24 * 60 * 60 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_IN_RANGE( ( ELASTIC_APM_BACKEND_COMM_MAX_RETRY_AFTER_IN_SECONDS - 1 ) * 1000
+                                            , backendCommBackoff_getTimeLeftToWaitInMilliseconds( &backoff )
+                                            , ELASTIC_APM_BACKEND_COMM_MAX_RETRY_AFTER_IN_SECONDS * 1000 );
+
+    backendCommBackoff_onSuccess( &backoff );
+    ELASTIC_APM_CMOCKA_ASSERT( ! backendCommBackoff_shouldWait( &backoff ) );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( 0, backendCommBackoff_getTimeLeftToWaitInMilliseconds( &backoff ) );
+}
+
+static
+TimeSpec makeTimeSpecForTests( long seconds )
+{
+    TimeSpec result = { .tv_sec = seconds, .tv_nsec = 0 };
+    return result;
+}
+
+static
+void test_backendCommRetry_max_attempts( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    BackendCommRetry retry = ELASTIC_APM_DEFAULT_BACKEND_COMM_RETRY;
+    TimeSpec currentTime = makeTimeSpecForTests( 1000 );
+
+    ELASTIC_APM_REPEAT_N_TIMES( ELASTIC_APM_BACKEND_COMM_MAX_SEND_ATTEMPTS - 1 )
+    {
+        ELASTIC_APM_CMOCKA_ASSERT( backendCommRetry_onFailure( &retry, /* batchId */ 1, /* isRetriable */ true, &currentTime ) );
+    }
+    ELASTIC_APM_CMOCKA_ASSERT( ! backendCommRetry_onFailure( &retry, /* batchId */ 1, /* isRetriable */ true, &currentTime ) );
+
+    // Counting starts from scratch for the next batch
+    ELASTIC_APM_CMOCKA_ASSERT( backendCommRetry_onFailure( &retry, /* batchId */ 2, /* isRetriable */ true, &currentTime ) );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( 1, retry.failedAttemptsCount );
+
+    // ... and also after success
+    backendCommRetry_onSuccess( &retry );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( 0, retry.failedAttemptsCount );
+}
+
+static
+void test_backendCommRetry_max_duration( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    BackendCommRetry retry = ELASTIC_APM_DEFAULT_BACKEND_COMM_RETRY;
+    TimeSpec currentTime = makeTimeSpecForTests( 1000 );
+
+    ELASTIC_APM_CMOCKA_ASSERT( backendCommRetry_onFailure( &retry, /* batchId */ 1, /* isRetriable */ true, &currentTime ) );
+    currentTime = makeTimeSpecForTests( 1000 + ELASTIC_APM_BACKEND_COMM_MAX_RETRY_DURATION_IN_SECONDS - 1 );
+    ELASTIC_APM_CMOCKA_ASSERT( backendCommRetry_onFailure( &retry, /* batchId */ 1, /* isRetriable */ true, &currentTime ) );
+    currentTime = makeTimeSpecForTests( 1000 + ELASTIC_APM_BACKEND_COMM_MAX_RETRY_DURATION_IN_SECONDS );
+    ELASTIC_APM_CMOCKA_ASSERT( ! backendCommRetry_onFailure( &retry, /* batchId */ 1, /* isRetriable */ true, &currentTime ) );
+
+    // Time is measured from the first failure of the current batch
+    ELASTIC_APM_CMOCKA_ASSERT( backendCommRetry_onFailure( &retry, /* batchId */ 2, /* isRetriable */ true, &currentTime ) );
+}
+
+/**
+ * Mock APM Server replies to each attempt with the next HTTP status from the script (0 means connection reset)
+ * and the test checks which batches are kept at the head of the queue and which are dropped
+ */
+struct MockApmServerScriptStep
+{
+    UInt64 batchId;
+    long httpStatusCode;
+    bool expectedShouldRetry;
+};
+typedef struct MockApmServerScriptStep MockApmServerScriptStep;
+
+static
+void test_backendCommRetry_mock_server( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    MockApmServerScriptStep script[] =
+    {
+        // Overloaded server - the batch is kept and it's accepted on the third attempt
+        { .batchId = 1, .httpStatusCode = 503, .expectedShouldRetry = true },
+        { .batchId = 1, .httpStatusCode = 429, .expectedShouldRetry = true },
+        { .batchId = 1, .httpStatusCode = 202, .expectedShouldRetry = false },
+        // Connection reset and then the batch is rejected - it's dropped without waiting for the limits
+        { .batchId = 2, .httpStatusCode = 0, .expectedShouldRetry = true },
+        { .batchId = 2, .httpStatusCode = 400, .expectedShouldRetry = false },
+        // Rejected right away
+        { .batchId = 3, .httpStatusCode = 413, .expectedShouldRetry = false },
+        // Attempts of the previous batches are not counted for the next one
+        { .batchId = 4, .httpStatusCode = 503, .expectedShouldRetry = true },
+        { .batchId = 4, .httpStatusCode = 202, .expectedShouldRetry = false },
+    };
+
+    BackendCommRetry retry = ELASTIC_APM_DEFAULT_BACKEND_COMM_RETRY;
+    TimeSpec currentTime = makeTimeSpecForTests( 1000 );
+
+    ELASTIC_APM_FOR_EACH_INDEX( stepIndex, ELASTIC_APM_STATIC_ARRAY_SIZE( script ) )
+    {
+        const MockApmServerScriptStep* step = &( script[ stepIndex ] );
+        bool shouldRetry;
+        if ( ( step->httpStatusCode / 100 ) == 2 )
+        {
+            backendCommRetry_onSuccess( &retry );
+            shouldRetry = false;
+        }
+        else
+        {
+            shouldRetry = backendCommRetry_onFailure( &retry, step->batchId, isBackendCommFailureRetriable( step->httpStatusCode ), &currentTime );
+        }
+        ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( step->expectedShouldRetry, shouldRetry );
+        ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( shouldRetry, retry.failedAttemptsCount != 0 );
+        currentTime.tv_sec += 1;
+    }
+}
+
 int run_backend_comm_backoff_tests()
 {
     const struct CMUnitTest tests [] =
     {
         ELASTIC_APM_CMOCKA_UNIT_TEST( test_backendCommBackoff_convertRandomUIntToJitter ),
         ELASTIC_APM_CMOCKA_UNIT_TEST( test_backendCommBackoff_getTimeToWaitInSeconds ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_isBackendCommFailureRetriable ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_backendCommBackoff_onErrorWithRetryAfter ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_backendCommRetry_max_attempts ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_backendCommRetry_max_duration ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_backendCommRetry_mock_server ),
     };
 
     return cmocka_run_group_tests( tests, NULL, NULL );
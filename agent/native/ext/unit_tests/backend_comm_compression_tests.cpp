@@ -0,0 +1,190 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "backend_comm_compression.h"
+#include <string>
+#include <vector>
+#include <zlib.h>
+#include "cmocka_wrapped_for_unit_tests.h"
+#include "unit_test_util.h"
+#include "mock_assert.h"
+
+static
+std::string buildNdjsonForTests( size_t linesCount )
+{
+    std::string result = "{\"metadata\":{\"service\":{\"name\":\"test_service\"}}}\n";
+    ELASTIC_APM_FOR_EACH_INDEX( i, linesCount )
+    {
+        result += "{\"span\":{\"id\":\"" + std::to_string( i ) + "\",\"name\":\"SELECT * FROM test_table\",\"type\":\"db\"}}\n";
+    }
+    return result;
+}
+
+static
+std::string decompressForTests( StringView compressed )
+{
+    z_stream zStream = {};
+    // 15 + 32 makes zlib detect gzip or zlib wrapper automatically
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( inflateInit2( &zStream, 15 + 32 ), Z_OK );
+
+    std::string result;
+    std::vector<char> chunk( 4 * 1024 );
+    zStream.next_in = (Bytef*)( compressed.begin );
+    zStream.avail_in = (uInt)( compressed.length );
+    int zlibRetVal;
+    do {
+        zStream.next_out = (Bytef*)( chunk.data() );
+        zStream.avail_out = (uInt)( chunk.size() );
+        zlibRetVal = inflate( &zStream, Z_NO_FLUSH );
+        ELASTIC_APM_CMOCKA_ASSERT( zlibRetVal == Z_OK || zlibRetVal == Z_STREAM_END );
+        result.append( chunk.data(), chunk.size() - zStream.avail_out );
+    } while ( zlibRetVal != Z_STREAM_END );
+
+    inflateEnd( &zStream );
+    return result;
+}
+
+static
+void test_backendCommCompressionToContentEncoding( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    ELASTIC_APM_CMOCKA_ASSERT_NULL_PTR( backendCommCompressionToContentEncoding( backendCommCompression_off ) );
+    ELASTIC_APM_CMOCKA_ASSERT_STRING_EQUAL( backendCommCompressionToContentEncoding( backendCommCompression_gzip ), "gzip", "compression: %s", "gzip" );
+    ELASTIC_APM_CMOCKA_ASSERT_STRING_EQUAL( backendCommCompressionToContentEncoding( backendCommCompression_deflate ), "deflate", "compression: %s", "deflate" );
+}
+
+static
+void test_backendCommCompressor_round_trip( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    BackendCommCompression compressions[] = { backendCommCompression_gzip, backendCommCompression_deflate };
+    int levels[] = { ELASTIC_APM_BACKEND_COMM_COMPRESSION_MIN_LEVEL, 1, ELASTIC_APM_BACKEND_COMM_COMPRESSION_DEFAULT_LEVEL, ELASTIC_APM_BACKEND_COMM_COMPRESSION_MAX_LEVEL };
+    size_t linesCounts[] = { 0, 1, 100, 10 * 1000 };
+
+    ELASTIC_APM_FOR_EACH_INDEX( compressionIndex, ELASTIC_APM_STATIC_ARRAY_SIZE( compressions ) )
+    {
+        ELASTIC_APM_FOR_EACH_INDEX( levelIndex, ELASTIC_APM_STATIC_ARRAY_SIZE( levels ) )
+        {
+            BackendCommCompressor compressor = ELASTIC_APM_DEFAULT_BACKEND_COMM_COMPRESSOR;
+            ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommCompressor_init( &compressor, compressions[ compressionIndex ], levels[ levelIndex ] ) );
+
+            UInt64 expectedUncompressedBytesTotal = 0;
+            UInt64 expectedCompressedBytesTotal = 0;
+            // The same compressor is reused for a few batches the same way it is reused by the connection
+            ELASTIC_APM_FOR_EACH_INDEX( linesCountIndex, ELASTIC_APM_STATIC_ARRAY_SIZE( linesCounts ) )
+            {
+                std::string input = buildNdjsonForTests( linesCounts[ linesCountIndex ] );
+                StringView output = ELASTIC_APM_EMPTY_STRING_VIEW;
+                ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommCompressor_compress( &compressor, makeStringView( input.data(), input.length() ), /* out */ &output ) );
+                ELASTIC_APM_CMOCKA_ASSERT( output.length >= 2 );
+
+                if ( compressions[ compressionIndex ] == backendCommCompression_gzip )
+                {
+                    // gzip magic number
+                    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( (unsigned char)( output.begin[ 0 ] ), 0x1F );
+                    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( (unsigned char)( output.begin[ 1 ] ), 0x8B );
+                }
+                else
+                {
+                    // zlib header: CM = 8 (deflate) and header checksum is a multiple of 31
+                    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( (unsigned char)( output.begin[ 0 ] ) & 0x0F, 8 );
+                    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( ( ( (unsigned char)( output.begin[ 0 ] ) << 8 ) | (unsigned char)( output.begin[ 1 ] ) ) % 31, 0 );
+                }
+
+                if ( levels[ levelIndex ] != ELASTIC_APM_BACKEND_COMM_COMPRESSION_MIN_LEVEL && linesCounts[ linesCountIndex ] >= 100 )
+                {
+                    ELASTIC_APM_CMOCKA_ASSERT_INT_LESS_THAN( output.length, input.length() / 2 );
+                }
+
+                std::string decompressed = decompressForTests( output );
+                ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( decompressed.length(), input.length() );
+                ELASTIC_APM_CMOCKA_ASSERT( decompressed == input );
+
+                expectedUncompressedBytesTotal += input.length();
+                expectedCompressedBytesTotal += output.length;
+                ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( compressor.uncompressedBytesTotal, expectedUncompressedBytesTotal );
+                ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( compressor.compressedBytesTotal, expectedCompressedBytesTotal );
+            }
+
+            backendCommCompressor_cleanup( &compressor );
+            ELASTIC_APM_CMOCKA_ASSERT_NULL_PTR( compressor.zStream );
+            ELASTIC_APM_CMOCKA_ASSERT_NULL_PTR( compressor.outputBuffer );
+        }
+    }
+}
+
+static
+void test_backendCommCompressor_stream( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    BackendCommCompression compressions[] = { backendCommCompression_gzip, backendCommCompression_deflate };
+    int levels[] = { ELASTIC_APM_BACKEND_COMM_COMPRESSION_MIN_LEVEL, ELASTIC_APM_BACKEND_COMM_COMPRESSION_DEFAULT_LEVEL };
+    size_t linesCounts[] = { 0, 1, 100, 10 * 1000 };
+
+    ELASTIC_APM_FOR_EACH_INDEX( compressionIndex, ELASTIC_APM_STATIC_ARRAY_SIZE( compressions ) )
+    {
+        ELASTIC_APM_FOR_EACH_INDEX( levelIndex, ELASTIC_APM_STATIC_ARRAY_SIZE( levels ) )
+        {
+            BackendCommCompressor compressor = ELASTIC_APM_DEFAULT_BACKEND_COMM_COMPRESSOR;
+            ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommCompressor_init( &compressor, compressions[ compressionIndex ], levels[ levelIndex ] ) );
+
+            // The same compressor is reused for a few streams the same way it is reused for a few streaming requests
+            ELASTIC_APM_REPEAT_N_TIMES( 2 )
+            {
+                std::string input;
+                std::string compressed;
+                ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommCompressor_beginStream( &compressor ) );
+                ELASTIC_APM_FOR_EACH_INDEX( linesCountIndex, ELASTIC_APM_STATIC_ARRAY_SIZE( linesCounts ) )
+                {
+                    std::string chunk = buildNdjsonForTests( linesCounts[ linesCountIndex ] );
+                    StringView output = ELASTIC_APM_EMPTY_STRING_VIEW;
+                    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS(
+                            backendCommCompressor_compressStreamChunk( &compressor, makeStringView( chunk.data(), chunk.length() ), /* isLastChunk */ false, /* out */ &output ) );
+                    input += chunk;
+                    compressed.append( output.begin, output.length );
+                }
+                // The stream is terminated by an empty last chunk the same way streaming request does it
+                StringView output = ELASTIC_APM_EMPTY_STRING_VIEW;
+                ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommCompressor_compressStreamChunk( &compressor, ELASTIC_APM_EMPTY_STRING_VIEW, /* isLastChunk */ true, /* out */ &output ) );
+                compressed.append( output.begin, output.length );
+
+                std::string decompressed = decompressForTests( makeStringView( compressed.data(), compressed.length() ) );
+                ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( decompressed.length(), input.length() );
+                ELASTIC_APM_CMOCKA_ASSERT( decompressed == input );
+            }
+
+            backendCommCompressor_cleanup( &compressor );
+        }
+    }
+}
+
+int run_backend_comm_compression_tests()
+{
+    const struct CMUnitTest tests [] =
+    {
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_backendCommCompressionToContentEncoding ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_backendCommCompressor_round_trip ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_backendCommCompressor_stream ),
+    };
+
+    return cmocka_run_group_tests( tests, NULL, NULL );
+}
@@ -0,0 +1,89 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "backend_comm_curl_share.h"
+#include "cmocka_wrapped_for_unit_tests.h"
+#include "unit_test_util.h"
+#include "mock_assert.h"
+
+static
+void test_init_and_cleanup( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    ELASTIC_APM_CMOCKA_ASSERT( getBackendCommCurlShare() == NULL );
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( initBackendCommCurlShare() );
+    ELASTIC_APM_CMOCKA_ASSERT( getBackendCommCurlShare() != NULL );
+
+    resetBackendCommCurlShareInForkedChild();
+    ELASTIC_APM_CMOCKA_ASSERT( getBackendCommCurlShare() != NULL );
+
+    cleanupBackendCommCurlShare();
+    ELASTIC_APM_CMOCKA_ASSERT( getBackendCommCurlShare() == NULL );
+    // It's allowed to call cleanup when there is no share object
+    cleanupBackendCommCurlShare();
+}
+
+static
+CURL* newCurlHandleWithShare( String url )
+{
+    CURL* curlHandle = curl_easy_init();
+    ELASTIC_APM_CMOCKA_ASSERT( curlHandle != NULL );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( curl_easy_setopt( curlHandle, CURLOPT_SHARE, getBackendCommCurlShare() ), CURLE_OK );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( curl_easy_setopt( curlHandle, CURLOPT_URL, url ), CURLE_OK );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( curl_easy_setopt( curlHandle, CURLOPT_CONNECTTIMEOUT_MS, 1000L ), CURLE_OK );
+    return curlHandle;
+}
+
+static
+void test_dns_cache_is_shared_between_handles( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    // Nothing listens on port 1 so both requests fail but the way they fail shows whether the host name was resolved
+    String url = "http://elastic-apm-curl-share-test.invalid:1/";
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( initBackendCommCurlShare() );
+
+    CURL* resolvingHandle = newCurlHandleWithShare( url );
+    struct curl_slist* resolve = curl_slist_append( NULL, "elastic-apm-curl-share-test.invalid:1:127.0.0.1" );
+    ELASTIC_APM_CMOCKA_ASSERT( resolve != NULL );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( curl_easy_setopt( resolvingHandle, CURLOPT_RESOLVE, resolve ), CURLE_OK );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( curl_easy_perform( resolvingHandle ), CURLE_COULDNT_CONNECT );
+    curl_easy_cleanup( resolvingHandle );
+    curl_slist_free_all( resolve );
+
+    // This handle can find the host name only in the shared DNS cache
+    CURL* handleUsingCache = newCurlHandleWithShare( url );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( curl_easy_perform( handleUsingCache ), CURLE_COULDNT_CONNECT );
+    curl_easy_cleanup( handleUsingCache );
+
+    cleanupBackendCommCurlShare();
+    ELASTIC_APM_CMOCKA_ASSERT( getBackendCommCurlShare() == NULL );
+}
+
+int run_backend_comm_curl_share_tests()
+{
+    const struct CMUnitTest tests [] =
+    {
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_init_and_cleanup ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_dns_cache_is_shared_between_handles ),
+    };
+
+    return cmocka_run_group_tests( tests, NULL, NULL );
+}
@@ -0,0 +1,424 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "backend_comm_queue.h"
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cmocka_wrapped_for_unit_tests.h"
+#include "unit_test_util.h"
+#include "mock_assert.h"
+
+static
+std::string buildSerializedEventsForTests( size_t size, char fillChar )
+{
+    return std::string( size, fillChar );
+}
+
+static
+UInt64 pushToDataToSendQueueForTests( DataToSendQueue* queue, StringView userAgentHttpHeader, StringView serializedEvents )
+{
+    DataToSendNode* node = NULL;
+    UInt64 id = 0;
+    size_t totalSize = 0;
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( newDataToSendNode( userAgentHttpHeader, serializedEvents, /* out */ &node ) );
+    ELASTIC_APM_CMOCKA_ASSERT( tryPushNodeToDataToSendQueue( queue, /* maxTotalSize */ SIZE_MAX, node, /* out */ &id, /* out */ &totalSize ) );
+    return id;
+}
+
+static
+void test_DataToSendQueue_fifo( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    DataToSendQueue queue;
+    initDataToSendQueue( &queue );
+    ELASTIC_APM_CMOCKA_ASSERT( isDataToSendQueueEmpty( &queue ) );
+    ELASTIC_APM_CMOCKA_ASSERT_NULL_PTR( getFirstNodeInDataToSendQueue( &queue ) );
+
+    size_t sizes[] = { 0, 1, 100, 64 * 1024 };
+    std::string userAgentHttpHeader = "User-Agent: elasticapm-php/1.2.3";
+    size_t expectedTotalSize = 0;
+    ELASTIC_APM_FOR_EACH_INDEX( i, ELASTIC_APM_STATIC_ARRAY_SIZE( sizes ) )
+    {
+        std::string serializedEvents = buildSerializedEventsForTests( sizes[ i ], (char)( 'a' + i ) );
+        UInt64 id = pushToDataToSendQueueForTests( &queue
+                                                   , makeStringView( userAgentHttpHeader.data(), userAgentHttpHeader.length() )
+                                                   , makeStringView( serializedEvents.data(), serializedEvents.length() ) );
+        ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( id, i + 1 );
+        expectedTotalSize += sizes[ i ];
+        ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( getDataToSendQueueTotalSize( &queue ), expectedTotalSize );
+        // Pushed nodes are not visible to the consumer until they are moved from the intake
+        ELASTIC_APM_CMOCKA_ASSERT( isDataToSendQueueEmpty( &queue ) );
+    }
+    ELASTIC_APM_CMOCKA_ASSERT( ! isDataToSendQueueIntakeEmpty( &queue ) );
+
+    // Move in two steps to check that moving appends to the nodes already in the list
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( moveDataToSendQueueIntakeToList( &queue ), ELASTIC_APM_STATIC_ARRAY_SIZE( sizes ) );
+    ELASTIC_APM_CMOCKA_ASSERT( isDataToSendQueueIntakeEmpty( &queue ) );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( moveDataToSendQueueIntakeToList( &queue ), 0 );
+
+    ELASTIC_APM_FOR_EACH_INDEX( i, ELASTIC_APM_STATIC_ARRAY_SIZE( sizes ) )
+    {
+        const DataToSendNode* node = getFirstNodeInDataToSendQueue( &queue );
+        ELASTIC_APM_CMOCKA_ASSERT_VALID_PTR( node );
+        ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( node->id, i + 1 );
+
+        ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( node->userAgentHttpHeader.size, userAgentHttpHeader.length() + 1 );
+        ELASTIC_APM_CMOCKA_ASSERT_STRING_EQUAL( node->userAgentHttpHeader.begin, userAgentHttpHeader.c_str(), "i: %u", (unsigned)i );
+
+        std::string expectedSerializedEvents = buildSerializedEventsForTests( sizes[ i ], (char)( 'a' + i ) );
+        ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( node->serializedEvents.size, expectedSerializedEvents.length() + 1 );
+        ELASTIC_APM_CMOCKA_ASSERT( memcmp( node->serializedEvents.begin, expectedSerializedEvents.data(), expectedSerializedEvents.length() ) == 0 );
+        ELASTIC_APM_CMOCKA_ASSERT_CHAR_EQUAL( node->serializedEvents.begin[ expectedSerializedEvents.length() ], '\0' );
+
+        ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( removeFirstNodeInDataToSendQueue( &queue ), sizes[ i ] );
+        expectedTotalSize -= sizes[ i ];
+        ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( getDataToSendQueueTotalSize( &queue ), expectedTotalSize );
+    }
+
+    ELASTIC_APM_CMOCKA_ASSERT( isDataToSendQueueEmpty( &queue ) );
+    freeDataToSendQueue( &queue );
+}
+
+static
+void test_DataToSendQueue_max_total_size( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    DataToSendQueue queue;
+    initDataToSendQueue( &queue );
+    size_t maxTotalSize = 10;
+    StringView serializedEvents = makeStringView( "0123456", 7 );
+    DataToSendNode* node = NULL;
+    UInt64 id = 0;
+    size_t totalSize = 0;
+
+    // Events are accepted as long as the size of the already queued events is below max - the same as before
+    // so the last accepted batch can take the total size above max
+    ELASTIC_APM_REPEAT_N_TIMES( 2 )
+    {
+        ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( newDataToSendNode( makeStringView( "UA", 2 ), serializedEvents, /* out */ &node ) );
+        ELASTIC_APM_CMOCKA_ASSERT( tryPushNodeToDataToSendQueue( &queue, maxTotalSize, node, /* out */ &id, /* out */ &totalSize ) );
+        node = NULL;
+    }
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( totalSize, 2 * serializedEvents.length );
+
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( newDataToSendNode( makeStringView( "UA", 2 ), serializedEvents, /* out */ &node ) );
+    ELASTIC_APM_CMOCKA_ASSERT( ! tryPushNodeToDataToSendQueue( &queue, maxTotalSize, node, /* out */ &id, /* out */ &totalSize ) );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( totalSize, 2 * serializedEvents.length );
+    // The node that was not pushed is still owned by the caller
+    freeDataToSendNode( &node );
+
+    moveDataToSendQueueIntakeToList( &queue );
+    removeFirstNodeInDataToSendQueue( &queue );
+    removeFirstNodeInDataToSendQueue( &queue );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( getDataToSendQueueTotalSize( &queue ), 0 );
+
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( newDataToSendNode( makeStringView( "UA", 2 ), serializedEvents, /* out */ &node ) );
+    ELASTIC_APM_CMOCKA_ASSERT( tryPushNodeToDataToSendQueue( &queue, maxTotalSize, node, /* out */ &id, /* out */ &totalSize ) );
+
+    freeDataToSendQueue( &queue );
+}
+
+static
+void test_DataToSendQueue_multiple_producers( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    enum { producersCount = 4, batchesPerProducerCount = 2000 };
+    DataToSendQueue queue;
+    initDataToSendQueue( &queue );
+    std::vector< DataToSendNode* > nodesToPush[ producersCount ];
+    std::vector< std::thread > producers;
+
+    // Nodes are allocated up front so that producer threads do nothing but push and contention on the queue is as high as possible
+    ELASTIC_APM_FOR_EACH_INDEX( producerIndex, producersCount )
+    {
+        std::string userAgentHttpHeader = "producer " + std::to_string( producerIndex );
+        ELASTIC_APM_FOR_EACH_INDEX( batchIndex, batchesPerProducerCount )
+        {
+            std::string serializedEvents = std::to_string( batchIndex );
+            DataToSendNode* node = NULL;
+            ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS(
+                    newDataToSendNode( makeStringView( userAgentHttpHeader.data(), userAgentHttpHeader.length() )
+                                       , makeStringView( serializedEvents.data(), serializedEvents.length() )
+                                       , /* out */ &node ) );
+            nodesToPush[ producerIndex ].push_back( node );
+        }
+    }
+
+    ELASTIC_APM_FOR_EACH_INDEX( producerIndex, producersCount )
+    {
+        producers.emplace_back(
+                [ &queue, &nodesToPush, producerIndex ]()
+                {
+                    for ( DataToSendNode* node : nodesToPush[ producerIndex ] )
+                    {
+                        UInt64 id;
+                        size_t totalSize;
+                        tryPushNodeToDataToSendQueue( &queue, /* maxTotalSize */ SIZE_MAX, node, /* out */ &id, /* out */ &totalSize );
+                    }
+                } );
+    }
+
+    // The consumer runs concurrently with producers and checks that batches from each producer are received in the order they were pushed
+    size_t nextExpectedBatchIndex[ producersCount ] = {};
+    size_t receivedCount = 0;
+    while ( receivedCount != producersCount * batchesPerProducerCount )
+    {
+        moveDataToSendQueueIntakeToList( &queue );
+        const DataToSendNode* node = getFirstNodeInDataToSendQueue( &queue );
+        if ( node == NULL )
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        size_t producerIndex = (size_t) atoi( node->userAgentHttpHeader.begin + strlen( "producer " ) );
+        ELASTIC_APM_CMOCKA_ASSERT_INT_LESS_THAN( producerIndex, producersCount );
+        ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( (size_t) atoi( node->serializedEvents.begin ), nextExpectedBatchIndex[ producerIndex ] );
+        ++nextExpectedBatchIndex[ producerIndex ];
+        removeFirstNodeInDataToSendQueue( &queue );
+        ++receivedCount;
+    }
+
+    for ( std::thread& producer : producers )
+    {
+        producer.join();
+    }
+
+    ELASTIC_APM_CMOCKA_ASSERT( isDataToSendQueueIntakeEmpty( &queue ) );
+    ELASTIC_APM_CMOCKA_ASSERT( isDataToSendQueueEmpty( &queue ) );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( getDataToSendQueueTotalSize( &queue ), 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( queue.nextNodeId.load(), producersCount * batchesPerProducerCount + 1 );
+    freeDataToSendQueue( &queue );
+}
+
+static
+void test_classifySerializedEvents( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    std::string metadataLine = R"({"metadata":{"service":{"name":"test"}}})";
+    std::string spanLine = R"({"span":{"id":"1"}})";
+    std::string errorLine = R"({"error":{"id":"2"}})";
+    std::string metricsetLine = R"({"metricset":{"samples":{}}})";
+    std::string transactionLine = R"({"transaction":{"id":"3"}})";
+    std::string unknownLine = R"({"log":{}})";
+    std::string serializedEvents = metadataLine + "\n" + spanLine + "\n" + spanLine + "\n" + errorLine + "\n" + metricsetLine + "\n" + transactionLine + "\n" + unknownLine;
+
+    SerializedEventsClassification classification;
+    classifySerializedEvents( makeStringView( serializedEvents.data(), serializedEvents.length() ), /* out */ &classification );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( classification.metadataLineLength, metadataLine.length() );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( classification.eventsCount[ backendCommEventClass_span ], 2 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( classification.eventsSize[ backendCommEventClass_span ], 2 * ( spanLine.length() + 1 ) );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( classification.eventsCount[ backendCommEventClass_metricset ], 1 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( classification.eventsSize[ backendCommEventClass_metricset ], metricsetLine.length() + 1 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( classification.eventsCount[ backendCommEventClass_error ], 1 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( classification.eventsCount[ backendCommEventClass_transaction ], 1 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( classification.eventsCount[ backendCommEventClass_other ], 1 );
+
+    // Batch with only the metadata line
+    classifySerializedEvents( makeStringView( metadataLine.data(), metadataLine.length() ), /* out */ &classification );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( classification.metadataLineLength, metadataLine.length() );
+    ELASTIC_APM_FOR_EACH_INDEX( eventClass, numberOfBackendCommEventClasses )
+    {
+        ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( classification.eventsCount[ eventClass ], 0 );
+    }
+
+    std::string userAgentHttpHeader = "User-Agent: elasticapm-php/1.2.3";
+    struct
+    {
+        BackendCommEventClass minEventClassToKeep;
+        std::string expectedSerializedEvents;
+    } filterCases[] =
+    {
+        { backendCommEventClass_span, serializedEvents },
+        { backendCommEventClass_metricset, metadataLine + "\n" + errorLine + "\n" + metricsetLine + "\n" + transactionLine + "\n" + unknownLine },
+        { backendCommEventClass_error, metadataLine + "\n" + errorLine + "\n" + transactionLine + "\n" + unknownLine },
+        { backendCommEventClass_other, metadataLine + "\n" + unknownLine },
+    };
+    classifySerializedEvents( makeStringView( serializedEvents.data(), serializedEvents.length() ), /* out */ &classification );
+    ELASTIC_APM_FOR_EACH_INDEX( i, ELASTIC_APM_STATIC_ARRAY_SIZE( filterCases ) )
+    {
+        DataToSendNode* node = NULL;
+        ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS(
+                newFilteredDataToSendNode( makeStringView( userAgentHttpHeader.data(), userAgentHttpHeader.length() )
+                                           , makeStringView( serializedEvents.data(), serializedEvents.length() )
+                                           , &classification
+                                           , filterCases[ i ].minEventClassToKeep
+                                           , /* out */ &node ) );
+        ELASTIC_APM_CMOCKA_ASSERT_STRING_EQUAL( node->serializedEvents.begin, filterCases[ i ].expectedSerializedEvents.c_str(), "i: %d", (int) i );
+        ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( node->serializedEvents.size, filterCases[ i ].expectedSerializedEvents.length() + 1 );
+        ELASTIC_APM_CMOCKA_ASSERT_STRING_EQUAL( node->userAgentHttpHeader.begin, userAgentHttpHeader.c_str(), "i: %d", (int) i );
+        freeDataToSendNode( &node );
+    }
+}
+
+static
+void test_DataToSendQueue_free_non_empty( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    DataToSendQueue queue;
+    initDataToSendQueue( &queue );
+
+    ELASTIC_APM_REPEAT_N_TIMES( 3 )
+    {
+        pushToDataToSendQueueForTests( &queue, makeStringView( "UA", 2 ), makeStringView( "{}\n", 3 ) );
+    }
+    moveDataToSendQueueIntakeToList( &queue );
+    ELASTIC_APM_REPEAT_N_TIMES( 2 )
+    {
+        pushToDataToSendQueueForTests( &queue, makeStringView( "UA", 2 ), makeStringView( "{}\n", 3 ) );
+    }
+
+    // Nodes both in the list and in the intake should be freed
+    freeDataToSendQueue( &queue );
+    ELASTIC_APM_CMOCKA_ASSERT( isDataToSendQueueEmpty( &queue ) );
+}
+
+#ifdef ELASTIC_APM_UNIT_TESTS_BENCHMARKS
+
+struct LegacyDataToSendNode
+{
+    LegacyDataToSendNode* next;
+    char* userAgentHttpHeader;
+    char* serializedEvents;
+};
+
+static
+char* legacyDupMallocStringView( const std::string& src )
+{
+    char* dst = (char*)malloc( src.length() + 1 );
+    memcpy( dst, src.data(), src.length() );
+    dst[ src.length() ] = '\0';
+    return dst;
+}
+
+/**
+ * Not a pass/fail test - it prints enqueue latency and the time spent in the part shared with the other threads for different payload sizes
+ * for the way events were queued before (node and both strings allocated and copied while holding the lock)
+ * and the way they are queued now (single allocation and copy before the node is pushed to the lock-free queue).
+ */
+static
+void test_DataToSendQueue_enqueue_benchmark( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    typedef std::chrono::steady_clock Clock;
+    std::mutex mtx;
+    size_t payloadSizes[] = { 1024, 16 * 1024, 128 * 1024, 1024 * 1024 };
+    enum { iterationsCount = 100 };
+    std::string userAgentHttpHeader = "User-Agent: elasticapm-php/1.2.3";
+
+    printf( "%12s | %26s | %26s\n", "", "before (ns/op)", "after (ns/op)" );
+    printf( "%12s | %12s %13s | %12s %13s\n", "payload size", "enqueue", "lock held", "enqueue", "push" );
+
+    ELASTIC_APM_FOR_EACH_INDEX( payloadSizeIndex, ELASTIC_APM_STATIC_ARRAY_SIZE( payloadSizes ) )
+    {
+        std::string serializedEvents = buildSerializedEventsForTests( payloadSizes[ payloadSizeIndex ], 'x' );
+        Clock::duration legacyEnqueueTotal = Clock::duration::zero();
+        Clock::duration legacyLockHeldTotal = Clock::duration::zero();
+        Clock::duration enqueueTotal = Clock::duration::zero();
+        Clock::duration pushTotal = Clock::duration::zero();
+
+        LegacyDataToSendNode* legacyQueueHead = NULL;
+        DataToSendQueue queue;
+        initDataToSendQueue( &queue );
+
+        ELASTIC_APM_REPEAT_N_TIMES( iterationsCount )
+        {
+            {
+                Clock::time_point enqueueStart = Clock::now();
+                mtx.lock();
+                Clock::time_point lockAcquired = Clock::now();
+                LegacyDataToSendNode* node = (LegacyDataToSendNode*)malloc( sizeof( LegacyDataToSendNode ) );
+                node->userAgentHttpHeader = legacyDupMallocStringView( userAgentHttpHeader );
+                node->serializedEvents = legacyDupMallocStringView( serializedEvents );
+                node->next = legacyQueueHead;
+                legacyQueueHead = node;
+                Clock::time_point lockReleased = Clock::now();
+                mtx.unlock();
+                legacyEnqueueTotal += lockReleased - enqueueStart;
+                legacyLockHeldTotal += lockReleased - lockAcquired;
+            }
+
+            {
+                Clock::time_point enqueueStart = Clock::now();
+                DataToSendNode* node = NULL;
+                ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS(
+                        newDataToSendNode( makeStringView( userAgentHttpHeader.data(), userAgentHttpHeader.length() )
+                                           , makeStringView( serializedEvents.data(), serializedEvents.length() )
+                                           , /* out */ &node ) );
+                UInt64 id;
+                size_t totalSize;
+                Clock::time_point pushStart = Clock::now();
+                ELASTIC_APM_CMOCKA_ASSERT( tryPushNodeToDataToSendQueue( &queue, /* maxTotalSize */ SIZE_MAX, node, /* out */ &id, /* out */ &totalSize ) );
+                Clock::time_point pushEnd = Clock::now();
+                enqueueTotal += pushEnd - enqueueStart;
+                pushTotal += pushEnd - pushStart;
+            }
+        }
+
+        while ( legacyQueueHead != NULL )
+        {
+            LegacyDataToSendNode* next = legacyQueueHead->next;
+            free( legacyQueueHead->userAgentHttpHeader );
+            free( legacyQueueHead->serializedEvents );
+            free( legacyQueueHead );
+            legacyQueueHead = next;
+        }
+        freeDataToSendQueue( &queue );
+
+        auto toNanosPerOp = []( Clock::duration total ) -> long long
+        {
+            return (long long)( std::chrono::duration_cast< std::chrono::nanoseconds >( total ).count() / iterationsCount );
+        };
+        printf( "%12zu | %12lld %13lld | %12lld %13lld\n"
+                , payloadSizes[ payloadSizeIndex ]
+                , toNanosPerOp( legacyEnqueueTotal ), toNanosPerOp( legacyLockHeldTotal )
+                , toNanosPerOp( enqueueTotal ), toNanosPerOp( pushTotal ) );
+    }
+}
+
+#endif // #ifdef ELASTIC_APM_UNIT_TESTS_BENCHMARKS
+
+int run_backend_comm_queue_tests()
+{
+    const struct CMUnitTest tests [] =
+    {
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_DataToSendQueue_fifo ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_DataToSendQueue_max_total_size ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_DataToSendQueue_multiple_producers ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_classifySerializedEvents ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_DataToSendQueue_free_non_empty ),
+        #ifdef ELASTIC_APM_UNIT_TESTS_BENCHMARKS
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_DataToSendQueue_enqueue_benchmark ),
+        #endif
+    };
+
+    return cmocka_run_group_tests( tests, NULL, NULL );
+}
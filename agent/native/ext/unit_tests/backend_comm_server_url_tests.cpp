@@ -0,0 +1,193 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "backend_comm_server_url.h"
+#include <string>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "cmocka_wrapped_for_unit_tests.h"
+#include "unit_test_util.h"
+#include "mock_assert.h"
+
+static
+void test_isUnixSocketServerUrl( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    String socketPath = NULL;
+    ELASTIC_APM_CMOCKA_ASSERT( isUnixSocketServerUrl( "unix:///var/run/apm-server.sock", /* out */ &socketPath ) );
+    ELASTIC_APM_CMOCKA_ASSERT_STRING_VIEW_EQUAL_LITERAL( stringToView( socketPath ), "/var/run/apm-server.sock" );
+    ELASTIC_APM_CMOCKA_ASSERT( isUnixSocketServerUrl( "UNIX:///a", /* out */ &socketPath ) );
+    ELASTIC_APM_CMOCKA_ASSERT_STRING_VIEW_EQUAL_LITERAL( stringToView( socketPath ), "/a" );
+    ELASTIC_APM_CMOCKA_ASSERT( isUnixSocketServerUrl( "unix://", /* out */ &socketPath ) );
+    ELASTIC_APM_CMOCKA_ASSERT_STRING_VIEW_EQUAL_LITERAL( stringToView( socketPath ), "" );
+
+    ELASTIC_APM_CMOCKA_ASSERT( ! isUnixSocketServerUrl( "http://localhost:8200", /* out */ &socketPath ) );
+    ELASTIC_APM_CMOCKA_ASSERT( ! isUnixSocketServerUrl( "https://unix:8200", /* out */ &socketPath ) );
+    ELASTIC_APM_CMOCKA_ASSERT( ! isUnixSocketServerUrl( "unix:/a", /* out */ &socketPath ) );
+    ELASTIC_APM_CMOCKA_ASSERT( ! isUnixSocketServerUrl( NULL, /* out */ &socketPath ) );
+}
+
+static
+void test_buildIntakeApiUrl( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    char url[ intakeApiUrlBufferSize ];
+
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( buildIntakeApiUrl( "http://localhost:8200", /* out */ url ) );
+    ELASTIC_APM_CMOCKA_ASSERT_STRING_VIEW_EQUAL_LITERAL( stringToView( url ), "http://localhost:8200/intake/v2/events" );
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( buildIntakeApiUrl( "https://apm.example.com:443/prefix/", /* out */ url ) );
+    ELASTIC_APM_CMOCKA_ASSERT_STRING_VIEW_EQUAL_LITERAL( stringToView( url ), "https://apm.example.com:443/prefix/intake/v2/events" );
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( buildIntakeApiUrl( "unix:///var/run/apm-server.sock", /* out */ url ) );
+    ELASTIC_APM_CMOCKA_ASSERT_STRING_VIEW_EQUAL_LITERAL( stringToView( url ), "http://localhost/intake/v2/events" );
+
+    std::string tooLongServerUrl = "http://" + std::string( intakeApiUrlBufferSize, 'a' );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( buildIntakeApiUrl( tooLongServerUrl.c_str(), /* out */ url ), resultFailure );
+}
+
+/**
+ * Stand-in for APM Server listening on Unix domain socket.
+ * Runs in a child process - accepts one connection, reads one request and responds with 202 Accepted.
+ * Exit code is 0 only if the request is for intake API and has the expected body.
+ */
+static
+int runUnixSocketStandInServer( int listenFd, const std::string& expectedBody )
+{
+    int connectionFd = accept( listenFd, NULL, NULL );
+    if ( connectionFd < 0 )
+    {
+        return 1;
+    }
+
+    std::string request;
+    char buffer[ 4096 ];
+    size_t headersEnd = std::string::npos;
+    while ( headersEnd == std::string::npos || request.length() < headersEnd + 4 + expectedBody.length() )
+    {
+        ssize_t readRetVal = read( connectionFd, buffer, sizeof( buffer ) );
+        if ( readRetVal <= 0 )
+        {
+            return 2;
+        }
+        request.append( buffer, (size_t) readRetVal );
+        headersEnd = request.find( "\r\n\r\n" );
+    }
+
+    if ( request.rfind( "POST /intake/v2/events HTTP/1.1\r\n", 0 ) != 0 )
+    {
+        return 3;
+    }
+    if ( request.find( "\r\nHost: localhost\r\n" ) == std::string::npos )
+    {
+        return 4;
+    }
+    if ( request.substr( headersEnd + 4 ) != expectedBody )
+    {
+        return 5;
+    }
+
+    const char response[] = "HTTP/1.1 202 Accepted\r\nContent-Length: 0\r\n\r\n";
+    if ( write( connectionFd, response, sizeof( response ) - 1 ) != (ssize_t) ( sizeof( response ) - 1 ) )
+    {
+        return 6;
+    }
+    close( connectionFd );
+    return 0;
+}
+
+static
+void test_setIntakeApiUrlCurlOptions_unix_socket_stand_in_server( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    String tmpDir = getenv( "TMPDIR" );
+    std::string socketPath = std::string( ( tmpDir == NULL || tmpDir[ 0 ] == '\0' ) ? "/tmp" : tmpDir ) + "/elastic_apm_server_url_unit_tests_" + std::to_string( getpid() ) + ".sock";
+    std::string serverUrl = ELASTIC_APM_UNIX_SOCKET_SERVER_URL_PREFIX + socketPath;
+    std::string body = "{\"metadata\":{}}\n{\"span\":{}}\n";
+
+    struct sockaddr_un address;
+    memset( &address, 0, sizeof( address ) );
+    address.sun_family = AF_UNIX;
+    ELASTIC_APM_CMOCKA_ASSERT( socketPath.length() < sizeof( address.sun_path ) );
+    memcpy( address.sun_path, socketPath.c_str(), socketPath.length() + 1 );
+    unlink( socketPath.c_str() );
+    int listenFd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    ELASTIC_APM_CMOCKA_ASSERT( listenFd >= 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( bind( listenFd, (const struct sockaddr*) &address, sizeof( address ) ), 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( listen( listenFd, /* backlog */ 1 ), 0 );
+
+    pid_t serverPid = fork();
+    ELASTIC_APM_CMOCKA_ASSERT( serverPid >= 0 );
+    if ( serverPid == 0 )
+    {
+        _exit( runUnixSocketStandInServer( listenFd, body ) );
+    }
+    close( listenFd );
+
+    CURL* curlHandle = curl_easy_init();
+    ELASTIC_APM_CMOCKA_ASSERT( curlHandle != NULL );
+    char url[ intakeApiUrlBufferSize ];
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( setIntakeApiUrlCurlOptions( curlHandle, serverUrl.c_str(), /* out */ url ) );
+    ELASTIC_APM_CMOCKA_ASSERT_STRING_VIEW_EQUAL_LITERAL( stringToView( url ), "http://localhost/intake/v2/events" );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( curl_easy_setopt( curlHandle, CURLOPT_POST, 1L ), CURLE_OK );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( curl_easy_setopt( curlHandle, CURLOPT_POSTFIELDS, body.c_str() ), CURLE_OK );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( curl_easy_setopt( curlHandle, CURLOPT_POSTFIELDSIZE, (long) body.length() ), CURLE_OK );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( curl_easy_setopt( curlHandle, CURLOPT_TIMEOUT_MS, 10000L ), CURLE_OK );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( curl_easy_perform( curlHandle ), CURLE_OK );
+    long httpStatusCode = 0;
+    curl_easy_getinfo( curlHandle, CURLINFO_RESPONSE_CODE, &httpStatusCode );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( httpStatusCode, 202 );
+    curl_easy_cleanup( curlHandle );
+
+    int serverStatus = 0;
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( waitpid( serverPid, &serverStatus, 0 ), serverPid );
+    ELASTIC_APM_CMOCKA_ASSERT( WIFEXITED( serverStatus ) );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( WEXITSTATUS( serverStatus ), 0 );
+    unlink( socketPath.c_str() );
+}
+
+static
+void test_setIntakeApiUrlCurlOptions_empty_socket_path( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    CURL* curlHandle = curl_easy_init();
+    ELASTIC_APM_CMOCKA_ASSERT( curlHandle != NULL );
+    char url[ intakeApiUrlBufferSize ];
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( setIntakeApiUrlCurlOptions( curlHandle, ELASTIC_APM_UNIX_SOCKET_SERVER_URL_PREFIX, /* out */ url ), resultFailure );
+    curl_easy_cleanup( curlHandle );
+}
+
+int run_backend_comm_server_url_tests()
+{
+    const struct CMUnitTest tests [] =
+    {
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_isUnixSocketServerUrl ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_buildIntakeApiUrl ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_setIntakeApiUrlCurlOptions_unix_socket_stand_in_server ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_setIntakeApiUrlCurlOptions_empty_socket_path ),
+    };
+
+    return cmocka_run_group_tests( tests, NULL, NULL );
+}
@@ -0,0 +1,306 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "backend_comm_shared_ring.h"
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "cmocka_wrapped_for_unit_tests.h"
+#include "unit_test_util.h"
+#include "mock_assert.h"
+
+static
+StringView stdStringToView( const std::string& str )
+{
+    return makeStringView( str.data(), str.length() );
+}
+
+static
+void assertAndRemoveFirstSharedRingRecord( BackendCommSharedRing* ring, const std::string& expectedUserAgentHttpHeader, const std::string& expectedSerializedEvents )
+{
+    bool hasFirst = false;
+    StringView userAgentHttpHeader;
+    StringView serializedEvents;
+    TimeSpec timeout;
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( getCurrentAbsTimeSpec( /* out */ &timeout ) );
+    addDelayToAbsTimeSpec( /* in, out */ &timeout, /* delayInNanoseconds */ 10 * 1000 * 1000 * 1000L );
+
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSharedRing_waitForFirst( ring, &timeout, /* out */ &hasFirst, /* out */ &userAgentHttpHeader, /* out */ &serializedEvents ) );
+    ELASTIC_APM_CMOCKA_ASSERT( hasFirst );
+    ELASTIC_APM_CMOCKA_ASSERT( areStringViewsEqual( userAgentHttpHeader, stdStringToView( expectedUserAgentHttpHeader ) ) );
+    ELASTIC_APM_CMOCKA_ASSERT( areStringViewsEqual( serializedEvents, stdStringToView( expectedSerializedEvents ) ) );
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSharedRing_removeFirst( ring ) );
+}
+
+static
+void assertSharedRingIsEmpty( BackendCommSharedRing* ring )
+{
+    BackendCommSharedRingStats stats;
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSharedRing_getStats( ring, /* out */ &stats ) );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( stats.batchesCount, 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( stats.usedSize, 0 );
+
+    // Wait with timeout in the past returns right away
+    bool hasFirst = true;
+    StringView userAgentHttpHeader;
+    StringView serializedEvents;
+    TimeSpec timeout = { .tv_sec = 0, .tv_nsec = 0 };
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSharedRing_waitForFirst( ring, &timeout, /* out */ &hasFirst, /* out */ &userAgentHttpHeader, /* out */ &serializedEvents ) );
+    ELASTIC_APM_CMOCKA_ASSERT( ! hasFirst );
+}
+
+static
+void test_BackendCommSharedRing_fifo_with_wrapping( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    BackendCommSharedRing* ring = NULL;
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( newBackendCommSharedRing( /* capacity */ 1000, /* out */ &ring ) );
+    assertSharedRingIsEmpty( ring );
+
+    // Sizes are not multiples of the alignment and the records don't fit evenly into the buffer
+    // so the buffer wraps around at different offsets
+    size_t sizes[] = { 0, 1, 13, 100, 250, 333 };
+    std::string userAgentHttpHeader = "User-Agent: elasticapm-php/1.2.3";
+    std::vector< std::string > appended;
+    size_t removedCount = 0;
+    ELASTIC_APM_REPEAT_N_TIMES( 20 )
+    {
+        ELASTIC_APM_FOR_EACH_INDEX( i, ELASTIC_APM_STATIC_ARRAY_SIZE( sizes ) )
+        {
+            std::string serializedEvents( sizes[ i ], (char)( 'a' + ( appended.size() % 26 ) ) );
+            // Remove the oldest records until the new one fits
+            while ( backendCommSharedRing_append( ring, stdStringToView( userAgentHttpHeader ), stdStringToView( serializedEvents ) ) != resultSuccess )
+            {
+                ELASTIC_APM_CMOCKA_ASSERT( removedCount < appended.size() );
+                assertAndRemoveFirstSharedRingRecord( ring, userAgentHttpHeader, appended[ removedCount ] );
+                ++removedCount;
+            }
+            appended.push_back( serializedEvents );
+        }
+    }
+
+    while ( removedCount < appended.size() )
+    {
+        assertAndRemoveFirstSharedRingRecord( ring, userAgentHttpHeader, appended[ removedCount ] );
+        ++removedCount;
+    }
+    assertSharedRingIsEmpty( ring );
+
+    deleteBackendCommSharedRingAndSetToNull( &ring );
+    ELASTIC_APM_CMOCKA_ASSERT( ring == NULL );
+}
+
+static
+void test_BackendCommSharedRing_capacity( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    BackendCommSharedRing* ring = NULL;
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( newBackendCommSharedRing( /* capacity */ 1024, /* out */ &ring ) );
+
+    std::string userAgentHttpHeader = "User-Agent: elasticapm-php/1.2.3";
+    // Record that does not fit even into the empty buffer
+    std::string tooBig( 1024, 'x' );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( backendCommSharedRing_append( ring, stdStringToView( userAgentHttpHeader ), stdStringToView( tooBig ) ), resultFailure );
+    assertSharedRingIsEmpty( ring );
+
+    std::string half( 400, 'h' );
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSharedRing_append( ring, stdStringToView( userAgentHttpHeader ), stdStringToView( half ) ) );
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSharedRing_append( ring, stdStringToView( userAgentHttpHeader ), stdStringToView( half ) ) );
+    // Failed append does not change the buffer
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( backendCommSharedRing_append( ring, stdStringToView( userAgentHttpHeader ), stdStringToView( half ) ), resultFailure );
+    BackendCommSharedRingStats stats;
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSharedRing_getStats( ring, /* out */ &stats ) );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( stats.batchesCount, 2 );
+
+    assertAndRemoveFirstSharedRingRecord( ring, userAgentHttpHeader, half );
+    assertAndRemoveFirstSharedRingRecord( ring, userAgentHttpHeader, half );
+    assertSharedRingIsEmpty( ring );
+
+    deleteBackendCommSharedRingAndSetToNull( &ring );
+}
+
+static
+void test_BackendCommSharedRing_sender_election( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    BackendCommSharedRing* ring = NULL;
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( newBackendCommSharedRing( /* capacity */ 4096, /* out */ &ring ) );
+    bool isSender = false;
+    // Time does not advance so only the process being alive matters
+    Int64 currentTime = 0;
+    Int64 senderHeartbeatTimeout = 1000;
+
+    // Fork a child that exits right away to get PID of a process that is not alive
+    pid_t deadProcessId = fork();
+    if ( deadProcessId == 0 )
+    {
+        _exit( 0 );
+    }
+    ELASTIC_APM_CMOCKA_ASSERT( deadProcessId > 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( waitpid( deadProcessId, /* wstatus */ NULL, /* options */ 0 ), deadProcessId );
+
+    // The first process becomes the sender
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSharedRing_tryBecomeSender( ring, deadProcessId, currentTime, senderHeartbeatTimeout, /* out */ &isSender ) );
+    ELASTIC_APM_CMOCKA_ASSERT( isSender );
+
+    // Current process takes over because the sender is not alive anymore
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSharedRing_tryBecomeSender( ring, getCurrentProcessId(), currentTime, senderHeartbeatTimeout, /* out */ &isSender ) );
+    ELASTIC_APM_CMOCKA_ASSERT( isSender );
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSharedRing_tryBecomeSender( ring, getCurrentProcessId(), currentTime, senderHeartbeatTimeout, /* out */ &isSender ) );
+    ELASTIC_APM_CMOCKA_ASSERT( isSender );
+
+    // Another process cannot take over while the sender is alive
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSharedRing_tryBecomeSender( ring, deadProcessId, currentTime, senderHeartbeatTimeout, /* out */ &isSender ) );
+    ELASTIC_APM_CMOCKA_ASSERT( ! isSender );
+
+    // Resigning by process that is not the sender is a no-op
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSharedRing_resignSender( ring, deadProcessId ) );
+    BackendCommSharedRingStats stats;
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSharedRing_getStats( ring, /* out */ &stats ) );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( stats.senderProcessId, getCurrentProcessId() );
+
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSharedRing_resignSender( ring, getCurrentProcessId() ) );
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSharedRing_tryBecomeSender( ring, deadProcessId, currentTime, senderHeartbeatTimeout, /* out */ &isSender ) );
+    ELASTIC_APM_CMOCKA_ASSERT( isSender );
+
+    deleteBackendCommSharedRingAndSetToNull( &ring );
+}
+
+static
+void test_BackendCommSharedRing_sender_heartbeat( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    BackendCommSharedRing* ring = NULL;
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( newBackendCommSharedRing( /* capacity */ 4096, /* out */ &ring ) );
+    bool isSender = false;
+    Int64 senderHeartbeatTimeout = 1000;
+    // Parent process is alive - it stands for a process that reused PID of the sender that died
+    pid_t aliveProcessId = getppid();
+
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSharedRing_tryBecomeSender( ring, aliveProcessId, /* currentTime */ 0, senderHeartbeatTimeout, /* out */ &isSender ) );
+    ELASTIC_APM_CMOCKA_ASSERT( isSender );
+
+    // Another process cannot take over while the sender signals heartbeat
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSharedRing_tryBecomeSender( ring, getCurrentProcessId(), /* currentTime */ senderHeartbeatTimeout, senderHeartbeatTimeout, /* out */ &isSender ) );
+    ELASTIC_APM_CMOCKA_ASSERT( ! isSender );
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSharedRing_onSenderHeartbeat( ring, aliveProcessId, /* currentTime */ senderHeartbeatTimeout, /* out */ &isSender ) );
+    ELASTIC_APM_CMOCKA_ASSERT( isSender );
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSharedRing_tryBecomeSender( ring, getCurrentProcessId(), /* currentTime */ 2 * senderHeartbeatTimeout, senderHeartbeatTimeout, /* out */ &isSender ) );
+    ELASTIC_APM_CMOCKA_ASSERT( ! isSender );
+
+    // Heartbeat by process that is not the sender does not make it the sender
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSharedRing_onSenderHeartbeat( ring, getCurrentProcessId(), /* currentTime */ 2 * senderHeartbeatTimeout, /* out */ &isSender ) );
+    ELASTIC_APM_CMOCKA_ASSERT( ! isSender );
+
+    // Current process takes over because the sender is alive but missed its heartbeat
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSharedRing_tryBecomeSender( ring, getCurrentProcessId(), /* currentTime */ 2 * senderHeartbeatTimeout + 1, senderHeartbeatTimeout, /* out */ &isSender ) );
+    ELASTIC_APM_CMOCKA_ASSERT( isSender );
+    BackendCommSharedRingStats stats;
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSharedRing_getStats( ring, /* out */ &stats ) );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( stats.senderProcessId, getCurrentProcessId() );
+
+    // The previous sender learns on its next heartbeat that it is not the sender anymore
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSharedRing_onSenderHeartbeat( ring, aliveProcessId, /* currentTime */ 3 * senderHeartbeatTimeout, /* out */ &isSender ) );
+    ELASTIC_APM_CMOCKA_ASSERT( ! isSender );
+
+    deleteBackendCommSharedRingAndSetToNull( &ring );
+}
+
+static
+void test_BackendCommSharedRing_multiple_processes( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    enum { producersCount = 4, batchesPerProducer = 100 };
+    BackendCommSharedRing* ring = NULL;
+    // Buffer is smaller than all the batches together so producers have to wait for the consumer
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( newBackendCommSharedRing( /* capacity */ 4096, /* out */ &ring ) );
+    pid_t producers[ producersCount ];
+
+    ELASTIC_APM_FOR_EACH_INDEX( producerIndex, producersCount )
+    {
+        producers[ producerIndex ] = fork();
+        if ( producers[ producerIndex ] == 0 )
+        {
+            ELASTIC_APM_FOR_EACH_INDEX( batchIndex, batchesPerProducer )
+            {
+                std::string serializedEvents = std::to_string( producerIndex ) + ":" + std::to_string( batchIndex );
+                while ( backendCommSharedRing_append( ring, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "User-Agent: test" ), stdStringToView( serializedEvents ) ) != resultSuccess )
+                {
+                    usleep( 100 );
+                }
+            }
+            _exit( 0 );
+        }
+        ELASTIC_APM_CMOCKA_ASSERT( producers[ producerIndex ] > 0 );
+    }
+
+    // Batches from each producer are received in the order they were appended
+    size_t nextBatchIndex[ producersCount ] = { 0 };
+    ELASTIC_APM_REPEAT_N_TIMES( producersCount * batchesPerProducer )
+    {
+        bool hasFirst = false;
+        StringView userAgentHttpHeader;
+        StringView serializedEvents;
+        TimeSpec timeout;
+        ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( getCurrentAbsTimeSpec( /* out */ &timeout ) );
+        addDelayToAbsTimeSpec( /* in, out */ &timeout, /* delayInNanoseconds */ 10 * 1000 * 1000 * 1000L );
+        ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSharedRing_waitForFirst( ring, &timeout, /* out */ &hasFirst, /* out */ &userAgentHttpHeader, /* out */ &serializedEvents ) );
+        ELASTIC_APM_CMOCKA_ASSERT( hasFirst );
+
+        std::string received( serializedEvents.begin, serializedEvents.length );
+        size_t separatorPos = received.find( ':' );
+        ELASTIC_APM_CMOCKA_ASSERT( separatorPos != std::string::npos );
+        size_t producerIndex = std::stoul( received.substr( 0, separatorPos ) );
+        ELASTIC_APM_CMOCKA_ASSERT( producerIndex < producersCount );
+        ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( std::stoul( received.substr( separatorPos + 1 ) ), nextBatchIndex[ producerIndex ] );
+        ++nextBatchIndex[ producerIndex ];
+
+        ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSharedRing_removeFirst( ring ) );
+    }
+
+    ELASTIC_APM_FOR_EACH_INDEX( producerIndex, producersCount )
+    {
+        int status = -1;
+        ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( waitpid( producers[ producerIndex ], &status, /* options */ 0 ), producers[ producerIndex ] );
+        ELASTIC_APM_CMOCKA_ASSERT( WIFEXITED( status ) && WEXITSTATUS( status ) == 0 );
+    }
+    assertSharedRingIsEmpty( ring );
+
+    deleteBackendCommSharedRingAndSetToNull( &ring );
+}
+
+int run_backend_comm_shared_ring_tests()
+{
+    const struct CMUnitTest tests [] =
+    {
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_BackendCommSharedRing_fifo_with_wrapping ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_BackendCommSharedRing_capacity ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_BackendCommSharedRing_sender_election ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_BackendCommSharedRing_sender_heartbeat ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_BackendCommSharedRing_multiple_processes ),
+    };
+
+    return cmocka_run_group_tests( tests, NULL, NULL );
+}
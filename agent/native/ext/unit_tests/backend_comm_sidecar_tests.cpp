@@ -0,0 +1,193 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "backend_comm_sidecar.h"
+#include <string>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "SidecarProtocol.h"
+#include "cmocka_wrapped_for_unit_tests.h"
+#include "unit_test_util.h"
+#include "mock_assert.h"
+
+static
+std::string getSocketPathForTests()
+{
+    String tmpDir = getenv( "TMPDIR" );
+    std::string dir = ( tmpDir == NULL || tmpDir[ 0 ] == '\0' ) ? "/tmp" : tmpDir;
+    return dir + "/elastic_apm_sidecar_unit_tests_" + std::to_string( getpid() ) + ".sock";
+}
+
+static
+StringView stdStringToView( const std::string& str )
+{
+    return makeStringView( str.data(), str.length() );
+}
+
+/**
+ * Stand-in for the sidecar - only listens, connections are accepted by the test
+ */
+static
+int listenAsSidecar( const std::string& socketPath )
+{
+    struct sockaddr_un address;
+    memset( &address, 0, sizeof( address ) );
+    address.sun_family = AF_UNIX;
+    ELASTIC_APM_CMOCKA_ASSERT( socketPath.length() < sizeof( address.sun_path ) );
+    memcpy( address.sun_path, socketPath.c_str(), socketPath.length() + 1 );
+
+    unlink( socketPath.c_str() );
+    int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    ELASTIC_APM_CMOCKA_ASSERT( fd >= 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( bind( fd, (const struct sockaddr*) &address, sizeof( address ) ), 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( listen( fd, /* backlog */ 16 ), 0 );
+    return fd;
+}
+
+static
+std::string readExactly( int fd, size_t size )
+{
+    std::string data( size, '\0' );
+    size_t readSoFar = 0;
+    while ( readSoFar < size )
+    {
+        ssize_t readRetVal = read( fd, &( data[ readSoFar ] ), size - readSoFar );
+        ELASTIC_APM_CMOCKA_ASSERT( readRetVal > 0 );
+        readSoFar += (size_t) readRetVal;
+    }
+    return data;
+}
+
+static
+void assertReceivedFrame( int connectionFd, const std::string& expectedUserAgentHttpHeader, const std::string& expectedSerializedEvents )
+{
+    elasticapm::sidecar::FrameHeader header;
+    std::string headerData = readExactly( connectionFd, sizeof( header ) );
+    memcpy( &header, headerData.data(), sizeof( header ) );
+
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( header.magic, elasticapm::sidecar::frameMagic );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( header.version, elasticapm::sidecar::protocolVersion );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( header.userAgentLength, expectedUserAgentHttpHeader.length() );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( header.serializedEventsLength, expectedSerializedEvents.length() );
+    ELASTIC_APM_CMOCKA_ASSERT( readExactly( connectionFd, header.userAgentLength ) == expectedUserAgentHttpHeader );
+    ELASTIC_APM_CMOCKA_ASSERT( readExactly( connectionFd, header.serializedEventsLength ) == expectedSerializedEvents );
+}
+
+static
+void test_sendEventsToSidecar( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    std::string socketPath = getSocketPathForTests();
+    int listenFd = listenAsSidecar( socketPath );
+    std::string userAgentHttpHeader = "User-Agent: elasticapm-php/1.2.3";
+    std::string metadata = "{\"metadata\":{}}\n";
+    // Larger than socket buffer so it's written in parts
+    std::string largeSerializedEvents = metadata + std::string( 4 * 1024 * 1024, 'x' );
+
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( sendEventsToSidecar( socketPath.c_str(), stdStringToView( userAgentHttpHeader ), stdStringToView( metadata ) ) );
+    int connectionFd = accept( listenFd, NULL, NULL );
+    ELASTIC_APM_CMOCKA_ASSERT( connectionFd >= 0 );
+    assertReceivedFrame( connectionFd, userAgentHttpHeader, metadata );
+
+    // The same connection is used for the next batches
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( sendEventsToSidecar( socketPath.c_str(), stdStringToView( userAgentHttpHeader ), stdStringToView( metadata + "{\"span\":{}}\n" ) ) );
+    assertReceivedFrame( connectionFd, userAgentHttpHeader, metadata + "{\"span\":{}}\n" );
+
+    pid_t childPid = fork();
+    ELASTIC_APM_CMOCKA_ASSERT( childPid >= 0 );
+    if ( childPid == 0 )
+    {
+        // Reads in a child process so that the parent can write more than fits into the socket buffer
+        close( listenFd );
+        int retVal = sendEventsToSidecar( socketPath.c_str(), stdStringToView( userAgentHttpHeader ), stdStringToView( largeSerializedEvents ) ) == resultSuccess ? 0 : 1;
+        _exit( retVal );
+    }
+    assertReceivedFrame( connectionFd, userAgentHttpHeader, largeSerializedEvents );
+    int childStatus = 0;
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( waitpid( childPid, &childStatus, 0 ), childPid );
+    ELASTIC_APM_CMOCKA_ASSERT( WIFEXITED( childStatus ) && WEXITSTATUS( childStatus ) == 0 );
+
+    closeSidecarConnection();
+    close( connectionFd );
+    close( listenFd );
+    unlink( socketPath.c_str() );
+}
+
+static
+void test_sendEventsToSidecar_reconnects( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    std::string socketPath = getSocketPathForTests();
+    std::string userAgentHttpHeader = "User-Agent: elasticapm-php/1.2.3";
+    std::string serializedEvents = "{\"metadata\":{}}\n";
+    int listenFd = listenAsSidecar( socketPath );
+
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( sendEventsToSidecar( socketPath.c_str(), stdStringToView( userAgentHttpHeader ), stdStringToView( serializedEvents ) ) );
+    int connectionFd = accept( listenFd, NULL, NULL );
+    ELASTIC_APM_CMOCKA_ASSERT( connectionFd >= 0 );
+    assertReceivedFrame( connectionFd, userAgentHttpHeader, serializedEvents );
+
+    // Sidecar exits
+    close( connectionFd );
+    close( listenFd );
+    unlink( socketPath.c_str() );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( sendEventsToSidecar( socketPath.c_str(), stdStringToView( userAgentHttpHeader ), stdStringToView( serializedEvents ) ), resultFailure );
+    // Socket does not exist so the caller falls back to sending events itself
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( sendEventsToSidecar( socketPath.c_str(), stdStringToView( userAgentHttpHeader ), stdStringToView( serializedEvents ) ), resultFailure );
+
+    // Sidecar is restarted
+    listenFd = listenAsSidecar( socketPath );
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( sendEventsToSidecar( socketPath.c_str(), stdStringToView( userAgentHttpHeader ), stdStringToView( serializedEvents ) ) );
+    connectionFd = accept( listenFd, NULL, NULL );
+    ELASTIC_APM_CMOCKA_ASSERT( connectionFd >= 0 );
+    assertReceivedFrame( connectionFd, userAgentHttpHeader, serializedEvents );
+
+    closeSidecarConnection();
+    close( connectionFd );
+    close( listenFd );
+    unlink( socketPath.c_str() );
+}
+
+static
+void test_sendEventsToSidecar_non_existing_socket( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    std::string userAgentHttpHeader = "User-Agent: elasticapm-php/1.2.3";
+    std::string serializedEvents = "{\"metadata\":{}}\n";
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( sendEventsToSidecar( "/non_existing_dir_for_elastic_apm_unit_tests/sidecar.sock", stdStringToView( userAgentHttpHeader ), stdStringToView( serializedEvents ) ), resultFailure );
+}
+
+int run_backend_comm_sidecar_tests()
+{
+    const struct CMUnitTest tests [] =
+    {
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_sendEventsToSidecar ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_sendEventsToSidecar_reconnects ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_sendEventsToSidecar_non_existing_socket ),
+    };
+
+    return cmocka_run_group_tests( tests, NULL, NULL );
+}
@@ -0,0 +1,150 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "backend_comm_queue.h"
+#include "backend_comm_spill.h"
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include "cmocka_wrapped_for_unit_tests.h"
+#include "unit_test_util.h"
+#include "mock_assert.h"
+
+static
+String getSpillDirForTests()
+{
+    String tmpDir = getenv( "TMPDIR" );
+    return ( tmpDir == NULL || tmpDir[ 0 ] == '\0' ) ? "/tmp" : tmpDir;
+}
+
+static
+StringView stdStringToView( const std::string& str )
+{
+    return makeStringView( str.data(), str.length() );
+}
+
+static
+void assertFirstSpilledRecord( const BackendCommSpillFile* spillFile, const std::string& expectedUserAgentHttpHeader, const std::string& expectedSerializedEvents )
+{
+    StringView userAgentHttpHeader;
+    StringView serializedEvents;
+    backendCommSpillFile_peekFirst( spillFile, /* out */ &userAgentHttpHeader, /* out */ &serializedEvents );
+    ELASTIC_APM_CMOCKA_ASSERT( areStringViewsEqual( userAgentHttpHeader, stdStringToView( expectedUserAgentHttpHeader ) ) );
+    ELASTIC_APM_CMOCKA_ASSERT( areStringViewsEqual( serializedEvents, stdStringToView( expectedSerializedEvents ) ) );
+}
+
+static
+void test_BackendCommSpillFile_fifo( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    BackendCommSpillFile spillFile = ELASTIC_APM_DEFAULT_BACKEND_COMM_SPILL_FILE;
+    ELASTIC_APM_CMOCKA_ASSERT( ! backendCommSpillFile_isOpen( &spillFile ) );
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSpillFile_open( &spillFile, getSpillDirForTests(), /* capacity */ 1024 * 1024 ) );
+    ELASTIC_APM_CMOCKA_ASSERT( backendCommSpillFile_isOpen( &spillFile ) );
+    ELASTIC_APM_CMOCKA_ASSERT( backendCommSpillFile_isEmpty( &spillFile ) );
+
+    // Sizes are not multiples of the alignment to check that records are padded correctly
+    size_t sizes[] = { 0, 1, 13, 100, 64 * 1024 + 3 };
+    std::vector< std::string > userAgentHttpHeaders;
+    std::vector< std::string > serializedEventsBatches;
+    ELASTIC_APM_FOR_EACH_INDEX( i, ELASTIC_APM_STATIC_ARRAY_SIZE( sizes ) )
+    {
+        userAgentHttpHeaders.push_back( "User-Agent: elasticapm-php/1.2." + std::to_string( i ) );
+        serializedEventsBatches.push_back( std::string( sizes[ i ], (char)( 'a' + i ) ) );
+        ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSpillFile_append( &spillFile, stdStringToView( userAgentHttpHeaders.back() ), stdStringToView( serializedEventsBatches.back() ) ) );
+        ELASTIC_APM_CMOCKA_ASSERT( ! backendCommSpillFile_isEmpty( &spillFile ) );
+        ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( spillFile.recordsCount, i + 1 );
+    }
+
+    ELASTIC_APM_FOR_EACH_INDEX( i, ELASTIC_APM_STATIC_ARRAY_SIZE( sizes ) )
+    {
+        assertFirstSpilledRecord( &spillFile, userAgentHttpHeaders[ i ], serializedEventsBatches[ i ] );
+        backendCommSpillFile_removeFirst( &spillFile );
+    }
+    ELASTIC_APM_CMOCKA_ASSERT( backendCommSpillFile_isEmpty( &spillFile ) );
+    // The file is reused from the beginning after all the records are removed
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( spillFile.readOffset, 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( spillFile.writeOffset, 0 );
+
+    backendCommSpillFile_close( &spillFile );
+    ELASTIC_APM_CMOCKA_ASSERT( ! backendCommSpillFile_isOpen( &spillFile ) );
+}
+
+static
+void test_BackendCommSpillFile_capacity( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    enum { capacity = 4096 };
+    BackendCommSpillFile spillFile = ELASTIC_APM_DEFAULT_BACKEND_COMM_SPILL_FILE;
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSpillFile_open( &spillFile, getSpillDirForTests(), capacity ) );
+
+    std::string userAgentHttpHeader = "User-Agent: elasticapm-php/1.2.3";
+    std::string tooLarge( capacity, 'x' );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( backendCommSpillFile_append( &spillFile, stdStringToView( userAgentHttpHeader ), stdStringToView( tooLarge ) ), resultFailure );
+    ELASTIC_APM_CMOCKA_ASSERT( backendCommSpillFile_isEmpty( &spillFile ) );
+
+    std::string serializedEvents( 1000, 'e' );
+    size_t appendedCount = 0;
+    while ( backendCommSpillFile_append( &spillFile, stdStringToView( userAgentHttpHeader ), stdStringToView( serializedEvents ) ) == resultSuccess )
+    {
+        ++appendedCount;
+        ELASTIC_APM_CMOCKA_ASSERT( spillFile.writeOffset <= capacity );
+    }
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( appendedCount, 3 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( spillFile.recordsCount, appendedCount );
+
+    // Space freed by removing records is not reused until the file is empty
+    backendCommSpillFile_removeFirst( &spillFile );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( backendCommSpillFile_append( &spillFile, stdStringToView( userAgentHttpHeader ), stdStringToView( serializedEvents ) ), resultFailure );
+    ELASTIC_APM_REPEAT_N_TIMES( appendedCount - 1 )
+    {
+        assertFirstSpilledRecord( &spillFile, userAgentHttpHeader, serializedEvents );
+        backendCommSpillFile_removeFirst( &spillFile );
+    }
+    ELASTIC_APM_CMOCKA_ASSERT( backendCommSpillFile_isEmpty( &spillFile ) );
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( backendCommSpillFile_append( &spillFile, stdStringToView( userAgentHttpHeader ), stdStringToView( serializedEvents ) ) );
+
+    backendCommSpillFile_close( &spillFile );
+}
+
+static
+void test_BackendCommSpillFile_open_non_existing_dir( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    BackendCommSpillFile spillFile = ELASTIC_APM_DEFAULT_BACKEND_COMM_SPILL_FILE;
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( backendCommSpillFile_open( &spillFile, "/non_existing_dir_for_elastic_apm_unit_tests", /* capacity */ 4096 ), resultFailure );
+    ELASTIC_APM_CMOCKA_ASSERT( ! backendCommSpillFile_isOpen( &spillFile ) );
+    // Closing file that failed to open is a no-op
+    backendCommSpillFile_close( &spillFile );
+}
+
+int run_backend_comm_spill_tests()
+{
+    const struct CMUnitTest tests [] =
+    {
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_BackendCommSpillFile_fifo ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_BackendCommSpillFile_capacity ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_BackendCommSpillFile_open_non_existing_dir ),
+    };
+
+    return cmocka_run_group_tests( tests, NULL, NULL );
+}
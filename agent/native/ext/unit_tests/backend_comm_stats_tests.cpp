@@ -0,0 +1,100 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "backend_comm_stats.h"
+#include "cmocka_wrapped_for_unit_tests.h"
+#include "unit_test_util.h"
+#include "mock_assert.h"
+
+static
+void test_backendCommStats_getHttpStatusClass( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( backendCommStats_getHttpStatusClass( 0 ), 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( backendCommStats_getHttpStatusClass( 99 ), 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( backendCommStats_getHttpStatusClass( 100 ), 1 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( backendCommStats_getHttpStatusClass( 202 ), 2 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( backendCommStats_getHttpStatusClass( 307 ), 3 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( backendCommStats_getHttpStatusClass( 429 ), 4 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( backendCommStats_getHttpStatusClass( 503 ), 5 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( backendCommStats_getHttpStatusClass( 600 ), 0 );
+}
+
+static
+void test_backendCommStats_getLatencyHistogramBucket( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( backendCommStats_getLatencyHistogramBucket( 0 ), 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( backendCommStats_getLatencyHistogramBucket( 1 ), 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( backendCommStats_getLatencyHistogramBucket( 2 ), 1 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( backendCommStats_getLatencyHistogramBucket( 100 ), 5 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( backendCommStats_getLatencyHistogramBucket( 101 ), 6 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( backendCommStats_getLatencyHistogramBucket( 5000 ), numberOfBackendCommLatencyHistogramBuckets - 2 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( backendCommStats_getLatencyHistogramBucket( 5001 ), numberOfBackendCommLatencyHistogramBuckets - 1 );
+}
+
+static
+void test_backendCommStats_counters( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    BackendCommStats stats;
+    backendCommStats_reset();
+
+    backendCommStats_onRequest( /* sentBytesCount */ 1000, /* httpStatusCode */ 202, /* isFailed */ false, /* latencyInMilliseconds */ 3 );
+    backendCommStats_onRequest( /* sentBytesCount */ 500, /* httpStatusCode */ 503, /* isFailed */ true, /* latencyInMilliseconds */ 7000 );
+    backendCommStats_onRequest( /* sentBytesCount */ 0, /* httpStatusCode */ 0, /* isFailed */ true, /* latencyInMilliseconds */ 4 );
+    backendCommStats_onBatchesSent( 3 );
+    backendCommStats_onBatchesDropped( 2 );
+
+    backendCommStats_get( /* out */ &stats );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( stats.requestsCount, 3 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( stats.failedRequestsCount, 2 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( stats.sentBytesCount, 1500 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( stats.httpStatusClassCounts[ 0 ], 1 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( stats.httpStatusClassCounts[ 2 ], 1 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( stats.httpStatusClassCounts[ 5 ], 1 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( stats.latencyHistogram[ 1 ], 2 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( stats.latencyHistogram[ numberOfBackendCommLatencyHistogramBuckets - 1 ], 1 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( stats.latencySumInMilliseconds, 7007 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( stats.sentBatchesCount, 3 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( stats.droppedBatchesCount, 2 );
+
+    backendCommStats_reset();
+    backendCommStats_get( /* out */ &stats );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( stats.requestsCount, 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( stats.sentBytesCount, 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( stats.latencyHistogram[ 1 ], 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( stats.droppedBatchesCount, 0 );
+}
+
+int run_backend_comm_stats_tests()
+{
+    const struct CMUnitTest tests [] =
+    {
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_backendCommStats_getHttpStatusClass ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_backendCommStats_getLatencyHistogramBucket ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_backendCommStats_counters ),
+    };
+
+    return cmocka_run_group_tests( tests, NULL, NULL );
+}
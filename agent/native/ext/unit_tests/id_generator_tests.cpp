@@ -0,0 +1,98 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "id_generator.h"
+#include <string.h>
+#include "cmocka_wrapped_for_unit_tests.h"
+#include "unit_test_util.h"
+#include "mock_assert.h"
+
+static
+void test_idGenerator_convertBinaryIdToHex( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    Byte binaryId[ 40 ];
+    char hexId[ 2 * ELASTIC_APM_STATIC_ARRAY_SIZE( binaryId ) ];
+    char expectedHexId[ 2 * ELASTIC_APM_STATIC_ARRAY_SIZE( binaryId ) + 1 ];
+
+    ELASTIC_APM_FOR_EACH_INDEX( i, ELASTIC_APM_STATIC_ARRAY_SIZE( binaryId ) )
+    {
+        binaryId[ i ] = (Byte) ( i * 37 + 11 );
+    }
+
+    // Sizes below, equal to and above the size processed at once by vectorized implementation
+    size_t binaryIdSizes[] = { 0, 1, 8, 15, 16, 17, 32, 40 };
+    ELASTIC_APM_FOR_EACH_INDEX( sizeIndex, ELASTIC_APM_STATIC_ARRAY_SIZE( binaryIdSizes ) )
+    {
+        size_t binaryIdSize = binaryIdSizes[ sizeIndex ];
+        ELASTIC_APM_FOR_EACH_INDEX( i, binaryIdSize )
+        {
+            snprintf( expectedHexId + 2 * i, 3, "%02x", binaryId[ i ] );
+        }
+        memset( hexId, 0, sizeof( hexId ) );
+        idGenerator_convertBinaryIdToHex( binaryId, binaryIdSize, /* out */ hexId );
+        ELASTIC_APM_CMOCKA_ASSERT( memcmp( hexId, expectedHexId, 2 * binaryIdSize ) == 0 );
+    }
+
+    const Byte allNibbles[] = { 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF, 0xFE, 0xDC, 0xBA, 0x98, 0x76, 0x54, 0x32, 0x10 };
+    idGenerator_convertBinaryIdToHex( allNibbles, ELASTIC_APM_STATIC_ARRAY_SIZE( allNibbles ), /* out */ hexId );
+    ELASTIC_APM_CMOCKA_ASSERT( memcmp( hexId, "0123456789abcdeffedcba9876543210", 32 ) == 0 );
+}
+
+static
+void test_idGenerator_generateHexId( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    enum { idSizeInBytes = 16, numberOfIds = 1000 };
+    static char hexIds[ numberOfIds ][ 2 * idSizeInBytes ];
+
+    ELASTIC_APM_FOR_EACH_INDEX( i, numberOfIds )
+    {
+        idGenerator_generateHexId( idSizeInBytes, /* out */ hexIds[ i ] );
+        ELASTIC_APM_FOR_EACH_INDEX( j, 2 * idSizeInBytes )
+        {
+            char c = hexIds[ i ][ j ];
+            ELASTIC_APM_CMOCKA_ASSERT( ( '0' <= c && c <= '9' ) || ( 'a' <= c && c <= 'f' ) );
+        }
+        ELASTIC_APM_FOR_EACH_INDEX( prevIndex, i )
+        {
+            ELASTIC_APM_CMOCKA_ASSERT( memcmp( hexIds[ prevIndex ], hexIds[ i ], 2 * idSizeInBytes ) != 0 );
+        }
+    }
+
+    // Reseeded generator (as in forked child) does not repeat the sequence
+    char hexIdAfterReset[ 2 * idSizeInBytes ];
+    idGenerator_resetInForkedChild();
+    idGenerator_generateHexId( idSizeInBytes, /* out */ hexIdAfterReset );
+    ELASTIC_APM_CMOCKA_ASSERT( memcmp( hexIds[ 0 ], hexIdAfterReset, 2 * idSizeInBytes ) != 0 );
+}
+
+int run_id_generator_tests()
+{
+    const struct CMUnitTest tests [] =
+    {
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_idGenerator_convertBinaryIdToHex ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_idGenerator_generateHexId ),
+    };
+
+    return cmocka_run_group_tests( tests, NULL, NULL );
+}
@@ -0,0 +1,164 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "json_writer.h"
+#include <stdint.h>
+#include <string.h>
+#include "cmocka_wrapped_for_unit_tests.h"
+#include "unit_test_util.h"
+#include "mock_assert.h"
+
+static
+void assertStringSerializedAs( StringView str, StringView expectedJson )
+{
+    JsonWriter writer = ELASTIC_APM_DEFAULT_JSON_WRITER;
+    jsonWriter_appendString( &writer, str );
+    ELASTIC_APM_CMOCKA_ASSERT( ! writer.isOutOfMemory );
+    ELASTIC_APM_CMOCKA_ASSERT_STRING_VIEW_EQUAL( jsonWriter_getText( &writer ), expectedJson );
+    jsonWriter_free( &writer );
+}
+
+#define ELASTIC_APM_ASSERT_STRING_SERIALIZED_AS( strLiteral, expectedJsonLiteral ) \
+    assertStringSerializedAs( ELASTIC_APM_STRING_LITERAL_TO_VIEW( strLiteral ), ELASTIC_APM_STRING_LITERAL_TO_VIEW( expectedJsonLiteral ) )
+
+/**
+ * Expected values are the output of json_encode( $str, JSON_INVALID_UTF8_SUBSTITUTE )
+ */
+static
+void test_jsonWriter_appendString( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    ELASTIC_APM_ASSERT_STRING_SERIALIZED_AS( "", "\"\"" );
+    ELASTIC_APM_ASSERT_STRING_SERIALIZED_AS( "GET /api/users?id=1&x=<y>'", "\"GET \\/api\\/users?id=1&x=<y>'\"" );
+    ELASTIC_APM_ASSERT_STRING_SERIALIZED_AS( "a\"b\\c\n\t\b\f\r\x01\x1f\x7f", "\"a\\\"b\\\\c\\n\\t\\b\\f\\r\\u0001\\u001f\x7f\"" );
+
+    // Non-ASCII characters are escaped as UTF-16 code units
+    ELASTIC_APM_ASSERT_STRING_SERIALIZED_AS( "caf\xC3\xA9", "\"caf\\u00e9\"" );
+    ELASTIC_APM_ASSERT_STRING_SERIALIZED_AS( "\xE2\x82\xAC", "\"\\u20ac\"" );
+    ELASTIC_APM_ASSERT_STRING_SERIALIZED_AS( "\xF0\x9F\x98\x80", "\"\\ud83d\\ude00\"" );
+
+    // Invalid UTF-8 sequences are substituted by U+FFFD
+    ELASTIC_APM_ASSERT_STRING_SERIALIZED_AS( "a\xFF" "b", "\"a\\ufffdb\"" );
+    ELASTIC_APM_ASSERT_STRING_SERIALIZED_AS( "\xC3", "\"\\ufffd\"" );
+    ELASTIC_APM_ASSERT_STRING_SERIALIZED_AS( "\xC3(", "\"\\ufffd(\"" );
+    ELASTIC_APM_ASSERT_STRING_SERIALIZED_AS( "\xE2\x82", "\"\\ufffd\"" );
+    ELASTIC_APM_ASSERT_STRING_SERIALIZED_AS( "\xC0\x80", "\"\\ufffd\\ufffd\"" );
+    ELASTIC_APM_ASSERT_STRING_SERIALIZED_AS( "\xED\xA0\x80" "a", "\"\\ufffda\"" );
+    ELASTIC_APM_ASSERT_STRING_SERIALIZED_AS( "\xF4\x90\x80\x80", "\"\\ufffd\"" );
+}
+
+static
+void test_findFirstByteToEscapeInJsonString( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    char buffer[ 100 ];
+    memset( buffer, 'a', sizeof( buffer ) );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( findFirstByteToEscapeInJsonString( makeStringView( buffer, sizeof( buffer ) ) ), sizeof( buffer ) );
+
+    const char bytesToEscape[] = { '"', '\\', '/', '\0', '\n', 0x1F, (char) 0x80, (char) 0xFF };
+    ELASTIC_APM_FOR_EACH_INDEX( byteToEscapeIndex, ELASTIC_APM_STATIC_ARRAY_SIZE( bytesToEscape ) )
+    {
+        ELASTIC_APM_FOR_EACH_INDEX( pos, sizeof( buffer ) )
+        {
+            buffer[ pos ] = bytesToEscape[ byteToEscapeIndex ];
+            ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( findFirstByteToEscapeInJsonString( makeStringView( buffer, sizeof( buffer ) ) ), pos );
+            // Only the bytes inside the view are considered
+            ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( findFirstByteToEscapeInJsonString( makeStringView( buffer, pos ) ), pos );
+            buffer[ pos ] = 'a';
+        }
+    }
+}
+
+static
+void test_jsonWriter_appendInt( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    JsonWriter writer = ELASTIC_APM_DEFAULT_JSON_WRITER;
+
+    jsonWriter_appendInt( &writer, 0 );
+    jsonWriter_appendChar( &writer, ',' );
+    jsonWriter_appendInt( &writer, -1 );
+    jsonWriter_appendChar( &writer, ',' );
+    jsonWriter_appendInt( &writer, 1700000000123456 );
+    jsonWriter_appendChar( &writer, ',' );
+    jsonWriter_appendInt( &writer, INT64_MAX );
+    jsonWriter_appendChar( &writer, ',' );
+    jsonWriter_appendInt( &writer, INT64_MIN );
+    ELASTIC_APM_CMOCKA_ASSERT_STRING_VIEW_EQUAL_LITERAL( jsonWriter_getText( &writer ), "0,-1,1700000000123456,9223372036854775807,-9223372036854775808" );
+
+    jsonWriter_free( &writer );
+}
+
+static
+void test_jsonWriter_grows_and_clears( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    JsonWriter writer = ELASTIC_APM_DEFAULT_JSON_WRITER;
+    enum { numberOfElements = 10000 };
+
+    jsonWriter_appendChar( &writer, '[' );
+    ELASTIC_APM_FOR_EACH_INDEX( i, numberOfElements )
+    {
+        if ( i != 0 )
+        {
+            jsonWriter_appendChar( &writer, ',' );
+        }
+        jsonWriter_appendString( &writer, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "x/y" ) );
+    }
+    jsonWriter_appendChar( &writer, ']' );
+
+    ELASTIC_APM_CMOCKA_ASSERT( ! writer.isOutOfMemory );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( writer.length, 2 + numberOfElements * 7 - 1 );
+    ELASTIC_APM_CMOCKA_ASSERT( writer.capacity >= writer.length );
+    ELASTIC_APM_CMOCKA_ASSERT( memcmp( writer.buffer, "[\"x\\/y\",\"x\\/y\",", 15 ) == 0 );
+    ELASTIC_APM_CMOCKA_ASSERT( memcmp( writer.buffer + writer.length - 8, ",\"x\\/y\"]", 8 ) == 0 );
+
+    size_t capacity = writer.capacity;
+    jsonWriter_clear( &writer );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( writer.length, 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( writer.capacity, capacity );
+    jsonWriter_appendRaw( &writer, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "{}" ) );
+    ELASTIC_APM_CMOCKA_ASSERT_STRING_VIEW_EQUAL_LITERAL( jsonWriter_getText( &writer ), "{}" );
+
+    jsonWriter_appendRaw( &writer, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "\n{\"partial\":" ) );
+    jsonWriter_truncate( &writer, /* length */ 2 );
+    ELASTIC_APM_CMOCKA_ASSERT_STRING_VIEW_EQUAL_LITERAL( jsonWriter_getText( &writer ), "{}" );
+
+    jsonWriter_free( &writer );
+    ELASTIC_APM_CMOCKA_ASSERT( writer.buffer == NULL );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( writer.capacity, 0 );
+}
+
+int run_json_writer_tests()
+{
+    const struct CMUnitTest tests [] =
+    {
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_jsonWriter_appendString ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_findFirstByteToEscapeInJsonString ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_jsonWriter_appendInt ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_jsonWriter_grows_and_clears ),
+    };
+
+    return cmocka_run_group_tests( tests, NULL, NULL );
+}
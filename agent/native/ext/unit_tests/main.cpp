@@ -30,7 +30,6 @@
 #   endif
 #   include <windows.h>
 #endif
-#include "gen_numbered_intercepting_callbacks_src.h"
 
 void printInfo(int argc, const char **argv);
 
@@ -51,6 +50,19 @@ int run_iterateOverCStackTrace_tests();
 int run_ResultCode_tests( int argc, const char* argv[] );
 // int run_parse_value_with_units_tests();
 int run_backend_comm_backoff_tests();
+int run_backend_comm_compression_tests();
+int run_backend_comm_curl_share_tests();
+int run_backend_comm_queue_tests();
+int run_backend_comm_server_url_tests();
+int run_backend_comm_shared_ring_tests();
+int run_backend_comm_sidecar_tests();
+int run_backend_comm_spill_tests();
+int run_backend_comm_stats_tests();
+int run_id_generator_tests();
+int run_json_writer_tests();
+int run_metadata_cache_tests();
+int run_ptr_to_id_map_tests();
+int run_w3c_trace_context_tests();
 
 int main( int argc, const char* argv[] )
 {
@@ -74,8 +86,19 @@ int main( int argc, const char* argv[] )
     failedTestsCount += run_ResultCode_tests(argc, argv);
     // failedTestsCount += run_parse_value_with_units_tests();
     failedTestsCount += run_backend_comm_backoff_tests();
-
-    // gen_numbered_intercepting_callbacks_src( 1000 );
+    failedTestsCount += run_backend_comm_compression_tests();
+    failedTestsCount += run_backend_comm_curl_share_tests();
+    failedTestsCount += run_backend_comm_queue_tests();
+    failedTestsCount += run_backend_comm_server_url_tests();
+    failedTestsCount += run_backend_comm_shared_ring_tests();
+    failedTestsCount += run_backend_comm_sidecar_tests();
+    failedTestsCount += run_backend_comm_spill_tests();
+    failedTestsCount += run_backend_comm_stats_tests();
+    failedTestsCount += run_id_generator_tests();
+    failedTestsCount += run_json_writer_tests();
+    failedTestsCount += run_metadata_cache_tests();
+    failedTestsCount += run_ptr_to_id_map_tests();
+    failedTestsCount += run_w3c_trace_context_tests();
 
     return failedTestsCount;
 }
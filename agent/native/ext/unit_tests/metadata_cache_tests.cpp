@@ -0,0 +1,69 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "metadata_cache.h"
+#include "cmocka_wrapped_for_unit_tests.h"
+#include "unit_test_util.h"
+#include "mock_assert.h"
+#include "util.h"
+
+static
+void test_metadataCache_get_set_clear( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    StringView serializedMetadata;
+    StringView userAgentHttpHeader;
+
+    metadataCache_clear();
+    ELASTIC_APM_CMOCKA_ASSERT( ! metadataCache_get( ELASTIC_APM_STRING_LITERAL_TO_VIEW( "key_1" ), /* out */ &serializedMetadata, /* out */ &userAgentHttpHeader ) );
+
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( metadataCache_set( ELASTIC_APM_STRING_LITERAL_TO_VIEW( "key_1" )
+                                                            , ELASTIC_APM_STRING_LITERAL_TO_VIEW( "{\"service\":{\"name\":\"svc_1\"}}" )
+                                                            , ELASTIC_APM_STRING_LITERAL_TO_VIEW( "apm-agent-php/1.0 (svc_1)" ) )
+                                         , resultSuccess );
+    ELASTIC_APM_CMOCKA_ASSERT( metadataCache_get( ELASTIC_APM_STRING_LITERAL_TO_VIEW( "key_1" ), /* out */ &serializedMetadata, /* out */ &userAgentHttpHeader ) );
+    ELASTIC_APM_CMOCKA_ASSERT( areStringViewsEqual( serializedMetadata, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "{\"service\":{\"name\":\"svc_1\"}}" ) ) );
+    ELASTIC_APM_CMOCKA_ASSERT( areStringViewsEqual( userAgentHttpHeader, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "apm-agent-php/1.0 (svc_1)" ) ) );
+    ELASTIC_APM_CMOCKA_ASSERT( ! metadataCache_get( ELASTIC_APM_STRING_LITERAL_TO_VIEW( "key_2" ), /* out */ &serializedMetadata, /* out */ &userAgentHttpHeader ) );
+
+    // Setting with another key replaces the cached metadata
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( metadataCache_set( ELASTIC_APM_STRING_LITERAL_TO_VIEW( "key_2" )
+                                                            , ELASTIC_APM_STRING_LITERAL_TO_VIEW( "{\"service\":{\"name\":\"svc_2\"}}" )
+                                                            , ELASTIC_APM_STRING_LITERAL_TO_VIEW( "" ) )
+                                         , resultSuccess );
+    ELASTIC_APM_CMOCKA_ASSERT( ! metadataCache_get( ELASTIC_APM_STRING_LITERAL_TO_VIEW( "key_1" ), /* out */ &serializedMetadata, /* out */ &userAgentHttpHeader ) );
+    ELASTIC_APM_CMOCKA_ASSERT( metadataCache_get( ELASTIC_APM_STRING_LITERAL_TO_VIEW( "key_2" ), /* out */ &serializedMetadata, /* out */ &userAgentHttpHeader ) );
+    ELASTIC_APM_CMOCKA_ASSERT( areStringViewsEqual( serializedMetadata, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "{\"service\":{\"name\":\"svc_2\"}}" ) ) );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( userAgentHttpHeader.length, 0 );
+
+    metadataCache_clear();
+    ELASTIC_APM_CMOCKA_ASSERT( ! metadataCache_get( ELASTIC_APM_STRING_LITERAL_TO_VIEW( "key_2" ), /* out */ &serializedMetadata, /* out */ &userAgentHttpHeader ) );
+}
+
+int run_metadata_cache_tests()
+{
+    const struct CMUnitTest tests [] =
+    {
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_metadataCache_get_set_clear ),
+    };
+
+    return cmocka_run_group_tests( tests, NULL, NULL );
+}
@@ -19,7 +19,9 @@
 
 #include <errno.h>
 #include <string.h>
+#include <thread>
 #include "platform.h"
+#include "platform_threads.h"
 #include "unit_test_util.h"
 #include "TextOutputStream_tests.h"
 
@@ -176,6 +178,65 @@ void current_process_command_line( void** testFixtureState )
     }
 }
 
+static
+void calcTimeoutForTests( long delayInMilliseconds, /* out */ TimeSpec* timeoutAbsUtc )
+{
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( getCurrentAbsTimeSpec( /* out */ timeoutAbsUtc ) );
+    addDelayToAbsTimeSpec( /* in, out */ timeoutAbsUtc, delayInMilliseconds * ELASTIC_APM_NUMBER_OF_NANOSECONDS_IN_MILLISECOND );
+}
+
+static
+void wakeup_event_signal_without_announced_wait( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    WakeupEvent* wakeupEvent = NULL;
+    TimeSpec timeoutAbsUtc;
+    bool hasTimedOut = false;
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( newWakeupEvent( &wakeupEvent, "test" ) );
+
+    // Signal is a no-op if wait was not announced
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( signalWakeupEvent( wakeupEvent, "test" ) );
+    announceWaitWakeupEvent( wakeupEvent );
+    calcTimeoutForTests( /* delayInMilliseconds */ 10, /* out */ &timeoutAbsUtc );
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( timedWaitWakeupEvent( wakeupEvent, &timeoutAbsUtc, /* out */ &hasTimedOut, "test" ) );
+    ELASTIC_APM_CMOCKA_ASSERT( hasTimedOut );
+
+    // Signal after wait was announced is not lost even if it happens before the wait
+    announceWaitWakeupEvent( wakeupEvent );
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( signalWakeupEvent( wakeupEvent, "test" ) );
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( timedWaitWakeupEvent( wakeupEvent, /* timeoutAbsUtc */ NULL, /* out */ &hasTimedOut, "test" ) );
+    ELASTIC_APM_CMOCKA_ASSERT( ! hasTimedOut );
+
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( deleteWakeupEvent( &wakeupEvent ) );
+    ELASTIC_APM_CMOCKA_ASSERT_NULL_PTR( wakeupEvent );
+}
+
+static
+void wakeup_event_wakes_up_waiting_thread( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    WakeupEvent* wakeupEvent = NULL;
+    TimeSpec timeoutAbsUtc;
+    bool hasTimedOut = true;
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( newWakeupEvent( &wakeupEvent, "test" ) );
+
+    announceWaitWakeupEvent( wakeupEvent );
+    std::thread signalingThread(
+            [ wakeupEvent ]()
+            {
+                std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+                signalWakeupEvent( wakeupEvent, "test" );
+            } );
+    calcTimeoutForTests( /* delayInMilliseconds */ 60 * 1000, /* out */ &timeoutAbsUtc );
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( timedWaitWakeupEvent( wakeupEvent, &timeoutAbsUtc, /* out */ &hasTimedOut, "test" ) );
+    ELASTIC_APM_CMOCKA_ASSERT( ! hasTimedOut );
+    signalingThread.join();
+
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( deleteWakeupEvent( &wakeupEvent ) );
+}
+
 int run_platform_tests( int argc, const char* argv[] )
 {
     const ElasticApmTestArgVC argVC = { .argc = argc, .argv = argv };
@@ -189,6 +250,8 @@ int run_platform_tests( int argc, const char* argv[] )
 #       endif
 #       ifndef PHP_WIN32
         ELASTIC_APM_CMOCKA_UNIT_TEST_WITH_INITIAL_STATE( current_process_command_line, (void*)(&argVC) ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( wakeup_event_signal_without_announced_wait ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( wakeup_event_wakes_up_waiting_thread ),
 #       endif
     };
 
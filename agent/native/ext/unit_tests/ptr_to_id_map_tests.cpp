@@ -0,0 +1,182 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+#include "ptr_to_id_map.h"
+#include <array>
+#include <chrono>
+#include <utility>
+#include "cmocka_wrapped_for_unit_tests.h"
+#include "unit_test_util.h"
+#include "mock_assert.h"
+
+static
+void test_ptrToIdMap_set_get( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    PtrToIdMap map = ELASTIC_APM_PTR_TO_ID_MAP_INITIALIZER;
+    // Enough keys to grow the map a few times
+    static char keys[ 1000 ];
+    UInt32 id;
+
+    ELASTIC_APM_CMOCKA_ASSERT( ! ptrToIdMap_get( &map, &( keys[ 0 ] ), /* out */ &id ) );
+
+    ELASTIC_APM_FOR_EACH_INDEX( i, ELASTIC_APM_STATIC_ARRAY_SIZE( keys ) )
+    {
+        ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( ptrToIdMap_set( &map, &( keys[ i ] ), (UInt32) i ) );
+    }
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( map.count, ELASTIC_APM_STATIC_ARRAY_SIZE( keys ) );
+    ELASTIC_APM_FOR_EACH_INDEX( i, ELASTIC_APM_STATIC_ARRAY_SIZE( keys ) )
+    {
+        ELASTIC_APM_CMOCKA_ASSERT( ptrToIdMap_get( &map, &( keys[ i ] ), /* out */ &id ) );
+        ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( id, i );
+    }
+    ELASTIC_APM_CMOCKA_ASSERT( ! ptrToIdMap_get( &map, &id, /* out */ &id ) );
+
+    // Setting an existing key updates its ID
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( ptrToIdMap_set( &map, &( keys[ 7 ] ), 12345 ) );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( map.count, ELASTIC_APM_STATIC_ARRAY_SIZE( keys ) );
+    ELASTIC_APM_CMOCKA_ASSERT( ptrToIdMap_get( &map, &( keys[ 7 ] ), /* out */ &id ) );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( id, 12345 );
+
+    ptrToIdMap_free( &map );
+    ELASTIC_APM_CMOCKA_ASSERT( ! ptrToIdMap_get( &map, &( keys[ 0 ] ), /* out */ &id ) );
+}
+
+#ifdef ELASTIC_APM_UNIT_TESTS_BENCHMARKS
+
+/**
+ * Not a pass/fail test - compares per-call overhead of dispatching intercepted calls
+ * by a table of numbered trampolines (each trampoline passes its registration ID)
+ * and by a single generic handler that looks up the registration by the called function's entry.
+ */
+namespace {
+
+struct FakeFunctionEntry;
+typedef void (* FakeHandler)( FakeFunctionEntry* func, UInt64* result );
+
+struct FakeFunctionEntry
+{
+    FakeHandler handler;
+};
+
+enum { fakeFunctionsCount = 100 };
+FakeFunctionEntry g_fakeFunctions[ fakeFunctionsCount ];
+UInt64 g_fakeRegistrationsData[ fakeFunctionsCount ];
+PtrToIdMap g_fakeFuncEntryToRegistrationId = ELASTIC_APM_PTR_TO_ID_MAP_INITIALIZER;
+
+__attribute__(( noinline ))
+void fakeInterceptingImpl( UInt32 registrationId, UInt64* result )
+{
+    *result += g_fakeRegistrationsData[ registrationId ];
+}
+
+template< UInt32 n >
+void fakeNumberedInterceptingCallback( FakeFunctionEntry* func, UInt64* result )
+{
+    fakeInterceptingImpl( n, result );
+}
+
+template< UInt32... n >
+constexpr std::array< FakeHandler, sizeof...( n ) > buildFakeNumberedInterceptingCallbacks( std::integer_sequence< UInt32, n... > )
+{
+    return { fakeNumberedInterceptingCallback< n >... };
+}
+
+const std::array< FakeHandler, fakeFunctionsCount > g_fakeNumberedInterceptingCallbacks
+        = buildFakeNumberedInterceptingCallbacks( std::make_integer_sequence< UInt32, fakeFunctionsCount >{} );
+
+void fakeGenericInterceptingCallback( FakeFunctionEntry* func, UInt64* result )
+{
+    UInt32 registrationId;
+    if ( ptrToIdMap_get( &g_fakeFuncEntryToRegistrationId, func, /* out */ &registrationId ) )
+    {
+        fakeInterceptingImpl( registrationId, result );
+    }
+}
+
+std::chrono::steady_clock::duration measureFakeCalls( size_t callsCount, /* out */ UInt64* result )
+{
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    *result = 0;
+    ELASTIC_APM_FOR_EACH_INDEX( i, callsCount )
+    {
+        // Stride through the functions so that consecutive calls don't hit the same entry
+        FakeFunctionEntry* func = &( g_fakeFunctions[ ( i * 7 ) % fakeFunctionsCount ] );
+        func->handler( func, result );
+    }
+    return Clock::now() - start;
+}
+
+}
+
+static
+void test_ptrToIdMap_intercepting_callback_dispatch_benchmark( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    constexpr size_t callsCount = 10 * 1000 * 1000;
+
+    ELASTIC_APM_FOR_EACH_INDEX( i, fakeFunctionsCount )
+    {
+        g_fakeRegistrationsData[ i ] = i + 1;
+        ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( ptrToIdMap_set( &g_fakeFuncEntryToRegistrationId, &( g_fakeFunctions[ i ] ), (UInt32) i ) );
+    }
+
+    ELASTIC_APM_FOR_EACH_INDEX( i, fakeFunctionsCount )
+    {
+        g_fakeFunctions[ i ].handler = g_fakeNumberedInterceptingCallbacks[ i ];
+    }
+    UInt64 numberedResult;
+    std::chrono::steady_clock::duration numberedDuration = measureFakeCalls( callsCount, /* out */ &numberedResult );
+
+    ELASTIC_APM_FOR_EACH_INDEX( i, fakeFunctionsCount )
+    {
+        g_fakeFunctions[ i ].handler = fakeGenericInterceptingCallback;
+    }
+    UInt64 genericResult;
+    std::chrono::steady_clock::duration genericDuration = measureFakeCalls( callsCount, /* out */ &genericResult );
+
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( genericResult, numberedResult );
+
+    printf( "%30s | %30s\n", "numbered trampolines (ns/call)", "generic handler (ns/call)" );
+    printf( "%30.2f | %30.2f\n"
+            , (double) std::chrono::duration_cast< std::chrono::nanoseconds >( numberedDuration ).count() / callsCount
+            , (double) std::chrono::duration_cast< std::chrono::nanoseconds >( genericDuration ).count() / callsCount );
+
+    ptrToIdMap_free( &g_fakeFuncEntryToRegistrationId );
+}
+
+#endif // #ifdef ELASTIC_APM_UNIT_TESTS_BENCHMARKS
+
+int run_ptr_to_id_map_tests()
+{
+    const struct CMUnitTest tests [] =
+    {
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_ptrToIdMap_set_get ),
+        #ifdef ELASTIC_APM_UNIT_TESTS_BENCHMARKS
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_ptrToIdMap_intercepting_callback_dispatch_benchmark ),
+        #endif
+    };
+
+    return cmocka_run_group_tests( tests, NULL, NULL );
+}
@@ -0,0 +1,384 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+#include "w3c_trace_context.h"
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <string.h>
+#include <strings.h>
+#include "cmocka_wrapped_for_unit_tests.h"
+#include "unit_test_util.h"
+#include "mock_assert.h"
+#include "util.h"
+
+namespace {
+
+struct W3cDataEntry
+{
+    std::vector< std::pair< std::string, std::string > > headers;
+    bool isTraceParentValid = false;
+    // -1 if the entry does not specify it
+    int isTraceStateValid = -1;
+};
+
+/**
+ * Minimal reader for the subset of JSON used by w3c_distributed_tracing.json
+ * (array of objects with "headers" array of [name, value] pairs and boolean properties).
+ * The file starts with // comment lines which are not JSON so they are skipped.
+ */
+class W3cDataReader
+{
+public:
+    explicit W3cDataReader( std::string text ) : text_( std::move( text ) ) {}
+
+    std::vector< W3cDataEntry > readEntries()
+    {
+        std::vector< W3cDataEntry > entries;
+        expect( '[' );
+        while ( ! tryConsume( ']' ) )
+        {
+            if ( ! entries.empty() ) expect( ',' );
+            entries.push_back( readEntry() );
+        }
+        return entries;
+    }
+
+private:
+    W3cDataEntry readEntry()
+    {
+        W3cDataEntry entry;
+        expect( '{' );
+        bool isFirst = true;
+        while ( ! tryConsume( '}' ) )
+        {
+            if ( ! isFirst ) expect( ',' );
+            isFirst = false;
+            const std::string key = readString();
+            expect( ':' );
+            if ( key == "headers" )
+            {
+                expect( '[' );
+                while ( ! tryConsume( ']' ) )
+                {
+                    if ( ! entry.headers.empty() ) expect( ',' );
+                    expect( '[' );
+                    std::string name = readString();
+                    expect( ',' );
+                    std::string value = readString();
+                    expect( ']' );
+                    entry.headers.emplace_back( std::move( name ), std::move( value ) );
+                }
+            }
+            else if ( key == "is_traceparent_valid" )
+            {
+                entry.isTraceParentValid = readBool();
+            }
+            else if ( key == "is_tracestate_valid" )
+            {
+                entry.isTraceStateValid = readBool() ? 1 : 0;
+            }
+            else
+            {
+                ELASTIC_APM_CMOCKA_ASSERT_MSG( false, "Unexpected key: %s", key.c_str() );
+            }
+        }
+        return entry;
+    }
+
+    std::string readString()
+    {
+        expect( '"' );
+        std::string result;
+        for ( ;; )
+        {
+            ELASTIC_APM_CMOCKA_ASSERT( pos_ < text_.length() );
+            const char c = text_[ pos_++ ];
+            if ( c == '"' ) return result;
+            if ( c != '\\' )
+            {
+                result += c;
+                continue;
+            }
+            ELASTIC_APM_CMOCKA_ASSERT( pos_ < text_.length() );
+            const char escaped = text_[ pos_++ ];
+            switch ( escaped )
+            {
+                case 'b': result += '\b'; break;
+                case 'f': result += '\f'; break;
+                case 'n': result += '\n'; break;
+                case 'r': result += '\r'; break;
+                case 't': result += '\t'; break;
+                case 'u':
+                {
+                    ELASTIC_APM_CMOCKA_ASSERT( pos_ + 4 <= text_.length() );
+                    const unsigned long codePoint = std::stoul( text_.substr( pos_, 4 ), nullptr, /* base */ 16 );
+                    ELASTIC_APM_CMOCKA_ASSERT_MSG( codePoint < 0x80, "Only ASCII is supported; codePoint: %lu", codePoint );
+                    result += (char) codePoint;
+                    pos_ += 4;
+                    break;
+                }
+                default: result += escaped; break;
+            }
+        }
+    }
+
+    bool readBool()
+    {
+        skipWhiteSpace();
+        if ( text_.compare( pos_, 4, "true" ) == 0 )
+        {
+            pos_ += 4;
+            return true;
+        }
+        ELASTIC_APM_CMOCKA_ASSERT( text_.compare( pos_, 5, "false" ) == 0 );
+        pos_ += 5;
+        return false;
+    }
+
+    void skipWhiteSpace()
+    {
+        for ( ; pos_ < text_.length() && isWhiteSpace( text_[ pos_ ] ) ; ++pos_ );
+    }
+
+    bool tryConsume( char c )
+    {
+        skipWhiteSpace();
+        if ( pos_ < text_.length() && text_[ pos_ ] == c )
+        {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+
+    void expect( char c )
+    {
+        ELASTIC_APM_CMOCKA_ASSERT_MSG( tryConsume( c ), "Expected '%c' at position %zu", c, pos_ );
+    }
+
+    std::string text_;
+    size_t pos_ = 0;
+};
+
+std::vector< W3cDataEntry > readW3cDataFile()
+{
+    std::ifstream file( ELASTIC_APM_UNIT_TESTS_APM_AGENTS_SHARED_DIR "/json-specs/w3c_distributed_tracing.json" );
+    ELASTIC_APM_CMOCKA_ASSERT( file.is_open() );
+    std::stringstream jsonText;
+    std::string line;
+    while ( std::getline( file, line ) )
+    {
+        if ( line.rfind( "//", 0 ) == 0 ) continue;
+        jsonText << line << '\n';
+    }
+    return W3cDataReader( jsonText.str() ).readEntries();
+}
+
+StringView stdStringToView( const std::string& str )
+{
+    return makeStringView( str.data(), str.length() );
+}
+
+/**
+ * The same sequence of steps as HttpDistributedTracing::parseHeadersImpl in the PHP part
+ */
+void parseHeaders( const W3cDataEntry& entry, /* out */ bool* isTraceParentValid, /* out */ int* isTraceStateValid )
+{
+    std::vector< StringView > traceParentHeaderValues;
+    std::vector< StringView > traceStateHeaderValues;
+    for ( const auto& header : entry.headers )
+    {
+        if ( strcasecmp( header.first.c_str(), "traceparent" ) == 0 ) traceParentHeaderValues.push_back( stdStringToView( header.second ) );
+        if ( strcasecmp( header.first.c_str(), "tracestate" ) == 0 ) traceStateHeaderValues.push_back( stdStringToView( header.second ) );
+    }
+
+    TraceParentData traceParentData;
+    *isTraceParentValid = traceParentHeaderValues.size() == 1 && w3cTraceContext_parseTraceParent( traceParentHeaderValues[ 0 ], /* out */ &traceParentData );
+    *isTraceStateValid = -1;
+    if ( ! *isTraceParentValid || traceStateHeaderValues.empty() )
+    {
+        return;
+    }
+
+    TraceStateData traceStateData;
+    w3cTraceContext_initTraceState( /* out */ &traceStateData );
+    TraceStateParsingStatus status = traceStateParsing_continue;
+    for ( size_t i = 0 ; i < traceStateHeaderValues.size() && status == traceStateParsing_continue ; ++i )
+    {
+        status = w3cTraceContext_parseTraceStateHeaderValue( traceStateHeaderValues[ i ], /* in,out */ &traceStateData );
+    }
+    *isTraceStateValid = ( status != traceStateParsing_invalid && w3cTraceContext_finishTraceState( /* in,out */ &traceStateData ) ) ? 1 : 0;
+}
+
+}
+
+static
+void test_w3cTraceContext_APM_Agents_shared_w3c_data( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    const std::vector< W3cDataEntry > entries = readW3cDataFile();
+    ELASTIC_APM_CMOCKA_ASSERT_INT_GREATER_THAN_OR_EQUAL( entries.size(), 1 );
+
+    ELASTIC_APM_FOR_EACH_INDEX( entryIndex, entries.size() )
+    {
+        const W3cDataEntry& entry = entries[ entryIndex ];
+        bool isTraceParentValid;
+        int isTraceStateValid;
+        parseHeaders( entry, /* out */ &isTraceParentValid, /* out */ &isTraceStateValid );
+        ELASTIC_APM_CMOCKA_ASSERT_MSG( isTraceParentValid == entry.isTraceParentValid, "entryIndex: %zu", entryIndex );
+        if ( entry.isTraceStateValid != -1 )
+        {
+            ELASTIC_APM_CMOCKA_ASSERT_MSG( isTraceStateValid == entry.isTraceStateValid, "entryIndex: %zu", entryIndex );
+        }
+    }
+}
+
+static
+void test_w3cTraceContext_parseTraceParent( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    TraceParentData data;
+
+    ELASTIC_APM_CMOCKA_ASSERT( w3cTraceContext_parseTraceParent( ELASTIC_APM_STRING_LITERAL_TO_VIEW( " 00-0AF7651916CD43DD8448EB211C80319C-b9c7c989f97918e1-03\t" ), /* out */ &data ) );
+    ELASTIC_APM_CMOCKA_ASSERT_STRING_VIEW_EQUAL_LITERAL( data.traceId, "0AF7651916CD43DD8448EB211C80319C" );
+    ELASTIC_APM_CMOCKA_ASSERT_STRING_VIEW_EQUAL_LITERAL( data.parentId, "b9c7c989f97918e1" );
+    ELASTIC_APM_CMOCKA_ASSERT( data.isSampled );
+
+    ELASTIC_APM_CMOCKA_ASSERT( w3cTraceContext_parseTraceParent( ELASTIC_APM_STRING_LITERAL_TO_VIEW( "00-0af7651916cd43dd8448eb211c80319c-b9c7c989f97918e1-fe" ), /* out */ &data ) );
+    ELASTIC_APM_CMOCKA_ASSERT( ! data.isSampled );
+
+    ELASTIC_APM_CMOCKA_ASSERT( ! w3cTraceContext_parseTraceParent( ELASTIC_APM_STRING_LITERAL_TO_VIEW( "" ), /* out */ &data ) );
+    ELASTIC_APM_CMOCKA_ASSERT( ! w3cTraceContext_parseTraceParent( ELASTIC_APM_STRING_LITERAL_TO_VIEW( "00-0af7651916cd43dd8448eb211c80319c-b9c7c989f97918e1-0g" ), /* out */ &data ) );
+}
+
+static
+void test_w3cTraceContext_buildTraceParent( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    char buffer[ w3cTraceContext_traceParentHeaderLength ];
+
+    ELASTIC_APM_CMOCKA_ASSERT( w3cTraceContext_buildTraceParent( ELASTIC_APM_STRING_LITERAL_TO_VIEW( "0af7651916cd43dd8448eb211c80319c" )
+                                                                 , ELASTIC_APM_STRING_LITERAL_TO_VIEW( "b9c7c989f97918e1" )
+                                                                 , /* isSampled */ true
+                                                                 , /* out */ buffer ) );
+    ELASTIC_APM_CMOCKA_ASSERT_STRING_VIEW_EQUAL_LITERAL( makeStringView( buffer, sizeof( buffer ) ), "00-0af7651916cd43dd8448eb211c80319c-b9c7c989f97918e1-01" );
+
+    ELASTIC_APM_CMOCKA_ASSERT( w3cTraceContext_buildTraceParent( ELASTIC_APM_STRING_LITERAL_TO_VIEW( "0af7651916cd43dd8448eb211c80319c" )
+                                                                 , ELASTIC_APM_STRING_LITERAL_TO_VIEW( "b9c7c989f97918e1" )
+                                                                 , /* isSampled */ false
+                                                                 , /* out */ buffer ) );
+    ELASTIC_APM_CMOCKA_ASSERT_STRING_VIEW_EQUAL_LITERAL( makeStringView( buffer, sizeof( buffer ) ), "00-0af7651916cd43dd8448eb211c80319c-b9c7c989f97918e1-00" );
+
+    ELASTIC_APM_CMOCKA_ASSERT( ! w3cTraceContext_buildTraceParent( ELASTIC_APM_STRING_LITERAL_TO_VIEW( "0af7651916cd43dd" )
+                                                                   , ELASTIC_APM_STRING_LITERAL_TO_VIEW( "b9c7c989f97918e1" )
+                                                                   , /* isSampled */ false
+                                                                   , /* out */ buffer ) );
+}
+
+static
+bool parseTraceState( StringView headerValue, /* out */ TraceStateData* data )
+{
+    w3cTraceContext_initTraceState( /* out */ data );
+    return w3cTraceContext_parseTraceStateHeaderValue( headerValue, /* in,out */ data ) != traceStateParsing_invalid
+           && w3cTraceContext_finishTraceState( /* in,out */ data );
+}
+
+static
+void test_w3cTraceContext_traceState( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    TraceStateData data;
+    char outgoingTraceState[ 100 ];
+
+    ELASTIC_APM_CMOCKA_ASSERT( parseTraceState( ELASTIC_APM_STRING_LITERAL_TO_VIEW( "foo=1, es=s:0.5 ,bar@baz=2" ), /* out */ &data ) );
+    ELASTIC_APM_CMOCKA_ASSERT( data.hasSampleRate );
+    ELASTIC_APM_CMOCKA_ASSERT( data.sampleRate == 0.5 );
+    size_t outgoingTraceStateLength = w3cTraceContext_calcOutgoingTraceStateLength( &data );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_LESS_THAN_OR_EQUAL( outgoingTraceStateLength, sizeof( outgoingTraceState ) );
+    w3cTraceContext_buildOutgoingTraceState( &data, /* out */ outgoingTraceState );
+    ELASTIC_APM_CMOCKA_ASSERT_STRING_VIEW_EQUAL_LITERAL( makeStringView( outgoingTraceState, outgoingTraceStateLength ), "es=s:0.5,foo=1,bar@baz=2" );
+
+    ELASTIC_APM_CMOCKA_ASSERT( parseTraceState( ELASTIC_APM_STRING_LITERAL_TO_VIEW( "foo=1" ), /* out */ &data ) );
+    ELASTIC_APM_CMOCKA_ASSERT( ! data.hasSampleRate );
+    outgoingTraceStateLength = w3cTraceContext_calcOutgoingTraceStateLength( &data );
+    w3cTraceContext_buildOutgoingTraceState( &data, /* out */ outgoingTraceState );
+    ELASTIC_APM_CMOCKA_ASSERT_STRING_VIEW_EQUAL_LITERAL( makeStringView( outgoingTraceState, outgoingTraceStateLength ), "foo=1" );
+
+    ELASTIC_APM_CMOCKA_ASSERT( parseTraceState( ELASTIC_APM_STRING_LITERAL_TO_VIEW( " , " ), /* out */ &data ) );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( w3cTraceContext_calcOutgoingTraceStateLength( &data ), 0 );
+
+    ELASTIC_APM_CMOCKA_ASSERT( parseTraceState( ELASTIC_APM_STRING_LITERAL_TO_VIEW( "es=s:1" ), /* out */ &data ) );
+    ELASTIC_APM_CMOCKA_ASSERT( data.sampleRate == 1 );
+    ELASTIC_APM_CMOCKA_ASSERT( parseTraceState( ELASTIC_APM_STRING_LITERAL_TO_VIEW( "es=s:.25" ), /* out */ &data ) );
+    ELASTIC_APM_CMOCKA_ASSERT( data.sampleRate == 0.25 );
+
+    String invalidElasticVendorValues[] = { "es=s:1.5", "es=s:-0.1", "es=s:0.12345", "es=s:", "es=x:0.5", "es=ss:0.5", "es=s:0.5:1", "es=0.5", "es=s:abc" };
+    ELASTIC_APM_FOR_EACH_INDEX( i, ELASTIC_APM_STATIC_ARRAY_SIZE( invalidElasticVendorValues ) )
+    {
+        ELASTIC_APM_CMOCKA_ASSERT_MSG( ! parseTraceState( makeStringViewFromString( invalidElasticVendorValues[ i ] ), /* out */ &data ), "%s", invalidElasticVendorValues[ i ] );
+    }
+}
+
+static
+void test_w3cTraceContext_formatSampleRate( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    char buffer[ w3cTraceContext_sampleRateAsStringBufferSize ];
+
+    struct { double sampleRate; String expected; } testCases[] =
+    {
+        { 0, "0" },
+        { 1, "1" },
+        { 0.5, "0.5" },
+        { 0.1234, "0.1234" },
+        { 0.12345678, "0.1235" },
+        { 0.00001, "0" },
+        { 0.001, "0.001" },
+        { 10, "10" },
+    };
+    ELASTIC_APM_FOR_EACH_INDEX( i, ELASTIC_APM_STATIC_ARRAY_SIZE( testCases ) )
+    {
+        const size_t length = w3cTraceContext_formatSampleRate( testCases[ i ].sampleRate, /* out */ buffer, sizeof( buffer ) );
+        ELASTIC_APM_CMOCKA_ASSERT_STRING_VIEW_EQUAL( makeStringView( buffer, length ), makeStringViewFromString( testCases[ i ].expected ) );
+    }
+}
+
+int run_w3c_trace_context_tests()
+{
+    const struct CMUnitTest tests [] =
+    {
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_w3cTraceContext_APM_Agents_shared_w3c_data ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_w3cTraceContext_parseTraceParent ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_w3cTraceContext_buildTraceParent ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_w3cTraceContext_traceState ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( test_w3cTraceContext_formatSampleRate ),
+    };
+
+    return cmocka_run_group_tests( tests, NULL, NULL );
+}
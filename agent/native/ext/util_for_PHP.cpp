@@ -274,6 +274,39 @@ ResultCode callPhpFunctionRetZval( StringView phpFunctionName, uint32_t argsCoun
     return callPhpFunction( phpFunctionName, argsCount, args, consumeZvalRetVal, retVal );
 }
 
+ResultCode callPhpCallableRetVoid( zval* callable, uint32_t argsCount, zval args[] )
+{
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY_MSG( "callable type: %u, argsCount: %u", Z_TYPE_P( callable ), argsCount );
+
+    ResultCode resultCode;
+    zval retVal;
+    ZVAL_UNDEF( &retVal );
+
+    int callUserFunctionRetVal = call_user_function(
+            EG( function_table )
+            , /* object: */ NULL
+            , /* function_name: */ callable
+            , /* retval_ptr: */ &retVal
+            , argsCount
+            , args );
+    if ( callUserFunctionRetVal != SUCCESS )
+    {
+        ELASTIC_APM_LOG_ERROR( "call_user_function failed. Return value: %d. Callable type: %u. argsCount: %u. Exception: %p", callUserFunctionRetVal, Z_TYPE_P( callable ), argsCount, EG( exception ) );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    resultCode = resultSuccess;
+
+    finally:
+    zval_dtor( &retVal );
+
+    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT();
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
 bool isPhpRunningAsCliScript()
 {
     return strcmp( sapi_module.name, "cli" ) == 0;
@@ -0,0 +1,542 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "w3c_trace_context.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "elastic_apm_assert.h"
+#include "log.h"
+#include "util.h"
+
+#define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_DISTRIBUTED_TRACING
+
+enum { traceParentExpectedNumberOfParts = 4 };
+enum { traceStateMaxVendorKeyLength = 256 };
+enum { traceStateMaxTenantIdLength = 241 };
+enum { traceStateMaxSystemIdLength = 14 };
+/*
+ * transaction_sample_rate configuration option has a maximum precision of 4 decimal places.
+ * So sample rate's max length is 6 (for example 0.1234)
+ *
+ * @link https://github.com/elastic/apm/blob/main/specs/agents/tracing-sampling.md#propagation
+ */
+enum { traceStateElasticVendorSampleRateMaxLength = 6 };
+
+#define ELASTIC_APM_W3C_TRACE_CONTEXT_TRACE_STATE_ELASTIC_VENDOR_KEY "es"
+#define ELASTIC_APM_W3C_TRACE_CONTEXT_TRACE_STATE_ELASTIC_VENDOR_SAMPLE_RATE_SUBKEY "s"
+
+static inline
+bool isHexDigit( char c )
+{
+    return ( '0' <= c && c <= '9' ) || ( 'a' <= c && c <= 'f' ) || ( 'A' <= c && c <= 'F' );
+}
+
+static
+bool isValidHexNumberString( StringView str, size_t expectedLength )
+{
+    if ( str.length != expectedLength )
+    {
+        return false;
+    }
+    ELASTIC_APM_FOR_EACH_INDEX( i, str.length )
+    {
+        if ( ! isHexDigit( str.begin[ i ] ) )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static
+bool isAllZeros( StringView str )
+{
+    ELASTIC_APM_FOR_EACH_INDEX( i, str.length )
+    {
+        if ( str.begin[ i ] != '0' )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Splits the same way as PHP's explode() with limit - the last part contains the rest of the string
+ *
+ * @return number of parts
+ */
+static
+size_t splitBySeparator( StringView str, char separator, size_t maxPartsCount, /* out */ StringView* parts )
+{
+    size_t partsCount = 0;
+    StringView rest = str;
+    for ( ;; )
+    {
+        if ( partsCount + 1 == maxPartsCount )
+        {
+            parts[ partsCount++ ] = rest;
+            return partsCount;
+        }
+        const char* separatorPos = isEmptyStringView( rest ) ? NULL : (const char*) memchr( rest.begin, separator, rest.length );
+        if ( separatorPos == NULL )
+        {
+            parts[ partsCount++ ] = rest;
+            return partsCount;
+        }
+        parts[ partsCount++ ] = makeStringViewFromBeginEnd( rest.begin, separatorPos );
+        rest = makeStringViewFromBeginEnd( separatorPos + 1, stringViewEnd( rest ) );
+    }
+}
+
+static inline
+unsigned int hexDigitValue( char c )
+{
+    if ( '0' <= c && c <= '9' ) return (unsigned int)( c - '0' );
+    if ( 'a' <= c && c <= 'f' ) return (unsigned int)( c - 'a' + 10 );
+    return (unsigned int)( c - 'A' + 10 );
+}
+
+bool w3cTraceContext_parseTraceParent( StringView headerValue, /* out */ TraceParentData* result )
+{
+    // 00-0af7651916cd43dd8448eb211c80319c-b9c7c989f97918e1-01
+    // ^^ ^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^ ^^^^^^^^^^^^^^^^ ^^
+    // || |||||||||||||||||||||||||||||||| |||||||||||||||| -- - flags
+    // || |||||||||||||||||||||||||||||||| ---------------- - parentId
+    // || -------------------------------- - trace-id
+    // -- - version
+
+    ELASTIC_APM_ASSERT_VALID_PTR( result );
+
+    const StringView trimmedHeaderValue = trimStringView( headerValue );
+    /**
+     * One more part than expected because according to W3C spec requires parser to allow
+     * more than the expected number of parts in the future versions
+     * as long as the new parts are appended at the end after a dash
+     *
+     * @link https://www.w3.org/TR/trace-context/#versioning-of-traceparent
+     */
+    StringView parts[ traceParentExpectedNumberOfParts + 1 ];
+    const size_t partsCount = splitBySeparator( trimmedHeaderValue, '-', ELASTIC_APM_STATIC_ARRAY_SIZE( parts ), /* out */ parts );
+    if ( partsCount < traceParentExpectedNumberOfParts )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Failed to parse traceparent HTTP header: the number of separated parts is less than expected; header value: %.*s"
+                               , (int) trimmedHeaderValue.length, trimmedHeaderValue.begin );
+        return false;
+    }
+
+    /**
+     * Version ff is forbidden
+     *
+     * @link https://www.w3.org/TR/trace-context/#version
+     */
+    const StringView version = parts[ 0 ];
+    if ( areStringViewsEqualIgnoringCase( version, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "ff" ) ) )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Failed to parse traceparent HTTP header: version ff is forbidden; header value: %.*s"
+                               , (int) trimmedHeaderValue.length, trimmedHeaderValue.begin );
+        return false;
+    }
+    if ( ! isValidHexNumberString( version, 2 ) )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Failed to parse traceparent HTTP header: version is not a valid 2 hex characters string; header value: %.*s"
+                               , (int) trimmedHeaderValue.length, trimmedHeaderValue.begin );
+        return false;
+    }
+    if ( areStringViewsEqual( version, ELASTIC_APM_STRING_LITERAL_TO_VIEW( "00" ) ) && partsCount != traceParentExpectedNumberOfParts )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Failed to parse traceparent HTTP header: there are more than expected number of separated parts for the current format version"
+                               "; header value: %.*s", (int) trimmedHeaderValue.length, trimmedHeaderValue.begin );
+        return false;
+    }
+
+    const StringView traceId = parts[ 1 ];
+    if ( ! isValidHexNumberString( traceId, w3cTraceContext_traceIdHexLength ) || isAllZeros( traceId ) )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Failed to parse traceparent HTTP header: traceId is not a valid non-zero 16 bytes hex ID; header value: %.*s"
+                               , (int) trimmedHeaderValue.length, trimmedHeaderValue.begin );
+        return false;
+    }
+
+    const StringView parentId = parts[ 2 ];
+    if ( ! isValidHexNumberString( parentId, w3cTraceContext_parentIdHexLength ) || isAllZeros( parentId ) )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Failed to parse traceparent HTTP header: parentId is not a valid non-zero 8 bytes hex ID; header value: %.*s"
+                               , (int) trimmedHeaderValue.length, trimmedHeaderValue.begin );
+        return false;
+    }
+
+    const StringView flags = parts[ 3 ];
+    if ( ! isValidHexNumberString( flags, 2 ) )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Failed to parse traceparent HTTP header: flags is not a valid 2 hex characters string; header value: %.*s"
+                               , (int) trimmedHeaderValue.length, trimmedHeaderValue.begin );
+        return false;
+    }
+
+    result->traceId = traceId;
+    result->parentId = parentId;
+    // Sampled flag is the lowest bit so only the second hex digit is relevant
+    result->isSampled = ( hexDigitValue( flags.begin[ 1 ] ) & 1 ) != 0;
+    return true;
+}
+
+bool w3cTraceContext_buildTraceParent( StringView traceId, StringView parentId, bool isSampled, /* out */ char* buffer )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( buffer );
+
+    if ( traceId.length != w3cTraceContext_traceIdHexLength || parentId.length != w3cTraceContext_parentIdHexLength )
+    {
+        return false;
+    }
+
+    char* current = buffer;
+    *current++ = '0';
+    *current++ = '0';
+    *current++ = '-';
+    memcpy( current, traceId.begin, traceId.length );
+    current += traceId.length;
+    *current++ = '-';
+    memcpy( current, parentId.begin, parentId.length );
+    current += parentId.length;
+    *current++ = '-';
+    *current++ = '0';
+    *current++ = isSampled ? '1' : '0';
+    ELASTIC_APM_ASSERT_EQ_UINT64( current - buffer, w3cTraceContext_traceParentHeaderLength );
+    return true;
+}
+
+static inline
+bool isTraceStateIdFirstChar( char c )
+{
+    return ( 'a' <= c && c <= 'z' ) || isDecimalDigit( c );
+}
+
+static inline
+bool isTraceStateIdChar( char c )
+{
+    return isTraceStateIdFirstChar( c ) || c == '_' || c == '-' || c == '*' || c == '/';
+}
+
+/**
+ * id = ( lcalpha / DIGIT ) 0*N( lcalpha / DIGIT / "_" / "-"/ "*" / "/" )
+ *
+ * @link https://www.w3.org/TR/trace-context/#key
+ */
+static
+bool isValidTraceStateId( StringView id, size_t maxLength )
+{
+    if ( isEmptyStringView( id ) || id.length > maxLength || ! isTraceStateIdFirstChar( id.begin[ 0 ] ) )
+    {
+        return false;
+    }
+    for ( size_t i = 1 ; i < id.length ; ++i )
+    {
+        if ( ! isTraceStateIdChar( id.begin[ i ] ) )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static
+bool isValidTraceStateKey( StringView key )
+{
+    if ( isEmptyStringView( key ) )
+    {
+        return false;
+    }
+    if ( memchr( key.begin, '@', key.length ) == NULL )
+    {
+        return isValidTraceStateId( key, traceStateMaxVendorKeyLength );
+    }
+
+    // multi-tenant-key = tenant-id "@" system-id
+    StringView parts[ 3 ];
+    if ( splitBySeparator( key, '@', ELASTIC_APM_STATIC_ARRAY_SIZE( parts ), /* out */ parts ) != 2 )
+    {
+        return false;
+    }
+    return isValidTraceStateId( parts[ 0 ], traceStateMaxTenantIdLength ) && isValidTraceStateId( parts[ 1 ], traceStateMaxSystemIdLength );
+}
+
+void w3cTraceContext_initTraceState( /* out */ TraceStateData* data )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( data );
+
+    data->pairsCount = 0;
+    data->elasticVendorPairIndex = -1;
+    data->hasSampleRate = false;
+    data->sampleRate = 0;
+}
+
+static
+bool parseTraceStateKeyValuePair( StringView keyValuePair, /* in,out */ TraceStateData* data )
+{
+    StringView parts[ 3 ];
+    if ( splitBySeparator( keyValuePair, '=', ELASTIC_APM_STATIC_ARRAY_SIZE( parts ), /* out */ parts ) != 2 )
+    {
+        ELASTIC_APM_LOG_DEBUG( "key=value pair in tracestate HTTP header is invalid because separator (=) is missing or appears more than once"
+                               "; key=value pair: %.*s", (int) keyValuePair.length, keyValuePair.begin );
+        return false;
+    }
+    const StringView key = parts[ 0 ];
+    const StringView value = parts[ 1 ];
+    if ( isEmptyStringView( value ) || ! isValidTraceStateKey( key ) )
+    {
+        ELASTIC_APM_LOG_DEBUG( "key=value pair in tracestate HTTP header is invalid because key is invalid or value is empty"
+                               "; key=value pair: %.*s", (int) keyValuePair.length, keyValuePair.begin );
+        return false;
+    }
+
+    ELASTIC_APM_FOR_EACH_INDEX( i, data->pairsCount )
+    {
+        if ( areStringViewsEqual( data->pairs[ i ].key, key ) )
+        {
+            ELASTIC_APM_LOG_DEBUG( "Encountered key more than once in tracestate HTTP header; key: %.*s", (int) key.length, key.begin );
+            return false;
+        }
+    }
+
+    if ( areStringViewsEqual( key, ELASTIC_APM_STRING_LITERAL_TO_VIEW( ELASTIC_APM_W3C_TRACE_CONTEXT_TRACE_STATE_ELASTIC_VENDOR_KEY ) ) )
+    {
+        data->elasticVendorPairIndex = (int) data->pairsCount;
+    }
+    data->pairs[ data->pairsCount ].key = key;
+    data->pairs[ data->pairsCount ].value = value;
+    ++data->pairsCount;
+    return true;
+}
+
+TraceStateParsingStatus w3cTraceContext_parseTraceStateHeaderValue( StringView headerValue, /* in,out */ TraceStateData* data )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( data );
+    ELASTIC_APM_ASSERT_LE_UINT64( data->pairsCount, w3cTraceContext_traceStateMaxPairsCount );
+
+    // Parts limit is computed once per header value the same way as the PHP part does it
+    // so that the two implementations handle a header value with more than the max number of pairs the same way
+    const size_t maxPartsCount = w3cTraceContext_traceStateMaxPairsCount - data->pairsCount + 1;
+    size_t partsCount = 0;
+    StringView rest = headerValue;
+    bool isLastPart = false;
+    while ( ! isLastPart )
+    {
+        StringView part;
+        const char* separatorPos = ( partsCount + 1 == maxPartsCount || isEmptyStringView( rest ) ) ? NULL : (const char*) memchr( rest.begin, ',', rest.length );
+        ++partsCount;
+        if ( separatorPos == NULL )
+        {
+            part = rest;
+            isLastPart = true;
+        }
+        else
+        {
+            part = makeStringViewFromBeginEnd( rest.begin, separatorPos );
+            rest = makeStringViewFromBeginEnd( separatorPos + 1, stringViewEnd( rest ) );
+        }
+
+        const StringView keyValuePair = trimStringView( part );
+        if ( isEmptyStringView( keyValuePair ) )
+        {
+            continue;
+        }
+        if ( data->pairsCount == w3cTraceContext_traceStateMaxPairsCount )
+        {
+            ELASTIC_APM_LOG_DEBUG( "Number of found pairs in tracestate HTTP header is more than allowed maximum (%d) - only the first %d pairs will be used"
+                                   , (int) w3cTraceContext_traceStateMaxPairsCount, (int) w3cTraceContext_traceStateMaxPairsCount );
+            return traceStateParsing_done;
+        }
+        if ( ! parseTraceStateKeyValuePair( keyValuePair, /* in,out */ data ) )
+        {
+            return traceStateParsing_invalid;
+        }
+    }
+
+    return traceStateParsing_continue;
+}
+
+/**
+ * Same format as PHP's filter_var( $value, FILTER_VALIDATE_FLOAT ):
+ *      [+-]? ( digits ( "." digits? )? / "." digits ) ( [eE] [+-]? digits )?
+ */
+static
+bool isValidFloatFormat( StringView str )
+{
+    size_t pos = 0;
+    if ( pos < str.length && ( str.begin[ pos ] == '+' || str.begin[ pos ] == '-' ) ) ++pos;
+    size_t digitsCount = 0;
+    for ( ; pos < str.length && isDecimalDigit( str.begin[ pos ] ) ; ++pos ) ++digitsCount;
+    if ( pos < str.length && str.begin[ pos ] == '.' )
+    {
+        ++pos;
+        for ( ; pos < str.length && isDecimalDigit( str.begin[ pos ] ) ; ++pos ) ++digitsCount;
+    }
+    if ( digitsCount == 0 )
+    {
+        return false;
+    }
+    if ( pos < str.length && ( str.begin[ pos ] == 'e' || str.begin[ pos ] == 'E' ) )
+    {
+        ++pos;
+        if ( pos < str.length && ( str.begin[ pos ] == '+' || str.begin[ pos ] == '-' ) ) ++pos;
+        size_t exponentDigitsCount = 0;
+        for ( ; pos < str.length && isDecimalDigit( str.begin[ pos ] ) ; ++pos ) ++exponentDigitsCount;
+        if ( exponentDigitsCount == 0 )
+        {
+            return false;
+        }
+    }
+    return pos == str.length;
+}
+
+static
+bool parseSampleRate( StringView sampleRateAsString, /* out */ double* sampleRate )
+{
+    const StringView trimmed = trimStringView( sampleRateAsString );
+    if ( ! isValidFloatFormat( trimmed ) )
+    {
+        return false;
+    }
+
+    char zeroTerminated[ traceStateElasticVendorSampleRateMaxLength + 1 ];
+    ELASTIC_APM_ASSERT_LE_UINT64( trimmed.length, traceStateElasticVendorSampleRateMaxLength );
+    memcpy( zeroTerminated, trimmed.begin, trimmed.length );
+    zeroTerminated[ trimmed.length ] = '\0';
+    const double parsed = strtod( zeroTerminated, /* endptr */ NULL );
+    if ( ! ( 0 <= parsed && parsed <= 1 ) )
+    {
+        return false;
+    }
+    *sampleRate = parsed;
+    return true;
+}
+
+bool w3cTraceContext_finishTraceState( /* in,out */ TraceStateData* data )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( data );
+
+    if ( data->elasticVendorPairIndex < 0 )
+    {
+        return true;
+    }
+
+    /**
+     * tracestate: es=s:0.1,othervendor=<opaque>
+     *
+     * @link https://github.com/elastic/apm/blob/main/specs/agents/tracing-sampling.md#propagation
+     */
+    const StringView elasticVendorValue = data->pairs[ data->elasticVendorPairIndex ].value;
+    StringView parts[ 3 ];
+    if ( splitBySeparator( elasticVendorValue, ':', ELASTIC_APM_STATIC_ARRAY_SIZE( parts ), /* out */ parts ) != 2
+         || ! areStringViewsEqual( parts[ 0 ], ELASTIC_APM_STRING_LITERAL_TO_VIEW( ELASTIC_APM_W3C_TRACE_CONTEXT_TRACE_STATE_ELASTIC_VENDOR_SAMPLE_RATE_SUBKEY ) )
+         || isEmptyStringView( parts[ 1 ] )
+         || parts[ 1 ].length > traceStateElasticVendorSampleRateMaxLength
+         || ! parseSampleRate( parts[ 1 ], /* out */ &data->sampleRate ) )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Elastic vendor value in tracestate HTTP header is invalid; value: %.*s", (int) elasticVendorValue.length, elasticVendorValue.begin );
+        return false;
+    }
+
+    data->hasSampleRate = true;
+    return true;
+}
+
+size_t w3cTraceContext_calcOutgoingTraceStateLength( const TraceStateData* data )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( data );
+
+    if ( data->pairsCount == 0 )
+    {
+        return 0;
+    }
+
+    // separators between pairs
+    size_t length = data->pairsCount - 1;
+    ELASTIC_APM_FOR_EACH_INDEX( i, data->pairsCount )
+    {
+        length += data->pairs[ i ].key.length + 1 + data->pairs[ i ].value.length;
+    }
+    return length;
+}
+
+static
+char* appendTraceStateKeyValuePair( const TraceStateKeyValuePair* pair, bool isFirst, char* current )
+{
+    if ( ! isFirst )
+    {
+        *current++ = ',';
+    }
+    memcpy( current, pair->key.begin, pair->key.length );
+    current += pair->key.length;
+    *current++ = '=';
+    memcpy( current, pair->value.begin, pair->value.length );
+    current += pair->value.length;
+    return current;
+}
+
+void w3cTraceContext_buildOutgoingTraceState( const TraceStateData* data, /* out */ char* buffer )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( data );
+
+    char* current = buffer;
+    if ( data->elasticVendorPairIndex >= 0 )
+    {
+        current = appendTraceStateKeyValuePair( &( data->pairs[ data->elasticVendorPairIndex ] ), /* isFirst */ true, current );
+    }
+    ELASTIC_APM_FOR_EACH_INDEX( i, data->pairsCount )
+    {
+        if ( (int) i == data->elasticVendorPairIndex )
+        {
+            continue;
+        }
+        current = appendTraceStateKeyValuePair( &( data->pairs[ i ] ), /* isFirst */ current == buffer, current );
+    }
+    ELASTIC_APM_ASSERT_EQ_UINT64( current - buffer, w3cTraceContext_calcOutgoingTraceStateLength( data ) );
+}
+
+size_t w3cTraceContext_formatSampleRate( double sampleRate, /* out */ char* buffer, size_t bufferSize )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( buffer );
+    ELASTIC_APM_ASSERT_GT_UINT64( bufferSize, 0 );
+
+    const int snprintfRetVal = snprintf( buffer, bufferSize, "%.4f", sampleRate );
+    if ( snprintfRetVal < 0 )
+    {
+        buffer[ 0 ] = '\0';
+        return 0;
+    }
+    size_t length = ( (size_t) snprintfRetVal < bufferSize ) ? (size_t) snprintfRetVal : ( bufferSize - 1 );
+
+    // Remove trailing zeros (and the decimal point if there are no decimal digits left)
+    const char* decimalPoint = (const char*) memchr( buffer, '.', length );
+    if ( decimalPoint != NULL )
+    {
+        const size_t decimalPointPos = (size_t)( decimalPoint - buffer );
+        for ( ; length > decimalPointPos + 1 && buffer[ length - 1 ] == '0' ; --length );
+        if ( length == decimalPointPos + 1 )
+        {
+            --length;
+        }
+    }
+    buffer[ length ] = '\0';
+    return length;
+}
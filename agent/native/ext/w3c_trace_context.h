@@ -0,0 +1,118 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#pragma once
+
+#include <stddef.h>
+#include "StringView.h"
+
+/**
+ * Parsing and building of W3C Trace Context HTTP headers (traceparent and tracestate).
+ * Parsing does not allocate - parsed parts are views into the header values
+ * so the header values have to outlive the parsed data.
+ *
+ * @link https://www.w3.org/TR/trace-context/
+ */
+
+enum { w3cTraceContext_traceIdHexLength = 32 };
+enum { w3cTraceContext_parentIdHexLength = 16 };
+// 00-0af7651916cd43dd8448eb211c80319c-b9c7c989f97918e1-01
+enum { w3cTraceContext_traceParentHeaderLength = 2 + 1 + w3cTraceContext_traceIdHexLength + 1 + w3cTraceContext_parentIdHexLength + 1 + 2 };
+enum { w3cTraceContext_traceStateMaxPairsCount = 32 };
+// Enough for any double formatted with 4 decimal digits
+enum { w3cTraceContext_sampleRateAsStringBufferSize = 350 };
+
+struct TraceParentData
+{
+    // Trace ID and parent ID are not lower-cased (they are views into the header value)
+    StringView traceId;
+    StringView parentId;
+    bool isSampled;
+};
+typedef struct TraceParentData TraceParentData;
+
+bool w3cTraceContext_parseTraceParent( StringView headerValue, /* out */ TraceParentData* result );
+
+/**
+ * Writes w3cTraceContext_traceParentHeaderLength chars (without terminating '\0')
+ *
+ * @return false if traceId or parentId do not have the expected length
+ */
+bool w3cTraceContext_buildTraceParent( StringView traceId, StringView parentId, bool isSampled, /* out */ char* buffer );
+
+struct TraceStateKeyValuePair
+{
+    StringView key;
+    StringView value;
+};
+typedef struct TraceStateKeyValuePair TraceStateKeyValuePair;
+
+struct TraceStateData
+{
+    TraceStateKeyValuePair pairs[ w3cTraceContext_traceStateMaxPairsCount ];
+    size_t pairsCount;
+    // Index in pairs of Elastic's vendor (es) pair or -1 if there is no such pair
+    int elasticVendorPairIndex;
+    bool hasSampleRate;
+    double sampleRate;
+};
+typedef struct TraceStateData TraceStateData;
+
+enum TraceStateParsingStatus
+{
+    traceStateParsing_continue,
+    // Max number of pairs is reached - the rest of the header values should be ignored
+    traceStateParsing_done,
+    traceStateParsing_invalid
+};
+typedef enum TraceStateParsingStatus TraceStateParsingStatus;
+
+/**
+ * Usage: init, then parse each tracestate header value until the status is not traceStateParsing_continue
+ * and then (if the status is not traceStateParsing_invalid) finish.
+ */
+void w3cTraceContext_initTraceState( /* out */ TraceStateData* data );
+
+TraceStateParsingStatus w3cTraceContext_parseTraceStateHeaderValue( StringView headerValue, /* in,out */ TraceStateData* data );
+
+/**
+ * Parses sample rate from Elastic's vendor value (es=s:0.1)
+ *
+ * @return false if Elastic's vendor value is invalid
+ */
+bool w3cTraceContext_finishTraceState( /* in,out */ TraceStateData* data );
+
+/**
+ * @return 0 if there is no outgoing tracestate
+ */
+size_t w3cTraceContext_calcOutgoingTraceStateLength( const TraceStateData* data );
+
+/**
+ * Writes w3cTraceContext_calcOutgoingTraceStateLength( data ) chars (without terminating '\0')
+ * - Elastic's vendor pair first and then the other vendors' pairs in the original order.
+ */
+void w3cTraceContext_buildOutgoingTraceState( const TraceStateData* data, /* out */ char* buffer );
+
+/**
+ * Formats sample rate with at most 4 decimal digits and without trailing zeros (for example 0.1, 0.1234, 1)
+ *
+ * @return length of the written string (without terminating '\0')
+ */
+size_t w3cTraceContext_formatSampleRate( double sampleRate, /* out */ char* buffer, size_t bufferSize );
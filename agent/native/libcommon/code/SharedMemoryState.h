@@ -1,18 +1,31 @@
-
-
 #include <boost/interprocess/anonymous_shared_memory.hpp>
 #include <boost/interprocess/mapped_region.hpp>
 #include <boost/interprocess/sync/interprocess_upgradable_mutex.hpp>
 #include <boost/interprocess/sync/scoped_lock.hpp>
 #include <boost/interprocess/sync/sharable_lock.hpp>
 
+#include <algorithm>
+#include <cstdint>
+#include <sys/types.h>
+
 namespace elasticapm::php {
 
 class SharedMemoryState {
 public:
+    // Backoff after failure to communicate with APM Server shared by all the workers in the pool
+    // Times are in nanoseconds of monotonic clock - it's system-wide so the time set by one process is valid in the others
+    struct BackendCommBackoff {
+        uint32_t errorCount = 0;
+        int64_t waitEndTime = 0;
+        // After the wait ends only this process tries to send until it reports the outcome or probeEndTime is reached
+        pid_t probingProcessId = 0;
+        int64_t probeEndTime = 0;
+    };
+
     struct SharedData {
         boost::interprocess::interprocess_upgradable_mutex mutex;
         bool oneTimeTaskAmongWorkersExecuted = false;
+        BackendCommBackoff backendCommBackoff;
     };
 
     bool shouldExecuteOneTimeTaskAmongWorkers() {
@@ -33,10 +46,108 @@ public:
         return true;
     }
 
+    /**
+     * @return 0 if the pool is not waiting - after the wait ends only the probing process is allowed to send (see tryToProbeBackendComm)
+     */
+    int64_t getBackendCommBackoffTimeLeftToWait( pid_t currentProcessId, int64_t currentTime ) {
+        boost::interprocess::sharable_lock< decltype( SharedData::mutex ) > lock( data_->mutex );
+        int64_t timeLeftToWait = 0;
+        canProbeBackendComm( data_->backendCommBackoff, currentProcessId, currentTime, timeLeftToWait );
+        return timeLeftToWait;
+    }
+
+    /**
+     * When the wait ends the first process to try becomes the only one in the pool probing whether APM Server has recovered
+     * - the rest keep waiting until the probe's outcome is reported or probeTimeout elapses.
+     *
+     * @return true if the current process may send
+     */
+    bool tryToProbeBackendComm( pid_t currentProcessId, int64_t currentTime, int64_t probeTimeout ) {
+        int64_t timeLeftToWait = 0;
+        {
+            boost::interprocess::sharable_lock< decltype( SharedData::mutex ) > lock( data_->mutex );
+            if ( ! canProbeBackendComm( data_->backendCommBackoff, currentProcessId, currentTime, timeLeftToWait ) )
+            {
+                return false;
+            }
+            if ( data_->backendCommBackoff.errorCount == 0 || data_->backendCommBackoff.probingProcessId == currentProcessId )
+            {
+                return true;
+            }
+        }
+
+        boost::interprocess::scoped_lock< decltype( SharedData::mutex ) > ulock( data_->mutex );
+        BackendCommBackoff& backoff = data_->backendCommBackoff;
+        // State might have changed while no lock was held
+        if ( ! canProbeBackendComm( backoff, currentProcessId, currentTime, timeLeftToWait ) )
+        {
+            return false;
+        }
+        if ( backoff.errorCount != 0 )
+        {
+            backoff.probingProcessId = currentProcessId;
+            backoff.probeEndTime = currentTime + probeTimeout;
+        }
+        return true;
+    }
+
+    uint32_t getBackendCommBackoffErrorCount() {
+        boost::interprocess::sharable_lock< decltype( SharedData::mutex ) > lock( data_->mutex );
+        return data_->backendCommBackoff.errorCount;
+    }
+
+    /**
+     * Failure reported while the pool is still waiting comes from a request started before the pool backed off
+     * so it does not extend the wait.
+     */
+    void onBackendCommError( uint32_t errorCount, int64_t waitEndTime, int64_t currentTime ) {
+        boost::interprocess::scoped_lock< decltype( SharedData::mutex ) > ulock( data_->mutex );
+        BackendCommBackoff& backoff = data_->backendCommBackoff;
+        if ( currentTime < backoff.waitEndTime )
+        {
+            return;
+        }
+        backoff.errorCount = std::max( backoff.errorCount, errorCount );
+        backoff.waitEndTime = waitEndTime;
+        backoff.probingProcessId = 0;
+        backoff.probeEndTime = 0;
+    }
+
+    void onBackendCommSuccess() {
+        {
+            boost::interprocess::sharable_lock< decltype( SharedData::mutex ) > lock( data_->mutex );
+            if ( data_->backendCommBackoff.errorCount == 0 )
+            {
+                return;
+            }
+        }
+
+        boost::interprocess::scoped_lock< decltype( SharedData::mutex ) > ulock( data_->mutex );
+        data_->backendCommBackoff = BackendCommBackoff{};
+    }
+
 
 protected:
+    static bool canProbeBackendComm( BackendCommBackoff const& backoff, pid_t currentProcessId, int64_t currentTime, int64_t& timeLeftToWait ) {
+        if ( backoff.errorCount == 0 || backoff.probingProcessId == currentProcessId )
+        {
+            return true;
+        }
+        if ( currentTime < backoff.waitEndTime )
+        {
+            timeLeftToWait = backoff.waitEndTime - currentTime;
+            return false;
+        }
+        if ( backoff.probingProcessId != 0 && currentTime < backoff.probeEndTime )
+        {
+            timeLeftToWait = backoff.probeEndTime - currentTime;
+            return false;
+        }
+        return true;
+    }
+
     boost::interprocess::mapped_region region_{ boost::interprocess::anonymous_shared_memory( sizeof( SharedData ) ) };
     SharedData* data_{ new (region_.get_address()) SharedData };
 };
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Protocol between the extension and the local sidecar process (elastic_apm_sidecar) over a Unix domain stream socket.
+// Each batch of events is sent as a frame: FrameHeader followed by User-Agent HTTP header and serialized events (NDJSON).
+// Both ends run on the same host so the header is in host byte order.
+namespace elasticapm::sidecar {
+
+constexpr uint32_t frameMagic = 0x45415043; // "EAPC"
+constexpr uint32_t protocolVersion = 1;
+
+constexpr std::size_t maxUserAgentLength = 4 * 1024;
+constexpr std::size_t maxSerializedEventsLength = 64 * 1024 * 1024;
+
+struct FrameHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t userAgentLength;
+    uint32_t serializedEventsLength;
+};
+
+static_assert(sizeof(FrameHeader) == 4 * sizeof(uint32_t));
+
+}
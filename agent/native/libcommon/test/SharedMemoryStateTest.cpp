@@ -43,4 +43,61 @@ TEST_F(SharedMemoryStateTest, shouldExecuteOneTimeTaskAmongWorkersFromThreads) {
 }
 
 
+TEST_F(SharedMemoryStateTest, backendCommBackoffNoErrors) {
+    EXPECT_EQ(state_.getBackendCommBackoffErrorCount(), 0u);
+    EXPECT_EQ(state_.getBackendCommBackoffTimeLeftToWait(1, 1000), 0);
+    EXPECT_TRUE(state_.tryToProbeBackendComm(1, 1000, 100));
+    EXPECT_TRUE(state_.tryToProbeBackendComm(2, 1000, 100));
+}
+
+TEST_F(SharedMemoryStateTest, backendCommBackoffErrorThrottlesAllProcesses) {
+    state_.onBackendCommError(2, 2000, 1000);
+    EXPECT_EQ(state_.getBackendCommBackoffErrorCount(), 2u);
+    EXPECT_EQ(state_.getBackendCommBackoffTimeLeftToWait(1, 1000), 1000);
+    EXPECT_EQ(state_.getBackendCommBackoffTimeLeftToWait(2, 1500), 500);
+    EXPECT_FALSE(state_.tryToProbeBackendComm(2, 1500, 100));
+
+    // failure of a request started before the pool backed off does not extend the wait
+    state_.onBackendCommError(3, 5000, 1500);
+    EXPECT_EQ(state_.getBackendCommBackoffErrorCount(), 2u);
+    EXPECT_EQ(state_.getBackendCommBackoffTimeLeftToWait(3, 1500), 500);
+}
+
+TEST_F(SharedMemoryStateTest, backendCommBackoffSingleProcessProbesRecovery) {
+    state_.onBackendCommError(2, 2000, 1000);
+
+    // waiting is over but nobody is probing yet
+    EXPECT_EQ(state_.getBackendCommBackoffTimeLeftToWait(2, 2000), 0);
+
+    EXPECT_TRUE(state_.tryToProbeBackendComm(1, 2000, 100));
+    EXPECT_TRUE(state_.tryToProbeBackendComm(1, 2010, 100));
+    EXPECT_EQ(state_.getBackendCommBackoffTimeLeftToWait(1, 2010), 0);
+    EXPECT_FALSE(state_.tryToProbeBackendComm(2, 2010, 100));
+    EXPECT_EQ(state_.getBackendCommBackoffTimeLeftToWait(2, 2010), 90);
+
+    state_.onBackendCommSuccess();
+    EXPECT_EQ(state_.getBackendCommBackoffErrorCount(), 0u);
+    EXPECT_TRUE(state_.tryToProbeBackendComm(2, 2020, 100));
+}
+
+TEST_F(SharedMemoryStateTest, backendCommBackoffFailedProbeExtendsWait) {
+    state_.onBackendCommError(2, 2000, 1000);
+    EXPECT_TRUE(state_.tryToProbeBackendComm(1, 2000, 100));
+
+    state_.onBackendCommError(3, 6000, 2050);
+    EXPECT_EQ(state_.getBackendCommBackoffErrorCount(), 3u);
+    EXPECT_EQ(state_.getBackendCommBackoffTimeLeftToWait(1, 2050), 3950);
+    EXPECT_FALSE(state_.tryToProbeBackendComm(1, 2050, 100));
+    EXPECT_EQ(state_.getBackendCommBackoffTimeLeftToWait(2, 2050), 3950);
+}
+
+TEST_F(SharedMemoryStateTest, backendCommBackoffProbeTimesOut) {
+    state_.onBackendCommError(2, 2000, 1000);
+    EXPECT_TRUE(state_.tryToProbeBackendComm(1, 2000, 100));
+
+    // the probing process did not report the outcome in time (for example it was terminated) so another process takes over
+    EXPECT_TRUE(state_.tryToProbeBackendComm(2, 2100, 100));
+    EXPECT_FALSE(state_.tryToProbeBackendComm(1, 2150, 100));
+}
+
 }
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <random>
+
+namespace elasticapm::sidecar {
+
+// Same backoff as the extension's in-process sender (and other Elastic APM agents):
+// after N-th consecutive error wait min((N - 1)^2, 36) seconds +/- 10% jitter
+class Backoff {
+public:
+    // returns random value in range [-1, 1]
+    using jitter_generator_t = std::function<double()>;
+
+    static constexpr std::size_t maxSequentialErrorsCount = 7;
+
+    Backoff() : jitterGenerator_([]() {
+        static thread_local std::mt19937 engine{std::random_device{}()};
+        return std::uniform_real_distribution<double>(-1.0, 1.0)(engine);
+    }) {
+    }
+
+    explicit Backoff(jitter_generator_t jitterGenerator) : jitterGenerator_(std::move(jitterGenerator)) {
+    }
+
+    void onSuccess() {
+        errorCount_ = 0;
+    }
+
+    // returns how long to wait before the next attempt
+    std::chrono::milliseconds onError() {
+        if (errorCount_ < maxSequentialErrorsCount) {
+            ++errorCount_;
+        }
+        return getWaitDuration();
+    }
+
+    std::size_t getErrorCount() const {
+        return errorCount_;
+    }
+
+    static std::chrono::milliseconds getWaitDurationWithoutJitter(std::size_t errorCount) {
+        if (errorCount == 0) {
+            return std::chrono::milliseconds::zero();
+        }
+        std::size_t reconnectCount = errorCount - 1;
+        return std::chrono::seconds(std::min<std::size_t>(reconnectCount * reconnectCount, 36));
+    }
+
+private:
+    std::chrono::milliseconds getWaitDuration() const {
+        auto withoutJitter = getWaitDurationWithoutJitter(errorCount_);
+        double jitterHalfRange = static_cast<double>(withoutJitter.count()) * 0.1;
+        double jitter = std::clamp(jitterGenerator_(), -1.0, 1.0) * jitterHalfRange;
+        return std::chrono::milliseconds(withoutJitter.count() + static_cast<std::chrono::milliseconds::rep>(std::round(jitter)));
+    }
+
+    jitter_generator_t jitterGenerator_;
+    std::size_t errorCount_ = 0;
+};
+
+}
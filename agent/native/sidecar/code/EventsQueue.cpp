@@ -0,0 +1,93 @@
+#include "EventsQueue.h"
+
+#include <string_view>
+
+namespace elasticapm::sidecar {
+
+namespace {
+
+std::string_view getMetadataLine(std::string_view serializedEvents) {
+    auto endOfLine = serializedEvents.find('\n');
+    return endOfLine == std::string_view::npos ? serializedEvents : serializedEvents.substr(0, endOfLine + 1);
+}
+
+bool canCoalesce(Batch const &batch, Frame const &frame) {
+    return batch.userAgent == frame.userAgent && getMetadataLine(batch.body) == getMetadataLine(frame.serializedEvents);
+}
+
+void appendFrameEvents(Batch &batch, Frame const &frame) {
+    if (!batch.body.empty() && batch.body.back() != '\n') {
+        batch.body.push_back('\n');
+    }
+    // metadata is sent only once at the beginning of the request
+    batch.body.append(std::string_view(frame.serializedEvents).substr(getMetadataLine(frame.serializedEvents).length()));
+    ++batch.framesCount;
+}
+
+}
+
+bool EventsQueue::push(Frame frame) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::size_t frameSize = frame.serializedEvents.size();
+        if (closed_ || size_ + frameSize > maxSize_) {
+            ++droppedFramesCount_;
+            return false;
+        }
+        size_ += frameSize;
+        frames_.emplace_back(std::move(frame));
+    }
+    frameAvailable_.notify_one();
+    return true;
+}
+
+std::optional<Batch> EventsQueue::popBatch(std::chrono::milliseconds timeout, std::size_t maxBatchSize) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    frameAvailable_.wait_for(lock, timeout, [this]() -> bool {
+        return !frames_.empty() || closed_;
+    });
+
+    if (frames_.empty()) {
+        return std::nullopt;
+    }
+
+    Batch batch;
+    batch.userAgent = std::move(frames_.front().userAgent);
+    batch.body = std::move(frames_.front().serializedEvents);
+    batch.framesCount = 1;
+    size_ -= batch.body.size();
+    frames_.pop_front();
+
+    while (!frames_.empty() && batch.body.size() + frames_.front().serializedEvents.size() <= maxBatchSize && canCoalesce(batch, frames_.front())) {
+        size_ -= frames_.front().serializedEvents.size();
+        appendFrameEvents(batch, frames_.front());
+        frames_.pop_front();
+    }
+
+    return batch;
+}
+
+void EventsQueue::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+    }
+    frameAvailable_.notify_all();
+}
+
+bool EventsQueue::isClosed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return closed_;
+}
+
+std::size_t EventsQueue::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return size_;
+}
+
+uint64_t EventsQueue::getDroppedFramesCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return droppedFramesCount_;
+}
+
+}
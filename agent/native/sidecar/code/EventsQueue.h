@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Frame.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+
+namespace elasticapm::sidecar {
+
+// Events to send in one intake API request
+struct Batch {
+    std::string userAgent;
+    std::string body; // NDJSON - metadata line followed by events
+    std::size_t framesCount = 0;
+};
+
+// Frames received from all the connections waiting to be sent to APM Server.
+// The queue is bounded by the total size of queued events - frames that don't fit are dropped.
+class EventsQueue {
+public:
+    explicit EventsQueue(std::size_t maxSize) : maxSize_(maxSize) {
+    }
+
+    bool push(Frame frame); // returns false if the frame was dropped
+
+    // Waits up to timeout for at least one frame and coalesces consecutive frames with the same User-Agent and metadata
+    // into one batch as long as the batch stays below maxBatchSize.
+    // After close() it does not wait - it returns frames left in the queue and then std::nullopt
+    std::optional<Batch> popBatch(std::chrono::milliseconds timeout, std::size_t maxBatchSize);
+
+    void close();
+
+    bool isClosed() const;
+    std::size_t size() const;
+    uint64_t getDroppedFramesCount() const;
+
+private:
+    EventsQueue(const EventsQueue&) = delete;
+    EventsQueue& operator=(const EventsQueue&) = delete;
+
+    mutable std::mutex mutex_;
+    std::condition_variable frameAvailable_;
+    std::deque<Frame> frames_;
+    std::size_t size_ = 0;
+    std::size_t maxSize_;
+    uint64_t droppedFramesCount_ = 0;
+    bool closed_ = false;
+};
+
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+
+namespace elasticapm::sidecar {
+
+// Batch of events received from one of the extension's processes
+struct Frame {
+    std::string userAgent;
+    std::string serializedEvents; // NDJSON - the first line is metadata
+};
+
+}
@@ -0,0 +1,53 @@
+#include "FrameReader.h"
+
+#include "SidecarProtocol.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace elasticapm::sidecar {
+
+void FrameReader::feed(std::string_view data) {
+    if (offset_ > 0) {
+        buffer_.erase(0, offset_);
+        offset_ = 0;
+    }
+    buffer_.append(data);
+}
+
+std::optional<Frame> FrameReader::next() {
+    std::size_t available = buffer_.size() - offset_;
+    if (available < sizeof(FrameHeader)) {
+        return std::nullopt;
+    }
+
+    FrameHeader header;
+    std::memcpy(&header, buffer_.data() + offset_, sizeof(header));
+
+    if (header.magic != frameMagic) {
+        throw std::runtime_error("Invalid frame magic: " + std::to_string(header.magic));
+    }
+    if (header.version != protocolVersion) {
+        throw std::runtime_error("Unsupported protocol version: " + std::to_string(header.version));
+    }
+    if (header.userAgentLength > maxUserAgentLength || header.serializedEventsLength > maxSerializedEventsLength) {
+        throw std::runtime_error("Frame is too large; userAgentLength: " + std::to_string(header.userAgentLength) + "; serializedEventsLength: " + std::to_string(header.serializedEventsLength));
+    }
+
+    std::size_t frameSize = sizeof(header) + header.userAgentLength + header.serializedEventsLength;
+    if (available < frameSize) {
+        return std::nullopt;
+    }
+
+    const char *payload = buffer_.data() + offset_ + sizeof(header);
+    Frame frame{std::string(payload, header.userAgentLength), std::string(payload + header.userAgentLength, header.serializedEventsLength)};
+    offset_ += frameSize;
+    if (offset_ == buffer_.size()) {
+        buffer_.clear();
+        offset_ = 0;
+    }
+    return frame;
+}
+
+}
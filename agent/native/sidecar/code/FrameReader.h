@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Frame.h"
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace elasticapm::sidecar {
+
+// Parses frames from the data received on a connection - the data can be split at any point
+class FrameReader {
+public:
+    void feed(std::string_view data);
+
+    // returns std::nullopt if the whole frame was not received yet, throws std::runtime_error if the data is not a valid frame
+    std::optional<Frame> next();
+
+    bool hasPartialFrame() const {
+        return offset_ < buffer_.size();
+    }
+
+private:
+    std::string buffer_;
+    std::size_t offset_ = 0;
+};
+
+}
@@ -0,0 +1,163 @@
+#include "IntakeClient.h"
+
+#include "Log.h"
+
+#include <curl/curl.h>
+#include <zlib.h>
+
+#include <stdexcept>
+#include <string_view>
+
+namespace elasticapm::sidecar {
+
+namespace {
+
+constexpr std::string_view unixSocketServerUrlPrefix = "unix://";
+// host is not used to connect over Unix domain socket but it's still sent in Host HTTP request header
+constexpr std::string_view unixSocketUrlBase = "http://localhost";
+
+constexpr int gzipWindowBits = 15 + 16;
+constexpr int defaultMemLevel = 8;
+
+std::size_t discardResponseBody([[maybe_unused]] char *data, std::size_t size, std::size_t nmemb, [[maybe_unused]] void *userData) {
+    return size * nmemb;
+}
+
+class CurlHeaders {
+public:
+    ~CurlHeaders() {
+        curl_slist_free_all(list_);
+    }
+
+    void append(std::string const &header) {
+        curl_slist *newList = curl_slist_append(list_, header.c_str());
+        if (!newList) {
+            throw std::runtime_error("curl_slist_append failed");
+        }
+        list_ = newList;
+    }
+
+    curl_slist *get() const {
+        return list_;
+    }
+
+private:
+    curl_slist *list_ = nullptr;
+};
+
+}
+
+bool isRetriableHttpStatus(long httpStatusCode) {
+    // Request failed without HTTP response - for example connection was refused or reset, or timed out
+    if (httpStatusCode == 0) {
+        return true;
+    }
+    if (httpStatusCode / 100 == 4) {
+        return httpStatusCode == 408 || httpStatusCode == 429;
+    }
+    return true;
+}
+
+std::string gzipCompress(std::string const &data) {
+    z_stream stream{};
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, gzipWindowBits, defaultMemLevel, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw std::runtime_error("deflateInit2 failed");
+    }
+
+    std::string compressed;
+    compressed.resize(deflateBound(&stream, data.size()));
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+    stream.avail_in = data.size();
+    stream.next_out = reinterpret_cast<Bytef *>(compressed.data());
+    stream.avail_out = compressed.size();
+
+    int result = deflate(&stream, Z_FINISH);
+    deflateEnd(&stream);
+    if (result != Z_STREAM_END) {
+        throw std::runtime_error("deflate failed: " + std::to_string(result));
+    }
+    compressed.resize(stream.total_out);
+    return compressed;
+}
+
+IntakeClient::IntakeClient(IntakeConfig config) : config_(std::move(config)) {
+    // same unix:///path/to/socket form of server URL as supported by the extension
+    if (config_.serverUrl.starts_with(unixSocketServerUrlPrefix)) {
+        unixSocketPath_ = config_.serverUrl.substr(unixSocketServerUrlPrefix.length());
+        url_ = unixSocketUrlBase;
+    } else {
+        url_ = config_.serverUrl;
+    }
+    if (!url_.empty() && url_.back() == '/') {
+        url_.pop_back();
+    }
+    url_ += "/intake/v2/events";
+
+    if (!config_.apiKey.empty()) {
+        authorizationHeader_ = "Authorization: ApiKey " + config_.apiKey;
+    } else if (!config_.secretToken.empty()) {
+        authorizationHeader_ = "Authorization: Bearer " + config_.secretToken;
+    }
+
+    curl_ = curl_easy_init();
+    if (!curl_) {
+        throw std::runtime_error("curl_easy_init failed");
+    }
+}
+
+IntakeClient::~IntakeClient() {
+    curl_easy_cleanup(curl_);
+}
+
+SendResult IntakeClient::send(Batch const &batch) {
+    std::string compressedBody;
+    CurlHeaders headers;
+    headers.append("Content-Type: application/x-ndjson");
+    if (config_.compress) {
+        compressedBody = gzipCompress(batch.body);
+        headers.append("Content-Encoding: gzip");
+    }
+    if (!authorizationHeader_.empty()) {
+        headers.append(authorizationHeader_);
+    }
+    headers.append("User-Agent: " + batch.userAgent);
+    std::string const &body = config_.compress ? compressedBody : batch.body;
+
+    // Options are set again for each request but the connection is reused
+    curl_easy_reset(curl_);
+    curl_easy_setopt(curl_, CURLOPT_URL, url_.c_str());
+    if (!unixSocketPath_.empty()) {
+        curl_easy_setopt(curl_, CURLOPT_UNIX_SOCKET_PATH, unixSocketPath_.c_str());
+    }
+    curl_easy_setopt(curl_, CURLOPT_POST, 1L);
+    curl_easy_setopt(curl_, CURLOPT_POSTFIELDS, body.data());
+    curl_easy_setopt(curl_, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(body.size()));
+    curl_easy_setopt(curl_, CURLOPT_HTTPHEADER, headers.get());
+    curl_easy_setopt(curl_, CURLOPT_TIMEOUT_MS, static_cast<long>(config_.timeout.count()));
+    curl_easy_setopt(curl_, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, discardResponseBody);
+    if (!config_.verifyServerCert) {
+        curl_easy_setopt(curl_, CURLOPT_SSL_VERIFYPEER, 0L);
+        curl_easy_setopt(curl_, CURLOPT_SSL_VERIFYHOST, 0L);
+    }
+
+    CURLcode result = curl_easy_perform(curl_);
+    if (result != CURLE_OK) {
+        logMessage(LogLevel::error, std::string("Sending events to APM Server failed: ") + curl_easy_strerror(result) + "; url: " + url_);
+        return SendResult::retriableFailure;
+    }
+
+    long httpStatusCode = 0;
+    curl_easy_getinfo(curl_, CURLINFO_RESPONSE_CODE, &httpStatusCode);
+    if (httpStatusCode >= 200 && httpStatusCode < 300) {
+        if (isLogLevelEnabled(LogLevel::debug)) {
+            logMessage(LogLevel::debug, "Sent " + std::to_string(batch.framesCount) + " batch(es) of events; body size: " + std::to_string(batch.body.size()) + "; sent size: " + std::to_string(body.size()));
+        }
+        return SendResult::success;
+    }
+
+    logMessage(LogLevel::error, "APM Server responded with HTTP status " + std::to_string(httpStatusCode) + "; url: " + url_);
+    return isRetriableHttpStatus(httpStatusCode) ? SendResult::retriableFailure : SendResult::nonRetriableFailure;
+}
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "EventsQueue.h"
+
+#include <chrono>
+#include <string>
+
+typedef void CURL;
+
+namespace elasticapm::sidecar {
+
+struct IntakeConfig {
+    std::string serverUrl = "http://localhost:8200";
+    std::string secretToken;
+    std::string apiKey;
+    std::chrono::milliseconds timeout{30000};
+    bool verifyServerCert = true;
+    bool compress = true;
+};
+
+enum class SendResult { success, retriableFailure, nonRetriableFailure };
+
+// Same classification as the extension: only failures without HTTP response, 5xx, 408 and 429 are worth retrying
+bool isRetriableHttpStatus(long httpStatusCode);
+
+std::string gzipCompress(std::string const &data); // throws std::runtime_error
+
+// Sends batches to APM Server's intake API - the connection is kept open between requests.
+// It's not thread safe - it's used only by the sender thread
+class IntakeClient {
+public:
+    explicit IntakeClient(IntakeConfig config);
+    ~IntakeClient();
+
+    SendResult send(Batch const &batch);
+
+private:
+    IntakeClient(const IntakeClient&) = delete;
+    IntakeClient& operator=(const IntakeClient&) = delete;
+
+    IntakeConfig config_;
+    std::string url_;
+    std::string unixSocketPath_;
+    std::string authorizationHeader_;
+    CURL *curl_ = nullptr;
+};
+
+}
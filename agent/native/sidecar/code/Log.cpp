@@ -0,0 +1,58 @@
+#include "Log.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <unistd.h>
+
+namespace elasticapm::sidecar {
+
+namespace {
+std::atomic<LogLevel> currentLogLevel{LogLevel::info};
+
+std::string_view getLogLevelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::error:
+            return "ERROR";
+        case LogLevel::warning:
+            return "WARNING";
+        case LogLevel::info:
+            return "INFO";
+        case LogLevel::debug:
+            return "DEBUG";
+    }
+    return "UNKNOWN";
+}
+}
+
+void setLogLevel(LogLevel level) {
+    currentLogLevel.store(level, std::memory_order_relaxed);
+}
+
+bool isLogLevelEnabled(LogLevel level) {
+    return level <= currentLogLevel.load(std::memory_order_relaxed);
+}
+
+void logMessage(LogLevel level, std::string_view message) {
+    if (!isLogLevelEnabled(level)) {
+        return;
+    }
+    auto now = std::chrono::system_clock::now();
+    std::time_t nowSeconds = std::chrono::system_clock::to_time_t(now);
+    auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000;
+    std::tm nowTm;
+    gmtime_r(&nowSeconds, &nowTm);
+    char timestamp[64];
+    std::size_t timestampLength = std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", &nowTm);
+    std::snprintf(timestamp + timestampLength, sizeof(timestamp) - timestampLength, ".%03dZ", static_cast<int>(milliseconds));
+
+    // one fputs per line so lines written by different threads are not interleaved
+    std::string line = std::string(timestamp) + " [Elastic APM sidecar] [PID: " + std::to_string(getpid()) + "] [" + std::string(getLogLevelName(level)) + "] ";
+    line.append(message);
+    line.push_back('\n');
+    std::fputs(line.c_str(), stderr);
+}
+
+}
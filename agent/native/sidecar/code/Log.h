@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string_view>
+
+namespace elasticapm::sidecar {
+
+enum class LogLevel { error = 1, warning, info, debug };
+
+void setLogLevel(LogLevel level);
+bool isLogLevelEnabled(LogLevel level);
+void logMessage(LogLevel level, std::string_view message); // writes to stderr
+
+}
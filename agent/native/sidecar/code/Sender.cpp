@@ -0,0 +1,92 @@
+#include "Sender.h"
+
+#include "Log.h"
+
+#include <exception>
+#include <string>
+
+namespace elasticapm::sidecar {
+
+Sender::Sender(EventsQueue &queue, send_func_t send, Options options, Backoff backoff) : queue_(queue), send_(std::move(send)), options_(options), backoff_(std::move(backoff)), thread_([this]() { work(); }) {
+}
+
+Sender::~Sender() {
+    stop(std::chrono::milliseconds::zero());
+}
+
+void Sender::stop(std::chrono::milliseconds flushTimeout) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!isStopping_) {
+            isStopping_ = true;
+            flushDeadline_ = clock_t::now() + flushTimeout;
+        }
+    }
+    queue_.close();
+    stopRequested_.notify_all();
+
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void Sender::work() {
+    while (true) {
+        auto batch = queue_.popBatch(options_.pollInterval, options_.maxBatchSize);
+        if (!batch) {
+            if (queue_.isClosed()) {
+                break;
+            }
+            continue;
+        }
+
+        if (isPastFlushDeadline()) {
+            droppedBatchesCount_.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        sendWithRetries(*batch);
+    }
+}
+
+void Sender::sendWithRetries(Batch const &batch) {
+    for (std::size_t attempt = 1;; ++attempt) {
+        SendResult result;
+        try {
+            result = send_(batch);
+        } catch (std::exception const &e) {
+            logMessage(LogLevel::error, std::string("Sending events to APM Server failed: ") + e.what());
+            result = SendResult::nonRetriableFailure;
+        }
+
+        if (result == SendResult::success) {
+            backoff_.onSuccess();
+            sentBatchesCount_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        auto waitDuration = backoff_.onError();
+        if (result == SendResult::nonRetriableFailure || attempt >= options_.maxSendAttempts || !waitBeforeRetry(waitDuration)) {
+            logMessage(LogLevel::warning, "Dropping " + std::to_string(batch.framesCount) + " batch(es) of events after " + std::to_string(attempt) + " attempt(s)");
+            droppedBatchesCount_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+bool Sender::waitBeforeRetry(std::chrono::milliseconds duration) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto waitEnd = clock_t::now() + duration;
+    auto wouldExceedFlushDeadline = [this, waitEnd]() -> bool {
+        return isStopping_ && flushDeadline_ < waitEnd;
+    };
+    stopRequested_.wait_until(lock, waitEnd, wouldExceedFlushDeadline);
+    return !wouldExceedFlushDeadline();
+}
+
+bool Sender::isPastFlushDeadline() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return isStopping_ && flushDeadline_ <= clock_t::now();
+}
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Backoff.h"
+#include "EventsQueue.h"
+#include "IntakeClient.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace elasticapm::sidecar {
+
+// Takes batches from the queue and sends them to APM Server on its own thread.
+// Retriable failures are retried with backoff - the batch is dropped after maxSendAttempts attempts
+class Sender {
+public:
+    using clock_t = std::chrono::steady_clock;
+    using send_func_t = std::function<SendResult(Batch const &)>;
+
+    struct Options {
+        std::size_t maxBatchSize = 4 * 1024 * 1024;
+        std::size_t maxSendAttempts = 10;
+        std::chrono::milliseconds pollInterval{1000};
+    };
+
+    Sender(EventsQueue &queue, send_func_t send, Options options, Backoff backoff = {});
+    ~Sender();
+
+    // Stops accepting new frames and tries to send what is left in the queue until flushTimeout is reached
+    void stop(std::chrono::milliseconds flushTimeout);
+
+    uint64_t getSentBatchesCount() const {
+        return sentBatchesCount_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t getDroppedBatchesCount() const {
+        return droppedBatchesCount_.load(std::memory_order_relaxed);
+    }
+
+private:
+    Sender(const Sender&) = delete;
+    Sender& operator=(const Sender&) = delete;
+
+    void work();
+    void sendWithRetries(Batch const &batch);
+    bool waitBeforeRetry(std::chrono::milliseconds duration); // returns false if the flush deadline would be exceeded
+    bool isPastFlushDeadline();
+
+    EventsQueue &queue_;
+    send_func_t send_;
+    Options options_;
+    Backoff backoff_;
+
+    std::mutex mutex_;
+    std::condition_variable stopRequested_;
+    bool isStopping_ = false;
+    clock_t::time_point flushDeadline_ = clock_t::time_point::max();
+
+    std::atomic<uint64_t> sentBatchesCount_ = 0;
+    std::atomic<uint64_t> droppedBatchesCount_ = 0;
+
+    std::thread thread_;
+};
+
+}
@@ -0,0 +1,167 @@
+#include "SidecarServer.h"
+
+#include "Log.h"
+
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace elasticapm::sidecar {
+
+namespace {
+
+constexpr int listenBacklog = 128;
+constexpr std::size_t readBufferSize = 64 * 1024;
+
+[[noreturn]] void throwSystemError(std::string const &what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+}
+
+SidecarServer::SidecarServer(std::string socketPath, EventsQueue &queue, mode_t socketMode) : socketPath_(std::move(socketPath)), queue_(queue) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath_.empty() || socketPath_.size() >= sizeof(address.sun_path)) {
+        throw std::system_error(ENAMETOOLONG, std::generic_category(), "Invalid socket path: `" + socketPath_ + "'");
+    }
+    std::memcpy(address.sun_path, socketPath_.c_str(), socketPath_.size() + 1);
+
+    if (pipe2(stopPipe_, O_CLOEXEC | O_NONBLOCK) != 0) {
+        throwSystemError("pipe2");
+    }
+
+    listenFd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (listenFd_ < 0) {
+        close(stopPipe_[0]);
+        close(stopPipe_[1]);
+        throwSystemError("socket");
+    }
+
+    // Socket file left by a previous instance that did not exit cleanly
+    struct stat existing;
+    if (lstat(socketPath_.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode)) {
+        unlink(socketPath_.c_str());
+    }
+
+    if (bind(listenFd_, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || chmod(socketPath_.c_str(), socketMode) != 0 || listen(listenFd_, listenBacklog) != 0) {
+        int errnoValue = errno;
+        close(listenFd_);
+        close(stopPipe_[0]);
+        close(stopPipe_[1]);
+        throw std::system_error(errnoValue, std::generic_category(), "Failed to listen on `" + socketPath_ + "'");
+    }
+}
+
+SidecarServer::~SidecarServer() {
+    for (auto &connection : connections_) {
+        close(connection.fd);
+    }
+    close(listenFd_);
+    unlink(socketPath_.c_str());
+    close(stopPipe_[0]);
+    close(stopPipe_[1]);
+}
+
+void SidecarServer::stop() {
+    char signal = 0;
+    [[maybe_unused]] ssize_t written = write(stopPipe_[1], &signal, 1);
+}
+
+void SidecarServer::run() {
+    std::vector<pollfd> pollFds;
+    while (true) {
+        pollFds.clear();
+        pollFds.push_back({stopPipe_[0], POLLIN, 0});
+        pollFds.push_back({listenFd_, POLLIN, 0});
+        for (auto const &connection : connections_) {
+            pollFds.push_back({connection.fd, POLLIN, 0});
+        }
+
+        if (poll(pollFds.data(), pollFds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throwSystemError("poll");
+        }
+
+        if (pollFds[0].revents != 0) {
+            return;
+        }
+
+        // pollFds after the first two are in the same order as connections_
+        auto pollFd = pollFds.begin() + 2;
+        for (auto connection = connections_.begin(); connection != connections_.end(); ++pollFd) {
+            if (pollFd->revents == 0 || readFromConnection(*connection)) {
+                ++connection;
+                continue;
+            }
+            close(connection->fd);
+            connection = connections_.erase(connection);
+        }
+
+        if (pollFds[1].revents != 0) {
+            acceptConnections();
+        }
+    }
+}
+
+void SidecarServer::acceptConnections() {
+    while (true) {
+        int fd = accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                logMessage(LogLevel::error, std::string("accept4 failed: ") + std::strerror(errno));
+            }
+            return;
+        }
+        connections_.push_back({fd, {}});
+        if (isLogLevelEnabled(LogLevel::debug)) {
+            logMessage(LogLevel::debug, "Accepted connection; number of connections: " + std::to_string(connections_.size()));
+        }
+    }
+}
+
+bool SidecarServer::readFromConnection(Connection &connection) {
+    // Only one read per poll() so that a busy connection doesn't starve the others
+    char buffer[readBufferSize];
+    ssize_t received = read(connection.fd, buffer, sizeof(buffer));
+    if (received == 0) {
+        if (connection.reader.hasPartialFrame()) {
+            logMessage(LogLevel::warning, "Connection closed in the middle of a frame");
+        }
+        return false;
+    }
+    if (received < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return true;
+        }
+        logMessage(LogLevel::warning, std::string("Reading from connection failed: ") + std::strerror(errno));
+        return false;
+    }
+
+    try {
+        connection.reader.feed({buffer, static_cast<std::size_t>(received)});
+        while (auto frame = connection.reader.next()) {
+            receivedFramesCount_.fetch_add(1, std::memory_order_relaxed);
+            if (!queue_.push(std::move(*frame))) {
+                logMessage(LogLevel::warning, "Queue is full - dropped a batch of events");
+            }
+        }
+    } catch (std::exception const &e) {
+        logMessage(LogLevel::error, std::string("Closing connection that sent invalid data: ") + e.what());
+        return false;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "EventsQueue.h"
+#include "FrameReader.h"
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <string>
+
+#include <sys/types.h>
+
+namespace elasticapm::sidecar {
+
+// Accepts connections from the extension's processes on a Unix domain socket and puts received frames to the queue.
+// All the connections are handled by one thread calling run()
+class SidecarServer {
+public:
+    static constexpr mode_t defaultSocketMode = 0660;
+
+    // creates the socket (replacing the stale one left by a previous instance) - throws std::system_error on failure
+    // socketMode is applied to the socket file - PHP processes need write permission to connect
+    SidecarServer(std::string socketPath, EventsQueue &queue, mode_t socketMode = defaultSocketMode);
+    ~SidecarServer();
+
+    void run(); // returns after stop() is called
+
+    // can be called from any thread and from a signal handler
+    void stop();
+
+    uint64_t getReceivedFramesCount() const {
+        return receivedFramesCount_.load(std::memory_order_relaxed);
+    }
+
+private:
+    SidecarServer(const SidecarServer&) = delete;
+    SidecarServer& operator=(const SidecarServer&) = delete;
+
+    struct Connection {
+        int fd;
+        FrameReader reader;
+    };
+
+    void acceptConnections();
+    bool readFromConnection(Connection &connection); // returns false if the connection should be closed
+
+    std::string socketPath_;
+    EventsQueue &queue_;
+    int listenFd_ = -1;
+    int stopPipe_[2] = {-1, -1};
+    std::list<Connection> connections_;
+    std::atomic<uint64_t> receivedFramesCount_ = 0;
+};
+
+}
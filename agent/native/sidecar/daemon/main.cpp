@@ -0,0 +1,195 @@
+#include "CommonUtils.h"
+#include "EventsQueue.h"
+#include "IntakeClient.h"
+#include "Log.h"
+#include "Sender.h"
+#include "SidecarServer.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <signal.h>
+
+using namespace elasticapm::sidecar;
+using namespace std::string_view_literals;
+
+namespace {
+
+struct SidecarConfig {
+    std::string socketPath;
+    mode_t socketMode = SidecarServer::defaultSocketMode;
+    IntakeConfig intake;
+    std::size_t maxQueueSize = 64 * 1024 * 1024;
+    std::chrono::milliseconds flushTimeout{5000};
+    LogLevel logLevel = LogLevel::info;
+};
+
+constexpr std::string_view usage =
+    "Usage: elastic_apm_sidecar [options]\n"
+    "Receives events from Elastic APM PHP agent on a Unix domain socket and sends them to APM Server.\n"
+    "Point the agent to it with elastic_apm.backend_comm_sidecar_socket configuration option.\n"
+    "\n"
+    "Options (each can also be set with the environment variable in brackets):\n"
+    "  --socket=PATH            Unix domain socket to listen on (ELASTIC_APM_SIDECAR_SOCKET)\n"
+    "  --socket-mode=MODE       Permissions of the socket file in octal (ELASTIC_APM_SIDECAR_SOCKET_MODE), default: 0660\n"
+    "  --server-url=URL         APM Server URL, can be unix:///path/to/socket (ELASTIC_APM_SERVER_URL), default: http://localhost:8200\n"
+    "  --secret-token=TOKEN     (ELASTIC_APM_SECRET_TOKEN)\n"
+    "  --api-key=KEY            (ELASTIC_APM_API_KEY)\n"
+    "  --server-timeout=DURATION (ELASTIC_APM_SERVER_TIMEOUT), default: 30s\n"
+    "  --verify-server-cert=BOOL (ELASTIC_APM_VERIFY_SERVER_CERT), default: true\n"
+    "  --max-queue-size=BYTES   (ELASTIC_APM_SIDECAR_MAX_QUEUE_SIZE), default: 67108864\n"
+    "  --flush-timeout=DURATION (ELASTIC_APM_SIDECAR_FLUSH_TIMEOUT), time to send queued events on exit, default: 5s\n"
+    "  --log-level=LEVEL        error, warning, info or debug (ELASTIC_APM_SIDECAR_LOG_LEVEL), default: info\n";
+
+bool parseBool(std::string_view value) {
+    if (value == "true"sv || value == "1"sv || value == "yes"sv || value == "on"sv) {
+        return true;
+    }
+    if (value == "false"sv || value == "0"sv || value == "no"sv || value == "off"sv) {
+        return false;
+    }
+    throw std::invalid_argument("Invalid boolean value: `" + std::string(value) + "'");
+}
+
+LogLevel parseLogLevel(std::string_view value) {
+    if (value == "error"sv) {
+        return LogLevel::error;
+    }
+    if (value == "warning"sv) {
+        return LogLevel::warning;
+    }
+    if (value == "info"sv) {
+        return LogLevel::info;
+    }
+    if (value == "debug"sv) {
+        return LogLevel::debug;
+    }
+    throw std::invalid_argument("Invalid log level: `" + std::string(value) + "'");
+}
+
+void applyOption(SidecarConfig &config, std::string_view name, std::string const &value) {
+    if (name == "socket"sv) {
+        config.socketPath = value;
+    } else if (name == "socket-mode"sv) {
+        config.socketMode = static_cast<mode_t>(std::stoul(value, nullptr, 8));
+    } else if (name == "server-url"sv) {
+        config.intake.serverUrl = value;
+    } else if (name == "secret-token"sv) {
+        config.intake.secretToken = value;
+    } else if (name == "api-key"sv) {
+        config.intake.apiKey = value;
+    } else if (name == "server-timeout"sv) {
+        // same default unit as server_timeout configuration option of the agent
+        config.intake.timeout = elasticapm::utils::convertDurationWithUnit(value.find_first_not_of("0123456789. ") == std::string::npos ? value + "s" : value);
+    } else if (name == "verify-server-cert"sv) {
+        config.intake.verifyServerCert = parseBool(value);
+    } else if (name == "max-queue-size"sv) {
+        config.maxQueueSize = std::stoull(value);
+    } else if (name == "flush-timeout"sv) {
+        config.flushTimeout = elasticapm::utils::convertDurationWithUnit(value);
+    } else if (name == "log-level"sv) {
+        config.logLevel = parseLogLevel(value);
+    } else {
+        throw std::invalid_argument("Unknown option: --" + std::string(name));
+    }
+}
+
+SidecarConfig parseConfig(int argc, char *argv[]) {
+    SidecarConfig config;
+
+    constexpr std::pair<std::string_view, const char *> environmentVariables[] = {
+        {"socket", "ELASTIC_APM_SIDECAR_SOCKET"},
+        {"socket-mode", "ELASTIC_APM_SIDECAR_SOCKET_MODE"},
+        {"server-url", "ELASTIC_APM_SERVER_URL"},
+        {"secret-token", "ELASTIC_APM_SECRET_TOKEN"},
+        {"api-key", "ELASTIC_APM_API_KEY"},
+        {"server-timeout", "ELASTIC_APM_SERVER_TIMEOUT"},
+        {"verify-server-cert", "ELASTIC_APM_VERIFY_SERVER_CERT"},
+        {"max-queue-size", "ELASTIC_APM_SIDECAR_MAX_QUEUE_SIZE"},
+        {"flush-timeout", "ELASTIC_APM_SIDECAR_FLUSH_TIMEOUT"},
+        {"log-level", "ELASTIC_APM_SIDECAR_LOG_LEVEL"},
+    };
+    for (auto const &[name, environmentVariable] : environmentVariables) {
+        if (const char *value = std::getenv(environmentVariable)) {
+            applyOption(config, name, value);
+        }
+    }
+
+    // command line takes precedence over environment variables
+    for (int i = 1; i < argc; ++i) {
+        std::string_view argument = argv[i];
+        auto separator = argument.find('=');
+        if (!argument.starts_with("--"sv) || separator == std::string_view::npos) {
+            throw std::invalid_argument("Invalid argument: `" + std::string(argument) + "'");
+        }
+        applyOption(config, argument.substr(2, separator - 2), std::string(argument.substr(separator + 1)));
+    }
+
+    if (config.socketPath.empty()) {
+        throw std::invalid_argument("Socket path is not set");
+    }
+    return config;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    if (argc == 2 && (argv[1] == "--help"sv || argv[1] == "-h"sv)) {
+        std::cout << usage;
+        return EXIT_SUCCESS;
+    }
+
+    SidecarConfig config;
+    try {
+        config = parseConfig(argc, argv);
+    } catch (std::exception const &e) {
+        std::cerr << e.what() << "\n\n" << usage;
+        return EXIT_FAILURE;
+    }
+    setLogLevel(config.logLevel);
+
+    // Signals are handled by a dedicated thread - threads created later inherit the mask
+    elasticapm::utils::blockSignal(SIGTERM);
+    elasticapm::utils::blockSignal(SIGINT);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    try {
+        EventsQueue queue(config.maxQueueSize);
+        IntakeClient intakeClient(config.intake);
+        SidecarServer server(config.socketPath, queue, config.socketMode);
+        Sender sender(queue, [&intakeClient](Batch const &batch) { return intakeClient.send(batch); }, Sender::Options{});
+
+        std::thread signalWaiter([&server]() {
+            sigset_t signals;
+            sigemptyset(&signals);
+            sigaddset(&signals, SIGTERM);
+            sigaddset(&signals, SIGINT);
+            int signal = 0;
+            sigwait(&signals, &signal);
+            logMessage(LogLevel::info, "Received signal " + std::to_string(signal) + " - shutting down");
+            server.stop();
+        });
+        signalWaiter.detach();
+
+        logMessage(LogLevel::info, "Listening on `" + config.socketPath + "'; sending events to " + config.intake.serverUrl);
+        server.run();
+
+        sender.stop(config.flushTimeout);
+        logMessage(LogLevel::info, "Stopped; received batches: " + std::to_string(server.getReceivedFramesCount())
+            + "; sent requests: " + std::to_string(sender.getSentBatchesCount())
+            + "; dropped requests: " + std::to_string(sender.getDroppedBatchesCount())
+            + "; dropped batches (queue full): " + std::to_string(queue.getDroppedFramesCount()));
+    } catch (std::exception const &e) {
+        logMessage(LogLevel::error, e.what());
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,44 @@
+#include "Backoff.h"
+
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+
+namespace elasticapm::sidecar {
+
+TEST(BackoffTest, WaitDurationWithoutJitter) {
+    ASSERT_EQ(Backoff::getWaitDurationWithoutJitter(0), 0ms);
+    ASSERT_EQ(Backoff::getWaitDurationWithoutJitter(1), 0ms);
+    ASSERT_EQ(Backoff::getWaitDurationWithoutJitter(2), 1s);
+    ASSERT_EQ(Backoff::getWaitDurationWithoutJitter(3), 4s);
+    ASSERT_EQ(Backoff::getWaitDurationWithoutJitter(6), 25s);
+    ASSERT_EQ(Backoff::getWaitDurationWithoutJitter(7), 36s);
+    ASSERT_EQ(Backoff::getWaitDurationWithoutJitter(100), 36s);
+}
+
+TEST(BackoffTest, Jitter) {
+    double jitter = 0;
+    Backoff backoff([&jitter]() { return jitter; });
+
+    ASSERT_EQ(backoff.onError(), 0ms);
+    ASSERT_EQ(backoff.onError(), 1s);
+
+    jitter = 1;
+    ASSERT_EQ(backoff.onError(), 4400ms);
+    jitter = -1;
+    ASSERT_EQ(backoff.onError(), 8100ms);
+    ASSERT_EQ(backoff.getErrorCount(), 4u);
+
+    for (int i = 0; i < 10; ++i) {
+        backoff.onError();
+    }
+    ASSERT_EQ(backoff.getErrorCount(), Backoff::maxSequentialErrorsCount);
+    jitter = 0;
+    ASSERT_EQ(backoff.onError(), 36s);
+
+    backoff.onSuccess();
+    ASSERT_EQ(backoff.getErrorCount(), 0u);
+    ASSERT_EQ(backoff.onError(), 0ms);
+}
+
+}
@@ -0,0 +1,87 @@
+#include "EventsQueue.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+namespace elasticapm::sidecar {
+
+TEST(EventsQueueTest, CoalescesFramesWithSameMetadata) {
+    EventsQueue queue(1024 * 1024);
+    ASSERT_TRUE(queue.push({"agent", "{\"metadata\":1}\n{\"span\":1}\n"}));
+    ASSERT_TRUE(queue.push({"agent", "{\"metadata\":1}\n{\"span\":2}\n{\"span\":3}"}));
+    ASSERT_TRUE(queue.push({"agent", "{\"metadata\":1}\n{\"span\":4}\n"}));
+    ASSERT_TRUE(queue.push({"agent", "{\"metadata\":2}\n{\"span\":5}\n"}));
+    ASSERT_TRUE(queue.push({"other agent", "{\"metadata\":2}\n{\"span\":6}\n"}));
+
+    auto batch = queue.popBatch(0ms, 1024);
+    ASSERT_TRUE(batch.has_value());
+    ASSERT_EQ(batch->userAgent, "agent");
+    ASSERT_EQ(batch->body, "{\"metadata\":1}\n{\"span\":1}\n{\"span\":2}\n{\"span\":3}\n{\"span\":4}\n");
+    ASSERT_EQ(batch->framesCount, 3u);
+
+    batch = queue.popBatch(0ms, 1024);
+    ASSERT_TRUE(batch.has_value());
+    ASSERT_EQ(batch->body, "{\"metadata\":2}\n{\"span\":5}\n");
+    ASSERT_EQ(batch->framesCount, 1u);
+
+    batch = queue.popBatch(0ms, 1024);
+    ASSERT_TRUE(batch.has_value());
+    ASSERT_EQ(batch->userAgent, "other agent");
+    ASSERT_EQ(batch->framesCount, 1u);
+
+    ASSERT_FALSE(queue.popBatch(0ms, 1024).has_value());
+    ASSERT_EQ(queue.size(), 0u);
+}
+
+TEST(EventsQueueTest, BatchSizeLimit) {
+    EventsQueue queue(1024 * 1024);
+    std::string frame = "{\"metadata\":1}\n{\"span\":1}\n";
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_TRUE(queue.push({"agent", frame}));
+    }
+
+    auto batch = queue.popBatch(0ms, frame.size() * 2);
+    ASSERT_TRUE(batch.has_value());
+    ASSERT_EQ(batch->framesCount, 2u);
+
+    // a frame larger than the limit is still sent on its own
+    batch = queue.popBatch(0ms, 1);
+    ASSERT_TRUE(batch.has_value());
+    ASSERT_EQ(batch->framesCount, 1u);
+}
+
+TEST(EventsQueueTest, DropsFramesWhenFull) {
+    EventsQueue queue(10);
+    ASSERT_TRUE(queue.push({"agent", "0123456789"}));
+    ASSERT_FALSE(queue.push({"agent", "0"}));
+    ASSERT_EQ(queue.getDroppedFramesCount(), 1u);
+
+    ASSERT_TRUE(queue.popBatch(0ms, 1024).has_value());
+    ASSERT_TRUE(queue.push({"agent", "0"}));
+}
+
+TEST(EventsQueueTest, CloseWakesUpWaitingConsumer) {
+    EventsQueue queue(1024);
+    ASSERT_TRUE(queue.push({"agent", "{\"metadata\":1}\n"}));
+
+    std::thread closer([&queue]() {
+        std::this_thread::sleep_for(10ms);
+        queue.close();
+    });
+
+    // frames left in the queue are still returned after close
+    ASSERT_TRUE(queue.popBatch(0ms, 1024).has_value());
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_FALSE(queue.popBatch(10s, 1024).has_value());
+    ASSERT_LT(std::chrono::steady_clock::now() - start, 5s);
+    closer.join();
+
+    ASSERT_TRUE(queue.isClosed());
+    ASSERT_FALSE(queue.push({"agent", "{\"metadata\":1}\n"}));
+}
+
+}
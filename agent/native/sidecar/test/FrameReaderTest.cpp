@@ -0,0 +1,74 @@
+#include "FrameReader.h"
+#include "SidecarProtocol.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace elasticapm::sidecar {
+
+namespace {
+std::string encodeFrame(std::string const &userAgent, std::string const &serializedEvents, uint32_t magic = frameMagic, uint32_t version = protocolVersion) {
+    FrameHeader header{magic, version, static_cast<uint32_t>(userAgent.size()), static_cast<uint32_t>(serializedEvents.size())};
+    std::string encoded(reinterpret_cast<const char *>(&header), sizeof(header));
+    return encoded + userAgent + serializedEvents;
+}
+}
+
+TEST(FrameReaderTest, WholeFrames) {
+    FrameReader reader;
+    reader.feed(encodeFrame("agent/1", "{\"metadata\":{}}\n{\"span\":{}}\n") + encodeFrame("agent/2", ""));
+
+    auto first = reader.next();
+    ASSERT_TRUE(first.has_value());
+    ASSERT_EQ(first->userAgent, "agent/1");
+    ASSERT_EQ(first->serializedEvents, "{\"metadata\":{}}\n{\"span\":{}}\n");
+
+    auto second = reader.next();
+    ASSERT_TRUE(second.has_value());
+    ASSERT_EQ(second->userAgent, "agent/2");
+    ASSERT_EQ(second->serializedEvents, "");
+
+    ASSERT_FALSE(reader.next().has_value());
+    ASSERT_FALSE(reader.hasPartialFrame());
+}
+
+TEST(FrameReaderTest, FrameSplitAtEachByte) {
+    std::string encoded = encodeFrame("agent", "{\"metadata\":{}}\n");
+    FrameReader reader;
+    for (std::size_t i = 0; i < encoded.size() - 1; ++i) {
+        reader.feed(encoded.substr(i, 1));
+        ASSERT_FALSE(reader.next().has_value());
+        ASSERT_TRUE(reader.hasPartialFrame());
+    }
+    reader.feed(encoded.substr(encoded.size() - 1));
+
+    auto frame = reader.next();
+    ASSERT_TRUE(frame.has_value());
+    ASSERT_EQ(frame->userAgent, "agent");
+    ASSERT_EQ(frame->serializedEvents, "{\"metadata\":{}}\n");
+    ASSERT_FALSE(reader.hasPartialFrame());
+}
+
+TEST(FrameReaderTest, InvalidFrames) {
+    {
+        FrameReader reader;
+        reader.feed(encodeFrame("agent", "events", 0x12345678));
+        EXPECT_THROW(reader.next(), std::runtime_error);
+    }
+    {
+        FrameReader reader;
+        reader.feed(encodeFrame("agent", "events", frameMagic, protocolVersion + 1));
+        EXPECT_THROW(reader.next(), std::runtime_error);
+    }
+    {
+        FrameHeader header{frameMagic, protocolVersion, 0, static_cast<uint32_t>(maxSerializedEventsLength + 1)};
+        FrameReader reader;
+        reader.feed(std::string(reinterpret_cast<const char *>(&header), sizeof(header)));
+        EXPECT_THROW(reader.next(), std::runtime_error);
+    }
+}
+
+}
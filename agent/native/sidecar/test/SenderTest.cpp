@@ -0,0 +1,97 @@
+#include "Sender.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+namespace elasticapm::sidecar {
+
+namespace {
+Sender::Options makeOptions(std::size_t maxSendAttempts) {
+    Sender::Options options;
+    options.maxSendAttempts = maxSendAttempts;
+    options.pollInterval = 10ms;
+    return options;
+}
+
+Backoff makeBackoffWithoutJitter() {
+    return Backoff([]() { return 0.0; });
+}
+}
+
+TEST(SenderTest, SendsQueuedBatches) {
+    EventsQueue queue(1024 * 1024);
+    std::atomic<int> sentFrames = 0;
+    Sender sender(queue, [&sentFrames](Batch const &batch) {
+        sentFrames += static_cast<int>(batch.framesCount);
+        return SendResult::success;
+    }, makeOptions(3), makeBackoffWithoutJitter());
+
+    for (int i = 0; i < 10; ++i) {
+        ASSERT_TRUE(queue.push({"agent", "{\"metadata\":1}\n{\"span\":" + std::to_string(i) + "}\n"}));
+    }
+    sender.stop(5s);
+
+    ASSERT_EQ(sentFrames, 10);
+    ASSERT_EQ(sender.getDroppedBatchesCount(), 0u);
+    ASSERT_GE(sender.getSentBatchesCount(), 1u);
+}
+
+TEST(SenderTest, RetriesRetriableFailure) {
+    EventsQueue queue(1024 * 1024);
+    std::atomic<int> attempts = 0;
+    // the first retry is without waiting so the test does not need to wait for the backoff
+    Sender sender(queue, [&attempts](Batch const &) {
+        return ++attempts == 1 ? SendResult::retriableFailure : SendResult::success;
+    }, makeOptions(3), makeBackoffWithoutJitter());
+
+    ASSERT_TRUE(queue.push({"agent", "{\"metadata\":1}\n"}));
+    sender.stop(5s);
+
+    ASSERT_EQ(attempts, 2);
+    ASSERT_EQ(sender.getSentBatchesCount(), 1u);
+    ASSERT_EQ(sender.getDroppedBatchesCount(), 0u);
+}
+
+TEST(SenderTest, DropsAfterNonRetriableFailure) {
+    EventsQueue queue(1024 * 1024);
+    std::atomic<int> attempts = 0;
+    Sender sender(queue, [&attempts](Batch const &) {
+        ++attempts;
+        return SendResult::nonRetriableFailure;
+    }, makeOptions(3), makeBackoffWithoutJitter());
+
+    ASSERT_TRUE(queue.push({"agent", "{\"metadata\":1}\n"}));
+    sender.stop(5s);
+
+    ASSERT_EQ(attempts, 1);
+    ASSERT_EQ(sender.getSentBatchesCount(), 0u);
+    ASSERT_EQ(sender.getDroppedBatchesCount(), 1u);
+}
+
+TEST(SenderTest, StopDoesNotWaitForBackoffBeyondFlushTimeout) {
+    EventsQueue queue(1024 * 1024);
+    std::atomic<int> attempts = 0;
+    Sender sender(queue, [&attempts](Batch const &) {
+        ++attempts;
+        return SendResult::retriableFailure;
+    }, makeOptions(10), makeBackoffWithoutJitter());
+
+    ASSERT_TRUE(queue.push({"agent", "{\"metadata\":1}\n"}));
+    // wait until the sender backs off for 1s after the second attempt
+    while (attempts < 2) {
+        std::this_thread::sleep_for(1ms);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    sender.stop(100ms);
+    ASSERT_LT(std::chrono::steady_clock::now() - start, 900ms);
+    ASSERT_EQ(attempts, 2);
+    ASSERT_EQ(sender.getDroppedBatchesCount(), 1u);
+}
+
+}
@@ -0,0 +1,117 @@
+#include "SidecarServer.h"
+#include "SidecarProtocol.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std::chrono_literals;
+
+namespace elasticapm::sidecar {
+
+namespace {
+std::string encodeFrame(std::string const &userAgent, std::string const &serializedEvents) {
+    FrameHeader header{frameMagic, protocolVersion, static_cast<uint32_t>(userAgent.size()), static_cast<uint32_t>(serializedEvents.size())};
+    return std::string(reinterpret_cast<const char *>(&header), sizeof(header)) + userAgent + serializedEvents;
+}
+
+int connectTo(std::string const &socketPath) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    socketPath.copy(address.sun_path, sizeof(address.sun_path) - 1);
+    if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void writeAll(int fd, std::string const &data) {
+    std::size_t written = 0;
+    while (written < data.size()) {
+        ssize_t result = write(fd, data.data() + written, data.size() - written);
+        ASSERT_GT(result, 0);
+        written += static_cast<std::size_t>(result);
+    }
+}
+}
+
+class SidecarServerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        socketPath_ = "/tmp/elastic_apm_sidecar_test_" + std::to_string(getpid()) + ".sock";
+        server_ = std::make_unique<SidecarServer>(socketPath_, queue_);
+        serverThread_ = std::thread([this]() { server_->run(); });
+    }
+
+    void TearDown() override {
+        server_->stop();
+        serverThread_.join();
+        server_.reset();
+        ASSERT_NE(access(socketPath_.c_str(), F_OK), 0);
+    }
+
+    std::optional<Batch> waitForBatch() {
+        return queue_.popBatch(5s, 1024 * 1024);
+    }
+
+    std::string socketPath_;
+    EventsQueue queue_{1024 * 1024};
+    std::unique_ptr<SidecarServer> server_;
+    std::thread serverThread_;
+};
+
+TEST_F(SidecarServerTest, ReceivesFramesFromMultipleConnections) {
+    int first = connectTo(socketPath_);
+    int second = connectTo(socketPath_);
+    ASSERT_GE(first, 0);
+    ASSERT_GE(second, 0);
+
+    std::string frame = encodeFrame("agent/1", "{\"metadata\":1}\n{\"span\":1}\n");
+    // frame split between two writes
+    writeAll(first, frame.substr(0, 10));
+    writeAll(second, encodeFrame("agent/2", "{\"metadata\":2}\n"));
+    std::this_thread::sleep_for(10ms);
+    writeAll(first, frame.substr(10));
+
+    std::set<std::string> userAgents;
+    for (int i = 0; i < 2; ++i) {
+        auto batch = waitForBatch();
+        ASSERT_TRUE(batch.has_value());
+        userAgents.insert(batch->userAgent);
+    }
+    ASSERT_EQ(userAgents, (std::set<std::string>{"agent/1", "agent/2"}));
+    ASSERT_EQ(server_->getReceivedFramesCount(), 2u);
+
+    close(first);
+    close(second);
+}
+
+TEST_F(SidecarServerTest, ClosesConnectionOnInvalidData) {
+    int fd = connectTo(socketPath_);
+    ASSERT_GE(fd, 0);
+    writeAll(fd, std::string(sizeof(FrameHeader), 'x'));
+
+    char buffer[1];
+    ASSERT_EQ(read(fd, buffer, sizeof(buffer)), 0);
+    close(fd);
+
+    // other connections are not affected
+    fd = connectTo(socketPath_);
+    ASSERT_GE(fd, 0);
+    writeAll(fd, encodeFrame("agent", "{\"metadata\":1}\n"));
+    ASSERT_TRUE(waitForBatch().has_value());
+    close(fd);
+}
+
+}
@@ -81,14 +81,20 @@ final class CurlAutoInstrumentation extends AutoInstrumentationBase
         }
 
         $this->registerDelegatingToHandleTracker($ctx, 'curl_init', self::CURL_INIT_ID);
-        $this->registerDelegatingToHandleTracker($ctx, 'curl_setopt', self::CURL_SETOPT_ID);
+        // Only a few options are tracked so calls setting other options do not need to reach pre-hook
+        $this->registerDelegatingToHandleTracker(
+            $ctx,
+            'curl_setopt',
+            self::CURL_SETOPT_ID,
+            InterceptedCallArgFilter::argIntValueIn(/* argIndex - option */ 1, CurlHandleTracker::TRACKED_SET_OPT_OPTION_IDS)
+        );
         $this->registerDelegatingToHandleTracker($ctx, 'curl_setopt_array', self::CURL_SETOPT_ARRAY_ID);
         $this->registerDelegatingToHandleTracker($ctx, 'curl_copy_handle', self::CURL_COPY_HANDLE_ID);
         $this->registerDelegatingToHandleTracker($ctx, 'curl_exec', self::CURL_EXEC_ID);
         $this->registerDelegatingToHandleTracker($ctx, 'curl_close', self::CURL_CLOSE_ID);
     }
 
-    public function registerDelegatingToHandleTracker(RegistrationContextInterface $ctx, string $funcName, int $funcId): void
+    public function registerDelegatingToHandleTracker(RegistrationContextInterface $ctx, string $funcName, int $funcId, ?InterceptedCallArgFilter $argFilter = null): void
     {
         $ctx->interceptCallsToInternalFunction(
             $funcName,
@@ -99,7 +105,8 @@ final class CurlAutoInstrumentation extends AutoInstrumentationBase
              */
             function (array $interceptedCallArgs) use ($funcName, $funcId): ?callable {
                 return $this->preHook($funcName, $funcId, $interceptedCallArgs);
-            }
+            },
+            $argFilter
         );
     }
 
@@ -65,6 +65,20 @@ final class CurlHandleTracker implements LoggableInterface
     private const POST_HTTP_METHOD = 'POST';
     private const PUT_HTTP_METHOD = 'PUT';
 
+    /**
+     * Options handled by processSetOpt - setting any other option does not affect the tracked state
+     */
+    public const TRACKED_SET_OPT_OPTION_IDS = [
+        CURLOPT_CUSTOMREQUEST,
+        CURLOPT_HTTPHEADER,
+        CURLOPT_HTTPGET,
+        CURLOPT_NOBODY,
+        CURLOPT_POST,
+        CURLOPT_POSTFIELDS,
+        CURLOPT_PUT,
+        CURLOPT_URL,
+    ];
+
     /** @var Tracer */
     private $tracer;
 
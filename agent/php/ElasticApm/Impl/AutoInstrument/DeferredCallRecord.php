@@ -0,0 +1,102 @@
+<?php
+
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+declare(strict_types=1);
+
+namespace Elastic\Apm\Impl\AutoInstrument;
+
+use Elastic\Apm\Impl\Log\LoggableInterface;
+use Elastic\Apm\Impl\Log\LoggableTrait;
+
+/**
+ * Intercepted call recorded by the extension without calling PHP part (see elastic_apm_record_intercepted_calls_deferred)
+ *
+ * Code in this file is part of implementation internals and thus it is not covered by the backward compatibility.
+ *
+ * @internal
+ */
+final class DeferredCallRecord implements LoggableInterface
+{
+    use LoggableTrait;
+
+    /** @var float UTC based and in microseconds since Unix epoch */
+    public $timestamp;
+
+    /** @var float In milliseconds */
+    public $duration;
+
+    /**
+     * ID of $this object (see spl_object_id) - the extension does not keep the object itself
+     * so the object's lifetime is not extended until the records are processed
+     *
+     * @var ?int
+     */
+    public $thisObjId;
+
+    /**
+     * Values of $this properties declared by the registration (null for properties that are not set)
+     *
+     * @var mixed[]
+     */
+    public $capturedThisProps;
+
+    /**
+     * Arguments at the indexes declared by the registration (null for arguments that were not passed)
+     *
+     * @var mixed[]
+     */
+    public $capturedArgs;
+
+    /** @var bool */
+    public $hasExitedByException;
+
+    /**
+     * Return value (only if the registration declared it should be captured) or the object thrown by the call
+     *
+     * @var mixed
+     */
+    public $returnValueOrThrown;
+
+    /**
+     * @param ?int    $thisObjId
+     * @param mixed[] $capturedThisProps
+     * @param mixed[] $capturedArgs
+     * @param mixed   $returnValueOrThrown
+     */
+    public function __construct(float $timestamp, float $duration, ?int $thisObjId, array $capturedThisProps, array $capturedArgs, bool $hasExitedByException, $returnValueOrThrown)
+    {
+        $this->timestamp = $timestamp;
+        $this->duration = $duration;
+        $this->thisObjId = $thisObjId;
+        $this->capturedThisProps = $capturedThisProps;
+        $this->capturedArgs = $capturedArgs;
+        $this->hasExitedByException = $hasExitedByException;
+        $this->returnValueOrThrown = $returnValueOrThrown;
+    }
+
+    /**
+     * @return string[]
+     */
+    protected static function propertiesExcludedFromLog(): array
+    {
+        return ['capturedThisProps', 'capturedArgs', 'returnValueOrThrown'];
+    }
+}
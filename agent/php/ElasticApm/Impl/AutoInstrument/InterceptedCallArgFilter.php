@@ -0,0 +1,99 @@
+<?php
+
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+declare(strict_types=1);
+
+namespace Elastic\Apm\Impl\AutoInstrument;
+
+use Elastic\Apm\Impl\Log\LoggableInterface;
+use Elastic\Apm\Impl\Log\LoggableTrait;
+
+/**
+ * Cheap predicate on one of the intercepted call's arguments evaluated by the extension
+ * - pre-hook is called only for the calls with the argument matching the predicate.
+ * Pre-hook should still handle the calls that do not match because the extension might not support the filter.
+ *
+ * Code in this file is part of implementation internals and thus it is not covered by the backward compatibility.
+ *
+ * @internal
+ */
+final class InterceptedCallArgFilter implements LoggableInterface
+{
+    use LoggableTrait;
+
+    private const KIND_TYPE = 'type';
+    private const KIND_INT_VALUE_IN = 'int_value_in';
+    private const KIND_STRING_PREFIX = 'string_prefix';
+
+    /** @var int */
+    public $argIndex;
+
+    /** @var string */
+    public $kind;
+
+    /** @var array<int|string> */
+    public $values;
+
+    /**
+     * @param int               $argIndex
+     * @param string            $kind
+     * @param array<int|string> $values
+     */
+    private function __construct(int $argIndex, string $kind, array $values)
+    {
+        $this->argIndex = $argIndex;
+        $this->kind = $kind;
+        $this->values = $values;
+    }
+
+    /**
+     * @param int      $argIndex
+     * @param string[] $types Type names as returned by gettype()
+     *
+     * @return self
+     */
+    public static function argTypeIn(int $argIndex, array $types): self
+    {
+        return new self($argIndex, self::KIND_TYPE, $types);
+    }
+
+    /**
+     * @param int   $argIndex
+     * @param int[] $values
+     *
+     * @return self
+     */
+    public static function argIntValueIn(int $argIndex, array $values): self
+    {
+        return new self($argIndex, self::KIND_INT_VALUE_IN, $values);
+    }
+
+    /**
+     * @param int      $argIndex
+     * @param string[] $prefixes
+     *
+     * @return self
+     */
+    public static function argStringHasPrefix(int $argIndex, array $prefixes): self
+    {
+        return new self($argIndex, self::KIND_STRING_PREFIX, $prefixes);
+    }
+}
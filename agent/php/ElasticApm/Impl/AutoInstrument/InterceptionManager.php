@@ -26,6 +26,7 @@ namespace Elastic\Apm\Impl\AutoInstrument;
 use Elastic\Apm\Impl\Log\LogCategory;
 use Elastic\Apm\Impl\Log\Logger;
 use Elastic\Apm\Impl\Tracer;
+use Elastic\Apm\Impl\Transaction;
 use Elastic\Apm\Impl\Util\ArrayUtil;
 use Elastic\Apm\Impl\Util\ClassNameUtil;
 use Elastic\Apm\Impl\Util\DbgUtil;
@@ -41,22 +42,22 @@ final class InterceptionManager
     /** @var Registration[] */
     private $interceptedCallRegistrations;
 
+    /** @var DeferredCallRegistration[] */
+    private $deferredCallRegistrations;
+
     /** @var Logger */
     private $logger;
 
     /** @var BuiltinPlugin */
     private $builtinPlugin;
 
-    /** @var int|null */
-    private $interceptedCallInProgressRegistrationId = null;
-
-    /** @var Registration|null */
-    private $interceptedCallInProgressRegistration = null;
-
     /**
-     * @var null|callable(int, bool, mixed): void
+     * Intercepted calls can be nested (for example when the extension uses zend_observer API)
+     * so post-hooks are kept as a stack - the extension calls post-hook for the innermost call first
+     *
+     * @var array<array{int, Registration, callable(int, bool, mixed): void}>
      */
-    private $interceptedCallInProgressPreHookRetVal = null;
+    private $interceptedCallsInProgress = [];
 
     public function __construct(Tracer $tracer)
     {
@@ -64,6 +65,10 @@ final class InterceptionManager
                                ->loggerForClass(LogCategory::INTERCEPTION, __NAMESPACE__, __CLASS__, __FILE__);
 
         $this->loadPlugins($tracer);
+
+        if (!ArrayUtil::isEmpty($this->deferredCallRegistrations)) {
+            $this->processDeferredCallRecordsBeforeTransactionEnd($tracer);
+        }
     }
 
     private function loadPlugins(Tracer $tracer): void
@@ -74,6 +79,58 @@ final class InterceptionManager
         $registerCtx->dbgCurrentPluginDesc = $this->builtinPlugin->getDescription();
         $this->builtinPlugin->register($registerCtx);
         $this->interceptedCallRegistrations = $registerCtx->interceptedCallRegistrations;
+        $this->deferredCallRegistrations = $registerCtx->deferredCallRegistrations;
+    }
+
+    private function processDeferredCallRecordsBeforeTransactionEnd(Tracer $tracer): void
+    {
+        $onBeforeTransactionEnd = function (Transaction $transaction): void {
+            $this->processDeferredCallRecords($transaction);
+        };
+
+        $tracer->onNewCurrentTransactionHasBegun->add(
+            function (Transaction $transaction) use ($onBeforeTransactionEnd): void {
+                $transaction->onBeforeEnd->add($onBeforeTransactionEnd);
+            }
+        );
+
+        $currentTransaction = $tracer->getCurrentTransaction();
+        if ($currentTransaction instanceof Transaction) {
+            $currentTransaction->onBeforeEnd->add($onBeforeTransactionEnd);
+        }
+    }
+
+    private function processDeferredCallRecords(Transaction $transaction): void
+    {
+        /**
+         * elastic_apm_* functions are provided by the elastic_apm extension
+         *
+         * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
+         * @phpstan-ignore-next-line
+         */
+        $records = \elastic_apm_take_deferred_call_records();
+
+        ($loggerProxy = $this->logger->ifTraceLevelEnabled(__LINE__, __FUNCTION__))
+        && $loggerProxy->log('Processing deferred call records...', ['records count' => count($records)]);
+
+        /** @var array{int, float, float, bool, ?int, mixed[], mixed[], mixed} $recordAsArray */
+        foreach ($records as $recordAsArray) {
+            [$interceptRegistrationId, $timestamp, $duration, $hasExitedByException, $thisObjId, $capturedThisProps, $capturedArgs, $returnValueOrThrown] = $recordAsArray;
+            $deferredCallRegistration = ArrayUtil::getValueIfKeyExistsElse($interceptRegistrationId, $this->deferredCallRegistrations, null);
+            if ($deferredCallRegistration === null) {
+                ($loggerProxy = $this->logger->ifErrorLevelEnabled(__LINE__, __FUNCTION__))
+                && $loggerProxy->log('There is no deferred call registration with the given interceptRegistrationId', compact('interceptRegistrationId'));
+                continue;
+            }
+
+            $record = new DeferredCallRecord($timestamp, $duration, $thisObjId, $capturedThisProps, $capturedArgs, $hasExitedByException, $returnValueOrThrown);
+            try {
+                ($deferredCallRegistration->processRecord)($transaction, $record);
+            } catch (Throwable $throwable) {
+                ($loggerProxy = $this->logger->ifErrorLevelEnabled(__LINE__, __FUNCTION__))
+                && $loggerProxy->logThrowable($throwable, 'processRecord has let a Throwable to escape', compact('deferredCallRegistration', 'record'));
+            }
+        }
     }
 
     /**
@@ -123,9 +180,7 @@ final class InterceptionManager
 
         $shouldCallPostHook = ($preHookRetVal !== null);
         if ($shouldCallPostHook) {
-            $this->interceptedCallInProgressRegistrationId = $interceptRegistrationId;
-            $this->interceptedCallInProgressRegistration = $interceptRegistration;
-            $this->interceptedCallInProgressPreHookRetVal = $preHookRetVal;
+            $this->interceptedCallsInProgress[] = [$interceptRegistrationId, $interceptRegistration, $preHookRetVal];
         }
 
         $loggerProxyTrace && $loggerProxyTrace->log(__LINE__, 'preHook completed successfully', ['shouldCallPostHook' => $shouldCallPostHook]);
@@ -143,26 +198,21 @@ final class InterceptionManager
         bool $hasExitedByException,
         $returnValueOrThrown
     ): void {
-        $localLogger = $this->logger->inherit()->addAllContext(
-            [
-                'interceptRegistrationId' => $this->interceptedCallInProgressRegistrationId,
-                'interceptRegistration'   => $this->interceptedCallInProgressRegistration,
-            ]
-        );
-        $loggerProxyTrace = $localLogger->ifTraceLevelEnabledNoLine(__FUNCTION__);
-        $loggerProxyTrace && $loggerProxyTrace->log(__LINE__, 'Entered');
-
-        if ($this->interceptedCallInProgressRegistrationId === null) {
+        $interceptedCallInProgress = array_pop(/* ref */ $this->interceptedCallsInProgress);
+        if ($interceptedCallInProgress === null) {
             ($loggerProxy = $this->logger->ifErrorLevelEnabled(__LINE__, __FUNCTION__))
             && $loggerProxy->log('There is no intercepted call in progress');
             return;
         }
-        assert($this->interceptedCallInProgressRegistration !== null);
-        assert($this->interceptedCallInProgressPreHookRetVal !== null);
+        [$interceptRegistrationId, $interceptRegistration, $postHook] = $interceptedCallInProgress;
+
+        $localLogger = $this->logger->inherit()->addAllContext(compact('interceptRegistrationId', 'interceptRegistration'));
+        $loggerProxyTrace = $localLogger->ifTraceLevelEnabledNoLine(__FUNCTION__);
+        $loggerProxyTrace && $loggerProxyTrace->log(__LINE__, 'Entered');
 
         $loggerProxyTrace && $loggerProxyTrace->log(__LINE__, 'Calling postHook...');
         try {
-            ($this->interceptedCallInProgressPreHookRetVal)(
+            $postHook(
                 $numberOfStackFramesToSkip + 1,
                 $hasExitedByException,
                 $returnValueOrThrown
@@ -172,9 +222,6 @@ final class InterceptionManager
             ($loggerProxy = $localLogger->ifErrorLevelEnabled(__LINE__, __FUNCTION__))
             && $loggerProxy->logThrowable($throwable, 'postHook has thrown');
         }
-
-        $this->interceptedCallInProgressRegistrationId = null;
-        $this->interceptedCallInProgressPreHookRetVal = null;
     }
 
     public function astInstrumentationDirectCall(string $method): void
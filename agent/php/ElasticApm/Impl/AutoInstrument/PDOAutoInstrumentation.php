@@ -33,6 +33,7 @@ use Elastic\Apm\Impl\Constants;
 use Elastic\Apm\Impl\Log\LogCategory;
 use Elastic\Apm\Impl\Log\Logger;
 use Elastic\Apm\Impl\Tracer;
+use Elastic\Apm\Impl\Transaction;
 use PDO;
 use PDOStatement;
 
@@ -60,6 +61,15 @@ final class PDOAutoInstrumentation extends AutoInstrumentationBase
     /** @var MapPerWeakObject */
     private $mapPerObject;
 
+    /**
+     * Records of deferred calls have only $this object's ID (see DeferredCallRecord::$thisObjId)
+     * so the values stored in $mapPerObject are also kept by object ID to process the records.
+     * When object ID is reused the values are overwritten when the new object is constructed/prepared.
+     *
+     * @var array<int, array<string, mixed>>
+     */
+    private $mapPerObjectIdForDeferredCallRecords = [];
+
     /** @var DbConnectionStringParser */
     private $dataSourceNameParser;
 
@@ -152,17 +162,63 @@ final class PDOAutoInstrumentation extends AutoInstrumentationBase
                 if ($dbName !== null) {
                     $mapToStoreForPdoObj[DbAutoInstrumentationUtil::PER_OBJECT_KEY_DB_NAME] = $dbName;
                 }
-                $this->mapPerObject->setMultiple($interceptedCallThis, $mapToStoreForPdoObj);
+                $this->setMultiplePerObject($interceptedCallThis, $mapToStoreForPdoObj);
                 return null; // no post-hook
             }
         );
     }
 
+    /**
+     * @param object               $obj
+     * @param array<string, mixed> $keyValueMap
+     */
+    private function setMultiplePerObject(object $obj, array $keyValueMap): void
+    {
+        $this->mapPerObject->setMultiple($obj, $keyValueMap);
+        $this->mapPerObjectIdForDeferredCallRecords[spl_object_id($obj)] = $keyValueMap;
+    }
+
+    private function createDbSpanForDeferredCallRecord(Transaction $transaction, DeferredCallRecord $record, string $className, string $methodName, ?string $statement): void
+    {
+        $keyValueMap = ($record->thisObjId === null) ? [] : ($this->mapPerObjectIdForDeferredCallRecords[$record->thisObjId] ?? []);
+        /** @var string $dbType */
+        $dbType = $keyValueMap[DbAutoInstrumentationUtil::PER_OBJECT_KEY_DB_TYPE] ?? Constants::SPAN_SUBTYPE_UNKNOWN;
+        /** @var ?string $dbName */
+        $dbName = $keyValueMap[DbAutoInstrumentationUtil::PER_OBJECT_KEY_DB_NAME] ?? null;
+        DbAutoInstrumentationUtil::createDbSpanForDeferredCallRecord($transaction, $record, $className, $methodName, $dbType, $dbName, $statement);
+    }
+
     private function interceptPDOMethodToSpan(RegistrationContextInterface $ctx, string $methodName, bool $isFirstArgStatement): void
     {
-        $ctx->interceptCallsToInternalMethod(
+        $ctx->interceptCallsToInternalMethod(self::PDO_CLASS_NAME, $methodName, $this->buildPDOMethodToSpanPreHook($methodName, $isFirstArgStatement));
+    }
+
+    /**
+     * Calls that have statement as the first argument are the most frequent ones
+     * so they are only recorded by the extension and spans are created from the records before the transaction ends
+     */
+    private function interceptPDOMethodWithStatementToSpanDeferred(RegistrationContextInterface $ctx, string $methodName): void
+    {
+        $ctx->interceptCallsToInternalMethodDeferred(
             self::PDO_CLASS_NAME,
             $methodName,
+            [0] /* <- argsToCapture: statement */,
+            false /* <- shouldCaptureReturnValue */,
+            [] /* <- thisPropsToCapture */,
+            function (Transaction $transaction, DeferredCallRecord $record) use ($methodName): void {
+                $statement = is_string($record->capturedArgs[0]) ? $record->capturedArgs[0] : null;
+                $this->createDbSpanForDeferredCallRecord($transaction, $record, self::PDO_CLASS_NAME, $methodName, $statement);
+            },
+            $this->buildPDOMethodToSpanPreHook($methodName, /* isFirstArgStatement */ true)
+        );
+    }
+
+    /**
+     * @return callable(?object, mixed[]): ?callable
+     */
+    private function buildPDOMethodToSpanPreHook(string $methodName, bool $isFirstArgStatement): callable
+    {
+        return
             /**
              * @param ?object $interceptedCallThis
              * @param mixed[] $interceptedCallArgs
@@ -188,18 +244,17 @@ final class PDOAutoInstrumentation extends AutoInstrumentationBase
                 /** @var ?string $dbName */
                 $dbName = $this->mapPerObject->getOr($interceptedCallThis, DbAutoInstrumentationUtil::PER_OBJECT_KEY_DB_NAME, /* defaultValue */ null);
                 return AutoInstrumentationUtil::createInternalFuncPostHookFromEndSpan(DbAutoInstrumentationUtil::beginDbSpan(self::PDO_CLASS_NAME, $methodName, $dbType, $dbName, $statement));
-            }
-        );
+            };
     }
 
     private function interceptPDOExec(RegistrationContextInterface $ctx): void
     {
-        $this->interceptPDOMethodToSpan($ctx, 'exec', /* isFirstArgStatement */ true);
+        $this->interceptPDOMethodWithStatementToSpanDeferred($ctx, 'exec');
     }
 
     private function interceptPDOQuery(RegistrationContextInterface $ctx): void
     {
-        $this->interceptPDOMethodToSpan($ctx, 'query', /* isFirstArgStatement */ true);
+        $this->interceptPDOMethodWithStatementToSpanDeferred($ctx, 'query');
     }
 
     private function interceptPDOMethodToSpanAsFuncCall(RegistrationContextInterface $ctx, string $methodName): void
@@ -261,7 +316,7 @@ final class PDOAutoInstrumentation extends AutoInstrumentationBase
                         return;
                     }
 
-                    $this->mapPerObject->setMultiple($returnValueOrThrown, $keyValueMapPerObjectToPropagate);
+                    $this->setMultiplePerObject($returnValueOrThrown, $keyValueMapPerObjectToPropagate);
                 };
             }
         );
@@ -271,9 +326,16 @@ final class PDOAutoInstrumentation extends AutoInstrumentationBase
     {
         $className = self::PDO_STATEMENT_CLASS_NAME;
         $methodName = 'execute';
-        $ctx->interceptCallsToInternalMethod(
+        $ctx->interceptCallsToInternalMethodDeferred(
             $className,
             $methodName,
+            [] /* <- argsToCapture */,
+            false /* <- shouldCaptureReturnValue */,
+            ['queryString'] /* <- thisPropsToCapture: statement */,
+            function (Transaction $transaction, DeferredCallRecord $record) use ($className, $methodName): void {
+                $statement = is_string($record->capturedThisProps[0]) ? $record->capturedThisProps[0] : null;
+                $this->createDbSpanForDeferredCallRecord($transaction, $record, $className, $methodName, $statement);
+            },
             /**
              * @param ?object $interceptedCallThis
              * @param mixed[]     $interceptedCallArgs
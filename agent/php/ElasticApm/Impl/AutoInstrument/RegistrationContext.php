@@ -33,6 +33,9 @@ final class RegistrationContext implements RegistrationContextInterface
     /** @var Registration[] */
     public $interceptedCallRegistrations;
 
+    /** @var DeferredCallRegistration[] */
+    public $deferredCallRegistrations = [];
+
     /** @var int */
     public $dbgCurrentPluginIndex;
 
@@ -42,7 +45,8 @@ final class RegistrationContext implements RegistrationContextInterface
     public function interceptCallsToInternalMethod(
         string $className,
         string $methodName,
-        callable $preHook
+        callable $preHook,
+        ?InterceptedCallArgFilter $argFilter = null
     ): void {
         /**
          * elastic_apm_* functions are provided by the elastic_apm extension
@@ -57,6 +61,7 @@ final class RegistrationContext implements RegistrationContextInterface
             strtolower($methodName)
         );
         if ($interceptRegistrationId >= 0) {
+            self::setArgFilter($interceptRegistrationId, $argFilter);
             $this->interceptedCallRegistrations[$interceptRegistrationId] = new Registration(
                 $this->dbgCurrentPluginIndex,
                 $this->dbgCurrentPluginDesc,
@@ -66,9 +71,54 @@ final class RegistrationContext implements RegistrationContextInterface
         }
     }
 
+    public function interceptCallsToInternalMethodDeferred(
+        string $className,
+        string $methodName,
+        array $argsToCapture,
+        bool $shouldCaptureReturnValue,
+        array $thisPropsToCapture,
+        callable $processRecord,
+        callable $preHook
+    ): void {
+        /**
+         * elastic_apm_* functions are provided by the elastic_apm extension
+         *
+         * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
+         * @phpstan-ignore-next-line
+         */
+        $interceptRegistrationId = \elastic_apm_intercept_calls_to_internal_method(strtolower($className), strtolower($methodName));
+        if ($interceptRegistrationId < 0) {
+            return;
+        }
+
+        /**
+         * elastic_apm_* functions are provided by the elastic_apm extension
+         *
+         * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
+         * @phpstan-ignore-next-line
+         */
+        if (\elastic_apm_record_intercepted_calls_deferred($interceptRegistrationId, $argsToCapture, $shouldCaptureReturnValue, $thisPropsToCapture)) {
+            $this->deferredCallRegistrations[$interceptRegistrationId] = new DeferredCallRegistration(
+                $this->dbgCurrentPluginIndex,
+                $this->dbgCurrentPluginDesc,
+                $className . '::' . $methodName /* <- dbgInterceptedCallDesc */,
+                $processRecord
+            );
+            return;
+        }
+
+        $this->interceptedCallRegistrations[$interceptRegistrationId] = new Registration(
+            $this->dbgCurrentPluginIndex,
+            $this->dbgCurrentPluginDesc,
+            $className . '::' . $methodName /* <- dbgInterceptedCallDesc */,
+            $preHook
+        );
+    }
+
     public function interceptCallsToInternalFunction(
         string $functionName,
-        callable $preHook
+        callable $preHook,
+        ?InterceptedCallArgFilter $argFilter = null
     ): void {
         /**
          * elastic_apm_* functions are provided by the elastic_apm extension
@@ -80,6 +130,7 @@ final class RegistrationContext implements RegistrationContextInterface
         // where key is a name converted to lower case
         $interceptRegistrationId = \elastic_apm_intercept_calls_to_internal_function(strtolower($functionName));
         if ($interceptRegistrationId >= 0) {
+            self::setArgFilter($interceptRegistrationId, $argFilter);
             $this->interceptedCallRegistrations[$interceptRegistrationId] = new Registration(
                 $this->dbgCurrentPluginIndex,
                 $this->dbgCurrentPluginDesc,
@@ -93,4 +144,20 @@ final class RegistrationContext implements RegistrationContextInterface
             );
         }
     }
+
+    private static function setArgFilter(int $interceptRegistrationId, ?InterceptedCallArgFilter $argFilter): void
+    {
+        if ($argFilter === null) {
+            return;
+        }
+
+        // If the extension cannot apply the filter pre-hook is called for all the calls
+        /**
+         * elastic_apm_* functions are provided by the elastic_apm extension
+         *
+         * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
+         * @phpstan-ignore-next-line
+         */
+        \elastic_apm_set_intercepted_call_arg_filter($interceptRegistrationId, $argFilter->argIndex, $argFilter->kind, $argFilter->values);
+    }
 }
@@ -23,25 +23,54 @@ declare(strict_types=1);
 
 namespace Elastic\Apm\Impl\AutoInstrument;
 
+use Elastic\Apm\Impl\Transaction;
+
 interface RegistrationContextInterface
 {
     /**
      * @param string                                $className
      * @param string                                $methodName
      * @param callable(?object, mixed[]): ?callable $preHook
+     * @param ?InterceptedCallArgFilter             $argFilter If set pre-hook is called only for the calls matching the filter
      */
     public function interceptCallsToInternalMethod(
         string $className,
         string $methodName,
+        callable $preHook,
+        ?InterceptedCallArgFilter $argFilter = null
+    ): void;
+
+    /**
+     * Calls are only recorded by the extension and the records are processed in bulk before the transaction ends.
+     * If the extension cannot record calls to the method (for example because it is disabled by configuration)
+     * the calls are intercepted with $preHook the same way as by interceptCallsToInternalMethod.
+     *
+     * @param string                                            $className
+     * @param string                                            $methodName
+     * @param int[]                                             $argsToCapture Indexes of the arguments to capture
+     * @param bool                                              $shouldCaptureReturnValue
+     * @param string[]                                          $thisPropsToCapture Names of $this properties to capture when the call is recorded
+     * @param callable(Transaction, DeferredCallRecord): void   $processRecord
+     * @param callable(?object, mixed[]): ?callable             $preHook
+     */
+    public function interceptCallsToInternalMethodDeferred(
+        string $className,
+        string $methodName,
+        array $argsToCapture,
+        bool $shouldCaptureReturnValue,
+        array $thisPropsToCapture,
+        callable $processRecord,
         callable $preHook
     ): void;
 
     /**
      * @param string                       $functionName
      * @param callable(mixed[]): ?callable $preHook
+     * @param ?InterceptedCallArgFilter    $argFilter If set pre-hook is called only for the calls matching the filter
      */
     public function interceptCallsToInternalFunction(
         string $functionName,
-        callable $preHook
+        callable $preHook,
+        ?InterceptedCallArgFilter $argFilter = null
     ): void;
 }
@@ -25,10 +25,12 @@ namespace Elastic\Apm\Impl\AutoInstrument\Util;
 
 use Closure;
 use Elastic\Apm\ElasticApm;
+use Elastic\Apm\Impl\AutoInstrument\DeferredCallRecord;
 use Elastic\Apm\Impl\Log\LogCategory;
 use Elastic\Apm\Impl\Log\Logger;
 use Elastic\Apm\Impl\Log\LoggerFactory;
 use Elastic\Apm\Impl\Span;
+use Elastic\Apm\Impl\Transaction;
 use Elastic\Apm\Impl\Util\Assert;
 use Elastic\Apm\Impl\Util\DbgUtil;
 use Elastic\Apm\Impl\Util\StackTraceUtil;
@@ -77,6 +79,31 @@ final class AutoInstrumentationUtil
         return $span;
     }
 
+    /**
+     * Span for a call recorded by the extension is created after the call has ended
+     * so it is a child of the transaction (and not of the span that was current during the call)
+     */
+    public static function beginSpanForDeferredCallRecord(Transaction $transaction, DeferredCallRecord $record, string $name, string $type, ?string $subtype = null, ?string $action = null): ?Span
+    {
+        $span = $transaction->beginSpan($transaction /* <- parentExecutionSegment */, $name, $type, $subtype, $action, $record->timestamp);
+        if ($span === null) {
+            return null;
+        }
+
+        self::processNewSpan($span);
+        $span->setShouldCaptureStackTrace(false);
+
+        return $span;
+    }
+
+    public static function endSpanForDeferredCallRecord(Span $span, DeferredCallRecord $record): void
+    {
+        if ($record->hasExitedByException && ($record->returnValueOrThrown instanceof Throwable)) {
+            $span->createErrorFromThrowable($record->returnValueOrThrown);
+        }
+        $span->end($record->duration);
+    }
+
     /**
      * @param string   $name
      * @param string   $type
@@ -23,8 +23,10 @@ declare(strict_types=1);
 
 namespace Elastic\Apm\Impl\AutoInstrument\Util;
 
+use Elastic\Apm\Impl\AutoInstrument\DeferredCallRecord;
 use Elastic\Apm\Impl\Constants;
 use Elastic\Apm\Impl\Span;
+use Elastic\Apm\Impl\Transaction;
 use Elastic\Apm\Impl\Util\StaticClassTrait;
 use Elastic\Apm\Impl\Util\TextUtil;
 use Elastic\Apm\SpanInterface;
@@ -58,6 +60,34 @@ final class DbAutoInstrumentationUtil
         return $span;
     }
 
+    public static function createDbSpanForDeferredCallRecord(
+        Transaction $transaction,
+        DeferredCallRecord $record,
+        ?string $className,
+        string $funcName,
+        string $dbType,
+        ?string $dbName,
+        ?string $statement
+    ): void {
+        $span = AutoInstrumentationUtil::beginSpanForDeferredCallRecord(
+            $transaction,
+            $record,
+            $statement ?? AutoInstrumentationUtil::buildSpanNameFromCall($className, $funcName),
+            Constants::SPAN_TYPE_DB,
+            $dbType /* <- subtype */,
+            Constants::SPAN_ACTION_QUERY
+        );
+        if ($span === null) {
+            return;
+        }
+
+        $span->context()->db()->setStatement($statement);
+
+        self::setServiceForDbSpan($span, $dbType, $dbName);
+
+        AutoInstrumentationUtil::endSpanForDeferredCallRecord($span, $record);
+    }
+
     public static function setServiceForDbSpan(SpanInterface $span, string $dbType, ?string $dbName): void
     {
         $destinationServiceResource = $dbType;
@@ -28,13 +28,16 @@ use Elastic\Apm\Impl\BreakdownMetrics\PerTransaction as BreakdownMetricsPerTrans
 use Elastic\Apm\Impl\Config\DevInternalSubOptionNames;
 use Elastic\Apm\Impl\Config\OptionNames;
 use Elastic\Apm\Impl\Config\Snapshot as ConfigSnapshot;
+use Elastic\Apm\Impl\Error;
 use Elastic\Apm\Impl\EventSinkInterface;
 use Elastic\Apm\Impl\Log\LogCategory;
 use Elastic\Apm\Impl\Log\Logger;
 use Elastic\Apm\Impl\Log\LoggerFactory;
-use Elastic\Apm\Impl\Metadata;
+use Elastic\Apm\Impl\MetadataDiscoverer;
 use Elastic\Apm\Impl\MetricSet;
+use Elastic\Apm\Impl\SpanToSendInterface;
 use Elastic\Apm\Impl\Transaction;
+use Elastic\Apm\Impl\Util\ArrayUtil;
 
 /**
  * Code in this file is part of implementation internals and thus it is not covered by the backward compatibility.
@@ -51,9 +54,6 @@ final class EventSender implements EventSinkInterface
     /** @var ConfigSnapshot */
     private $config;
 
-    /** @var ?string */
-    private $userAgentHttpHeader = null;
-
     public function __construct(ConfigSnapshot $config, LoggerFactory $loggerFactory)
     {
         $this->config = $config;
@@ -89,24 +89,175 @@ final class EventSender implements EventSinkInterface
 
     /** @inheritDoc */
     public function consume(
-        Metadata $metadata,
+        MetadataDiscoverer $metadataDiscoverer,
         array $spans,
         array $errors,
         ?BreakdownMetricsPerTransaction $breakdownMetricsPerTransaction,
         ?Transaction $transaction
     ): void {
-        if ($this->userAgentHttpHeader === null) {
-            $this->userAgentHttpHeader = self::buildUserAgentHttpHeader(
-                $metadata->service->name,
-                $metadata->service->version
+        if ($this->config->devInternal()->dropEventsBeforeSendCCode()) {
+            ($loggerProxy = $this->logger->ifDebugLevelEnabled(__LINE__, __FUNCTION__))
+            && $loggerProxy->log(
+                'Dropping events because '
+                . OptionNames::DEV_INTERNAL . ' sub-option ' . DevInternalSubOptionNames::DROP_EVENTS_BEFORE_SEND_C_CODE
+                . ' is set'
             );
+            return;
         }
 
-        $serializedMetadata = '{"metadata":';
-        $serializedMetadata .= SerializationUtil::serializeAsJson($metadata);
-        $serializedMetadata .= "}";
+        [$serializedMetadata, $userAgentHttpHeader] = $this->getSerializedMetadataAndUserAgentHttpHeader($metadataDiscoverer);
+
+        /** @var MetricSet[] $metricSets */
+        $metricSets = [];
+        if ($breakdownMetricsPerTransaction !== null) {
+            $breakdownMetricsPerTransaction->forEachMetricSet(
+                function (MetricSet $metricSet) use (&$metricSets) {
+                    $metricSets[] = $metricSet;
+                }
+            );
+        }
 
-        $serializedEvents = $serializedMetadata;
+        // Events are appended to the extension's per-request buffer as soon as they are finished
+        // and the buffer is sent to APM Server as one batch when the transaction ends.
+        // Only the events that could not be appended are serialized here and sent as a separate batch.
+        $spans = $this->appendToEventBuffer('span', $spans, $serializedMetadata, $userAgentHttpHeader);
+        $errors = $this->appendToEventBuffer('error', $errors, $serializedMetadata, $userAgentHttpHeader);
+        $metricSets = $this->appendToEventBuffer('metricset', $metricSets, $serializedMetadata, $userAgentHttpHeader);
+        if ($transaction !== null) {
+            $notAppendedTransactions = $this->appendToEventBuffer('transaction', [$transaction], $serializedMetadata, $userAgentHttpHeader);
+            $transaction = ArrayUtil::isEmpty($notAppendedTransactions) ? null : $notAppendedTransactions[0];
+            /**
+             * elastic_apm_* functions are provided by the elastic_apm extension
+             *
+             * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
+             * @phpstan-ignore-next-line
+             */
+            \elastic_apm_event_buffer_flush();
+        }
+
+        if (ArrayUtil::isEmpty($spans) && ArrayUtil::isEmpty($errors) && ArrayUtil::isEmpty($metricSets) && $transaction === null) {
+            return;
+        }
+
+        /**
+         * elastic_apm_* functions are provided by the elastic_apm extension
+         *
+         * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
+         * @phpstan-ignore-next-line
+         */
+        $serializedEvents = \elastic_apm_serialize_events($serializedMetadata, $spans, $errors, $metricSets, $transaction);
+        if (!is_string($serializedEvents)) {
+            ($loggerProxy = $this->logger->ifDebugLevelEnabled(__LINE__, __FUNCTION__))
+            && $loggerProxy->log('elastic_apm_serialize_events failed - falling back on serializing events in PHP');
+            $serializedEvents = self::serializeEvents($serializedMetadata, $spans, $errors, $metricSets, $transaction);
+        }
+
+        ($loggerProxy = $this->logger->ifDebugLevelEnabled(__LINE__, __FUNCTION__))
+        && $loggerProxy->log(
+            'Calling elastic_apm_send_to_server...',
+            [
+                'userAgentHttpHeader'      => $userAgentHttpHeader,
+                'strlen(serializedEvents)' => strlen($serializedEvents),
+            ]
+        );
+
+        /**
+         * elastic_apm_* functions are provided by the elastic_apm extension
+         *
+         * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
+         * @phpstan-ignore-next-line
+         */
+        \elastic_apm_send_to_server($userAgentHttpHeader, $serializedEvents);
+    }
+
+    /**
+     * @template TEvent of object
+     *
+     * @param string   $type
+     * @param TEvent[] $events
+     * @param string   $serializedMetadata
+     * @param string   $userAgentHttpHeader
+     *
+     * @return TEvent[] Events that could not be appended (for example because they could not be serialized natively)
+     */
+    private function appendToEventBuffer(string $type, array $events, string $serializedMetadata, string $userAgentHttpHeader): array
+    {
+        $notAppendedEvents = [];
+        foreach ($events as $event) {
+            /**
+             * elastic_apm_* functions are provided by the elastic_apm extension
+             *
+             * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
+             * @phpstan-ignore-next-line
+             */
+            if (!\elastic_apm_event_buffer_append($type, $event, $serializedMetadata, $userAgentHttpHeader)) {
+                ($loggerProxy = $this->logger->ifDebugLevelEnabled(__LINE__, __FUNCTION__))
+                && $loggerProxy->log('elastic_apm_event_buffer_append failed - event will be sent in a separate batch', ['type' => $type]);
+                $notAppendedEvents[] = $event;
+            }
+        }
+        return $notAppendedEvents;
+    }
+
+    /**
+     * Serialized metadata and User-Agent HTTP header are cached by the extension for the process lifetime
+     * so metadata is discovered only when the cache is empty or the key it was cached with changes.
+     *
+     * @return array{string, string}
+     */
+    private function getSerializedMetadataAndUserAgentHttpHeader(MetadataDiscoverer $metadataDiscoverer): array
+    {
+        $cacheKey = $metadataDiscoverer->buildCacheKey();
+
+        /**
+         * elastic_apm_* functions are provided by the elastic_apm extension
+         *
+         * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
+         * @phpstan-ignore-next-line
+         */
+        $cached = \elastic_apm_get_cached_metadata($cacheKey);
+        if (is_array($cached)) {
+            /** @var array{string, string} $cached */
+            return $cached;
+        }
+
+        $metadata = $metadataDiscoverer->discover();
+        $serializedMetadata = SerializationUtil::serializeAsJson($metadata);
+        $userAgentHttpHeader = self::buildUserAgentHttpHeader($metadata->service->name, $metadata->service->version);
+
+        /**
+         * elastic_apm_* functions are provided by the elastic_apm extension
+         *
+         * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
+         * @phpstan-ignore-next-line
+         */
+        if (!\elastic_apm_cache_metadata($cacheKey, $serializedMetadata, $userAgentHttpHeader)) {
+            ($loggerProxy = $this->logger->ifDebugLevelEnabled(__LINE__, __FUNCTION__))
+            && $loggerProxy->log('elastic_apm_cache_metadata failed', ['cacheKey' => $cacheKey]);
+        }
+
+        return [$serializedMetadata, $userAgentHttpHeader];
+    }
+
+    /**
+     * @param string                $serializedMetadata
+     * @param SpanToSendInterface[] $spans
+     * @param Error[]               $errors
+     * @param MetricSet[]           $metricSets
+     * @param ?Transaction          $transaction
+     *
+     * @return string
+     */
+    private static function serializeEvents(
+        string $serializedMetadata,
+        array $spans,
+        array $errors,
+        array $metricSets,
+        ?Transaction $transaction
+    ): string {
+        $serializedEvents = '{"metadata":';
+        $serializedEvents .= $serializedMetadata;
+        $serializedEvents .= "}";
 
         foreach ($spans as $span) {
             $serializedEvents .= "\n";
@@ -122,15 +273,11 @@ final class EventSender implements EventSinkInterface
             $serializedEvents .= '}';
         }
 
-        if ($breakdownMetricsPerTransaction !== null) {
-            $breakdownMetricsPerTransaction->forEachMetricSet(
-                function (MetricSet $metricSet) use (&$serializedEvents) {
-                    $serializedEvents .= "\n";
-                    $serializedEvents .= '{"metricset":';
-                    $serializedEvents .= SerializationUtil::serializeAsJson($metricSet);
-                    $serializedEvents .= '}';
-                }
-            );
+        foreach ($metricSets as $metricSet) {
+            $serializedEvents .= "\n";
+            $serializedEvents .= '{"metricset":';
+            $serializedEvents .= SerializationUtil::serializeAsJson($metricSet);
+            $serializedEvents .= '}';
         }
 
         if ($transaction !== null) {
@@ -140,30 +287,6 @@ final class EventSender implements EventSinkInterface
             $serializedEvents .= "}";
         }
 
-        if ($this->config->devInternal()->dropEventsBeforeSendCCode()) {
-            ($loggerProxy = $this->logger->ifDebugLevelEnabled(__LINE__, __FUNCTION__))
-            && $loggerProxy->log(
-                'Dropping events because '
-                . OptionNames::DEV_INTERNAL . ' sub-option ' . DevInternalSubOptionNames::DROP_EVENTS_BEFORE_SEND_C_CODE
-                . ' is set'
-            );
-        } else {
-            ($loggerProxy = $this->logger->ifDebugLevelEnabled(__LINE__, __FUNCTION__))
-            && $loggerProxy->log(
-                'Calling elastic_apm_send_to_server...',
-                [
-                    'userAgentHttpHeader'      => $this->userAgentHttpHeader,
-                    'strlen(serializedEvents)' => strlen($serializedEvents),
-                ]
-            );
-
-            /**
-             * elastic_apm_* functions are provided by the elastic_apm extension
-             *
-             * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
-             * @phpstan-ignore-next-line
-             */
-            \elastic_apm_send_to_server($this->userAgentHttpHeader, $serializedEvents);
-        }
+        return $serializedEvents;
     }
 }
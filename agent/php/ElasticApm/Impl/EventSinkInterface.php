@@ -33,14 +33,14 @@ use Elastic\Apm\Impl\BreakdownMetrics\PerTransaction as BreakdownMetricsPerTrans
 interface EventSinkInterface
 {
     /**
-     * @param Metadata                        $metadata
+     * @param MetadataDiscoverer              $metadataDiscoverer
      * @param SpanToSendInterface[]           $spans
      * @param Error[]                         $errors
      * @param ?BreakdownMetricsPerTransaction $breakdownMetricsPerTransaction
      * @param ?Transaction                    $transaction
      */
     public function consume(
-        Metadata $metadata,
+        MetadataDiscoverer $metadataDiscoverer,
         array $spans,
         array $errors,
         ?BreakdownMetricsPerTransaction $breakdownMetricsPerTransaction,
@@ -30,6 +30,7 @@ use Elastic\Apm\Impl\Log\LogCategory;
 use Elastic\Apm\Impl\Log\Logger;
 use Elastic\Apm\Impl\Log\LoggerFactory;
 use Elastic\Apm\Impl\Util\ArrayUtil;
+use Elastic\Apm\Impl\Util\ElasticApmExtensionUtil;
 use Elastic\Apm\Impl\Util\IdValidationUtil;
 use Elastic\Apm\Impl\Util\StaticClassTrait;
 use Elastic\Apm\Impl\Util\TextUtil;
@@ -182,6 +183,10 @@ final class HttpDistributedTracing
         // || -------------------------------- - trace-id
         // -- - version
 
+        if (ElasticApmExtensionUtil::isLoaded()) {
+            return self::parseTraceParentHeaderNatively($headerRawValue);
+        }
+
         $headerValue = trim($headerRawValue);
 
         $parentFunc = __FUNCTION__;
@@ -294,6 +299,25 @@ final class HttpDistributedTracing
         return $result;
     }
 
+    private static function parseTraceParentHeaderNatively(string $headerRawValue): ?DistributedTracingDataInternal
+    {
+        /**
+         * elastic_apm_* functions are provided by the elastic_apm extension
+         *
+         * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
+         * @phpstan-ignore-next-line
+         */
+        $parsed = \elastic_apm_parse_traceparent_header($headerRawValue);
+        if (!is_array($parsed)) {
+            return null;
+        }
+
+        $result = new DistributedTracingDataInternal();
+        /** @var array{string, string, bool} $parsed */
+        [$result->traceId, $result->parentId, $result->isSampled] = $parsed;
+        return $result;
+    }
+
     /**
      * @param string[]               $headerRawValues
      * @param DistributedTracingDataInternal $result
@@ -302,6 +326,10 @@ final class HttpDistributedTracing
      */
     private function parseTraceStateHeaders(array $headerRawValues, DistributedTracingDataInternal $result): bool
     {
+        if (ElasticApmExtensionUtil::isLoaded()) {
+            return self::parseTraceStateHeadersNatively($headerRawValues, $result);
+        }
+
         /** @var ?string */
         $elasticVendorValue = null;
         /** @var ?string */
@@ -323,6 +351,35 @@ final class HttpDistributedTracing
         return true;
     }
 
+    /**
+     * @param string[]                       $headerRawValues
+     * @param DistributedTracingDataInternal $result
+     *
+     * @return bool
+     */
+    private static function parseTraceStateHeadersNatively(
+        array $headerRawValues,
+        DistributedTracingDataInternal $result
+    ): bool {
+        /**
+         * elastic_apm_* functions are provided by the elastic_apm extension
+         *
+         * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
+         * @phpstan-ignore-next-line
+         */
+        $parsed = \elastic_apm_parse_tracestate_headers($headerRawValues);
+        if (!is_array($parsed)) {
+            return false;
+        }
+
+        /** @var array{?float, ?string} $parsed */
+        [$sampleRate, $result->outgoingTraceState] = $parsed;
+        if ($sampleRate !== null) {
+            $result->sampleRate = $sampleRate;
+        }
+        return true;
+    }
+
     /**
      * @param string[] $headerRawValues
      * @param ?string $elasticVendorValue
@@ -562,6 +619,19 @@ final class HttpDistributedTracing
 
     public static function convertSampleRateToString(float $sampleRate): string
     {
+        if (ElasticApmExtensionUtil::isLoaded()) {
+            /**
+             * elastic_apm_* functions are provided by the elastic_apm extension
+             *
+             * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
+             * @phpstan-ignore-next-line
+             */
+            $result = \elastic_apm_format_sample_rate($sampleRate);
+            if (is_string($result)) {
+                return $result;
+            }
+        }
+
         $result = number_format(
             $sampleRate,
             4 /* <- number of decimal digits */,
@@ -609,6 +679,19 @@ final class HttpDistributedTracing
 
     public static function buildTraceParentHeader(DistributedTracingData $data): string
     {
+        if (ElasticApmExtensionUtil::isLoaded()) {
+            /**
+             * elastic_apm_* functions are provided by the elastic_apm extension
+             *
+             * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
+             * @phpstan-ignore-next-line
+             */
+            $result = \elastic_apm_build_traceparent_header($data->traceId, $data->parentId, $data->isSampled);
+            if (is_string($result)) {
+                return $result;
+            }
+        }
+
         return self::TRACE_PARENT_SUPPORTED_FORMAT_VERSION
                . '-' . $data->traceId
                . '-' . $data->parentId
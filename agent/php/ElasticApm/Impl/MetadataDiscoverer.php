@@ -28,6 +28,7 @@ use Elastic\Apm\Impl\Config\Snapshot as ConfigSnapshot;
 use Elastic\Apm\Impl\Log\LogCategory;
 use Elastic\Apm\Impl\Log\Logger;
 use Elastic\Apm\Impl\Log\LoggerFactory;
+use Elastic\Apm\Impl\Util\JsonUtil;
 use Elastic\Apm\Impl\Util\TextUtil;
 
 /**
@@ -91,6 +92,27 @@ final class MetadataDiscoverer
         return $result;
     }
 
+    /**
+     * Serialized metadata is cached by the extension for the process lifetime (see EventSender)
+     * so the key includes everything metadata is built from except the values that are the same for the whole process
+     * (process ID, detected hostname, container ID, etc.)
+     */
+    public function buildCacheKey(): string
+    {
+        return JsonUtil::encode(
+            [
+                $this->config->globalLabels(),
+                $this->config->environment(),
+                $this->config->serviceName(),
+                $this->config->serviceNodeName(),
+                $this->config->serviceVersion(),
+                $this->config->hostname(),
+                $this->agentEphemeralId,
+                $this->discoverServiceFramework(),
+            ]
+        );
+    }
+
     public static function adaptServiceName(string $configuredName): string
     {
         if (TextUtil::isEmptyString($configuredName)) {
@@ -37,7 +37,7 @@ final class NoopEventSink implements EventSinkInterface
 
     /** @inheritDoc */
     public function consume(
-        Metadata $metadata,
+        MetadataDiscoverer $metadataDiscoverer,
         array $spans,
         array $errors,
         ?BreakdownMetricsPerTransaction $breakdownMetricsPerTransaction,
@@ -79,6 +79,9 @@ final class Span extends ExecutionSegment implements SpanInterface, SpanToSendIn
     /** @var bool */
     private $isCompressible = false;
 
+    /** @var bool */
+    private $shouldCaptureStackTrace = true;
+
     /** @var ?SpanComposite */
     public $composite = null;
 
@@ -205,6 +208,15 @@ final class Span extends ExecutionSegment implements SpanInterface, SpanToSendIn
         $this->isCompressible = $isCompressible;
     }
 
+    /**
+     * Stack trace captured when the span ends is useless for spans created after the fact
+     * (for example from calls recorded by the extension) because it points to agent's code
+     */
+    public function setShouldCaptureStackTrace(bool $shouldCaptureStackTrace): void
+    {
+        $this->shouldCaptureStackTrace = $shouldCaptureStackTrace;
+    }
+
     /** @inheritDoc */
     public function getDistributedTracingDataInternal(): ?DistributedTracingDataInternal
     {
@@ -481,7 +493,7 @@ final class Span extends ExecutionSegment implements SpanInterface, SpanToSendIn
         $this->onAboutToEnd->callCallbacks($this);
 
         if ($this->shouldBeSentToApmServer()) {
-            if ($this->containingTransaction->shouldCollectStackTraceForSpanDuration($this->duration)) {
+            if ($this->shouldCaptureStackTrace && $this->containingTransaction->shouldCollectStackTraceForSpanDuration($this->duration)) {
                 $this->stackTrace = $this->containingTransaction->captureApmFormatStackTrace($numberOfStackFramesToSkip + 1);
             }
             $this->prepareForSerialization();
@@ -86,9 +86,6 @@ final class Tracer implements TracerInterface, LoggableInterface
     /** @var MetadataDiscoverer */
     private $metadataDiscoverer;
 
-    /** @var ?Metadata */
-    private $cachedMetadata = null;
-
     /** @var HttpDistributedTracing */
     private $httpDistributedTracing;
 
@@ -485,12 +482,8 @@ final class Tracer implements TracerInterface, LoggableInterface
             return;
         }
 
-        if ($this->cachedMetadata === null) {
-            $this->cachedMetadata = $this->metadataDiscoverer->discover();
-        }
-
         $this->eventSink->consume(
-            $this->cachedMetadata,
+            $this->metadataDiscoverer,
             $spans,
             $errors,
             $breakdownMetricsPerTransaction,
@@ -87,6 +87,13 @@ final class Transaction extends ExecutionSegment implements TransactionInterface
     /** @var ?string */
     private $outgoingTraceState;
 
+    /**
+     * Called while the transaction can still be mutated (for example child spans can still be added)
+     *
+     * @var ObserverSet<Transaction>
+     */
+    public $onBeforeEnd;
+
     /** @var ObserverSet<Transaction> */
     public $onAboutToEnd;
 
@@ -147,6 +154,7 @@ final class Transaction extends ExecutionSegment implements TransactionInterface
         $this->isSampled = $isSampled;
 
         $this->onCurrentSpanChanged = new ObserverSet();
+        $this->onBeforeEnd = new ObserverSet();
         $this->onAboutToEnd = new ObserverSet();
 
         ($loggerProxy = $this->logger->ifDebugLevelEnabled(__LINE__, __FUNCTION__))
@@ -515,6 +523,10 @@ final class Transaction extends ExecutionSegment implements TransactionInterface
     /** @inheritDoc */
     public function end(?float $duration = null): void
     {
+        if (!$this->hasEnded()) {
+            $this->onBeforeEnd->callCallbacks($this);
+        }
+
         if (!$this->endExecutionSegment($duration)) {
             return;
         }
@@ -37,6 +37,19 @@ final class IdGenerator
 
     public static function generateId(int $idLengthInBytes): string
     {
+        if (ElasticApmExtensionUtil::isLoaded()) {
+            /**
+             * elastic_apm_* functions are provided by the elastic_apm extension
+             *
+             * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
+             * @phpstan-ignore-next-line
+             */
+            $id = \elastic_apm_generate_id($idLengthInBytes);
+            if (is_string($id)) {
+                return $id;
+            }
+        }
+
         return self::convertBinaryIdToString(self::generateBinaryId($idLengthInBytes));
     }
 
@@ -26,6 +26,7 @@ namespace ElasticApmTests\ComponentTests;
 use Elastic\Apm\ElasticApm;
 use Elastic\Apm\Impl\Log\Logger;
 use Elastic\Apm\Impl\Util\RangeUtil;
+use ElasticApmTests\ComponentTests\Util\AppCodeHostParams;
 use ElasticApmTests\ComponentTests\Util\AppCodeRequestParams;
 use ElasticApmTests\ComponentTests\Util\AppCodeTarget;
 use ElasticApmTests\ComponentTests\Util\ComponentTestCaseBase;
@@ -277,4 +278,148 @@ final class BackendCommTest extends ComponentTestCaseBase
         }
         $dbgCtx->popSubScope();
     }
+
+    private const SERVER_REQUEST_COMPRESSION_OPTION_NAME = 'server_request_compression';
+    private const SERVER_REQUEST_COMPRESSION_LEVEL_OPTION_NAME = 'server_request_compression_level';
+
+    private const COMPRESSION_KEY = 'compression';
+    private const COMPRESSION_LEVEL_KEY = 'compression_level';
+    private const SPANS_COUNT_KEY = 'spans_count';
+
+    /**
+     * @return iterable<string, array{MixedMap}>
+     */
+    public function dataProviderForTestRequestCompression(): iterable
+    {
+        $result = (new DataProviderForTestBuilder())
+            ->addKeyedDimensionAllValuesCombinable(self::COMPRESSION_KEY, [null, 'off', 'gzip', 'deflate'])
+            ->addKeyedDimensionOnlyFirstValueCombinable(self::COMPRESSION_LEVEL_KEY, [null, 1, 9])
+            ->build();
+
+        return DataProviderForTestBuilder::convertEachDataSetToMixedMap(self::adaptKeyValueToSmoke($result));
+    }
+
+    public static function appCodeForTestRequestCompression(MixedMap $appCodeArgs): void
+    {
+        $spansCount = $appCodeArgs->getInt(self::SPANS_COUNT_KEY);
+        foreach (RangeUtil::generateUpTo($spansCount) as $spanIndex) {
+            ElasticApm::getCurrentTransaction()->captureChildSpan(
+                'test_span_' . $spanIndex,
+                'test_span_type',
+                function (): void {
+                }
+            );
+        }
+    }
+
+    /**
+     * @dataProvider dataProviderForTestRequestCompression
+     */
+    public function testRequestCompression(MixedMap $testArgs): void
+    {
+        AssertMessageStack::newScope(/* out */ $dbgCtx, AssertMessageStack::funcArgs());
+
+        $compression = $testArgs->getNullableString(self::COMPRESSION_KEY);
+        $compressionLevel = $testArgs->getNullableInt(self::COMPRESSION_LEVEL_KEY);
+        $spansCount = 100;
+
+        $testCaseHandle = $this->getTestCaseHandle();
+        $appCodeHost = $testCaseHandle->ensureMainAppCodeHost(
+            function (AppCodeHostParams $appCodeParams) use ($compression, $compressionLevel): void {
+                if ($compression !== null) {
+                    $appCodeParams->setAgentOption(self::SERVER_REQUEST_COMPRESSION_OPTION_NAME, $compression);
+                }
+                if ($compressionLevel !== null) {
+                    $appCodeParams->setAgentOption(self::SERVER_REQUEST_COMPRESSION_LEVEL_OPTION_NAME, $compressionLevel);
+                }
+            }
+        );
+        $appCodeHost->sendRequest(
+            AppCodeTarget::asRouted([__CLASS__, 'appCodeForTestRequestCompression']),
+            function (AppCodeRequestParams $appCodeRequestParams) use ($spansCount): void {
+                $appCodeRequestParams->setAppCodeArgs([self::SPANS_COUNT_KEY => $spansCount]);
+            }
+        );
+
+        // Events are deserialized from the body after it was decoded by the mock APM Server
+        // so receiving all the expected events verifies that the body was compressed correctly
+        $dataFromAgent = $testCaseHandle->waitForDataFromAgent((new ExpectedEventCounts())->transactions(1)->spans($spansCount));
+        self::assertCount($spansCount, $dataFromAgent->idToSpan);
+
+        $expectedContentEncoding = ($compression === null || $compression === 'off') ? null : $compression;
+        $intakeApiRequests = $dataFromAgent->getRaw()->getAllIntakeApiRequests();
+        $dbgCtx->add(['intakeApiRequests' => $intakeApiRequests]);
+        self::assertNotEmpty($intakeApiRequests);
+        foreach ($intakeApiRequests as $intakeApiRequest) {
+            self::assertSame($expectedContentEncoding, $intakeApiRequest->contentEncoding);
+            $bodySize = strlen($intakeApiRequest->body);
+            if ($expectedContentEncoding === null) {
+                self::assertSame($bodySize, $intakeApiRequest->bodySizeAsReceived);
+            } else {
+                self::assertLessThan($bodySize, $intakeApiRequest->bodySizeAsReceived);
+            }
+        }
+    }
+
+    private const STREAMING_BACKEND_COMM_OPTION_NAME = 'streaming_backend_comm';
+    private const API_REQUEST_TIME_OPTION_NAME = 'api_request_time';
+
+    /**
+     * @return iterable<string, array{MixedMap}>
+     */
+    public function dataProviderForTestStreamingRequest(): iterable
+    {
+        $result = (new DataProviderForTestBuilder())
+            ->addKeyedDimensionAllValuesCombinable(self::COMPRESSION_KEY, [null, 'gzip'])
+            ->build();
+
+        return DataProviderForTestBuilder::convertEachDataSetToMixedMap(self::adaptKeyValueToSmoke($result));
+    }
+
+    /**
+     * @dataProvider dataProviderForTestStreamingRequest
+     */
+    public function testStreamingRequest(MixedMap $testArgs): void
+    {
+        AssertMessageStack::newScope(/* out */ $dbgCtx, AssertMessageStack::funcArgs());
+
+        $compression = $testArgs->getNullableString(self::COMPRESSION_KEY);
+        $spansCount = 10;
+        $appCodeRequestsCount = 3;
+
+        $testCaseHandle = $this->getTestCaseHandle();
+        $appCodeHost = $testCaseHandle->ensureMainAppCodeHost(
+            function (AppCodeHostParams $appCodeParams) use ($compression): void {
+                $appCodeParams->setAgentOption(self::STREAMING_BACKEND_COMM_OPTION_NAME, true);
+                // Close streaming request soon after the last event is sent so the test does not have to wait long
+                $appCodeParams->setAgentOption(self::API_REQUEST_TIME_OPTION_NAME, '1s');
+                if ($compression !== null) {
+                    $appCodeParams->setAgentOption(self::SERVER_REQUEST_COMPRESSION_OPTION_NAME, $compression);
+                }
+            }
+        );
+        foreach (RangeUtil::generateUpTo($appCodeRequestsCount) as $ignored) {
+            $appCodeHost->sendRequest(
+                AppCodeTarget::asRouted([__CLASS__, 'appCodeForTestRequestCompression']),
+                function (AppCodeRequestParams $appCodeRequestParams) use ($spansCount): void {
+                    $appCodeRequestParams->setAppCodeArgs([self::SPANS_COUNT_KEY => $spansCount]);
+                }
+            );
+        }
+
+        $expectedEventCounts = (new ExpectedEventCounts())
+            ->transactions($appCodeRequestsCount)
+            ->spans($appCodeRequestsCount * $spansCount);
+        $dataFromAgent = $testCaseHandle->waitForDataFromAgent($expectedEventCounts);
+        self::assertCount($appCodeRequestsCount, $dataFromAgent->idToTransaction);
+        self::assertCount($appCodeRequestsCount * $spansCount, $dataFromAgent->idToSpan);
+
+        $intakeApiRequests = $dataFromAgent->getRaw()->getAllIntakeApiRequests();
+        $dbgCtx->add(['intakeApiRequests' => $intakeApiRequests]);
+        self::assertNotEmpty($intakeApiRequests);
+        self::assertLessThanOrEqual($appCodeRequestsCount, count($intakeApiRequests));
+        foreach ($intakeApiRequests as $intakeApiRequest) {
+            self::assertSame($compression, $intakeApiRequest->contentEncoding);
+        }
+    }
 }
@@ -314,4 +314,40 @@ final class PDOAutoInstrumentationTest extends ComponentTestCaseBase
         SpanSequenceValidator::updateExpectationsEndTime($expectedSpans);
         SpanSequenceValidator::assertSequenceAsExpected($expectedSpans, array_values($dataFromAgent->idToSpan));
     }
+
+    public static function appCodeForTestCallsViaSubclass(): void
+    {
+        // Methods inherited from an internal class are copies of the internal class's methods
+        $pdo = new class (self::buildConnectionString(self::MEMORY_DB_NAME)) extends PDO {
+        };
+        self::assertTrue($pdo->setAttribute(PDO::ATTR_ERRMODE, PDO::ERRMODE_EXCEPTION));
+        self::assertSame(0, $pdo->exec(self::CREATE_TABLE_SQL));
+        self::assertNotFalse($queryResult = $pdo->query(self::SELECT_SQL));
+        self::assertSame([], $queryResult->fetchAll());
+    }
+
+    public function testCallsViaSubclass(): void
+    {
+        $testCaseHandle = $this->getTestCaseHandle();
+
+        $expectationsBuilder = new DbSpanExpectationsBuilder(/* dbType: */ 'sqlite', self::MEMORY_DB_NAME);
+        $expectedSpans = [
+            $expectationsBuilder->fromStatement(self::CREATE_TABLE_SQL),
+            $expectationsBuilder->fromStatement(self::SELECT_SQL),
+        ];
+
+        $appCodeHost = $testCaseHandle->ensureMainAppCodeHost(
+            function (AppCodeHostParams $appCodeParams): void {
+                self::disableTimingDependentFeatures($appCodeParams);
+            }
+        );
+        $appCodeHost->sendRequest(AppCodeTarget::asRouted([__CLASS__, 'appCodeForTestCallsViaSubclass']));
+
+        $dataFromAgent = $testCaseHandle->waitForDataFromAgent(
+            (new ExpectedEventCounts())->transactions(1)->spans(count($expectedSpans))
+        );
+
+        SpanSequenceValidator::updateExpectationsEndTime($expectedSpans);
+        SpanSequenceValidator::assertSequenceAsExpected($expectedSpans, array_values($dataFromAgent->idToSpan));
+    }
 }
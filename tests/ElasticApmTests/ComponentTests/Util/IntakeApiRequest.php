@@ -42,6 +42,12 @@ final class IntakeApiRequest implements JsonSerializable, JsonDeserializableInte
     /** @var string */
     public $body;
 
+    /** @var ?string */
+    public $contentEncoding = null;
+
+    /** @var int */
+    public $bodySizeAsReceived;
+
     /** @var float */
     public $timeReceivedAtApmServer;
 
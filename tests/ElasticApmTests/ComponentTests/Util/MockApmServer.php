@@ -51,6 +51,8 @@ final class MockApmServer extends TestInfraHttpServerProcessBase
     public const SET_TEST_SCOPED_BEHAVIOR_URI_SUBPATH = 'set_test_scoped_behavior';
     public const BEHAVIOR_HEADER_NAME = RequestHeadersRawSnapshotSource::HEADER_NAMES_PREFIX . 'behavior';
 
+    private const CONTENT_ENCODING_HEADER_NAME = 'Content-Encoding';
+
     /** @var RawDataFromAgentReceiverEvent[] */
     private $receiverEvents;
 
@@ -160,7 +162,18 @@ final class MockApmServer extends TestInfraHttpServerProcessBase
         $newRequest = new IntakeApiRequest();
         $newRequest->timeReceivedAtApmServer = AmbientContextForTests::clock()->getSystemClockCurrentTime();
         $newRequest->headers = $request->getHeaders();
-        $newRequest->body = $request->getBody()->getContents();
+        $bodyAsReceived = $request->getBody()->getContents();
+        $newRequest->bodySizeAsReceived = strlen($bodyAsReceived);
+        $contentEncoding = $request->getHeaderLine(self::CONTENT_ENCODING_HEADER_NAME);
+        $newRequest->contentEncoding = TextUtil::isEmptyString($contentEncoding) ? null : $contentEncoding;
+        $decodedBody = self::decodeIntakeApiRequestBody($newRequest->contentEncoding, $bodyAsReceived);
+        if ($decodedBody === null) {
+            return $this->buildIntakeApiErrorResponse(
+                HttpConstantsForTests::STATUS_BAD_REQUEST,
+                'Failed to decode Intake API request body; Content-Encoding: ' . $contentEncoding
+            );
+        }
+        $newRequest->body = $decodedBody;
 
         ($loggerProxy = $this->logger->ifDebugLevelEnabled(__LINE__, __FUNCTION__))
         && $loggerProxy->log('Received request for Intake API', ['newRequest' => $newRequest]);
@@ -170,6 +183,24 @@ final class MockApmServer extends TestInfraHttpServerProcessBase
         return new Response(/* status: */ 202);
     }
 
+    private static function decodeIntakeApiRequestBody(?string $contentEncoding, string $bodyAsReceived): ?string
+    {
+        switch ($contentEncoding) {
+            case null:
+                return $bodyAsReceived;
+            case 'gzip':
+                $decoded = gzdecode($bodyAsReceived);
+                break;
+            case 'deflate':
+                // HTTP's "deflate" content coding is the "zlib" format (RFC 1950)
+                $decoded = gzuncompress($bodyAsReceived);
+                break;
+            default:
+                return null;
+        }
+        return is_string($decoded) ? $decoded : null;
+    }
+
     /**
      * @param ServerRequestInterface $request
      *
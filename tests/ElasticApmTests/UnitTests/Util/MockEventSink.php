@@ -28,6 +28,7 @@ use Elastic\Apm\Impl\BreakdownMetrics\PerTransaction as BreakdownMetricsPerTrans
 use Elastic\Apm\Impl\Error;
 use Elastic\Apm\Impl\EventSinkInterface;
 use Elastic\Apm\Impl\Metadata;
+use Elastic\Apm\Impl\MetadataDiscoverer;
 use Elastic\Apm\Impl\MetricSet;
 use Elastic\Apm\Impl\Span;
 use Elastic\Apm\Impl\SpanToSendInterface;
@@ -60,9 +61,9 @@ final class MockEventSink implements EventSinkInterface
     }
 
     /** @inheritDoc */
-    public function consume(Metadata $metadata, array $spans, array $errors, ?BreakdownMetricsPerTransaction $breakdownMetricsPerTransaction, ?Transaction $transaction): void
+    public function consume(MetadataDiscoverer $metadataDiscoverer, array $spans, array $errors, ?BreakdownMetricsPerTransaction $breakdownMetricsPerTransaction, ?Transaction $transaction): void
     {
-        $this->consumeMetadata($metadata);
+        $this->consumeMetadata($metadataDiscoverer->discover());
 
         foreach ($spans as $span) {
             $this->consumeSpan($span);